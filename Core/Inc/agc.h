@@ -0,0 +1,53 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_AGC_H
+#define MY_AGC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Automatic gain ranging while listening. Over each agc_interval_s we count the samples
+ * that come near to clipping and estimate the noise floor, and between recordings step
+ * the PGA down if there was clipping, or up if the site is so quiet that we are wasting
+ * the ADC's range. The trigger thresholds already follow the gain.
+ *
+ * Every change of gain is noted with its position in the stream of samples stored by
+ * data_processor_buffers, so that recordings can say exactly where their gain changed.
+ * A change takes effect within a half frame of the position noted.
+ */
+
+typedef struct {
+	int64_t position;				// From data_processor_buffers_get_write_position.
+	int range;						// The gain range from then on.
+} agc_change_t;
+
+void agc_init(void);
+void agc_start(bool resume);
+void agc_stop(void);
+void agc_note_gain_change(void);
+void agc_main_fast_processing(int main_tick_count);
+void agc_main_processing(int main_tick_count);
+int agc_get_gain_changes(int64_t start, int64_t end, int *pStart_range, agc_change_t changes[], int max_changes);
+
+#endif // MY_AGC_H
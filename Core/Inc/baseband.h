@@ -0,0 +1,53 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_BASEBAND_H
+#define MY_BASEBAND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "data_acquisition.h"
+
+/*
+ * Band limited recording. The band between baseband_low_khz and baseband_high_khz is mixed
+ * down to around 0 Hz with a complex oscillator at its centre, low pass filtered and decimated,
+ * leaving I and Q samples at a fraction of the sampling rate. "baseband_tool up" on a PC
+ * turns such a file back into an ordinary one at the original rate.
+ */
+
+#define BASEBAND_MAX_DECIMATION 32
+#define BASEBAND_MAX_TAPS 256
+
+/**
+ * Receives interleaved I and Q samples as they are produced. count is of int16_t values.
+ */
+typedef void (*baseband_write_t)(void *context, int16_t *pSamples, int count);
+
+void baseband_init(void);
+void baseband_reset(int sampling_rate, baseband_write_t write, void *context);
+void baseband_process(const sample_type_t *pSamples, int count);
+void baseband_flush(void);
+int baseband_get_output_rate(void);
+int baseband_get_centre_hz(void);
+int baseband_get_delay(void);
+
+#endif // MY_BASEBAND_H
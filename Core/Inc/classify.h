@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_CLASSIFY_H
+#define MY_CLASSIFY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "verify.h"
+
+/*
+ * Classification of recordings into species groups, by a small multilayer perceptron over
+ * the call features from verify.c. Everything is integer arithmetic so that the host tools,
+ * which share this code, give exactly the same answers as the logger.
+ *
+ * The model is trained on a PC by host/classifier/classifier_train, which writes
+ * classifier_model.c.
+ */
+
+#define CLASSIFY_FEATURES 6
+#define CLASSIFY_LABEL_LEN 8
+
+typedef struct {
+	int hidden_count;
+	int class_count;
+	const int16_t *input_offsets;		// [CLASSIFY_FEATURES]
+	const int16_t *input_scales;		// q = (x - offset) * scale >> 8, clipped to +/-127.
+	const int8_t *hidden_weights;		// [hidden_count][CLASSIFY_FEATURES]
+	const int32_t *hidden_biases;		// [hidden_count]
+	int hidden_shift;					// Hidden activations are (acc >> shift), clipped to 0..127.
+	const int8_t *output_weights;		// [class_count][hidden_count]
+	const int32_t *output_biases;		// [class_count]
+	int32_t confidence_margin;			// The margin between the top two outputs that means 75%.
+	const char (*labels)[CLASSIFY_LABEL_LEN];
+} classify_model_t;
+
+typedef struct {
+	int class_index;					// -1 if there were no calls to go on.
+	const char *label;					// Empty if class_index is -1.
+	int confidence_percent;				// 50 to 100: how far ahead of the runner up.
+} classify_result_t;
+
+extern const classify_model_t g_classify_model;
+
+void classify_get_inputs(const call_features_t *pFeatures, int16_t inputs[CLASSIFY_FEATURES]);
+void classify_run(const classify_model_t *pModel, const int16_t inputs[CLASSIFY_FEATURES], classify_result_t *pResult);
+void classify(const call_features_t *pFeatures, classify_result_t *pResult);
+
+#endif // MY_CLASSIFY_H
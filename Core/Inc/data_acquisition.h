@@ -30,6 +30,7 @@
 
 typedef uint16_t dma_buffer_type_t;
 typedef int16_t sample_type_t;
+// Data processors get whole frames: count is in samples, ACQUISITION_CHANNELS per frame.
 typedef void(*data_processor_t)(const sample_type_t *, int buffer_offset, int count);
 
 
@@ -51,6 +52,20 @@ void data_acquisition_set_processor(data_processor_t processor);
 #define ACQUISITION_OFFSET 0x8000
 #define ACQUISITION_LEFTSHIFT 0
 
+/*
+ * Set to 2 for a board with a second microphone, for a stereo pair or a reference. ADC1
+ * then scans the second input after the first on each trigger, so the DMA buffer holds
+ * frames of two samples taken together, and recordings are two channel wav files.
+ * The second input's pin needs to be set to analogue in the .ioc. Note that the first
+ * input is differential on IN15/IN16 (PB0/PB1), so the second needs another pin.
+ */
+#define ACQUISITION_CHANNELS 1
+#define ACQUISITION_SECOND_ADC_CHANNEL ADC_CHANNEL_17
+
+#if ACQUISITION_CHANNELS != 1 && ACQUISITION_CHANNELS != 2
+#error ACQUISITION_CHANNELS must be 1 or 2
+#endif
+
 // The following is defined by CMSIS.
 // #define MIN(a, b)  (((a) < (b)) ? (a) : (b))
 // #define MAX(a, b)  (((a) > (b)) ? (a) : (b))
@@ -61,6 +76,7 @@ extern volatile sample_type_t *g_raw_half_frame;
 extern volatile int g_raw_half_frame_size;
 extern volatile int g_raw_half_frame_counter;
 extern volatile bool g_raw_half_frame_ready;
+extern volatile uint32_t g_overload_sample_count;		// Ever, for taking differences.
 
 
 #endif // MY_DATA_ACQUISITION_H
@@ -45,5 +45,11 @@ void data_processor_buffers(const sample_type_t *, int buffer_offset, int count)
 
 bool dataprocessor_buffers_get_next(sample_type_t **buffer);
 void data_processor_buffers_on_recording_complete(int main_tick_count);
+bool data_processor_buffers_is_busy(void);
+int64_t data_processor_buffers_get_write_position(void);
+int64_t data_processor_buffers_get_read_position(void);
+void data_processor_buffers_note_energy(uint32_t energy);
+int data_processor_buffers_find_quietest(int max_buffers);
+int data_processor_buffers_get_lost_count(void);
 
 #endif // MY_DATA_PROCESSOR_BUFFERS_H
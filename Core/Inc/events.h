@@ -0,0 +1,54 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_EVENTS_H
+#define MY_EVENTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Events posted by interrupt handlers (and occasionally main context) to wake up the
+ * main loop. Each fast loop task runs only when one of the events it cares about is
+ * pending, and when nothing is pending the core sleeps with WFI until the next interrupt.
+ *
+ * The SysTick interrupt wakes us every millisecond regardless, which takes care of the
+ * slow MAIN_LOOP_DELAY_MS tick without needing an event of its own.
+ */
+#define EVENT_HALF_FRAME	(1u << 0)		// A half DMA frame of ADC data has been processed.
+#define EVENT_SD			(1u << 1)		// SDMMC interrupt, probably a block transfer completing.
+#define EVENT_USB			(1u << 2)		// USB interrupt: TinyUSB has something queued.
+#define EVENT_RTC			(1u << 3)		// RTC alarm.
+#define EVENT_TRIGGER		(1u << 4)		// The trigger fired; posted from main context.
+
+#define EVENT_ALL			(EVENT_HALF_FRAME | EVENT_SD | EVENT_USB | EVENT_RTC | EVENT_TRIGGER)
+
+void events_init(void);
+void events_post(uint32_t events);
+uint32_t events_take(void);
+void events_wait(uint32_t until_tick);
+
+void events_reset_duty_cycle(void);
+int events_get_duty_cycle_permille(void);
+int events_get_average_duty_cycle_permille(void);
+
+#endif // MY_EVENTS_H
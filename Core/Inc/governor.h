@@ -0,0 +1,57 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_GOVERNOR_H
+#define MY_GOVERNOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Set to 0 to run at full speed all the time, as we did before the governor existed.
+ */
+#define DO_CLOCK_GOVERNOR 1
+
+typedef enum {
+	GOVERNOR_LEVEL_LOW = 0,		// Nothing much going on: LEDs, mode switch, schedule.
+	GOVERNOR_LEVEL_FULL,		// Acquisition, SD, USB.
+	GOVERNOR_LEVEL_LEN
+} governor_level_t;
+
+/*
+ * Reasons for needing the full speed clock. Any hold in place means full speed,
+ * otherwise we drop to the low speed clock.
+ */
+#define GOVERNOR_HOLD_STREAMING		(1u << 0)
+#define GOVERNOR_HOLD_SD			(1u << 1)
+#define GOVERNOR_HOLD_MODE_SWITCH	(1u << 2)
+
+void governor_init(void);
+void governor_hold(uint32_t reason);
+void governor_release(uint32_t reason);
+void governor_on_clocks_reset(void);
+governor_level_t governor_get_level(void);
+uint32_t governor_get_level_hz(governor_level_t level);
+void governor_reset_residency(void);
+uint32_t governor_get_residency_ms(governor_level_t level);
+
+#endif // MY_GOVERNOR_H
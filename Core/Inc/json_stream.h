@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_JSON_STREAM_H
+#define MY_JSON_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * An incremental JSON tokenizer that pulls its input in chunks through a read function,
+ * so the size of the document isn't limited by any buffer. Memory use is fixed: the
+ * chunk, the current key and the current value. The caller pulls one event at a time
+ * and can skip values it isn't interested in, however big they are.
+ */
+
+#define JSON_STREAM_CHUNK_LEN 256
+#define JSON_STREAM_KEY_LEN 32			// Longest key, including the terminator.
+#define JSON_STREAM_VALUE_LEN 128		// Longest string or primitive value, including the terminator.
+#define JSON_STREAM_MAX_DEPTH 8
+
+typedef enum {
+	JSON_STREAM_OBJECT_START,
+	JSON_STREAM_OBJECT_END,
+	JSON_STREAM_ARRAY_START,
+	JSON_STREAM_ARRAY_END,
+	JSON_STREAM_KEY,				// The key is in key.
+	JSON_STREAM_STRING,				// The value is in value, with escapes processed.
+	JSON_STREAM_PRIMITIVE,			// Number, true, false or null, as text in value.
+	JSON_STREAM_END,				// End of a valid document.
+	JSON_STREAM_ERROR				// Invalid, truncated, or a key or value too long for us.
+} json_stream_event_t;
+
+/**
+ * Supply up to len bytes of input, returning the number supplied, or 0 at the end.
+ */
+typedef int (*json_stream_read_t)(void *context, char *buf, int len);
+
+typedef struct {
+	json_stream_read_t read;
+	void *context;
+	const char *string;				// Input for json_stream_init_string.
+	size_t string_len, string_pos;
+
+	char chunk[JSON_STREAM_CHUNK_LEN];
+	int chunk_len, chunk_pos;
+	bool eof;
+	uint32_t offset;				// Bytes consumed, for locating errors.
+
+	uint8_t expecting;
+	bool error;
+	int depth;
+	uint8_t containers[JSON_STREAM_MAX_DEPTH];
+
+	char key[JSON_STREAM_KEY_LEN];
+	char value[JSON_STREAM_VALUE_LEN];
+} json_stream_t;
+
+void json_stream_init(json_stream_t *ps, json_stream_read_t read, void *context);
+void json_stream_init_string(json_stream_t *ps, const char *s);
+json_stream_event_t json_stream_next(json_stream_t *ps);
+json_stream_event_t json_stream_next_value(json_stream_t *ps);
+bool json_stream_skip_value(json_stream_t *ps);
+
+#endif // MY_JSON_STREAM_H
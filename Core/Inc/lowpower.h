@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_LOWPOWER_H
+#define MY_LOWPOWER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Set to 0 to doze between listening windows in the main loop rather than in STOP2,
+ * which is easier for debugging.
+ */
+#define DO_STOP_MODE 1
+
+typedef enum {
+	LOWPOWER_WAKE_TIMER,		// The time we asked for has elapsed.
+	LOWPOWER_WAKE_SWITCH,		// The user moved the mode switch away from auto.
+	LOWPOWER_WAKE_OTHER
+} lowpower_wake_t;
+
+void lowpower_init(void);
+lowpower_wake_t lowpower_stop(uint32_t seconds);
+
+#endif // MY_LOWPOWER_H
@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_LTSA_H
+#define MY_LTSA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Long term spectral average logging: a power spectrum averaged over each minute of
+ * listening. This puts the triggered recordings in the context of the soundscape, and of
+ * the noise, for the whole of each listening interval.
+ *
+ * Each active interval of the schedule gets its own file, named like the recordings after
+ * the time it started, with a .ltsa extension. ltsa_start opens it, and ltsa_end_file
+ * closes it when the interval ends. Duty cycle pauses and profile changes within the
+ * interval carry on in the same file, as they only stop and start the averaging.
+ *
+ * The file is an ltsa_header_t followed by an ltsa_record_t for each minute, with no
+ * padding and all little endian. record_len in the header gives the size of a record.
+ */
+
+#define LTSA_FFT_SIZE_LOG2 8
+#define LTSA_FFT_SIZE (1 << LTSA_FFT_SIZE_LOG2)
+#define LTSA_BINS (LTSA_FFT_SIZE / 2)
+#define LTSA_RECORD_INTERVAL_S 60
+#define LTSA_FILE_VERSION 1
+
+// Levels are in steps of half a dB above LTSA_DB_FLOOR, which is relative to a full scale
+// FFT bin. 0 means at or below the floor.
+#define LTSA_DB_FLOOR (-127.5f)
+#define LTSA_DB_STEP 0.5f
+
+typedef struct {
+	char magic[4];					// "LTSA".
+	uint16_t version;
+	uint16_t fft_size;
+	uint16_t bins;
+	uint16_t record_len;
+	int16_t db_floor_tenths;
+	uint16_t db_step_hundredths;
+	uint16_t year;					// When the file was started.
+	uint8_t month, day;
+	uint8_t hours, minutes, seconds;
+	uint8_t reserved;
+} ltsa_header_t;
+
+typedef struct {
+	uint8_t hours, minutes, seconds;	// When the record was completed.
+	uint8_t gain_range;
+	uint16_t sampling_rate_khz;			// Bin i is centred on i * sampling rate / LTSA_FFT_SIZE.
+	uint16_t window_count;				// FFT windows averaged. Fewer than usual for a part minute.
+	uint8_t levels[LTSA_BINS];
+} ltsa_record_t;
+
+void ltsa_init(void);
+void ltsa_start(int sampling_rate);
+void ltsa_stop(void);
+void ltsa_end_file(void);
+void ltsa_main_fast_processing(int main_tick_count);
+void ltsa_main_processing(int main_tick_count);
+
+#endif // MY_LTSA_H
@@ -66,7 +66,24 @@ extern "C" {
  */
 //#define ITCM_SECTION 		__attribute__((__section__(".itcm_text")))
 //#define DTCM_SECTION 		__attribute__((__section__(".dtcmdata")))
-//#define RAM_TEXT_SECTION 	__attribute__((__section__(".RamFunc")))	// Code in RAM section.
+
+/*
+ * Code that runs for every half frame, in the DMA interrupt or the fast main loop,
+ * runs from SRAM so that how long it takes doesn't depend on what the ICACHE happens
+ * to be holding. The startup code copies .RamFunc to SRAM along with .data, and
+ * hot_paths.c marks the HAL and DSP library functions those paths call. Set
+ * RUN_HOT_PATHS_FROM_RAM to 0 to leave all of it in flash, to compare the profiler's
+ * half_frame_isr, trigger_fast, buffers_fast and sdmmc_isr lines with and without.
+ */
+#define RUN_HOT_PATHS_FROM_RAM 1
+
+#ifndef RAM_TEXT_SECTION
+#if RUN_HOT_PATHS_FROM_RAM
+#define RAM_TEXT_SECTION 	__attribute__((__section__(".RamFunc")))	// Code in RAM section.
+#else
+#define RAM_TEXT_SECTION
+#endif
+#endif
 
 // The following match section names in the .ld script:
 #define RAM_DATA_SECTION 	__attribute__((__section__(".bss")))
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_PROFILER_H
+#define MY_PROFILER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "main.h"
+
+/*
+ * Lightweight profiling using the DWT cycle counter. Set to 0 to compile the
+ * instrumentation out completely.
+ */
+#define DO_PROFILING 1
+
+typedef enum {
+	// Slow main loop hooks:
+	PROFILE_MODE_MAIN = 0,
+	PROFILE_MANUAL_MODE_MAIN,
+	PROFILE_USB_MODE_MAIN,
+	PROFILE_AUTO_MODE_MAIN,
+	PROFILE_LEDS_MAIN,
+	PROFILE_STORAGE_MAIN,
+	PROFILE_RECORDING_MAIN,
+	PROFILE_SD_LOWLEVEL_MAIN,
+	PROFILE_LTSA_MAIN,
+	PROFILE_SECOND_PASS_MAIN,
+	PROFILE_THUMBNAIL_MAIN,
+	PROFILE_AGC_MAIN,
+	PROFILE_STORM_MAIN,
+
+	// Fast loop hooks:
+	PROFILE_USB_MODE_FAST,
+	PROFILE_AUTO_MODE_FAST,
+	PROFILE_SD_LOWLEVEL_FAST,
+	PROFILE_RECORDING_FAST,
+	PROFILE_TRIGGER_FAST,
+	PROFILE_BUFFERS_FAST,
+	PROFILE_LTSA_FAST,
+	PROFILE_AGC_FAST,
+
+	// Interrupt context:
+	PROFILE_HALF_FRAME,
+	PROFILE_APC_SOF,
+	PROFILE_SDMMC_ISR,			// Includes the SD Tx/Rx complete callbacks.
+
+	PROFILE_LEN
+} profile_id_t;
+
+// Histogram buckets are powers of two of cycle counts: bucket n counts durations
+// of 2^n to 2^(n+1)-1 cycles. The last bucket catches everything longer.
+#define PROFILE_HISTOGRAM_BUCKETS 24
+
+#if DO_PROFILING
+#define PROFILE_START() const uint32_t _profile_start_cycles = DWT->CYCCNT
+#define PROFILE_END(id) profiler_record(id, DWT->CYCCNT - _profile_start_cycles)
+#define PROFILE(id, statement) do { \
+		const uint32_t _profile_cycles = DWT->CYCCNT; \
+		statement; \
+		profiler_record(id, DWT->CYCCNT - _profile_cycles); \
+	} while (0)
+#else
+#define PROFILE_START()
+#define PROFILE_END(id)
+#define PROFILE(id, statement) do { statement; } while (0)
+#endif
+
+void profiler_init(void);
+void profiler_reset(void);
+void profiler_record(profile_id_t id, uint32_t cycles);
+size_t profiler_get_report_header(char *buf, size_t buflen);
+size_t profiler_get_report_line(profile_id_t id, char *buf, size_t buflen);
+
+#endif // MY_PROFILER_H
@@ -33,6 +33,7 @@ void recording_start(void);
 #endif
 void recording_stop(bool go_to_standby);
 void recording_close(void);
+void recording_reopen(void);
 
 void recording_main_processing(int);
 
@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_RETAINED_H
+#define MY_RETAINED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "settings.h"
+
+/*
+ * State that survives hard standby, held in backup SRAM. Each block has a header
+ * so we can tell whether what is there is ours and intact: backup SRAM contents
+ * are undefined after power up.
+ */
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t size;
+	uint32_t checksum;
+} retained_header_t;
+
+typedef struct {
+	retained_header_t header;
+	uint32_t schedule_hash;				// Hash of the schedule.json content this was parsed from.
+	int entry_count;
+	schedule_entry_t entries[MAX_SCHEDULE_INTERVALS];	// Unresolved, as solar times vary by date.
+	int64_t next_wakeup_epoch;			// Where we set the alarm for, 0 if we haven't.
+} retained_schedule_t;
+
+typedef struct {
+	retained_header_t header;
+	char firmware_version[16];			// The layout and defaults of settings_t can change between versions.
+	bool file_present;					// settings.json as it was when we parsed it:
+	uint32_t file_size;
+	uint32_t file_timestamp;			// FAT date and time packed together.
+	settings_t settings;				// Including the calculated fields.
+	int profile_count;
+	settings_profile_t profiles[SETTINGS_MAX_PROFILES];
+} retained_settings_t;
+
+void retained_init(void);
+bool retained_is_standby_wake(void);
+bool retained_take_standby_wake(void);
+uint32_t retained_hash(const void *p, size_t len);
+
+const retained_schedule_t *retained_get_schedule(void);
+void retained_save_schedule(uint32_t schedule_hash, const schedule_entry_t entries[], int count);
+void retained_set_next_wakeup(time_t epoch);
+void retained_invalidate_schedule(void);
+
+const retained_settings_t *retained_get_settings(void);
+void retained_save_settings(bool file_present, uint32_t file_size, uint32_t file_timestamp,
+		const settings_t *pSettings, const settings_profile_t profiles[], int profile_count);
+void retained_invalidate_settings(void);
+
+#endif // MY_RETAINED_H
@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_RUNTIME_CONFIG_H
+#define MY_RUNTIME_CONFIG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "settings.h"
+
+/*
+ * What the half frame interrupt and the trigger need from the settings, the gain range and
+ * the trigger storm level, worked out once instead of on every half frame or window. It is
+ * built at the start of each listening session, and again when the profile, the gain or the
+ * storm level changes. The hot paths take a pointer to it once per call and find it
+ * consistent, because a change builds a new one and then swaps the pointer.
+ */
+typedef struct {
+	// The trigger. Bucket i takes part if bit i of the mask is set, and its thresholds are
+	// power values, adjusted for the gain range and any storm:
+	trigger_pipeline_t trigger_pipeline;
+	trigger_channel_t trigger_channel;
+	uint32_t trigger_bucket_mask;
+	q31_t trigger_thresholds[MAX_TRIGGER_MATCH_CLAUSES];
+	float32_t trigger_thresholds_f32[MAX_TRIGGER_MATCH_CLAUSES];
+	int trigger_max_count;
+
+	// The buffers, with times as buffer counts at the session's sampling rate:
+	bool gated_recording;
+	int buffers_per_second;
+	int pretrigger_buffers;
+	int min_sampling_buffers;
+	int hangover_buffers;
+} runtime_config_t;
+
+void runtime_config_start_session(int samples_per_second);
+void runtime_config_update(void);
+const runtime_config_t *runtime_config_get(void);
+
+#endif // MY_RUNTIME_CONFIG_H
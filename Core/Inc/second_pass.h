@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_SECOND_PASS_H
+#define MY_SECOND_PASS_H
+
+#include <stdbool.h>
+
+/*
+ * Second pass verification and classification of recordings, once they are written. The
+ * trigger has to be cheap, so it lets through a lot of noise. Rather than look closer at
+ * everything on its way to the SD card, we read each wav file back while the logger is idle,
+ * then discard it, or label it and keep it.
+ */
+
+void second_pass_init(void);
+bool second_pass_add(const char *base_name);
+void second_pass_main_processing(int main_tick_count);
+bool second_pass_is_idle(void);
+void second_pass_get_counts(int *pKept, int *pDiscarded);
+
+#endif // MY_SECOND_PASS_H
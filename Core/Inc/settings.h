@@ -25,6 +25,7 @@
 
 #include <arm_math.h>
 #include "stdbool.h"
+#include "json_stream.h"
 
 #define MAX_TRIGGER_MATCH_CLAUSES 16
 #define SETTINGS_TRIGGER_MATCH_LEN 128
@@ -35,6 +36,31 @@
 #define SETTINGS_MIN_SAMPLING_RATE_INDEX 5
 #define SETTINGS_MAX_SAMPLING_RATE_INDEX 11
 
+#define SETTINGS_MAX_PROFILES 4
+#define SETTINGS_PROFILE_NAME_LEN 16
+#define SETTINGS_NO_PROFILE (-1)			// Use the settings without any profile.
+#define SETTINGS_UNKNOWN_PROFILE (-2)
+
+typedef enum {
+	RECORDING_FORMAT_WAV = 0,
+	RECORDING_FORMAT_ZC,				// Zero crossing only: much less data.
+	RECORDING_FORMAT_WAV_ZC,
+	RECORDING_FORMAT_BASEBAND			// I and Q for just the band of interest, at a lower sampling rate.
+} recording_format_t;
+
+// Which microphone the trigger listens to, on boards built with two:
+typedef enum {
+	TRIGGER_CHANNEL_FIRST = 0,
+	TRIGGER_CHANNEL_SECOND,
+	TRIGGER_CHANNEL_EITHER				// Whichever is louder, half frame by half frame.
+} trigger_channel_t;
+
+// How the trigger works out the power in each frequency bucket:
+typedef enum {
+	TRIGGER_PIPELINE_Q15 = 0,			// Fixed point FFT.
+	TRIGGER_PIPELINE_FLOAT				// FPU FFT, which keeps its precision for quiet calls.
+} trigger_pipeline_t;
+
 typedef struct {
 	float max_sampling_time_s;
 	float min_sampling_time_s;
@@ -49,6 +75,30 @@ typedef struct {
 	float pretrigger_time_s;
 	int logger_sampling_rate_index;
 	bool gated_recording;
+	bool write_profile_to_sd;
+	int listen_window_s;			// Duty cycled listening in auto mode: 0 to listen all the time.
+	int listen_period_s;
+	bool listen_adaptive;			// Keep listening while there is activity.
+	recording_format_t recording_format;
+	int zc_division_ratio;
+	int zc_hysteresis;				// In ADC counts either side of zero.
+	int zc_band_low_khz;			// Band pass filter ahead of zero crossing detection. 0 for no limit.
+	int zc_band_high_khz;
+	int baseband_low_khz;			// The band to keep with RECORDING_FORMAT_BASEBAND.
+	int baseband_high_khz;
+	bool ltsa_enabled;				// Log a long term spectral average while listening in auto mode.
+	bool thumbnails;				// Write a spectrogram image for each recording.
+	bool verify_enabled;			// Discard wav recordings that a second, closer look finds no calls in.
+	int verify_min_calls;
+	int verify_tonality_db;			// How far a call has to stand out from the rest of the spectrum.
+	bool classify_enabled;			// Label wav recordings with a species group, in the GUANO and catalogue.csv.
+	bool agc_enabled;				// Step the gain between recordings to suit the site.
+	int agc_interval_s;				// How long we look before deciding on a change.
+	trigger_channel_t trigger_channel;
+	float split_search_time_s;		// How early before max_sampling_time_s to look for a quiet place to split. 0 to cut at the limit.
+	float hangover_time_s;			// How long a file runs on after a retrigger.
+	int storm_files_per_hour;		// Recordings we keep in any hour before holding back. 0 for no limit.
+	trigger_pipeline_t trigger_pipeline;
 
 	// Some calculated fields:
 	q31_t _trigger_thresholds[MAX_TRIGGER_MATCH_CLAUSES];	// Values for comparison with FFT buckets.
@@ -57,6 +107,41 @@ typedef struct {
 	bool _location_present;
 } settings_t;
 
+/*
+ * The settings that a named profile in settings.json can override.
+ */
+typedef enum {
+	SETTINGS_PROFILE_MAX_SAMPLING_TIME = 1 << 0,
+	SETTINGS_PROFILE_MIN_SAMPLING_TIME = 1 << 1,
+	SETTINGS_PROFILE_PRETRIGGER_TIME = 1 << 2,
+	SETTINGS_PROFILE_SENSITIVITY_RANGE = 1 << 3,
+	SETTINGS_PROFILE_SENSITIVITY_DISABLE = 1 << 4,
+	SETTINGS_PROFILE_TRIGGER_MAX_COUNT = 1 << 5,
+	SETTINGS_PROFILE_TRIGGER = 1 << 6,
+	SETTINGS_PROFILE_TRIGGER_THRESHOLDS = 1 << 7,
+	SETTINGS_PROFILE_SAMPLING_RATE = 1 << 8,
+	SETTINGS_PROFILE_TRIGGER_PIPELINE = 1 << 9
+} settings_profile_field_t;
+
+/*
+ * A profile as parsed, with the trigger strings already compiled into tables. This is
+ * compact enough to keep in backup SRAM along with the settings.
+ */
+typedef struct {
+	char name[SETTINGS_PROFILE_NAME_LEN];
+	uint32_t overridden;				// settings_profile_field_t flags for the values present.
+	float max_sampling_time_s;
+	float min_sampling_time_s;
+	float pretrigger_time_s;
+	int sensitivity_range;
+	bool sensitivity_disable;
+	int trigger_max_count;
+	int logger_sampling_rate_index;
+	trigger_pipeline_t trigger_pipeline;
+	q31_t _trigger_thresholds[MAX_TRIGGER_MATCH_CLAUSES];
+	bool _trigger_flags[MAX_TRIGGER_MATCH_CLAUSES];
+} settings_profile_t;
+
 /*
  * Minutes are in the range 0 to 24 * 60 - 1.
  * If the end minutes are less than the start, that means it spans midnight.
@@ -64,13 +149,47 @@ typedef struct {
 typedef struct {
 	int start_minutes;
 	int duration_minutes;		// Use duration rather than end time to make midnight wrapping easier.
+	int profile;				// Index of the profile to use, or SETTINGS_NO_PROFILE.
 } schedule_interval_t;
 
+#define MINUTES_PER_DAY (24 * 60)
+
+/*
+ * A schedule time as written in schedule.json: either a clock time, or a time relative
+ * to a solar event which has to be resolved for each date.
+ */
+typedef enum {
+	SCHEDULE_ANCHOR_CLOCK = 0,		// offset_minutes is minutes into the day.
+	SCHEDULE_ANCHOR_SUNRISE,
+	SCHEDULE_ANCHOR_SUNSET,
+	SCHEDULE_ANCHOR_DAWN,			// Civil dawn.
+	SCHEDULE_ANCHOR_DUSK			// Civil dusk.
+} schedule_anchor_t;
+
+typedef struct {
+	schedule_anchor_t anchor;
+	int offset_minutes;				// Can be negative for solar anchors.
+} schedule_time_t;
+
+typedef struct {
+	schedule_time_t from, to;
+	char profile[SETTINGS_PROFILE_NAME_LEN];	// Empty for none.
+} schedule_entry_t;
+
 void settings_init(void);
 const settings_t *settings_get(void);
+void settings_restore(const settings_t *pSettings, const settings_profile_t profiles[], int profile_count);
+const settings_profile_t *settings_get_profiles(int *pCount);
+int settings_find_profile(const char *name);
+void settings_select_profile(int profile);
+int settings_get_selected_profile(void);
 bool settings_parse_and_process_json_settings(const char *json_string);
+bool settings_parse_and_process_json_stream(json_stream_read_t read, void *context);
 size_t settings_get_json_settings_string(char *buf, size_t buflen);
-int settings_parse_and_normalize_schedule(const char *json, schedule_interval_t intervals[]);
+int settings_parse_schedule(const char *json, schedule_entry_t entries[]);
+bool settings_schedule_uses_solar(const schedule_entry_t entries[], int count);
+int settings_resolve_schedule(const schedule_entry_t entries[], int count, int year, int month, int day,
+		schedule_interval_t resultant_intervals[]);
 int settings_get_logger_sampling_rate(void);
 
 #endif /* INC_SETTINGS_H_ */
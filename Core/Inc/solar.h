@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_SOLAR_H
+#define MY_SOLAR_H
+
+#include <stdbool.h>
+
+/*
+ * Times of sunrise, sunset and civil dawn/dusk for a given day and location.
+ * Times are minutes after midnight UTC, and can fall outside the range 0 to 24*60-1
+ * depending on longitude, so normalise them before use.
+ *
+ * In polar regions the sun may not rise or set at all on a given day, in which case
+ * the corresponding _valid flag is false.
+ */
+typedef struct {
+	bool sunrise_sunset_valid;
+	int sunrise_minutes;
+	int sunset_minutes;
+	bool dawn_dusk_valid;
+	int dawn_minutes;
+	int dusk_minutes;
+} solar_day_t;
+
+void solar_init(void);
+const solar_day_t *solar_get_day(int year, int month, int day, double latitude, double longitude);
+
+#endif // MY_SOLAR_H
@@ -33,10 +33,25 @@ FX_MEDIA *storage_mount(storage_write_type_t bandwidth);
 void storage_unmount(bool clean_unmount);
 void storage_flush(FX_MEDIA *pMedium);
 FX_FILE *storage_open_wav_file(FX_MEDIA *pMedium, FX_FILE *pFile, int sampling_rate, const char *trigger);
+FX_FILE *storage_open_baseband_file(FX_MEDIA *pMedium, FX_FILE *pFile, int sampling_rate,
+		int centre_hz, int source_rate, int delay, const char *trigger);
 void storage_close_wav_file(FX_MEDIA *pMedium, FX_FILE *pFile);
 void storage_clean_up_wav_file(FX_MEDIA *pMedium, FX_FILE *pFile);
+void storage_discard_closed_files(FX_MEDIA *pMedium, const char *base_name);
+bool storage_find_wav_data(FX_FILE *pFile, int *pSamplingRate, ULONG *pDataOffset, ULONG *pFrames);
 void storage_wav_file_append_data(FX_FILE *pFile, int16_t *pBuffer, int len);
+FX_FILE *storage_open_zc_file(FX_MEDIA *pMedium, FX_FILE *pFile, int division_ratio);
+void storage_zc_file_append_data(FX_FILE *pFile, const uint8_t *pData, int len);
+void storage_close_zc_file(FX_MEDIA *pMedium, FX_FILE *pFile);
+void storage_clean_up_zc_file(FX_MEDIA *pMedium, FX_FILE *pFile);
+const char *storage_get_last_wav_base_name(void);
+void storage_set_wav_auto_id(FX_MEDIA *pMedium, const char *base_name, const char *species, int confidence);
+void storage_set_gain_changes(int64_t start, int sample_count);
+bool storage_append_file(FX_MEDIA *pMedium, const char *pName, const void *pHeader, int header_len,
+		const void *pData, int len);
+void storage_get_base_name(char *buf, size_t buflen);
 void storage_write_settings(FX_MEDIA *pMedium);
+void storage_write_profile(FX_MEDIA *pMedium);
 bool storage_sd_card_present(void);
 bool storage_get_debounced_sd_present(void);
 void storage_main_processing(int);
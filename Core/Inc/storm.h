@@ -0,0 +1,45 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_STORM_H
+#define MY_STORM_H
+
+#include <stdbool.h>
+
+/*
+ * Trigger storm control. Insect choruses and the like can keep retriggering all night, and
+ * fill the card with back to back recordings. We count the recordings kept over the last
+ * hour and the last ten minutes, and when the ten minutes are on course to go over
+ * storm_files_per_hour we step up: first by raising the trigger thresholds, 6 dB a step,
+ * then by recording only one new trigger in 2, 4, 8 or 16, without extending recordings
+ * for retriggers. Once the hour has used up its budget, nothing more is recorded until it
+ * has room again. Each decision is logged to storm.csv.
+ */
+
+void storm_init(void);
+void storm_note_file(void);
+bool storm_admit_trigger(void);
+bool storm_admit_retrigger(void);
+int storm_get_threshold_shift(void);
+void storm_main_processing(int main_tick_count);
+
+#endif // MY_STORM_H
@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_THUMBNAIL_H
+#define MY_THUMBNAIL_H
+
+#include <stdbool.h>
+
+/*
+ * Small spectrogram images of recordings, so that a card full of recordings can be
+ * browsed without processing each one on a PC. Each is a greyscale binary PGM next
+ * to its wav file, with the same name. Frequency increases upwards and louder is lighter.
+ */
+
+#define THUMBNAIL_WIDTH 160
+#define THUMBNAIL_HEIGHT 64
+
+void thumbnail_init(void);
+void thumbnail_add(const char *base_name);
+void thumbnail_main_processing(int main_tick_count);
+
+#endif // MY_THUMBNAIL_H
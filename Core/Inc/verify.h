@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_VERIFY_H
+#define MY_VERIFY_H
+
+#include <stdbool.h>
+#include "data_acquisition.h"
+
+/*
+ * Second pass verification of recordings. The trigger has to be cheap so it lets through a
+ * lot of noise; this looks more closely at what was actually recorded, and recordings that
+ * contain nothing that looks like a bat call are discarded rather than kept.
+ */
+
+/*
+ * Averages over the calls found, as features for classification.
+ */
+typedef struct {
+	int call_count;
+	int start_khz;
+	int end_khz;
+	int peak_khz;					// Where the call is loudest.
+	int bandwidth_khz;
+	int duration_tenths_ms;
+	int calls_per_10s;
+} call_features_t;
+
+void verify_init(void);
+void verify_reset(int sampling_rate);
+void verify_process(const sample_type_t *pSamples, int count);
+bool verify_passed(void);
+int verify_get_call_count(void);
+void verify_get_features(call_features_t *pFeatures);
+
+#endif // MY_VERIFY_H
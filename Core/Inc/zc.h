@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_ZC_H
+#define MY_ZC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "data_acquisition.h"
+
+/*
+ * Zero crossing division of the recorded data, the way Anabat detectors do it, encoded
+ * as Anabat file data: one interval per division_ratio cycles of the signal.
+ */
+
+#define ZC_MIN_DIVISION_RATIO 1
+#define ZC_MAX_DIVISION_RATIO 64
+#define ZC_ANABAT_RES1 25000			// The only time base readers accept: intervals are in us.
+
+/**
+ * Receives encoded data as it is produced.
+ */
+typedef void (*zc_write_t)(void *context, const uint8_t *data, int len);
+
+void zc_init(void);
+void zc_reset(int sampling_rate, zc_write_t write, void *context);
+void zc_process(const sample_type_t *pSamples, int count);
+void zc_flush(void);
+int zc_get_division_ratio(void);
+
+#endif // MY_ZC_H
@@ -45,6 +45,7 @@
 #include "adc.h"
 
 /* USER CODE BEGIN 0 */
+#include "data_acquisition.h"		// For ACQUISITION_CHANNELS.
 
 /* USER CODE END 0 */
 
@@ -110,6 +111,22 @@ void MX_ADC1_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN ADC1_Init 2 */
+#if ACQUISITION_CHANNELS > 1
+  // A second microphone: convert it straight after the first on each timer trigger:
+  hadc1.Init.ScanConvMode = ADC_SCAN_ENABLE;
+  hadc1.Init.NbrOfConversion = 2;
+  if (HAL_ADC_Init(&hadc1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sConfig.Channel = ACQUISITION_SECOND_ADC_CHANNEL;
+  sConfig.Rank = ADC_REGULAR_RANK_2;
+  sConfig.SingleDiff = ADC_SINGLE_ENDED;
+  if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+#endif
 
   /* USER CODE END ADC1_Init 2 */
 
@@ -217,6 +234,16 @@ void HAL_ADC_MspInit(ADC_HandleTypeDef* adcHandle)
     }
 
   /* USER CODE BEGIN ADC1_MspInit 1 */
+#if ACQUISITION_CHANNELS > 1
+    // With two conversions per timer trigger, the ADC has to pace the DMA rather than the
+    // timer, otherwise the second conversion waits for the next trigger and overruns:
+    HAL_DMAEx_List_UnLinkQ(&handle_GPDMA1_Channel0);
+    Node_GPDMA1_Channel0.LinkRegisters[NODE_CTR2_DEFAULT_OFFSET] &= ~DMA_CTR2_TRIGPOL;
+    if (HAL_DMAEx_List_LinkQ(&handle_GPDMA1_Channel0, &List_GPDMA1_Channel0) != HAL_OK)
+    {
+      Error_Handler();
+    }
+#endif
 
   /* USER CODE END ADC1_MspInit 1 */
   }
@@ -0,0 +1,221 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "agc.h"
+#include "gain.h"
+#include "settings.h"
+#include "data_acquisition.h"
+#include "data_processor_buffers.h"
+
+/*
+ * The noise floor is the quietest of the short blocks in an interval: bat calls and other
+ * sounds only fill a fraction of the blocks, so the quietest ones are background.
+ * Levels are mean absolute sample values.
+ */
+#define HALF_FRAMES_PER_BLOCK 16
+#define QUIET_FLOOR 32					// About -60 dB full scale: room for more gain.
+#define NOISY_FLOOR 1024				// About -30 dB: the noise is eating the headroom.
+#define MAX_OVERLOAD_PPM 10				// Samples near clipping we put up with, per million.
+
+// Gain changes we remember, which need to cover the longest recording:
+#define HISTORY_LEN 16
+
+static bool s_running = false;
+static int s_pending_range = -1;		// A gain to apply on the next tick.
+static int s_learned_range = -1;		// Where we got to, to carry over a pause.
+
+static int s_last_half_frame_counter = 0;
+static int s_interval_start_half_frame = 0;
+static uint32_t s_interval_start_overloads = 0;
+static uint32_t s_block_sum = 0;
+static int s_block_samples = 0;
+static int s_block_half_frames = 0;
+static uint32_t s_floor = UINT32_MAX;
+
+static agc_change_t s_history[HISTORY_LEN];
+static int s_history_count = 0;
+static int s_history_next = 0;
+
+static void start_interval(void)
+{
+	s_interval_start_half_frame = g_raw_half_frame_counter;
+	s_interval_start_overloads = g_overload_sample_count;
+	s_block_sum = 0;
+	s_block_samples = 0;
+	s_block_half_frames = 0;
+	s_floor = UINT32_MAX;
+}
+
+static void add_to_history(int64_t position, int range)
+{
+	s_history[s_history_next].position = position;
+	s_history[s_history_next].range = range;
+	s_history_next = (s_history_next + 1) % HISTORY_LEN;
+	if (s_history_count < HISTORY_LEN)
+		s_history_count++;
+}
+
+void agc_init(void)
+{
+	s_running = false;
+	s_pending_range = -1;
+	s_learned_range = -1;
+	s_history_count = 0;
+	s_history_next = 0;
+}
+
+/**
+ * Call when listening starts, once the data processor buffers have been reset and
+ * streaming has set the gain from the settings. On resuming after a pause, we go
+ * back to the gain we had got to rather than starting again from the settings.
+ */
+void agc_start(bool resume)
+{
+	s_history_count = 0;
+	s_history_next = 0;
+	add_to_history(0, gain_get_range());
+
+	s_pending_range = -1;
+	if (!resume)
+		s_learned_range = -1;
+	else if (s_learned_range >= 0 && settings_get()->agc_enabled && !settings_get()->sensitivity_disable) {
+		// Not now: streaming has only just sent the PGA its gain and the SPI may still be busy.
+		s_pending_range = s_learned_range;
+	}
+
+	s_last_half_frame_counter = g_raw_half_frame_counter;
+	start_interval();
+	s_running = true;
+}
+
+void agc_stop(void)
+{
+	s_running = false;
+}
+
+/**
+ * Note a change of gain made by someone else, such as a change of profile.
+ */
+void agc_note_gain_change(void)
+{
+	add_to_history(data_processor_buffers_get_write_position(), gain_get_range());
+	s_learned_range = gain_get_range();
+	start_interval();
+}
+
+void agc_main_fast_processing(int main_tick_count)
+{
+	(void) main_tick_count;
+
+	if (!s_running || !settings_get()->agc_enabled || g_raw_half_frame_counter == s_last_half_frame_counter)
+		return;
+	s_last_half_frame_counter = g_raw_half_frame_counter;
+
+	const sample_type_t *pSamples = (const sample_type_t *) g_raw_half_frame;
+	const int count = g_raw_half_frame_size;
+	if (pSamples == NULL)
+		return;
+
+	uint32_t sum = 0;
+	for (int i = 0; i < count; i++)
+		sum += abs(pSamples[i]);
+	s_block_sum += sum;
+	s_block_samples += count;
+
+	if (++s_block_half_frames >= HALF_FRAMES_PER_BLOCK) {
+		const uint32_t level = s_block_sum / s_block_samples;
+		if (level < s_floor)
+			s_floor = level;
+		s_block_sum = 0;
+		s_block_samples = 0;
+		s_block_half_frames = 0;
+	}
+}
+
+static void change_gain(bool up)
+{
+	if (up ? gain_up() : gain_down())
+		agc_note_gain_change();
+	else
+		start_interval();		// Already at the limit.
+}
+
+void agc_main_processing(int main_tick_count)
+{
+	(void) main_tick_count;
+
+	const settings_t *pSettings = settings_get();
+	if (!s_running || !pSettings->agc_enabled || pSettings->sensitivity_disable)
+		return;
+
+	if (s_pending_range >= 0) {
+		gain_set(s_pending_range, false);
+		s_pending_range = -1;
+		agc_note_gain_change();
+		return;
+	}
+
+	// Is the interval up? Half frames are counted in the interrupt so this doesn't depend on
+	// how promptly we are called:
+	const int half_frames = g_raw_half_frame_counter - s_interval_start_half_frame;
+	const int64_t samples = (int64_t) half_frames * g_raw_half_frame_size;
+	if (samples < (int64_t) pSettings->agc_interval_s * settings_get_logger_sampling_rate() || s_floor == UINT32_MAX)
+		return;
+
+	// Only between recordings. Until then, the interval stretches:
+	if (data_processor_buffers_is_busy())
+		return;
+
+	const uint32_t overloads = g_overload_sample_count - s_interval_start_overloads;
+	if ((int64_t) overloads * 1000000 > samples * MAX_OVERLOAD_PPM || s_floor > NOISY_FLOOR)
+		change_gain(false);
+	else if (overloads == 0 && s_floor < QUIET_FLOOR)
+		change_gain(true);
+	else
+		start_interval();
+}
+
+/**
+ * The gain at the start of a run of samples, and the changes during it. Returns the number
+ * of changes, up to max_changes.
+ */
+int agc_get_gain_changes(int64_t start, int64_t end, int *pStart_range, agc_change_t changes[], int max_changes)
+{
+	const int oldest = (s_history_next - s_history_count + HISTORY_LEN) % HISTORY_LEN;
+
+	// If the start is older than we remember, the oldest gain we know of is the best guess:
+	*pStart_range = s_history_count > 0 ? s_history[oldest].range : gain_get_range();
+
+	int count = 0;
+	for (int n = 0; n < s_history_count; n++) {
+		const agc_change_t *pChange = &s_history[(oldest + n) % HISTORY_LEN];
+		if (pChange->position <= start)
+			*pStart_range = pChange->range;
+		else if (pChange->position < end && count < max_changes)
+			changes[count++] = *pChange;
+	}
+
+	return count;
+}
@@ -0,0 +1,248 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <arm_math.h>
+
+#include "baseband.h"
+#include "settings.h"
+
+/*
+ * The samples are mixed with cos and -sin from a table, which gives I and Q with the centre
+ * of the band at 0 Hz. Mixing a real signal leaves half of it there and half at twice the
+ * centre frequency, so the low pass filter has a gain of 2 to restore the level of the band.
+ *
+ * The filter works a block at a time, the way CMSIS's own FIR decimators do: each block is
+ * mixed into the end of a buffer that starts with the last tap count - 1 mixed samples of the
+ * previous block, so the inputs for every output are contiguous for arm_dot_prod_q15. Only the
+ * outputs we keep are computed.
+ */
+
+#define BLOCK_LEN 512
+#define OUTPUT_BUFFER_LEN 2048				// I and Q values, flushed when a block might not fit.
+#define NCO_TABLE_LEN_LOG2 10				// Spurs from the phase truncation are about 60 dB down.
+#define NCO_TABLE_LEN (1 << NCO_TABLE_LEN_LOG2)
+#define MIN_BANDWIDTH_HZ 1000
+#define MIN_DECIMATION 2
+
+static q15_t s_cos_table[NCO_TABLE_LEN];
+static uint32_t s_phase = 0;
+static uint32_t s_phase_increment = 0;
+
+static q15_t s_taps[BASEBAND_MAX_TAPS];
+static int s_tap_count = 1;
+static int s_tap_shift = 0;					// Extra bits of precision the taps are scaled up by.
+static q15_t s_i[BASEBAND_MAX_TAPS - 1 + BLOCK_LEN];
+static q15_t s_q[BASEBAND_MAX_TAPS - 1 + BLOCK_LEN];
+static int s_next_output = 0;				// Index in the next block of the input for the next output.
+
+static int s_sampling_rate = 0;
+static int s_centre_hz = 0;
+static int s_decimation = MIN_DECIMATION;
+
+static baseband_write_t s_write = NULL;
+static void *s_write_context = NULL;
+static int16_t s_output[OUTPUT_BUFFER_LEN];
+static int s_output_len = 0;
+
+_Static_assert(OUTPUT_BUFFER_LEN >= 2 * (BLOCK_LEN / MIN_DECIMATION + 1), "Output buffer too small for a block");
+
+void baseband_init(void)
+{
+	for (int i = 0; i < NCO_TABLE_LEN; i++)
+		s_cos_table[i] = (q15_t) lrintf(32767.0f * cosf(2.0f * (float) M_PI * i / NCO_TABLE_LEN));
+
+	s_write = NULL;
+	s_output_len = 0;
+}
+
+/**
+ * Tap m of a Hamming windowed sinc low pass filter with the cutoff as a fraction of the
+ * sampling rate.
+ */
+static float window_sinc(int m, int tap_count, float cutoff)
+{
+	const float x = m - (tap_count - 1) / 2.0f;
+	const float sinc = x == 0.0f ? 2.0f * cutoff : sinf(2.0f * (float) M_PI * cutoff * x) / ((float) M_PI * x);
+	const float window = 0.54f - 0.46f * cosf(2.0f * (float) M_PI * m / (tap_count - 1));
+	return sinc * window;
+}
+
+static void design_filter(float cutoff_hz, float transition_hz)
+{
+	// The usual estimate of the length a Hamming window needs, odd for a whole sample of delay:
+	int tap_count = (int) ceilf(3.3f * s_sampling_rate / transition_hz) | 1;
+	if (tap_count > BASEBAND_MAX_TAPS - 1)
+		tap_count = BASEBAND_MAX_TAPS - 1;
+	s_tap_count = tap_count;
+
+	const float cutoff = cutoff_hz / s_sampling_rate;
+	float sum = 0.0f, largest = 0.0f;
+	for (int m = 0; m < tap_count; m++) {
+		const float tap = window_sinc(m, tap_count, cutoff);
+		sum += tap;
+		if (fabsf(tap) > largest)
+			largest = fabsf(tap);
+	}
+
+	// A gain of 2, as above. The taps are small, so scale them up for precision and shift
+	// the output down to match:
+	const float gain = 2.0f / sum;
+	float scale = gain;
+	s_tap_shift = 0;
+	while (largest * scale * 2.0f < 0.99f && s_tap_shift < 15) {
+		scale *= 2.0f;
+		s_tap_shift++;
+	}
+
+	for (int m = 0; m < tap_count; m++)
+		s_taps[m] = (q15_t) lrintf(window_sinc(m, tap_count, cutoff) * scale * 32767.0f);
+}
+
+/**
+ * Start afresh, for a new file, with the band from the settings.
+ */
+void baseband_reset(int sampling_rate, baseband_write_t write, void *context)
+{
+	const settings_t *pSettings = settings_get();
+
+	s_sampling_rate = sampling_rate;
+	const float nyquist_hz = sampling_rate / 2.0f;
+	float high_hz = pSettings->baseband_high_khz * 1000.0f;
+	if (high_hz > nyquist_hz)
+		high_hz = nyquist_hz;
+	float low_hz = pSettings->baseband_low_khz * 1000.0f;
+	if (low_hz > high_hz - MIN_BANDWIDTH_HZ)
+		low_hz = high_hz - MIN_BANDWIDTH_HZ;
+	const float bandwidth_hz = high_hz - low_hz;
+	s_centre_hz = lrintf((low_hz + high_hz) / 2.0f);
+
+	// After mixing the band spans +-bandwidth/2. Leave a quarter of the bandwidth again for
+	// the filter to fall away before aliases would land in the band:
+	s_decimation = (int) (sampling_rate / (1.25f * bandwidth_hz));
+	if (s_decimation < MIN_DECIMATION)
+		s_decimation = MIN_DECIMATION;
+	if (s_decimation > BASEBAND_MAX_DECIMATION)
+		s_decimation = BASEBAND_MAX_DECIMATION;
+	const float output_rate = (float) sampling_rate / s_decimation;
+	float transition_hz = output_rate - bandwidth_hz;
+	if (transition_hz < output_rate / 8.0f)
+		transition_hz = output_rate / 8.0f;		// Wide bands lose their edges rather than alias.
+	design_filter(output_rate / 2.0f, transition_hz);
+
+	s_phase = 0;
+	s_phase_increment = (uint32_t) ((double) s_centre_hz / sampling_rate * 4294967296.0);
+	memset(s_i, 0, sizeof(s_i));
+	memset(s_q, 0, sizeof(s_q));
+	s_next_output = 0;
+
+	s_write = write;
+	s_write_context = context;
+	s_output_len = 0;
+}
+
+int baseband_get_output_rate(void)
+{
+	return s_sampling_rate / s_decimation;
+}
+
+int baseband_get_centre_hz(void)
+{
+	return s_centre_hz;
+}
+
+/**
+ * How many input samples the output lags by, for lining the two up.
+ */
+int baseband_get_delay(void)
+{
+	return (s_tap_count - 1) / 2;
+}
+
+void baseband_flush(void)
+{
+	if (s_output_len > 0 && s_write)
+		s_write(s_write_context, s_output, s_output_len);
+	s_output_len = 0;
+}
+
+static void mix_block(const sample_type_t *pSamples, int count)
+{
+	q15_t *pI = s_i + s_tap_count - 1;
+	q15_t *pQ = s_q + s_tap_count - 1;
+	for (int i = 0; i < count; i++) {
+		const int index = s_phase >> (32 - NCO_TABLE_LEN_LOG2);
+		const int32_t c = s_cos_table[index];
+		const int32_t s = s_cos_table[(index - NCO_TABLE_LEN / 4) & (NCO_TABLE_LEN - 1)];	// sin(x) = cos(x - pi/2)
+		const int32_t x = pSamples[i];
+		// The table stops short of -1, so these can't overflow:
+		pI[i] = (q15_t) ((x * c) >> 15);
+		pQ[i] = (q15_t) ((-x * s) >> 15);
+		s_phase += s_phase_increment;
+	}
+}
+
+static inline int16_t to_output(q63_t acc)
+{
+	const q63_t value = acc >> (15 + s_tap_shift);
+	return value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : (int16_t) value;
+}
+
+static void filter_block(int count)
+{
+	if (s_output_len > OUTPUT_BUFFER_LEN - 2 * (BLOCK_LEN / MIN_DECIMATION + 1))
+		baseband_flush();
+
+	int i = s_next_output;
+	for (; i < count; i += s_decimation) {
+		q63_t i_acc, q_acc;
+		arm_dot_prod_q15(s_i + i, s_taps, s_tap_count, &i_acc);
+		arm_dot_prod_q15(s_q + i, s_taps, s_tap_count, &q_acc);
+		s_output[s_output_len++] = to_output(i_acc);
+		s_output[s_output_len++] = to_output(q_acc);
+	}
+	s_next_output = i - count;
+
+	// Keep the tail of this block for the start of the next:
+	memmove(s_i, s_i + count, (s_tap_count - 1) * sizeof(q15_t));
+	memmove(s_q, s_q + count, (s_tap_count - 1) * sizeof(q15_t));
+}
+
+/**
+ * Process the next samples for the file. I and Q go to the write function supplied to
+ * baseband_reset whenever our buffer fills: call baseband_flush at the end of the file
+ * for the rest.
+ */
+void baseband_process(const sample_type_t *pSamples, int count)
+{
+	if (!s_write)
+		return;
+
+	while (count > 0) {
+		const int block = count < BLOCK_LEN ? count : BLOCK_LEN;
+		mix_block(pSamples, block);
+		filter_block(block);
+		pSamples += block;
+		count -= block;
+	}
+}
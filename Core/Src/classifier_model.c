@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Generated by host/classifier/classifier_train from prototypes.csv.
+ * Don't edit: train a new model instead.
+ */
+
+#include "classify.h"
+
+static const int16_t s_input_offsets[6] = { 64, 41, 47, 24, 126, 88 };
+
+static const int16_t s_input_scales[6] = { 420, 419, 444, 528, 72, 274 };
+
+static const int8_t s_hidden_weights[96] = {
+		 -28,   -3,  -26,  -14,  -49,  -14,
+		 -53,  -56,  -53,  -29,  -21,   16,
+		 -36,   45,  -21,   -5,    7,  -10,
+		  54,   19,   25,   63,  -24,   11,
+		  40,   31,   11,  -23,   52,    7,
+		  47,   -1,  -10,   45,  -24,   18,
+		  17,   14,   22,  -28,   32,    3,
+		   6,  121,   26,  -19,   46,   13,
+		   7,   45,   23,  -12,   54,   -7,
+		   4,   -8,   22,   -2,  -80,   29,
+		  22,   -3,    3,   -5,  -10,    3,
+		 -30,  -12,  -35,  -38,  127,  -32,
+		   3,   16,   37,  -17,   47,    6,
+		  31,  -38,   11,   56,  -21,    9,
+		  21,    4,   95,   11,  -52,   -5,
+		 -30,  -35,   -7,   -5,   22,   12
+};
+
+static const int32_t s_hidden_biases[16] = {
+		3234, 425, 3856, 2687, 504, 2638, 1906, 5280,
+		3726, 3163, -350, 1355, 2700, -1140, 4708, 965
+};
+
+static const int8_t s_output_weights[80] = {
+		  -4,  -86,   47,   31,  -34,   24,   -6,  119,   37,    2,   -8,  -42,    7,  -66,    6,  -39,
+		 -38,  -30,  -60,   82,   -5,   74,  -25,  -78,  -43,   17,   12,  -12,  -22,   72,   52,   -9,
+		  15,   80,   21,  -24,   -4,  -24,   -9,  -56,  -29,  -66,   -4,  102,  -22,   -8, -127,   35,
+		 -56,   -9,   -5,  -16,   70,  -34,   61,   75,   60,  -46,    3,   79,   68,  -13,   27,   14,
+		  59,   49,    0,  -82,    1,  -24,  -19,  -65,  -52,   86,   10, -122,  -36,   -2,   39,   -5
+};
+
+static const int32_t s_output_biases[5] = {
+		388, -215, -70, -346, 243
+};
+
+static const char s_labels[5][CLASSIFY_LABEL_LEN] = { "Pip", "Myo", "NSL", "Rhi", "Plec" };
+
+const classify_model_t g_classify_model = {
+		.hidden_count = 16,
+		.class_count = 5,
+		.input_offsets = s_input_offsets,
+		.input_scales = s_input_scales,
+		.hidden_weights = s_hidden_weights,
+		.hidden_biases = s_hidden_biases,
+		.hidden_shift = 8,
+		.output_weights = s_output_weights,
+		.output_biases = s_output_biases,
+		.confidence_margin = 459,
+		.labels = s_labels
+};
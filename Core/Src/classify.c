@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "classify.h"
+
+#define MAX_HIDDEN 32
+
+static inline int clip(int v, int min, int max)
+{
+	return v < min ? min : v > max ? max : v;
+}
+
+/**
+ * The features in the order the model takes them.
+ */
+void classify_get_inputs(const call_features_t *pFeatures, int16_t inputs[CLASSIFY_FEATURES])
+{
+	inputs[0] = pFeatures->start_khz;
+	inputs[1] = pFeatures->end_khz;
+	inputs[2] = pFeatures->peak_khz;
+	inputs[3] = pFeatures->bandwidth_khz;
+	inputs[4] = pFeatures->duration_tenths_ms;
+	inputs[5] = pFeatures->calls_per_10s;
+}
+
+/**
+ * Run the model. Kept separate from the model in the firmware so that the trainer can check
+ * its quantized models with exactly this code.
+ */
+void classify_run(const classify_model_t *pModel, const int16_t inputs[CLASSIFY_FEATURES], classify_result_t *pResult)
+{
+	int8_t q[CLASSIFY_FEATURES];
+	for (int i = 0; i < CLASSIFY_FEATURES; i++)
+		q[i] = clip(((int32_t) (inputs[i] - pModel->input_offsets[i]) * pModel->input_scales[i]) >> 8, -127, 127);
+
+	int8_t hidden[MAX_HIDDEN];
+	const int hidden_count = pModel->hidden_count < MAX_HIDDEN ? pModel->hidden_count : MAX_HIDDEN;
+	for (int h = 0; h < hidden_count; h++) {
+		int32_t acc = pModel->hidden_biases[h];
+		const int8_t *pw = pModel->hidden_weights + h * CLASSIFY_FEATURES;
+		for (int i = 0; i < CLASSIFY_FEATURES; i++)
+			acc += pw[i] * q[i];
+		hidden[h] = clip(acc >> pModel->hidden_shift, 0, 127);
+	}
+
+	int best = -1, second = -1;
+	int32_t best_output = 0, second_output = 0;
+	for (int c = 0; c < pModel->class_count; c++) {
+		int32_t acc = pModel->output_biases[c];
+		const int8_t *pw = pModel->output_weights + c * pModel->hidden_count;
+		for (int h = 0; h < hidden_count; h++)
+			acc += pw[h] * hidden[h];
+
+		if (best < 0 || acc > best_output) {
+			second = best;
+			second_output = best_output;
+			best = c;
+			best_output = acc;
+		}
+		else if (second < 0 || acc > second_output) {
+			second = c;
+			second_output = acc;
+		}
+	}
+
+	pResult->class_index = best;
+	pResult->label = best >= 0 ? pModel->labels[best] : "";
+
+	// A hyperbola rather than a sigmoid, to keep to integers: 50% for a tie, 75% at the
+	// model's confidence margin, tending to 100%:
+	const int64_t k = pModel->confidence_margin > 0 ? pModel->confidence_margin : 1;
+	const int64_t margin = second >= 0 ? (int64_t) best_output - second_output : k * 100;
+	pResult->confidence_percent = 100 - (int) ((50 * k) / (margin + k));
+}
+
+/**
+ * Classify a recording from the features of its calls.
+ */
+void classify(const call_features_t *pFeatures, classify_result_t *pResult)
+{
+	if (pFeatures->call_count == 0) {
+		pResult->class_index = -1;
+		pResult->label = "";
+		pResult->confidence_percent = 0;
+		return;
+	}
+
+	int16_t inputs[CLASSIFY_FEATURES];
+	classify_get_inputs(pFeatures, inputs);
+	classify_run(&g_classify_model, inputs, pResult);
+}
@@ -20,6 +20,7 @@
  * SOFTWARE.
  */
 
+#include "main.h"
 #include "cmplx_mag_squared.h"
 
 /**
@@ -32,7 +33,7 @@
  * This function i sheavily inspired by the CMSIS function arm_cmplx_mag_q15, with the square root removed.
  */
 
-void cmplx_mag_squared_q15_q31(
+RAM_TEXT_SECTION void cmplx_mag_squared_q15_q31(
   q15_t * pSrc,
   q31_t * pDst,
   uint32_t numSamples)
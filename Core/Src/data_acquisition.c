@@ -1,11 +1,15 @@
 #include "data_acquisition.h"
 #include "main.h"
 #include "adc.h"
+#include <stdlib.h>
 #include <arm_math.h>
 
 #include "storage.h"
 #include "leds.h"
 #include "gain.h"
+#include "events.h"
+#include "profiler.h"
+#include "runtime_config.h"
 
 
 // Round up a value to a multiple of 32 bytes:
@@ -48,7 +52,7 @@
 
 #define MAX_SAMPLES_PER_FRAME (SETTINGS_SAMPLING_RATE_MULTIPLIER_KHZ * SETTINGS_MAX_SAMPLING_RATE_INDEX)
 
-RAM_DATA_SECTION dma_buffer_type_t g_dmabuffer1[ROUNDUP32(MAX_SAMPLES_PER_FRAME + DMABUFFER_GUARD_COUNT, sizeof(dma_buffer_type_t))] __ALIGNED(32);
+RAM_DATA_SECTION dma_buffer_type_t g_dmabuffer1[ROUNDUP32(MAX_SAMPLES_PER_FRAME * ACQUISITION_CHANNELS + DMABUFFER_GUARD_COUNT, sizeof(dma_buffer_type_t))] __ALIGNED(32);
 // SRAM4_DATA_SECTION dma_buffer_type_t dmabuffer4[ROUNDUP32(MAX_SAMPLES_PER_FRAME + DMABUFFER_GUARD_COUNT, sizeof(dma_buffer_type_t))] __ALIGNED(32);
 
 // Stuff relating to DSP using the library CMSIS:
@@ -96,7 +100,11 @@ static q15_t s_filtered_buffer1_q15[MAX_SAMPLES_PER_FRAME];
 
 #endif
 
-static sample_type_t s_raw_buffer_q15[MAX_SAMPLES_PER_FRAME];
+static sample_type_t s_raw_buffer_q15[MAX_SAMPLES_PER_FRAME * ACQUISITION_CHANNELS];		// Frames, as in the DMA buffer.
+#if ACQUISITION_CHANNELS > 1
+// A channel at a time, for the analysis that works on one, so that it reads contiguous memory:
+static sample_type_t s_channel_q15[ACQUISITION_CHANNELS][MAX_SAMPLES_PER_FRAME];
+#endif
 
 static data_processor_t s_data_processor = NULL;
 
@@ -110,6 +118,7 @@ volatile sample_type_t *g_raw_half_frame = NULL;
 volatile int g_raw_half_frame_size = 0;
 volatile int g_raw_half_frame_counter = 0;
 volatile bool g_raw_half_frame_ready = false;
+volatile uint32_t g_overload_sample_count = 0;
 
 static int s_half_samples_per_frame = 0;		// Dumb initialisation value so it is obvious if we fail to set this.
 
@@ -118,11 +127,12 @@ static int s_half_samples_per_frame = 0;		// Dumb initialisation value so it is
  *
  * Their job is to copy the fresh data from the DMA buffer to another
  * buffer, in DTCM, before it gets overwritten by the next DMA cycle.
+ * They run from SRAM, as does what they call for every half frame.
  */
 
 static int s_conv_counter = 0;
 
-void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
+RAM_TEXT_SECTION void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
 {
 	if (s_enable_capture) {
 		if (hadc == &hadc1)
@@ -138,7 +148,7 @@ void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
 	}
 }
 
-void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+RAM_TEXT_SECTION void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
 {
 	if (s_enable_capture) {
 		if (hadc == &hadc1)
@@ -233,16 +243,45 @@ void data_acquisition_set_processor(data_processor_t processor)
 static uint16_t v_s = 0;
 #endif
 
-static void process_half_frame(bool is_first_half, const dma_buffer_type_t *dmabuffer,
+RAM_TEXT_SECTION static void process_half_frame(bool is_first_half, const dma_buffer_type_t *dmabuffer,
 		sample_type_t offset, int leftshift)
 {
+	PROFILE_START();
+
 	// A half DMA buffer is ready for us:
 	const int buffer_offset = is_first_half ? 0 : s_half_samples_per_frame;
 	const int samples_to_process = s_half_samples_per_frame;
 
 	// Basic scale and offset to end up with sample_type_t:
 	// TODO consider replacing the following with CMSIS vector operations, or writing our own composite one.
-	bool overload_detected = false;
+	uint32_t overload_count = 0;
+#if ACQUISITION_CHANNELS > 1
+	// Keep the frames for recording, and separate the channels out as we go. We also note
+	// each channel's peak so that the trigger can follow the louder one:
+	const dma_buffer_type_t *pSource = dmabuffer + buffer_offset * ACQUISITION_CHANNELS;
+	sample_type_t *pDest = s_raw_buffer_q15 + buffer_offset * ACQUISITION_CHANNELS;
+	sample_type_t *pFirst = s_channel_q15[0] + buffer_offset;
+	sample_type_t *pSecond = s_channel_q15[1] + buffer_offset;
+	int first_peak = 0, second_peak = 0;
+	for (int i = 0; i < s_half_samples_per_frame; i++) {
+		const sample_type_t first = ((*pSource++ - (dma_buffer_type_t) offset) << leftshift) - s_signal_offset_correction;
+		const sample_type_t second = ((*pSource++ - (dma_buffer_type_t) offset) << leftshift) - s_signal_offset_correction;
+		*pDest++ = first;
+		*pDest++ = second;
+		*pFirst++ = first;
+		*pSecond++ = second;
+		if (first > SCALE_DOWN_THRESHOLD_UPPER || first < SCALE_DOWN_THRESHOLD_LOWER)
+			overload_count++;
+		if (second > SCALE_DOWN_THRESHOLD_UPPER || second < SCALE_DOWN_THRESHOLD_LOWER)
+			overload_count++;
+		first_peak = MAX(first_peak, abs(first));
+		second_peak = MAX(second_peak, abs(second));
+	}
+
+	const trigger_channel_t trigger_channel = runtime_config_get()->trigger_channel;
+	const int analysis_channel = trigger_channel == TRIGGER_CHANNEL_SECOND
+			|| (trigger_channel == TRIGGER_CHANNEL_EITHER && second_peak > first_peak) ? 1 : 0;
+#else
 	const dma_buffer_type_t *pSource = dmabuffer + buffer_offset;
 	sample_type_t *pDest = s_raw_buffer_q15 + buffer_offset;
 	for (int i = 0; i < s_half_samples_per_frame; i++) {
@@ -255,17 +294,23 @@ static void process_half_frame(bool is_first_half, const dma_buffer_type_t *dmab
 		sample_type_t scaled_value = ((value - (dma_buffer_type_t) offset) << leftshift) - s_signal_offset_correction;
 		*pDest++ = scaled_value;
 		if (scaled_value > SCALE_DOWN_THRESHOLD_UPPER || scaled_value < SCALE_DOWN_THRESHOLD_LOWER)
-			overload_detected = true;
+			overload_count++;
 	}
+#endif
 
-	if (overload_detected) {
+	if (overload_count > 0) {
+		g_overload_sample_count += overload_count;
 #if BLINK_LEDS
 		leds_blink(LEDS_RED);
 #endif
 	}
 
-	// Flag globally that a raw data buffer is ready:
+	// Flag globally that a raw data buffer is ready. This is a single channel:
+#if ACQUISITION_CHANNELS > 1
+	g_raw_half_frame = s_channel_q15[analysis_channel] + buffer_offset;
+#else
 	g_raw_half_frame = s_raw_buffer_q15 + buffer_offset;
+#endif
 	g_raw_half_frame_size = s_half_samples_per_frame;
 	g_raw_half_frame_counter++;
 	g_raw_half_frame_ready = true;
@@ -284,9 +329,12 @@ static void process_half_frame(bool is_first_half, const dma_buffer_type_t *dmab
 
 	// Pass the data through to the processor:
 	if (s_data_processor != NULL) {
-		s_data_processor(pBufferToUse, buffer_offset, s_half_samples_per_frame);
+		s_data_processor(pBufferToUse, buffer_offset * ACQUISITION_CHANNELS, s_half_samples_per_frame * ACQUISITION_CHANNELS);
 	}
 
+	// Wake up the main loop to deal with the new data:
+	events_post(EVENT_HALF_FRAME);
+
 // TODO investigate this further. USB interrupt can show as pending even though it has more priority (0).
 #if 0
     uint32_t p = NVIC_GetPriority(USB_IRQn);
@@ -310,4 +358,5 @@ static void process_half_frame(bool is_first_half, const dma_buffer_type_t *dmab
     }
 #endif
 
+	PROFILE_END(PROFILE_HALF_FRAME);
 }
@@ -21,10 +21,13 @@
  */
 
 #include <stdatomic.h>
+#include <string.h>
 #include "data_processor_buffers.h"
 #include "trigger.h"
 #include "main.h"
 #include "leds.h"
+#include "storm.h"
+#include "runtime_config.h"
 
 #define BLINK_LEDS 1
 
@@ -110,8 +113,14 @@ static data_processor_mode_t s_mode = DATA_PROCESSOR_TRIGGERED;
 static volatile bool s_is_gated = false;
 static volatile int s_gate_released_ticks = 0;
 static volatile int s_trigger_count = 0;	// For debugging.
+static int s_lost_buffer_count = 0;			// Since boot: buffers overwritten before they could be written to SD.
 
-static int s_buffers_per_second = 0;
+static int32_t s_last_read_unwrapped_index = 0;		// The last buffer we handed out for writing.
+
+// The loudest trigger energy seen in each buffer, for finding quiet places to split files.
+// Indexed the same as s_buffers. Cleared in interrupt context as a buffer starts filling,
+// raised in main context as the trigger looks at the data:
+static volatile uint32_t s_buffer_energy[NUM_BUFFERS];
 
 static void data_processor_buffers_on_trigger(int main_tick_count);
 
@@ -135,8 +144,11 @@ void data_processor_buffers_reset(data_processor_mode_t mode, int samples_per_se
 	s_buffer_fifo_next_read = s_buffer_fifo_next_write = s_buffer_fifo_count = 0;
 	s_is_triggered = false;
 	s_trigger_unwrapped_buffer_count = s_final_unwrapped_buffer_for_trigger = 0;
+	s_last_read_unwrapped_index = 0;
+	memset((void *) s_buffer_energy, 0, sizeof(s_buffer_energy));
 
-	s_buffers_per_second = samples_per_second / DATA_BUFFER_ENTRIES;
+	// A new session, and the buffer counts for its sampling rate:
+	runtime_config_start_session(samples_per_second);
 
 
 	// No need to initialize_buffers to zero as .bss data is zeroed on startup.
@@ -152,6 +164,86 @@ void data_processor_buffers_fast_main_processing(int main_tick_count)
 	}
 }
 
+/**
+ * Is a triggered recording in progress, or data from one still waiting to be written?
+ */
+bool data_processor_buffers_is_busy(void)
+{
+	return g_trigger_triggered || s_is_triggered || s_is_gated || s_buffer_fifo_count > 0;
+}
+
+/**
+ * How many buffers queued for writing have been overwritten by new data before they could be
+ * written, since boot. Anything other than zero means the SD card isn't keeping up.
+ */
+int data_processor_buffers_get_lost_count(void)
+{
+	return s_lost_buffer_count;
+}
+
+/**
+ * How many samples have been stored since the last reset: a position in the stream of samples
+ * that buffers are cut from, for lining up events with recordings.
+ */
+int64_t data_processor_buffers_get_write_position(void)
+{
+	// Both change in the interrupt handler:
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	const int64_t position = (int64_t) s_unwrapped_filled_buffer_counter * DATA_BUFFER_ENTRIES + s_active_buffer_entry_count;
+	__set_PRIMASK(primask);
+
+	return position;
+}
+
+/**
+ * The position of the first sample of the buffer that dataprocessor_buffers_get_next last
+ * handed out.
+ */
+int64_t data_processor_buffers_get_read_position(void)
+{
+	return (int64_t) s_last_read_unwrapped_index * DATA_BUFFER_ENTRIES;
+}
+
+/**
+ * The trigger calls this with the energy it found in the half frame that has just arrived,
+ * which is nearly always in the buffer being filled. Near the edges of a buffer the odd
+ * value may land next door, which doesn't matter for finding the quiet ones.
+ */
+RAM_TEXT_SECTION void data_processor_buffers_note_energy(uint32_t energy)
+{
+	const int index = s_active_buffer_index;
+	if (energy > s_buffer_energy[index])
+		s_buffer_energy[index] = energy;
+}
+
+/**
+ * Look at the buffer that dataprocessor_buffers_get_next last handed out and the ones filled
+ * after it, up to max_buffers in all, and return how far along the quietest one is: 0 for the
+ * one just handed out. Stops at the end of a triggered sequence, and prefers later buffers on
+ * a tie so that files run long. Returns -1 if there is nothing to choose from.
+ */
+int data_processor_buffers_find_quietest(int max_buffers)
+{
+	int32_t last = s_unwrapped_filled_buffer_counter - 1;		// The last completely filled buffer.
+	if (s_mode == DATA_PROCESSOR_TRIGGERED && s_final_unwrapped_buffer_for_trigger < last)
+		last = s_final_unwrapped_buffer_for_trigger;
+	if (last > s_last_read_unwrapped_index + max_buffers - 1)
+		last = s_last_read_unwrapped_index + max_buffers - 1;
+
+	int quietest = -1;
+	uint32_t quietest_energy = UINT32_MAX;
+	for (int32_t i = s_last_read_unwrapped_index; i <= last; i++) {
+		const uint32_t energy = s_buffer_energy[i % NUM_BUFFERS];
+		if (energy <= quietest_energy) {
+			quietest_energy = energy;
+			quietest = i - s_last_read_unwrapped_index;
+		}
+	}
+
+	return quietest;
+}
+
 static inline int add_and_wrap(int i, int delta, int modulo)
 {
 	i += delta;
@@ -165,7 +257,7 @@ static inline int add_and_wrap(int i, int delta, int modulo)
  * Accordingly, instructions are carefully ordered and atomic increments/decrements are used for
  * variables also accessed from the main context.
  */
-static void buffer_fifo_put(int32_t unwrapped_buffer_index) {
+RAM_TEXT_SECTION static void buffer_fifo_put(int32_t unwrapped_buffer_index) {
 	s_buffer_fifo[s_buffer_fifo_next_write] = unwrapped_buffer_index;
 	s_buffer_fifo_next_write = add_and_wrap(s_buffer_fifo_next_write, 1, BUFFER_FIFO_LENGTH);
 	atomic_fetch_add(&s_buffer_fifo_count, 1); //	s_buffer_fifo_count++;
@@ -200,7 +292,7 @@ static bool buffer_fifo_sniff(int32_t* unwrapped_buffer_index) {
  * This function is called in interrupt context when ADC/DMA has read a new half frame of data
  * from input. We add the data into the buffers managed by this module.
  */
-void data_processor_buffers(const sample_type_t *pDMABuffer, int dma_buffer_offset, int count)
+RAM_TEXT_SECTION void data_processor_buffers(const sample_type_t *pDMABuffer, int dma_buffer_offset, int count)
 {
 	// TODO consider replacing the following with CMSIS vector operations, or writing our own composite one.
 
@@ -209,7 +301,7 @@ void data_processor_buffers(const sample_type_t *pDMABuffer, int dma_buffer_offs
 
 	// We could improve this to avoid the extra intermediate buffer. Rainy day stuff.
 
-	bool gated_recording = settings_get()->gated_recording;
+	bool gated_recording = runtime_config_get()->gated_recording;
 	if (gated_recording) {
 		if (s_is_gated) {
 			// Don't fill buffers when we are paused - the data is being
@@ -239,6 +331,7 @@ void data_processor_buffers(const sample_type_t *pDMABuffer, int dma_buffer_offs
 
 		s_active_buffer_ptr = &s_buffers[s_active_buffer_index][0];
 		s_active_buffer_entry_count = 0;
+		s_buffer_energy[s_active_buffer_index] = 0;
 
 		if (s_mode == DATA_PROCESSOR_TRIGGERED) {
 			// In triggered mode, populate the fifo subject to trigger logic.
@@ -326,7 +419,7 @@ void data_processor_buffers_on_recording_complete(int main_tick_count) {
 		buffer_fifo_put(BUFFERFIFO_START_SEQUENCE);
 	else if (s_mode == DATA_PROCESSOR_TRIGGERED) {
 		// Make sure the follow on file is at least the minimum length:
-		int minimum = s_unwrapped_filled_buffer_counter + s_buffers_per_second * settings_get()->min_sampling_time_s;
+		int minimum = s_unwrapped_filled_buffer_counter + runtime_config_get()->min_sampling_buffers;
 		if (s_final_unwrapped_buffer_for_trigger < minimum)
 			s_final_unwrapped_buffer_for_trigger = minimum;
 
@@ -348,7 +441,7 @@ bool dataprocessor_buffers_get_next(sample_type_t **pBuffer) {
 	*pBuffer = NULL;
 
 	// If we are not in concurrent_mode mode: do nothing until we are paused:
-	bool gated_recording = settings_get()->gated_recording;
+	bool gated_recording = runtime_config_get()->gated_recording;
 	if (gated_recording && !s_is_gated) {
 		return false;
 	}
@@ -373,6 +466,7 @@ bool dataprocessor_buffers_get_next(sample_type_t **pBuffer) {
 		// + 1 to exclude the buffer that is currently being written to.
 		if (unwrapped_buffer_index < s_unwrapped_filled_buffer_counter - NUM_BUFFERS + 1) {
 			buffer_fifo_get(&unwrapped_buffer_index);	// Consume the value to discard it.
+			s_lost_buffer_count++;
 			continue;
 		}
 
@@ -403,6 +497,7 @@ bool dataprocessor_buffers_get_next(sample_type_t **pBuffer) {
 		if (gated_recording) {
 			s_is_new_sequence = false;
 			buffer_fifo_get(&unwrapped_buffer_index);	// Consume the value for the caller.
+			s_last_read_unwrapped_index = unwrapped_buffer_index;
 			*pBuffer = (sample_type_t *) &s_buffers[read_buffer_index];
 			return false;
 		}
@@ -413,6 +508,7 @@ bool dataprocessor_buffers_get_next(sample_type_t **pBuffer) {
 			if ((!s_is_new_sequence) || (lead < MAXIMUM_READ_LEAD)) {
 				s_is_new_sequence = false;
 				buffer_fifo_get(&unwrapped_buffer_index);	// Consume the value for the caller.
+				s_last_read_unwrapped_index = unwrapped_buffer_index;
 				*pBuffer = (sample_type_t *) &s_buffers[read_buffer_index];
 				return false;
 			}
@@ -429,6 +525,7 @@ bool dataprocessor_buffers_get_next(sample_type_t **pBuffer) {
 static void data_processor_buffers_on_trigger(int main_tick_count) {
 
 	const int tick_delta = 10;
+	const runtime_config_t *pc = runtime_config_get();
 
 	if (s_is_gated || (main_tick_count < s_gate_released_ticks + tick_delta)) {
 		// Ignore triggers while we are writing to SD card, in case they are self
@@ -445,12 +542,18 @@ static void data_processor_buffers_on_trigger(int main_tick_count) {
 	if (s_is_triggered) {
 
 		/*
-		 * We are currently triggered, so this is a retrigger. We need to recalculate the
-		 * last unwrapped buffer count.
+		 * We are currently triggered, so this is a retrigger. Run on for the hangover time
+		 * from here, but never cut short what we already promised, which includes the
+		 * minimum length from the first trigger. In a trigger storm, let it finish.
 		 */
 
-		s_final_unwrapped_buffer_for_trigger =
-				s_unwrapped_filled_buffer_counter + s_buffers_per_second * settings_get()->min_sampling_time_s;
+		if (!storm_admit_retrigger())
+			return;
+
+		const int32_t final_buffer_count =
+				s_unwrapped_filled_buffer_counter + pc->hangover_buffers;
+		if (s_final_unwrapped_buffer_for_trigger < final_buffer_count)
+			s_final_unwrapped_buffer_for_trigger = final_buffer_count;
 	}
 	else {
 
@@ -459,17 +562,20 @@ static void data_processor_buffers_on_trigger(int main_tick_count) {
 		 * that we need to write to file. The range may be extended if there is a retrigger.
 		 */
 
+		if (!storm_admit_trigger())
+			return;
+
 		// Note the current buffer number when we received the trigger:
 		s_trigger_unwrapped_buffer_count = s_unwrapped_filled_buffer_counter;
 
 		// How much history is available that we can use for the pretrigger?
 		uint32_t unexpired_buffers_available = MIN(NUM_BUFFERS - BUFFER_DELTA, s_unwrapped_filled_buffer_counter);
-		uint32_t pretrigger_buffer_count = MIN(s_buffers_per_second * settings_get()->pretrigger_time_s, unexpired_buffers_available);
+		uint32_t pretrigger_buffer_count = MIN((uint32_t) pc->pretrigger_buffers, unexpired_buffers_available);
 
 		// Calculate the start and end unwrapped buffer count for this trigger. Note that it can be extended
 		// later by a retrigger.
 		uint32_t initial_buffer_count = s_unwrapped_filled_buffer_counter - pretrigger_buffer_count;
-		uint32_t final_buffer_count = s_unwrapped_filled_buffer_counter + s_buffers_per_second * settings_get()->min_sampling_time_s;
+		uint32_t final_buffer_count = s_unwrapped_filled_buffer_counter + pc->min_sampling_buffers;
 
 		// Signal that this is the start of a triggered sequence:
 		buffer_fifo_put(BUFFERFIFO_START_SEQUENCE);
@@ -60,5 +60,13 @@ void data_processor_uac_reset(void)
  */
 void data_processor_uac(const sample_type_t *pDataBuffer, int buffer_offset, int count)
 {
+#if ACQUISITION_CHANNELS > 1
+	// USB audio is mono, so send the channel the trigger is listening to:
+	(void) pDataBuffer;
+	(void) buffer_offset;
+	(void) count;
+	tud_audio_write((const void *) g_raw_half_frame, g_raw_half_frame_size * sizeof(*pDataBuffer));
+#else
 	tud_audio_write((const void *) (pDataBuffer + buffer_offset), count * sizeof(*pDataBuffer));
+#endif
 }
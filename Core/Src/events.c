@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "main.h"
+#include "events.h"
+#include <stdatomic.h>
+
+/*
+ * Set to 0 to go back to spinning in the fast loop, which can be handy when debugging
+ * as some debug probes lose the plot when the core sleeps.
+ */
+#define SLEEP_WHEN_IDLE 1
+
+// Period over which we measure the duty cycle:
+#define DUTY_CYCLE_WINDOW_MS 1000
+
+static atomic_uint s_pending = 0;
+
+/*
+ * Duty cycle measurement. The DWT cycle counter only counts while the core is clocked,
+ * so it is a natural way to measure time awake. We compare that with elapsed SysTick time
+ * to get the fraction of time awake. Cycles are converted to microseconds at the end of
+ * each awake span so that changes to SystemCoreClock don't skew things.
+ */
+static uint32_t s_awake_start_cycles = 0;
+static uint32_t s_window_start_tick = 0;
+static uint32_t s_window_awake_us = 0;
+static int s_duty_cycle_permille = 1000;
+
+static uint32_t s_total_start_tick = 0;
+static uint64_t s_total_awake_us = 0;
+
+void events_init(void)
+{
+	atomic_store(&s_pending, 0);
+
+	// Enable the DWT cycle counter:
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	events_reset_duty_cycle();
+}
+
+/**
+ * Safe to call from interrupt context.
+ */
+RAM_TEXT_SECTION void events_post(uint32_t events)
+{
+	atomic_fetch_or(&s_pending, events);
+}
+
+/**
+ * Return the pending events and clear them. Consumers still check their own
+ * state flags, so a spurious event just means a task runs and finds nothing to do.
+ */
+uint32_t events_take(void)
+{
+	return atomic_exchange(&s_pending, 0);
+}
+
+static void note_awake_end(void)
+{
+	const uint32_t cycles = DWT->CYCCNT - s_awake_start_cycles;		// Wraps safely.
+	const uint32_t cycles_per_us = SystemCoreClock / 1000000;
+	if (cycles_per_us > 0) {
+		const uint32_t us = cycles / cycles_per_us;
+		s_window_awake_us += us;
+		s_total_awake_us += us;
+	}
+}
+
+static void note_awake_start(void)
+{
+	s_awake_start_cycles = DWT->CYCCNT;
+
+	const uint32_t now = HAL_GetTick();
+	const uint32_t elapsed_ms = now - s_window_start_tick;
+	if (elapsed_ms >= DUTY_CYCLE_WINDOW_MS) {
+		int permille = s_window_awake_us / elapsed_ms;		// us per ms is permille.
+		s_duty_cycle_permille = permille > 1000 ? 1000 : permille;
+		s_window_awake_us = 0;
+		s_window_start_tick = now;
+	}
+}
+
+/**
+ * Sleep until an event is posted or the tick count reaches until_tick, whichever
+ * is first. SysTick wakes us every millisecond anyway, so the caller should loop.
+ */
+void events_wait(uint32_t until_tick)
+{
+#if SLEEP_WHEN_IDLE
+	note_awake_end();
+
+	// Interrupts are disabled so that an event posted between the check and the WFI
+	// isn't missed: a pending interrupt still wakes WFI with PRIMASK set, and the handler
+	// runs as soon as we reenable interrupts.
+	__disable_irq();
+	if (atomic_load(&s_pending) == 0 && HAL_GetTick() < until_tick) {
+		__DSB();
+		__WFI();
+	}
+	// Start the awake time before reenabling interrupts, so that it includes the handler
+	// that woke us.
+	note_awake_start();
+	__enable_irq();
+#else
+	(void) until_tick;
+#endif
+}
+
+void events_reset_duty_cycle(void)
+{
+	const uint32_t now = HAL_GetTick();
+	s_awake_start_cycles = DWT->CYCCNT;
+	s_window_start_tick = now;
+	s_window_awake_us = 0;
+	s_duty_cycle_permille = 1000;
+	s_total_start_tick = now;
+	s_total_awake_us = 0;
+}
+
+/**
+ * Fraction of time the core was awake over the last complete measurement window, in
+ * parts per thousand.
+ */
+int events_get_duty_cycle_permille(void)
+{
+#if SLEEP_WHEN_IDLE
+	return s_duty_cycle_permille;
+#else
+	return 1000;
+#endif
+}
+
+/**
+ * Fraction of time the core was awake since the last reset, in parts per thousand.
+ * Reset when a mode is opened so we get a figure for the mode as a whole.
+ */
+int events_get_average_duty_cycle_permille(void)
+{
+#if SLEEP_WHEN_IDLE
+	const uint32_t elapsed_ms = HAL_GetTick() - s_total_start_tick;
+	if (elapsed_ms == 0)
+		return 1000;
+	uint64_t permille = s_total_awake_us / elapsed_ms;
+	return permille > 1000 ? 1000 : (int) permille;
+#else
+	return 1000;
+#endif
+}
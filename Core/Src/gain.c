@@ -21,6 +21,7 @@
  */
 
 #include "gain.h"
+#include "runtime_config.h"
 
 static uint16_t s_logical_index = 0;
 
@@ -112,6 +113,7 @@ void gain_set(int gain_index, bool disabled)
 		gain_disable();
 	else
 		set_gain(s_logical_index);
+	runtime_config_update();
 }
 
 void gain_set_db(int gain_db, bool disabled)
@@ -147,6 +149,7 @@ bool gain_up(void)
 	{
 		s_logical_index++;
 		set_gain(s_logical_index);
+		runtime_config_update();
 		return true;
 	}
 	else
@@ -159,6 +162,7 @@ bool gain_down(void)
 	{
 		s_logical_index--;
 		set_gain(s_logical_index);
+		runtime_config_update();
 		return true;
 	}
 	else
@@ -0,0 +1,177 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "main.h"
+#include "governor.h"
+
+/*
+ * Clock governor: runs the core from a low speed MSI range when nothing needs the
+ * full 48 MHz. Only the MSI range (SYSCLK) is changed; the PLLs are left strictly
+ * alone as they provide the ADC kernel clock and, via MCO, the ADC trigger.
+ *
+ * Why only two levels? We'd like to run acquisition slower, but TIM2 counts MCO edges
+ * on its ETR input (up to about 13 MHz at 528 kHz sampling), and ETR is sampled by the
+ * timer kernel clock, which comes from SYSCLK. So SYSCLK has to stay at 48 MHz whenever
+ * we are streaming. Trigger FFTs and buffer handling only happen while streaming, so
+ * they are already at full speed and don't need a separate boost.
+ *
+ * Why not a lower voltage range? PLL1 runs all the time to feed MCO, and the PLL VCO
+ * frequencies we use (600-850 MHz) need range 1 or 2. So we stay at range 2 as per
+ * SystemClock_Config and save power from the lower frequency alone.
+ *
+ * SDMMC runs from HSI48 but its bus interface runs from HCLK, so we also run at full speed
+ * whenever the SD card is in use.
+ *
+ * Power and throughput per state. These want filling in from a bench run, and until then
+ * the governor's saving is an estimate. To measure:
+ *
+ * - Power the board from a bench supply at battery voltage, through a meter that averages
+ *   over at least 10 s, with USB unplugged.
+ * - Build with DO_PROFILING 1 and set write_profile_to_sd, so that each run leaves a
+ *   profile*.txt giving the clock residency, duty cycle and cycles per half frame.
+ * - Hold the logger in each state below for a minute and note the average current. Use a
+ *   schedule that covers the time, and sensitivity_disable or a quiet room to keep it
+ *   listening rather than recording. Then repeat with DO_CLOCK_GOVERNOR 0 for the baseline.
+ * - Throughput is the trigger_fast and buffers_fast average cycles per half frame from the
+ *   profile, which only run at full speed, and whether any buffers were lost.
+ *
+ * State                     Level   Current, governor   Current, DO_CLOCK_GOVERNOR 0   Cycles per half frame
+ * Auto mode between         LOW     -                   -                              n/a
+ *   intervals (soft standby)
+ * Listening, quiet          FULL    -                   -                              -
+ * Listening, triggering     FULL    -                   -                              -
+ * Recording to SD           FULL    -                   -                              -
+ *
+ * The same figures go into auto_mode_sim with -c, for its battery life estimates.
+ */
+
+typedef struct {
+	uint32_t msi_range;
+	uint32_t hz;
+} governor_level_config_t;
+
+static const governor_level_config_t s_level_configs[GOVERNOR_LEVEL_LEN] = {
+	{ RCC_MSIRANGE_4, 4000000 },		// GOVERNOR_LEVEL_LOW
+	{ RCC_MSIRANGE_0, 48000000 }		// GOVERNOR_LEVEL_FULL: must match SystemClock_Config.
+};
+
+static uint32_t s_holds = 0;
+static governor_level_t s_level = GOVERNOR_LEVEL_FULL;
+
+// Time spent at each level, so we can see where the power is going:
+static uint32_t s_residency_ms[GOVERNOR_LEVEL_LEN];
+static uint32_t s_level_start_tick = 0;
+
+static void apply_level(governor_level_t level);
+
+void governor_init(void)
+{
+	// SystemClock_Config leaves us at full speed:
+	s_level = GOVERNOR_LEVEL_FULL;
+	s_holds = 0;
+	governor_reset_residency();
+}
+
+static void note_residency(void)
+{
+	const uint32_t now = HAL_GetTick();
+	s_residency_ms[s_level] += now - s_level_start_tick;
+	s_level_start_tick = now;
+}
+
+static void update_level(void)
+{
+#if DO_CLOCK_GOVERNOR
+	const governor_level_t level = s_holds ? GOVERNOR_LEVEL_FULL : GOVERNOR_LEVEL_LOW;
+	if (level != s_level) {
+		note_residency();
+		apply_level(level);
+		s_level = level;
+	}
+#endif
+}
+
+static void apply_level(governor_level_t level)
+{
+	// The HAL adjusts flash latency in the right order relative to the range change,
+	// updates SystemCoreClock and reconfigures SysTick for us:
+	RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+	RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_MSI;
+	RCC_OscInitStruct.MSIState = RCC_MSI_ON;
+	RCC_OscInitStruct.MSICalibrationValue = RCC_MSICALIBRATION_DEFAULT;
+	RCC_OscInitStruct.MSIClockRange = s_level_configs[level].msi_range;
+	RCC_OscInitStruct.PLL.PLLState = RCC_PLL_NONE;
+	if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
+		Error_Handler();
+}
+
+/**
+ * Main context only - not from interrupts.
+ */
+void governor_hold(uint32_t reason)
+{
+	s_holds |= reason;
+	update_level();
+}
+
+/**
+ * Main context only - not from interrupts. It's fine to release a hold that isn't held.
+ */
+void governor_release(uint32_t reason)
+{
+	s_holds &= ~reason;
+	update_level();
+}
+
+/**
+ * Call this after SystemClock_Config has been run again, for example on waking from STOP.
+ * That leaves us at full speed whatever level we were at before.
+ */
+void governor_on_clocks_reset(void)
+{
+	note_residency();
+	s_level = GOVERNOR_LEVEL_FULL;
+	update_level();
+}
+
+governor_level_t governor_get_level(void)
+{
+	return s_level;
+}
+
+uint32_t governor_get_level_hz(governor_level_t level)
+{
+	return s_level_configs[level].hz;
+}
+
+void governor_reset_residency(void)
+{
+	for (int i = 0; i < GOVERNOR_LEVEL_LEN; i++)
+		s_residency_ms[i] = 0;
+	s_level_start_tick = HAL_GetTick();
+}
+
+uint32_t governor_get_residency_ms(governor_level_t level)
+{
+	note_residency();
+	return s_residency_ms[level];
+}
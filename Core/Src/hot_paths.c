@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The vendor code that the half frame and SDMMC interrupts and the trigger run, built
+ * here rather than from its own folders so that RAM_TEXT_SECTION can reach it. The HAL
+ * functions on those paths are declared with it ahead of their sources, and the DSP
+ * kernels get it through ARM_DSP_ATTRIBUTE. Everything else in these files stays in
+ * flash as usual, and with RUN_HOT_PATHS_FROM_RAM 0 so does all of this.
+ *
+ * The .cproject leaves these files out of the Drivers and CMSIS-DSP folders' builds, so
+ * a file added here has to be added to its exclusions too.
+ */
+
+#include "main.h"
+
+// HAL_GetTick and the GPIO writes for the LEDs:
+RAM_TEXT_SECTION uint32_t HAL_GetTick(void);
+RAM_TEXT_SECTION void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+
+// The audio DMA interrupt and the ADC's half and full transfer completions:
+RAM_TEXT_SECTION void HAL_DMA_IRQHandler(DMA_HandleTypeDef *const hdma);
+RAM_TEXT_SECTION void ADC_DMAConvCplt(DMA_HandleTypeDef *hdma);
+RAM_TEXT_SECTION void ADC_DMAHalfConvCplt(DMA_HandleTypeDef *hdma);
+
+// The SD card interrupt, and the stop command it sends at the end of each transfer:
+RAM_TEXT_SECTION void HAL_SD_IRQHandler(SD_HandleTypeDef *hsd);
+RAM_TEXT_SECTION uint32_t SDMMC_CmdStopTransfer(SDMMC_TypeDef *SDMMCx);
+RAM_TEXT_SECTION HAL_StatusTypeDef SDMMC_SendCommand(SDMMC_TypeDef *SDMMCx, const SDMMC_CmdInitTypeDef *Command);
+RAM_TEXT_SECTION uint32_t SDMMC_GetCmdResp1(SDMMC_TypeDef *SDMMCx, uint8_t SD_CMD, uint32_t Timeout);
+RAM_TEXT_SECTION uint8_t SDMMC_GetCommandResponse(const SDMMC_TypeDef *SDMMCx);
+RAM_TEXT_SECTION uint32_t SDMMC_GetResponse(const SDMMC_TypeDef *SDMMCx, uint32_t Response);
+
+#include "../../Drivers/STM32U5xx_HAL_Driver/Src/stm32u5xx_hal.c"
+#include "../../Drivers/STM32U5xx_HAL_Driver/Src/stm32u5xx_hal_gpio.c"
+#include "../../Drivers/STM32U5xx_HAL_Driver/Src/stm32u5xx_hal_dma.c"
+#include "../../Drivers/STM32U5xx_HAL_Driver/Src/stm32u5xx_hal_adc.c"
+#include "../../Drivers/STM32U5xx_HAL_Driver/Src/stm32u5xx_hal_sd.c"
+#include "../../Drivers/STM32U5xx_HAL_Driver/Src/stm32u5xx_ll_sdmmc.c"
+
+// The trigger's FFTs and windowing. These files hold nothing but the kernels, so all of
+// each goes to SRAM; their tables, and the init functions, are elsewhere and stay in flash.
+#undef ARM_DSP_ATTRIBUTE
+#define ARM_DSP_ATTRIBUTE RAM_TEXT_SECTION
+
+#include "../../CMSIS-DSP-1.16.2/1.16.2/Source/TransformFunctions/arm_rfft_q15.c"
+#include "../../CMSIS-DSP-1.16.2/1.16.2/Source/TransformFunctions/arm_cfft_q15.c"
+#include "../../CMSIS-DSP-1.16.2/1.16.2/Source/TransformFunctions/arm_cfft_radix4_q15.c"
+#include "../../CMSIS-DSP-1.16.2/1.16.2/Source/TransformFunctions/arm_rfft_fast_f32.c"
+#include "../../CMSIS-DSP-1.16.2/1.16.2/Source/TransformFunctions/arm_cfft_f32.c"
+#include "../../CMSIS-DSP-1.16.2/1.16.2/Source/TransformFunctions/arm_cfft_radix8_f32.c"
+#include "../../CMSIS-DSP-1.16.2/1.16.2/Source/TransformFunctions/arm_bitreversal2.c"
+#include "../../CMSIS-DSP-1.16.2/1.16.2/Source/BasicMathFunctions/arm_mult_q15.c"
+#include "../../CMSIS-DSP-1.16.2/1.16.2/Source/BasicMathFunctions/arm_shift_q15.c"
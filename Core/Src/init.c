@@ -34,6 +34,7 @@
 #include "storage.h"
 #include "buffer.h"
 #include "storage.h"
+#include "retained.h"
 
 
 #define DATETIME_FILE_NAME "datetime.txt"
@@ -109,20 +110,47 @@ void init_get_datetime_from_sd(FX_MEDIA *pMedium)
 	}
 }
 
+/**
+ * Feed the settings parser straight from the file, a chunk at a time, so there is
+ * no limit on the size of the file.
+ */
+static int read_settings_file(void *context, char *buf, int len)
+{
+	ULONG actual_len = 0;
+	if (fx_file_read((FX_FILE *) context, (void *) buf, len, &actual_len) != FX_SUCCESS)
+		return 0;		// Including FX_END_OF_MEDIA.
+	return (int) actual_len;
+}
+
 void init_get_settings_from_sd(FX_MEDIA *pMedium)
 {
 	FX_FILE file;
 
+	// If settings.json has the same size and timestamp as when we last parsed it, use the
+	// result we kept from then rather than reading and parsing it all again:
+	UINT attributes, year, month, day, hour, minute, second;
+	ULONG size = 0;
+	const bool present = fx_directory_information_get(pMedium, SETTINGS_FILE_NAME, &attributes, &size,
+			&year, &month, &day, &hour, &minute, &second) == FX_SUCCESS;
+	uint32_t timestamp = 0;
+	if (present) {
+		// The same packing as FAT uses, with 2 second resolution:
+		timestamp = ((year - 1980) << 25) | (month << 21) | (day << 16) | (hour << 11) | (minute << 5) | (second >> 1);
+	}
+
+	const retained_settings_t *pCached = retained_get_settings();
+	if (pCached && pCached->file_present == present
+			&& pCached->file_size == size && pCached->file_timestamp == timestamp) {
+		settings_restore(&pCached->settings, pCached->profiles, pCached->profile_count);
+		return;
+	}
+
+	bool ok = true;
 	memset(&file, 0, sizeof(file));
 	if (fx_file_open(pMedium, &file, SETTINGS_FILE_NAME, FX_OPEN_FOR_READ) == FX_SUCCESS) {
-		ULONG actual_len = 0;
-		// Allow buffer space for the final \0:
-		/*UINT status =*/ fx_file_read(&file, (void *) g_2k_char_buffer, LEN_2K_BUFFER - 1, &actual_len);
-		g_2k_char_buffer[actual_len] = '\0';
+		ok = settings_parse_and_process_json_stream(read_settings_file, &file);
 		fx_file_close(&file);
 
-		bool ok = settings_parse_and_process_json_settings(g_2k_char_buffer);
-
 		if (!ok) {
 			storage_set_filex_time();		// So any file timestamp is right.
 
@@ -140,10 +168,26 @@ void init_get_settings_from_sd(FX_MEDIA *pMedium)
 	    	fx_media_flush(pMedium);
 		}
 	}
+
+	if (ok) {
+		int profile_count;
+		const settings_profile_t *pProfiles = settings_get_profiles(&profile_count);
+		retained_save_settings(present, size, timestamp, settings_get(), pProfiles, profile_count);
+	}
+	else
+		retained_invalidate_settings();
 }
 
 void init_read_all_settings(void)
 {
+	// Waking from hard standby in auto mode, the files on the card can only have changed if someone
+	// swapped cards while we were asleep, so don't even mount it. The auto mode schedule works the same way.
+	const retained_settings_t *pCached = retained_get_settings();
+	if (retained_is_standby_wake() && pCached) {
+		settings_restore(&pCached->settings, pCached->profiles, pCached->profile_count);
+		return;
+	}
+
 	// Normal mode for speed:
 	FX_MEDIA *pMedium = storage_mount(STORAGE_FAST);
 	if (pMedium) {
@@ -0,0 +1,352 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "json_stream.h"
+
+/*
+ * The grammar is strict JSON, tracked with a small state machine and a stack of
+ * container types, rather than building a token array over the whole document as
+ * jsmn does.
+ */
+
+#define CHAR_EOF (-1)
+
+typedef enum {
+	CONTAINER_OBJECT,
+	CONTAINER_ARRAY
+} container_t;
+
+typedef enum {
+	EXPECT_VALUE,
+	EXPECT_VALUE_OR_END,		// Just after [
+	EXPECT_KEY,
+	EXPECT_KEY_OR_END,			// Just after {
+	EXPECT_COLON,
+	EXPECT_COMMA_OR_END,
+	EXPECT_NOTHING				// We've had the whole of the top level value.
+} expecting_t;
+
+static int read_string_input(void *context, char *buf, int len);
+
+void json_stream_init(json_stream_t *ps, json_stream_read_t read, void *context)
+{
+	memset(ps, 0, sizeof(*ps));
+	ps->read = read;
+	ps->context = context;
+	ps->expecting = EXPECT_VALUE;
+}
+
+/**
+ * Tokenize a string that is already in memory.
+ */
+void json_stream_init_string(json_stream_t *ps, const char *s)
+{
+	json_stream_init(ps, read_string_input, ps);
+	ps->string = s;
+	ps->string_len = strlen(s);
+}
+
+static int read_string_input(void *context, char *buf, int len)
+{
+	json_stream_t *ps = (json_stream_t *) context;
+	size_t n = ps->string_len - ps->string_pos;
+	if (n > (size_t) len)
+		n = len;
+	memcpy(buf, ps->string + ps->string_pos, n);
+	ps->string_pos += n;
+	return (int) n;
+}
+
+static int peek_char(json_stream_t *ps)
+{
+	if (ps->chunk_pos == ps->chunk_len) {
+		if (ps->eof)
+			return CHAR_EOF;
+		const int n = ps->read(ps->context, ps->chunk, JSON_STREAM_CHUNK_LEN);
+		if (n <= 0 || n > JSON_STREAM_CHUNK_LEN) {
+			ps->eof = true;
+			return CHAR_EOF;
+		}
+		ps->chunk_len = n;
+		ps->chunk_pos = 0;
+	}
+	return (unsigned char) ps->chunk[ps->chunk_pos];
+}
+
+static int next_char(json_stream_t *ps)
+{
+	const int c = peek_char(ps);
+	if (c != CHAR_EOF) {
+		ps->chunk_pos++;
+		ps->offset++;
+	}
+	return c;
+}
+
+static json_stream_event_t fail(json_stream_t *ps)
+{
+	ps->error = true;
+	return JSON_STREAM_ERROR;
+}
+
+static int hex_value(int c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/**
+ * Read the rest of a string, the opening quote having been consumed. We only need ASCII,
+ * so any \u escape outside that range becomes '?'.
+ */
+static bool read_string(json_stream_t *ps, char *buf, size_t buflen)
+{
+	size_t len = 0;
+	for (;;) {
+		int c = next_char(ps);
+		if (c == CHAR_EOF || c < 0x20)
+			return false;
+		if (c == '"')
+			break;
+		if (c == '\\') {
+			c = next_char(ps);
+			switch (c) {
+				case '"': case '\\': case '/':
+					break;
+				case 'b': c = '\b'; break;
+				case 'f': c = '\f'; break;
+				case 'n': c = '\n'; break;
+				case 'r': c = '\r'; break;
+				case 't': c = '\t'; break;
+				case 'u': {
+					int code_point = 0;
+					for (int i = 0; i < 4; i++) {
+						const int h = hex_value(next_char(ps));
+						if (h < 0)
+							return false;
+						code_point = (code_point << 4) | h;
+					}
+					c = (code_point > 0 && code_point < 0x80) ? code_point : '?';
+					break;
+				}
+				default:
+					return false;
+			}
+		}
+		if (len + 1 >= buflen)
+			return false;		// Too long for us.
+		buf[len++] = (char) c;
+	}
+	buf[len] = '\0';
+	return true;
+}
+
+static bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+/**
+ * -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+ */
+static bool is_number(const char *s)
+{
+	if (*s == '-')
+		s++;
+	if (*s == '0')
+		s++;
+	else if (is_digit(*s))
+		while (is_digit(*s))
+			s++;
+	else
+		return false;
+
+	if (*s == '.') {
+		s++;
+		if (!is_digit(*s))
+			return false;
+		while (is_digit(*s))
+			s++;
+	}
+
+	if (*s == 'e' || *s == 'E') {
+		s++;
+		if (*s == '+' || *s == '-')
+			s++;
+		if (!is_digit(*s))
+			return false;
+		while (is_digit(*s))
+			s++;
+	}
+
+	return *s == '\0';
+}
+
+static bool read_primitive(json_stream_t *ps, int first)
+{
+	size_t len = 0;
+	ps->value[len++] = (char) first;
+	for (;;) {
+		const int c = peek_char(ps);
+		if (c == CHAR_EOF || c == ',' || c == ']' || c == '}'
+				|| c == ' ' || c == '\t' || c == '\n' || c == '\r')
+			break;
+		if (len + 1 >= sizeof(ps->value))
+			return false;
+		ps->value[len++] = (char) next_char(ps);
+	}
+	ps->value[len] = '\0';
+
+	return strcmp(ps->value, "true") == 0 || strcmp(ps->value, "false") == 0
+			|| strcmp(ps->value, "null") == 0 || is_number(ps->value);
+}
+
+static void after_value(json_stream_t *ps)
+{
+	ps->expecting = ps->depth == 0 ? EXPECT_NOTHING : EXPECT_COMMA_OR_END;
+}
+
+static json_stream_event_t open_container(json_stream_t *ps, container_t container, json_stream_event_t event)
+{
+	if (ps->depth == JSON_STREAM_MAX_DEPTH)
+		return fail(ps);
+	ps->containers[ps->depth++] = container;
+	ps->expecting = container == CONTAINER_OBJECT ? EXPECT_KEY_OR_END : EXPECT_VALUE_OR_END;
+	return event;
+}
+
+static json_stream_event_t close_container(json_stream_t *ps, container_t container, json_stream_event_t event)
+{
+	if (ps->depth == 0 || ps->containers[ps->depth - 1] != container)
+		return fail(ps);
+	ps->depth--;
+	after_value(ps);
+	return event;
+}
+
+static json_stream_event_t start_value(json_stream_t *ps, int c)
+{
+	switch (c) {
+		case '{':
+			return open_container(ps, CONTAINER_OBJECT, JSON_STREAM_OBJECT_START);
+		case '[':
+			return open_container(ps, CONTAINER_ARRAY, JSON_STREAM_ARRAY_START);
+		case '"':
+			if (!read_string(ps, ps->value, sizeof(ps->value)))
+				return fail(ps);
+			after_value(ps);
+			return JSON_STREAM_STRING;
+		default:
+			if (!read_primitive(ps, c))
+				return fail(ps);
+			after_value(ps);
+			return JSON_STREAM_PRIMITIVE;
+	}
+}
+
+/**
+ * Get the next event. Once there has been an error, every call returns JSON_STREAM_ERROR.
+ */
+json_stream_event_t json_stream_next(json_stream_t *ps)
+{
+	if (ps->error)
+		return JSON_STREAM_ERROR;
+
+	for (;;) {
+		const int c = next_char(ps);
+		if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+			continue;
+		if (c == CHAR_EOF)
+			return ps->expecting == EXPECT_NOTHING ? JSON_STREAM_END : fail(ps);
+
+		switch (ps->expecting) {
+			case EXPECT_KEY_OR_END:
+				if (c == '}')
+					return close_container(ps, CONTAINER_OBJECT, JSON_STREAM_OBJECT_END);
+				// Fall through.
+			case EXPECT_KEY:
+				if (c != '"' || !read_string(ps, ps->key, sizeof(ps->key)))
+					return fail(ps);
+				ps->expecting = EXPECT_COLON;
+				return JSON_STREAM_KEY;
+
+			case EXPECT_COLON:
+				if (c != ':')
+					return fail(ps);
+				ps->expecting = EXPECT_VALUE;
+				break;
+
+			case EXPECT_VALUE_OR_END:
+				if (c == ']')
+					return close_container(ps, CONTAINER_ARRAY, JSON_STREAM_ARRAY_END);
+				// Fall through.
+			case EXPECT_VALUE:
+				return start_value(ps, c);
+
+			case EXPECT_COMMA_OR_END:
+				if (c == ',') {
+					ps->expecting = ps->containers[ps->depth - 1] == CONTAINER_OBJECT ? EXPECT_KEY : EXPECT_VALUE;
+					break;
+				}
+				if (c == '}')
+					return close_container(ps, CONTAINER_OBJECT, JSON_STREAM_OBJECT_END);
+				if (c == ']')
+					return close_container(ps, CONTAINER_ARRAY, JSON_STREAM_ARRAY_END);
+				return fail(ps);
+
+			case EXPECT_NOTHING:
+			default:
+				return fail(ps);
+		}
+	}
+}
+
+/**
+ * Get the next value, for example after a key. If it is an object or array, the whole
+ * of it is skipped and the start event is returned, so the caller can tell what it was.
+ */
+json_stream_event_t json_stream_next_value(json_stream_t *ps)
+{
+	const int depth = ps->depth;
+	const json_stream_event_t event = json_stream_next(ps);
+	if (event == JSON_STREAM_OBJECT_START || event == JSON_STREAM_ARRAY_START) {
+		while (ps->depth > depth && json_stream_next(ps) != JSON_STREAM_ERROR)
+			;
+	}
+	return ps->error ? JSON_STREAM_ERROR : event;
+}
+
+/**
+ * Skip the next value, however big. Returns false if the document is invalid.
+ */
+bool json_stream_skip_value(json_stream_t *ps)
+{
+	const json_stream_event_t event = json_stream_next_value(ps);
+	return event != JSON_STREAM_ERROR && event != JSON_STREAM_END
+			&& event != JSON_STREAM_OBJECT_END && event != JSON_STREAM_ARRAY_END;
+}
@@ -76,7 +76,7 @@ void leds_main_processing(int main_tick_count) {
 /**
  * Set an individual or all LEDS to be on or off in a stateless way.
  */
-void leds_set(int led, bool lit) {
+RAM_TEXT_SECTION void leds_set(int led, bool lit) {
 
 	// Only do the set if we are not currently flashing:
 	if (s_flash_state == flash_state_none) {
@@ -89,7 +89,7 @@ int s_flashes_requested = 0;
  *
  * Blink an individual LED.
  */
-void leds_blink(leds_led_t led) {
+RAM_TEXT_SECTION void leds_blink(leds_led_t led) {
 	if (led >= 0 && led < NUM_LEDS) {
 		// Don't blink if we are in the process of flashing:
 		if (s_flash_state == flash_state_none) {
@@ -147,7 +147,7 @@ static void do_flash() {
 	}
 }
 
-static void do_set(int led, bool lit) {
+RAM_TEXT_SECTION static void do_set(int led, bool lit) {
 	const GPIO_PinState value = lit ? GPIO_PIN_RESET : GPIO_PIN_SET;
 	if (led == LEDS_ALL) {
 		HAL_GPIO_WritePin(GPIO_LED_R_GPIO_Port, GPIO_LED_R_Pin, value);
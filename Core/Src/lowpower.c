@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "main.h"
+#include "rtc.h"
+#include "lowpower.h"
+#include "governor.h"
+
+/*
+ * STOP2 for short sleeps, such as between listening windows. Unlike standby, SRAM and
+ * peripheral state survive so we carry on from where we left off, and waking up takes
+ * microseconds plus the time to restart HSE and PLL1, rather than a full boot.
+ *
+ * We wake on the RTC wakeup timer, or on PC13 if the user moves the mode switch
+ * away from auto. PC13 is normally PWR_WKUP2, which only works for standby, so we
+ * borrow it as an EXTI input while we are stopped.
+ */
+
+#define SWITCH_PIN GPIO_PIN_13
+#define SWITCH_PORT GPIOC
+#define MAX_STOP_SECONDS 0x10000		// The wakeup timer counts seconds (CK_SPRE) in 16 bits.
+
+static volatile lowpower_wake_t s_wake_reason = LOWPOWER_WAKE_OTHER;
+
+static void configure_switch_exti(bool enable);
+
+void lowpower_init(void)
+{
+	s_wake_reason = LOWPOWER_WAKE_OTHER;
+}
+
+/**
+ * Go into STOP2 for up to the number of seconds supplied, returning the reason we
+ * woke up. Main context only. Anything that needs a clock (streaming, SD) must be
+ * stopped first, as the PLLs stop along with everything else.
+ */
+lowpower_wake_t lowpower_stop(uint32_t seconds)
+{
+	if (seconds == 0)
+		return LOWPOWER_WAKE_TIMER;
+	if (seconds > MAX_STOP_SECONDS)
+		seconds = MAX_STOP_SECONDS;
+
+	configure_switch_exti(true);
+
+	// If the switch has already moved there will be no edge to wake us, so don't
+	// stop at all. The mode module will notice and close us down shortly.
+	if (HAL_GPIO_ReadPin(SWITCH_PORT, SWITCH_PIN) == GPIO_PIN_SET) {
+		configure_switch_exti(false);
+		return LOWPOWER_WAKE_SWITCH;
+	}
+
+	s_wake_reason = LOWPOWER_WAKE_OTHER;
+	if (HAL_RTCEx_SetWakeUpTimer_IT(&hrtc, seconds - 1, RTC_WAKEUPCLOCK_CK_SPRE_16BITS, 0) != HAL_OK)
+		Error_Handler();
+
+	HAL_SuspendTick();		// Otherwise the timer tick wakes us immediately.
+
+	// Keep the debugger attached during stop. No effect on power consumption:
+	HAL_DBGMCU_EnableDBGStopMode();
+
+	HAL_PWREx_EnterSTOP2Mode(PWR_STOPENTRY_WFI);
+
+	// We wake up running from MSI, with HSE and the PLLs stopped, so set the clocks
+	// up again as at power up. That leaves us at full speed, so let the governor know:
+	SystemClock_Config();
+	governor_on_clocks_reset();
+	HAL_ResumeTick();
+
+	HAL_RTCEx_DeactivateWakeUpTimer(&hrtc);
+	configure_switch_exti(false);
+
+	return s_wake_reason;
+}
+
+static void configure_switch_exti(bool enable)
+{
+	if (enable) {
+		// Pull up as for standby: see enter_standby in mode_auto.c.
+		GPIO_InitTypeDef GPIO_InitStruct = {0};
+		GPIO_InitStruct.Pin = SWITCH_PIN;
+		GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+		GPIO_InitStruct.Pull = GPIO_PULLUP;
+		HAL_GPIO_Init(SWITCH_PORT, &GPIO_InitStruct);
+
+		HAL_NVIC_SetPriority(EXTI13_IRQn, 0, 0);
+		HAL_NVIC_EnableIRQ(EXTI13_IRQn);
+	}
+	else {
+		HAL_NVIC_DisableIRQ(EXTI13_IRQn);
+		HAL_GPIO_DeInit(SWITCH_PORT, SWITCH_PIN);
+	}
+}
+
+void HAL_RTCEx_WakeUpTimerEventCallback(RTC_HandleTypeDef *hrtc)
+{
+	UNUSED(hrtc);
+	s_wake_reason = LOWPOWER_WAKE_TIMER;
+}
+
+void HAL_GPIO_EXTI_Rising_Callback(uint16_t GPIO_Pin)
+{
+	if (GPIO_Pin == SWITCH_PIN)
+		s_wake_reason = LOWPOWER_WAKE_SWITCH;
+}
@@ -0,0 +1,285 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <arm_math.h>
+
+#include "ltsa.h"
+#include "cmplx_mag_squared.h"
+#include "data_acquisition.h"
+#include "settings.h"
+#include "storage.h"
+#include "gain.h"
+#include "rtc.h"
+#include "buffer.h"
+
+/*
+ * There's no need to analyse every sample for an average over a minute, so after each FFT
+ * window we skip some half frames. That keeps this to a small fraction of the CPU.
+ */
+#define HALF_FRAMES_BETWEEN_WINDOWS 16
+
+/*
+ * Records queue up here until we can write them. If the SD card is mounted anyway for
+ * recording, they go every minute; otherwise we mount it ourselves when the queue is
+ * nearly full, rather than once a minute.
+ */
+#define MAX_PENDING_RECORDS 8
+
+#define FILE_NAME_LEN 32
+
+static arm_rfft_instance_q15 s_fft_instance;
+static q15_t s_window_q15[LTSA_FFT_SIZE];
+static q15_t s_fill_buffer[LTSA_FFT_SIZE];
+static q15_t s_fft_output[LTSA_FFT_SIZE * 2];
+static q31_t s_power[LTSA_BINS];
+static uint64_t s_power_sums[LTSA_BINS];
+
+static bool s_running = false;
+static int s_sampling_rate = 0;
+static int s_last_half_frame_counter = 0;
+static int s_fill_count = 0;
+static int s_skip_half_frames = 0;
+static int s_window_count = 0;
+static int s_samples_since_record = 0;
+
+static ltsa_record_t s_pending[MAX_PENDING_RECORDS];
+static int s_pending_count = 0;
+static char s_file_name[FILE_NAME_LEN];		// Empty until we start a file.
+static ltsa_header_t s_header;
+
+_Static_assert(sizeof(ltsa_header_t) == 24, "ltsa_header_t has padding");
+_Static_assert(sizeof(ltsa_record_t) == 8 + LTSA_BINS, "ltsa_record_t has padding");
+
+void ltsa_init(void)
+{
+	arm_rfft_init_q15(&s_fft_instance, LTSA_FFT_SIZE, 0, 1);
+
+	// Hann window:
+	for (int i = 0; i < LTSA_FFT_SIZE; i++) {
+		const float w = 0.5f - 0.5f * cosf(2.0f * (float) M_PI * i / (LTSA_FFT_SIZE - 1));
+		s_window_q15[i] = (q15_t) (w * 32767.0f);
+	}
+
+	s_running = false;
+	s_pending_count = 0;
+	s_file_name[0] = '\0';
+}
+
+static void reset_accumulation(void)
+{
+	memset(s_power_sums, 0, sizeof(s_power_sums));
+	s_window_count = 0;
+	s_samples_since_record = 0;
+}
+
+/**
+ * Start or carry on averaging, into the current file if there is one, otherwise a new one.
+ */
+void ltsa_start(int sampling_rate)
+{
+	if (!settings_get()->ltsa_enabled)
+		return;
+
+	if (s_file_name[0] == '\0') {
+		storage_get_base_name(g_128bytes_char_buffer, LEN_128BYTES_BUFFER);
+		snprintf(s_file_name, sizeof(s_file_name), "%s.ltsa", g_128bytes_char_buffer);
+
+		RTC_TimeTypeDef t;
+		RTC_DateTypeDef d;
+		memset(&t, 0, sizeof(t));
+		memset(&d, 0, sizeof(d));
+		HAL_RTC_GetTime(&hrtc, &t, RTC_FORMAT_BIN);
+		// We *have* to call GetDate, otherwise the time is stuck. Duh.
+		HAL_RTC_GetDate(&hrtc, &d, RTC_FORMAT_BIN);
+
+		memset(&s_header, 0, sizeof(s_header));
+		memcpy(s_header.magic, "LTSA", 4);
+		s_header.version = LTSA_FILE_VERSION;
+		s_header.fft_size = LTSA_FFT_SIZE;
+		s_header.bins = LTSA_BINS;
+		s_header.record_len = sizeof(ltsa_record_t);
+		s_header.db_floor_tenths = (int16_t) (LTSA_DB_FLOOR * 10);
+		s_header.db_step_hundredths = (uint16_t) (LTSA_DB_STEP * 100);
+		s_header.year = d.Year + 2000;
+		s_header.month = d.Month;
+		s_header.day = d.Date;
+		s_header.hours = t.Hours;
+		s_header.minutes = t.Minutes;
+		s_header.seconds = t.Seconds;
+	}
+
+	s_sampling_rate = sampling_rate;
+	s_last_half_frame_counter = g_raw_half_frame_counter;
+	s_fill_count = 0;
+	s_skip_half_frames = 0;
+	reset_accumulation();
+	s_running = true;
+}
+
+static void finish_record(void)
+{
+	if (s_window_count == 0)
+		return;
+
+	if (s_pending_count >= MAX_PENDING_RECORDS) {
+		// We haven't been able to write for a while, perhaps there is no SD card. Lose the
+		// oldest record rather than the newest:
+		memmove(s_pending, s_pending + 1, sizeof(s_pending[0]) * (MAX_PENDING_RECORDS - 1));
+		s_pending_count--;
+	}
+
+	ltsa_record_t *pRecord = &s_pending[s_pending_count++];
+	memset(pRecord, 0, sizeof(*pRecord));
+
+	RTC_TimeTypeDef t;
+	RTC_DateTypeDef d;
+	memset(&t, 0, sizeof(t));
+	HAL_RTC_GetTime(&hrtc, &t, RTC_FORMAT_BIN);
+	HAL_RTC_GetDate(&hrtc, &d, RTC_FORMAT_BIN);
+	pRecord->hours = t.Hours;
+	pRecord->minutes = t.Minutes;
+	pRecord->seconds = t.Seconds;
+	pRecord->gain_range = gain_get_range();
+	pRecord->sampling_rate_khz = s_sampling_rate / 1000;
+	pRecord->window_count = s_window_count;
+
+	// Once a minute, so floating point log is no hardship:
+	for (int i = 0; i < LTSA_BINS; i++) {
+		const float mean = (float) s_power_sums[i] / s_window_count;
+		int level = 0;
+		if (mean > 0) {
+			const float db = 10.0f * log10f(mean / 2147483648.0f);
+			level = (int) ((db - LTSA_DB_FLOOR) / LTSA_DB_STEP + 0.5f);
+		}
+		pRecord->levels[i] = level < 0 ? 0 : level > 255 ? 255 : level;
+	}
+
+	reset_accumulation();
+}
+
+/**
+ * Stop averaging, keeping what we have so far as a (short) record.
+ */
+void ltsa_stop(void)
+{
+	if (s_running)
+		finish_record();
+	s_running = false;
+}
+
+static void write_pending_records(void)
+{
+	if (s_pending_count == 0 || s_file_name[0] == '\0')
+		return;
+
+	FX_MEDIA *pMedium = storage_mount(STORAGE_LOW_NOISE);
+	if (pMedium) {
+		if (storage_append_file(pMedium, s_file_name, &s_header, sizeof(s_header),
+				s_pending, s_pending_count * sizeof(s_pending[0])))
+			s_pending_count = 0;
+		storage_unmount(true);
+	}
+}
+
+/**
+ * Finish the file, when the active interval ends. The next ltsa_start starts a new one.
+ */
+void ltsa_end_file(void)
+{
+	ltsa_stop();
+	write_pending_records();
+	s_pending_count = 0;
+	s_file_name[0] = '\0';
+}
+
+static void analyse_window(void)
+{
+	arm_mult_q15(s_window_q15, s_fill_buffer, s_fill_buffer, LTSA_FFT_SIZE);
+	arm_rfft_q15(&s_fft_instance, s_fill_buffer, s_fft_output);
+	cmplx_mag_squared_q15_q31(s_fft_output, s_power, LTSA_BINS);
+	for (int i = 0; i < LTSA_BINS; i++)
+		s_power_sums[i] += (uint32_t) s_power[i];
+	s_window_count++;
+}
+
+/**
+ * Called in the main loop when there is a new half frame. We don't consume g_raw_half_frame_ready,
+ * which belongs to the trigger, but follow the half frame counter.
+ */
+void ltsa_main_fast_processing(int main_tick_count)
+{
+	if (!s_running)
+		return;
+
+	const int counter = g_raw_half_frame_counter;
+	const int new_half_frames = counter - s_last_half_frame_counter;
+	if (new_half_frames <= 0)
+		return;
+	s_last_half_frame_counter = counter;
+
+	const int size = g_raw_half_frame_size;
+	s_samples_since_record += new_half_frames * size;
+
+	if (s_skip_half_frames > 0) {
+		s_skip_half_frames -= new_half_frames;
+	}
+	else {
+		// A window has to be contiguous samples, so start again if we missed a half frame:
+		if (new_half_frames > 1)
+			s_fill_count = 0;
+
+		int n = LTSA_FFT_SIZE - s_fill_count;
+		if (n > size)
+			n = size;
+		memcpy(s_fill_buffer + s_fill_count, (const void *) g_raw_half_frame, n * sizeof(q15_t));
+
+		if (g_raw_half_frame_counter != counter) {
+			// The data changed under us while we were copying it:
+			s_fill_count = 0;
+		}
+		else {
+			s_fill_count += n;
+			if (s_fill_count == LTSA_FFT_SIZE) {
+				analyse_window();
+				s_fill_count = 0;
+				s_skip_half_frames = HALF_FRAMES_BETWEEN_WINDOWS;
+			}
+		}
+	}
+
+	if (s_samples_since_record >= s_sampling_rate * LTSA_RECORD_INTERVAL_S)
+		finish_record();
+}
+
+void ltsa_main_processing(int main_tick_count)
+{
+	if (s_pending_count == 0)
+		return;
+
+	// Write when someone else has the SD card mounted, so it costs us little, or when we
+	// are about to start losing records:
+	if (storage_get_medium() != NULL || s_pending_count >= MAX_PENDING_RECORDS - 1)
+		write_pending_records();
+}
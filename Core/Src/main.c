@@ -68,7 +68,18 @@
 #include "autophasecontrol.h"
 #include "tusb_config.h"
 #include "trigger.h"
+#include "ltsa.h"
+#include "agc.h"
+#include "storm.h"
+#include "thumbnail.h"
+#include "second_pass.h"
 #include "sd_lowlevel.h"
+#include "events.h"
+#include "profiler.h"
+#include "governor.h"
+#include "retained.h"
+#include "solar.h"
+#include "lowpower.h"
 
 /* USER CODE END Includes */
 
@@ -153,7 +164,18 @@ int main(void)
   recording_init();
   usb_handlers_init();
   trigger_init();
+  ltsa_init();
+  agc_init();
+  storm_init();
+  thumbnail_init();
+  second_pass_init();
   sd_lowlevel_init();
+  events_init();
+  profiler_init();
+  governor_init();
+  retained_init();
+  solar_init();
+  lowpower_init();
 
   // Perform the power on startup sequence:
   leds_set(LEDS_ALL, true);
@@ -194,29 +216,48 @@ int main(void)
 
 	// Various modules hook the main loop so they can do work in the main
 	// thread of execution:
-	mode_main_processing(main_tick_count);
-	manual_mode_main_processing(main_tick_count);
-	usb_mode_main_processing(main_tick_count);
-	auto_mode_main_processing(main_tick_count);
-	leds_main_processing(main_tick_count);
-	storage_main_processing(main_tick_count);
-	recording_main_processing(main_tick_count);
-	sd_lowlevel_main_processing(main_tick_count);
+	PROFILE(PROFILE_MODE_MAIN, mode_main_processing(main_tick_count));
+	PROFILE(PROFILE_MANUAL_MODE_MAIN, manual_mode_main_processing(main_tick_count));
+	PROFILE(PROFILE_USB_MODE_MAIN, usb_mode_main_processing(main_tick_count));
+	PROFILE(PROFILE_AUTO_MODE_MAIN, auto_mode_main_processing(main_tick_count));
+	PROFILE(PROFILE_LEDS_MAIN, leds_main_processing(main_tick_count));
+	PROFILE(PROFILE_STORAGE_MAIN, storage_main_processing(main_tick_count));
+	PROFILE(PROFILE_RECORDING_MAIN, recording_main_processing(main_tick_count));
+	PROFILE(PROFILE_SD_LOWLEVEL_MAIN, sd_lowlevel_main_processing(main_tick_count));
+	PROFILE(PROFILE_LTSA_MAIN, ltsa_main_processing(main_tick_count));
+	PROFILE(PROFILE_SECOND_PASS_MAIN, second_pass_main_processing(main_tick_count));
+	PROFILE(PROFILE_THUMBNAIL_MAIN, thumbnail_main_processing(main_tick_count));
+	PROFILE(PROFILE_AGC_MAIN, agc_main_processing(main_tick_count));
+	PROFILE(PROFILE_STORM_MAIN, storm_main_processing(main_tick_count));
 	main_tick_count++;
 
 	while (HAL_GetTick() < next_tick_count) {
-		// Fast loop:
-		usb_mode_main_fast_processing(main_tick_count);
-		auto_mode_main_fast_processing(main_tick_count);
-		sd_lowlevel_main_fast_processing(main_tick_count);
+		// Fast loop. Interrupt handlers post events, and each task only runs when there
+		// is an event it cares about. When there is nothing to do we sleep until the next
+		// interrupt, which is at most a millisecond away courtesy of SysTick.
+		const uint32_t events = events_take();
+		if (events & EVENT_USB)
+			PROFILE(PROFILE_USB_MODE_FAST, usb_mode_main_fast_processing(main_tick_count));
+		PROFILE(PROFILE_AUTO_MODE_FAST, auto_mode_main_fast_processing(main_tick_count));
+		if (events & EVENT_SD)
+			PROFILE(PROFILE_SD_LOWLEVEL_FAST, sd_lowlevel_main_fast_processing(main_tick_count));
 		// Fast loop, so we can process data buffers in time and avoid missed buffers:
-		recording_main_processing(main_tick_count);
+		if (events & (EVENT_HALF_FRAME | EVENT_SD))
+			PROFILE(PROFILE_RECORDING_FAST, recording_main_processing(main_tick_count));
 
 		// Beware - the following takes significant time and can get in the way of USB
 		// handling unless we compile with -Ofast. An alternative is to do this only in
 		// auto mode, invoked from auto.c.
-		trigger_main_fast_processing(main_tick_count);
-		data_processor_buffers_fast_main_processing(main_tick_count);
+		if (events & EVENT_HALF_FRAME)
+			PROFILE(PROFILE_TRIGGER_FAST, trigger_main_fast_processing(main_tick_count));
+		if (events & EVENT_HALF_FRAME)
+			PROFILE(PROFILE_LTSA_FAST, ltsa_main_fast_processing(main_tick_count));
+		if (events & EVENT_HALF_FRAME)
+			PROFILE(PROFILE_AGC_FAST, agc_main_fast_processing(main_tick_count));
+		if (events & EVENT_TRIGGER)
+			PROFILE(PROFILE_BUFFERS_FAST, data_processor_buffers_fast_main_processing(main_tick_count));
+
+		events_wait(next_tick_count);
 	}
 
 	// Yes, the tick interval will be a little longer than specified:
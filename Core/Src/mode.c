@@ -29,6 +29,10 @@
 #include "leds.h"
 #include "storage.h"
 #include "init.h"
+#include "events.h"
+#include "profiler.h"
+#include "settings.h"
+#include "governor.h"
 
 typedef enum { MODE_NONE=0, MODE_MANUAL, MODE_AUTO, MODE_USB, MODE_LEN } mode_t;
 
@@ -107,11 +111,25 @@ void mode_main_processing(int main_tick_count)
 
 static void switch_to_mode(mode_t mode)
 {
+	// Run at full speed while we close and open modes, which involves SD access
+	// and other work we want done promptly:
+	governor_hold(GOVERNOR_HOLD_MODE_SWITCH);
+
 	// Close with the current mode:
 	const mode_driver_t *mode_driver = mode_drivers[s_mode];
-	if (mode_driver)
+	if (mode_driver) {
 		mode_driver->close();
 
+		// Leave a record of where the CPU time went in the mode we are leaving:
+		if (settings_get()->write_profile_to_sd) {
+			FX_MEDIA *pMedium = storage_mount(STORAGE_FAST);
+			if (pMedium) {
+				storage_write_profile(pMedium);
+				storage_unmount(true);
+			}
+		}
+	}
+
 	// The LEDs may be in any start: reset them for the new mode:
 	leds_reset();
 
@@ -120,9 +138,17 @@ static void switch_to_mode(mode_t mode)
 
 	s_mode = mode;
 
+	// Start measuring the duty cycle and profiling afresh for the new mode:
+	events_reset_duty_cycle();
+	profiler_reset();
+	governor_reset_residency();
+
 	// Open the new mode:
 	mode_driver = mode_drivers[s_mode];
 	if (mode_driver)
 		mode_driver->open();
+
+	// The new mode holds full speed for itself if it needs it:
+	governor_release(GOVERNOR_HOLD_MODE_SWITCH);
 }
 
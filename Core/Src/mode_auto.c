@@ -37,6 +37,13 @@
 #include "init.h"
 #include "adc.h"
 #include "tusb_config.h"
+#include "retained.h"
+#include "lowpower.h"
+#include "gain.h"
+#include "ltsa.h"
+#include "agc.h"
+#include "second_pass.h"
+#include "runtime_config.h"
 
 #define BLINK_LEDS 1
 
@@ -56,6 +63,7 @@ const mode_driver_t auto_mode_driver = {
 
 typedef enum { STATE_START, STATE_SETTINGS_ERROR,
 	STATE_ACTIVE_MODE,
+	STATE_DOZING,					// Between listening windows within an active interval.
 	STATE_SOFT_STANDBY_MODE,
 	STATE_HARD_STANDBY_MODE,
 } auto_state_t;
@@ -63,24 +71,30 @@ typedef enum { STATE_START, STATE_SETTINGS_ERROR,
 static auto_state_t s_state = STATE_START;
 static bool s_main_processing_enabled = false;
 static bool s_streaming_started = false;
+static bool s_resume_from_standby = false;		// We woke from hard standby and have a retained schedule.
 
 #define SCHEDULE_FILE_NAME "schedule.json"
-#define MINUTES_PER_DAY (24 * 60)
 #define SECONDS_PER_DAY (24 * 60 * 60)
 
 typedef struct {
 	time_t start_epoch;
 	time_t duration_epoch;
+	int profile;
 } date_mapped_interval_t;
 
-static int read_raw_schedule(schedule_interval_t intervals[]);
+static int read_raw_schedule(schedule_entry_t entries[]);
 static time_t get_time_now(struct tm *now);
 static void enter_standby(time_t wakeup_epoch);
 static void exit_standby(void);
 static void enter_active(void);
 static void exit_active(void);
+static void pause_active(void);
+static void resume_active(void);
+static bool is_duty_cycled(void);
 static bool is_in_range(int v, int min, int max);
-static int realize_intervals(schedule_interval_t raw_intervals[], int raw_interval_count,
+static int find_current_interval(const date_mapped_interval_t intervals[], int count, time_t now_epoch);
+static void switch_profile(int profile);
+static int realize_intervals(const schedule_entry_t entries[], int entry_count,
 		date_mapped_interval_t mapped_intervals[]);
 
 #define DO_HARDWARE_STANDBY 1		// Disable this for easier debugging.
@@ -104,6 +118,11 @@ static void open_auto_mode(void)
 	reset_vars();
 	s_main_processing_enabled = true;
 
+	// If we just woke up from hard standby, the schedule we had before we went to sleep is in
+	// backup SRAM, so we don't need to read it from the SD card again. Any other way of
+	// arriving here (power up, the mode switch) means the card may have changed so we read it.
+	s_resume_from_standby = retained_take_standby_wake() && retained_get_schedule() != NULL;
+
 	// Switch to switched mode power supply. This reduces power current draw, at the expense of possibly
 	// more electrical noise:
 	HAL_PWREx_ConfigSupply(PWR_SMPS_SUPPLY);			// PWR_SMPS_SUPPLY or PWR_LDO_SUPPLY.
@@ -124,7 +143,11 @@ static void close_auto_mode(void)
 	}
 
 	recording_close();
+	ltsa_end_file();
 	data_acquisition_set_processor(NULL);
+	// As in exit_active, so that the second pass and the thumbnails can carry on:
+	data_processor_buffers_reset(DATA_PROCESSOR_TRIGGERED, settings_get_logger_sampling_rate());
+	settings_select_profile(SETTINGS_NO_PROFILE);
 }
 
 void auto_mode_main_processing(int main_tick_count)
@@ -135,13 +158,15 @@ void auto_mode_main_processing(int main_tick_count)
 	// IMPORTANT - this static data is not preserved through hard standby. Anything
 	// that matters needs to be repopulated during the start state.
 
-	static schedule_interval_t raw_intervals[MAX_SCHEDULE_INTERVALS];
+	static schedule_entry_t entries[MAX_SCHEDULE_INTERVALS];
 	static date_mapped_interval_t intervals[MAX_SCHEDULE_INTERVALS * 3];		// Allow space x 3: Yesterday, today, tomorrow.
-	static int interval_count = 0, raw_interval_count = 0;
+	static int interval_count = 0, entry_count = 0;
 	static const time_t s_soft_standby_duration = 30;			// Time taken to fall asleep before entering standby mode.
 	static const time_t s_minimum_hard_standby_duration = 15;			// Don't go into into hard standby for less than this duration
 	static time_t start_epoch, end_epoch;
+	static int active_interval = -1;
 	static time_t s_standby_wakeup_epoch, s_pending_standby_started;
+	static time_t s_listen_started_epoch, s_last_activity_epoch, s_next_listen_epoch;
 
 
 	struct tm tm_now;
@@ -173,31 +198,35 @@ void auto_mode_main_processing(int main_tick_count)
 	switch (s_state) {
 		case STATE_START:
 		{
-			// Read the schedule here in the main loop as it might be updated at any point.
-			HAL_Delay(10);	// Hack: not sure why but we seem to need this delay to be able to read from the SD here.
-			raw_interval_count = read_raw_schedule(raw_intervals);
-			interval_count = realize_intervals(raw_intervals, raw_interval_count, intervals);
+			if (s_resume_from_standby) {
+				// Use the schedule retained in backup SRAM, avoiding the need to mount the card:
+				const retained_schedule_t *pRetained = retained_get_schedule();
+				entry_count = pRetained->entry_count;
+				memcpy(entries, pRetained->entries, entry_count * sizeof(entries[0]));
+			}
+			else {
+				// Read the schedule here in the main loop as it might be updated at any point.
+				HAL_Delay(10);	// Hack: not sure why but we seem to need this delay to be able to read from the SD here.
+				entry_count = read_raw_schedule(entries);
+			}
+			interval_count = realize_intervals(entries, entry_count, intervals);
+
+			// Only the first pass after waking is special:
+			const bool resuming = s_resume_from_standby;
+			s_resume_from_standby = false;
 
 			if (interval_count > 0) {
 				// See if there there is a currently active internal, or one due to become active
 				// in the next short time. Intervals have already been sorted in ascending order.
 				// Choose the latest one by searching in reverse order.
 
-				bool active_interval_found = false;
-				for (int i = interval_count - 1; i >= 0; i--) {
-					// start and end can be outside the range of today:
-					time_t start = intervals[i].start_epoch;
-					time_t end = start + intervals[i].duration_epoch;
-					if (now_epoch >= start && now_epoch <= end) {
-						start_epoch = start;
-						end_epoch = end;
-						active_interval_found = true;
-						break;
-					}
-				}
-
-				if (active_interval_found) {
+				active_interval = find_current_interval(intervals, interval_count, now_epoch);
+				if (active_interval >= 0) {
+					start_epoch = intervals[active_interval].start_epoch;
+					end_epoch = start_epoch + intervals[active_interval].duration_epoch;
+					settings_select_profile(intervals[active_interval].profile);
 					enter_active();
+					s_listen_started_epoch = s_last_activity_epoch = now_epoch;
 					s_state = STATE_ACTIVE_MODE;
 					break;
 				}
@@ -225,6 +254,11 @@ void auto_mode_main_processing(int main_tick_count)
 					// using a state:
 					s_standby_wakeup_epoch = start_epoch;
 					s_pending_standby_started = now_epoch;
+					if (resuming) {
+						// We have only just woken from standby (perhaps early), so there is no need for the
+						// soft standby pause: backdate it so that we go straight back to hard standby.
+						s_pending_standby_started = now_epoch - s_soft_standby_duration - 1;
+					}
 					s_state = STATE_SOFT_STANDBY_MODE;
 					break;
 				}
@@ -255,9 +289,73 @@ void auto_mode_main_processing(int main_tick_count)
 
 		case STATE_ACTIVE_MODE:
 		{
-			if (!is_in_range(now_epoch, start_epoch, end_epoch)) {
+			// Another interval can start within this one and take over for its duration, after
+			// which this one resumes:
+			const int current_interval = find_current_interval(intervals, interval_count, now_epoch);
+			if (current_interval < 0) {
 				exit_active();
+				ltsa_end_file();
+				settings_select_profile(SETTINGS_NO_PROFILE);
 				s_state = STATE_START;
+				break;
+			}
+			if (current_interval != active_interval) {
+				active_interval = current_interval;
+				start_epoch = intervals[active_interval].start_epoch;
+				end_epoch = start_epoch + intervals[active_interval].duration_epoch;
+				switch_profile(intervals[active_interval].profile);
+			}
+
+			if (is_duty_cycled()) {
+				// Never cut a recording short, and in adaptive mode, keep listening for a further
+				// window after the most recent activity:
+				const bool busy = data_processor_buffers_is_busy();
+				if (busy)
+					s_last_activity_epoch = now_epoch;
+
+				const settings_t *pSettings = settings_get();
+				time_t window_end = s_listen_started_epoch + pSettings->listen_window_s;
+				if (pSettings->listen_adaptive && s_last_activity_epoch + pSettings->listen_window_s > window_end)
+					window_end = s_last_activity_epoch + pSettings->listen_window_s;
+
+				if (!busy && now_epoch >= window_end) {
+					// Doze for the rest of the period, measured from the end of this window so that an
+					// extended window doesn't eat into the next quiet time:
+					s_next_listen_epoch = window_end + (pSettings->listen_period_s - pSettings->listen_window_s);
+					pause_active();
+					s_state = STATE_DOZING;
+				}
+			}
+		}
+		break;
+
+		case STATE_DOZING:
+		{
+			if (find_current_interval(intervals, interval_count, now_epoch) != active_interval) {
+				// The interval ended, or another took over, while we were dozing. Everything is
+				// already stopped, so start afresh.
+				ltsa_end_file();
+				settings_select_profile(SETTINGS_NO_PROFILE);
+				s_state = STATE_START;
+			}
+			else if (now_epoch >= s_next_listen_epoch) {
+				resume_active();
+				s_listen_started_epoch = s_last_activity_epoch = now_epoch;
+				s_state = STATE_ACTIVE_MODE;
+			}
+			else {
+#if DO_STOP_MODE
+				// Sleep until the next window, or the end of the interval or the start of another
+				// if that is sooner. If the mode switch wakes us, the mode module will close us down shortly.
+				time_t wake_epoch = s_next_listen_epoch < end_epoch + 1 ? s_next_listen_epoch : end_epoch + 1;
+				for (int i = active_interval + 1; i < interval_count; i++) {
+					if (intervals[i].start_epoch > now_epoch && intervals[i].start_epoch < wake_epoch) {
+						wake_epoch = intervals[i].start_epoch;
+						break;
+					}
+				}
+				lowpower_stop((uint32_t) (wake_epoch - now_epoch));
+#endif
 			}
 		}
 		break;
@@ -267,10 +365,14 @@ void auto_mode_main_processing(int main_tick_count)
 			// Pause here before we enter standby. This is to allow time to attach
 			// a debugger in the event of immediate delay. It also avoids going into hard standby
 			// for a very short time, avoiding the risk of wake up time in the past.
+			// Recordings still waiting for the second pass would be kept unchecked, so we
+			// stay awake for those too.
 
 			if ((now_epoch > s_pending_standby_started + s_soft_standby_duration)
 					&&
-				(start_epoch > now_epoch + s_minimum_hard_standby_duration))
+				(start_epoch > now_epoch + s_minimum_hard_standby_duration)
+					&&
+				second_pass_is_idle())
 				{
 				// Time to go to standby:
 				enter_standby(start_epoch);
@@ -291,9 +393,9 @@ void auto_mode_main_processing(int main_tick_count)
 				exit_standby();
 
 				// Simulate hardware standby by resetting static data:
-				memset(raw_intervals, 0, sizeof(raw_intervals));
+				memset(entries, 0, sizeof(entries));
 				memset(intervals, 0, sizeof(intervals));
-				interval_count = 0; raw_interval_count = 0;
+				interval_count = 0; entry_count = 0;
 				start_epoch = end_epoch = 0;
 				s_standby_wakeup_epoch = s_pending_standby_started = 0;
 
@@ -311,7 +413,7 @@ void auto_mode_main_fast_processing(int main_tick_count)
 /**
  * Try to mount the SD card and read any schedule json file there.
  */
-static int read_raw_schedule(schedule_interval_t intervals[])
+static int read_raw_schedule(schedule_entry_t entries[])
 {
 	int count = 0;
 
@@ -328,7 +430,23 @@ static int read_raw_schedule(schedule_interval_t intervals[])
 			g_2k_char_buffer[actual_len] = '\0';
 			fx_file_close(&file);
 
-			count = settings_parse_and_normalize_schedule(g_2k_char_buffer, intervals);
+			// If the content hasn't changed since we last parsed it, use the retained result:
+			const uint32_t hash = retained_hash(g_2k_char_buffer, actual_len);
+			const retained_schedule_t *pRetained = retained_get_schedule();
+			if (pRetained && pRetained->schedule_hash == hash) {
+				count = pRetained->entry_count;
+				memcpy(entries, pRetained->entries, count * sizeof(entries[0]));
+			}
+			else {
+				count = settings_parse_schedule(g_2k_char_buffer, entries);
+				if (count > 0)
+					retained_save_schedule(hash, entries, count);
+				else
+					retained_invalidate_schedule();
+			}
+		}
+		else {
+			retained_invalidate_schedule();
 		}
 	}
 
@@ -340,7 +458,12 @@ static int read_raw_schedule(schedule_interval_t intervals[])
 	return count;
 }
 
-static int realize_intervals(schedule_interval_t raw_intervals[], int raw_interval_count,
+/**
+ * Work out the intervals for yesterday, today and tomorrow as epoch times. Solar relative
+ * times are resolved separately for each of those dates. Returns -1 if the schedule can't
+ * be resolved, for example solar times without a location setting.
+ */
+static int realize_intervals(const schedule_entry_t entries[], int entry_count,
 		date_mapped_interval_t mapped_intervals[])
 {
 	// Calculate the start of today as a unix epoch time.
@@ -362,9 +485,17 @@ static int realize_intervals(schedule_interval_t raw_intervals[], int raw_interv
 	for (time_t day_offset = t_today - (time_t) SECONDS_PER_DAY;
 			day_offset <= t_today + (time_t) SECONDS_PER_DAY;
 			day_offset += SECONDS_PER_DAY) {
-		for (int i = 0; i < raw_interval_count; i++) {
-			mapped_intervals[j].start_epoch = raw_intervals[i].start_minutes * 60 + day_offset;
-			mapped_intervals[j].duration_epoch = raw_intervals[i].duration_minutes * 60;
+		struct tm day;
+		localtime_r(&day_offset, &day);
+		schedule_interval_t day_intervals[MAX_SCHEDULE_INTERVALS];
+		const int count = settings_resolve_schedule(entries, entry_count,
+				day.tm_year + 1900, day.tm_mon + 1, day.tm_mday, day_intervals);
+		if (count < 0)
+			return -1;
+		for (int i = 0; i < count; i++) {
+			mapped_intervals[j].start_epoch = day_intervals[i].start_minutes * 60 + day_offset;
+			mapped_intervals[j].duration_epoch = day_intervals[i].duration_minutes * 60;
+			mapped_intervals[j].profile = day_intervals[i].profile;
 			j++;
 		}
 	}
@@ -396,7 +527,7 @@ static time_t get_time_now(struct tm *now)
 	now->tm_hour = t.Hours;
 	now->tm_mday = d.Date;			// 1 based.
 	now->tm_mon = d.Month - 1;		// 0 based.
-	now->tm_year = (int) d.Year + 2000;
+	now->tm_year = (int) d.Year + 100;		// Years since 1900.
 	now->tm_isdst = -1;
 
 	return mktime(now);		// Populate tm_wday, tm_yday and tm_isdst.
@@ -450,6 +581,7 @@ static void enter_standby(time_t alarm_epoch)
 #if DO_HARDWARE_STANDBY
 	// Set an alarm to wake us from standby:
 	set_alarm(alarm_epoch);
+	retained_set_next_wakeup(alarm_epoch);
 
 	HAL_SuspendTick();		// Otherwise the timer tick wakes up the stop mode immediately.
 
@@ -486,8 +618,12 @@ static void exit_standby(void)
 
 static void enter_active(void)
 {
+	// The buffers depend on the sampling rate, which the interval's profile might change:
+	data_processor_buffers_reset(DATA_PROCESSOR_TRIGGERED, settings_get_logger_sampling_rate());
+
 	streaming_start(settings_get()->logger_sampling_rate_index);
 	s_streaming_started = true;
+	agc_start(false);
 
 	// Tell the data module we are ready for it to tell us about ready data buffers:
 	data_acquisition_enable_capture(true);
@@ -498,16 +634,100 @@ static void enter_active(void)
 
 	// Prime recording so that we can be ready to start recording with low latency:
 	recording_prime();
+
+	ltsa_start(settings_get_logger_sampling_rate());
 }
 
 static void exit_active(void)
 {
+	ltsa_stop();
+	agc_stop();
 	recording_close();
 	streaming_stop();
 	s_streaming_started = false;
+
+	// No more data is coming, so a trigger still in progress will never run its course. Forget
+	// it, otherwise the second pass and the thumbnails wait for it until we listen again:
+	data_processor_buffers_reset(DATA_PROCESSOR_TRIGGERED, settings_get_logger_sampling_rate());
+}
+
+/**
+ * Stop listening between windows, powering down everything we can, but without
+ * ending the recording session.
+ */
+static void pause_active(void)
+{
+	data_acquisition_enable_capture(false);
+	exit_active();
+}
+
+static void resume_active(void)
+{
+	// Start from clean buffers, otherwise the pretrigger for the first recording in the
+	// window would include stale data from before we paused:
+	data_processor_buffers_reset(DATA_PROCESSOR_TRIGGERED, settings_get_logger_sampling_rate());
+
+	streaming_start(settings_get()->logger_sampling_rate_index);
+	s_streaming_started = true;
+	agc_start(true);
+	data_acquisition_enable_capture(true);
+
+	recording_reopen();
+	recording_prime();
+	ltsa_start(settings_get_logger_sampling_rate());
+}
+
+static bool is_duty_cycled(void)
+{
+	const settings_t *pSettings = settings_get();
+	return pSettings->listen_window_s > 0 && pSettings->listen_window_s < pSettings->listen_period_s;
 }
 
 static bool is_in_range(int v, int min, int max)
 {
 	return v >= min && v <= max;
 }
+
+/**
+ * Find the interval that applies now, which is the one that started most recently of any that
+ * include now. Intervals are sorted by start time so we search in reverse order. Returns -1
+ * if there is none.
+ */
+static int find_current_interval(const date_mapped_interval_t intervals[], int count, time_t now_epoch)
+{
+	for (int i = count - 1; i >= 0; i--) {
+		// start and end can be outside the range of today:
+		const time_t start = intervals[i].start_epoch;
+		if (is_in_range(now_epoch, start, start + intervals[i].duration_epoch))
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * Switch to the profile for a new interval while listening. Usually that is only a matter of
+ * which settings are current, but a different sampling rate means starting again, and a
+ * different gain has to be applied.
+ */
+static void switch_profile(int profile)
+{
+	const settings_t *pOld = settings_get();
+	settings_select_profile(profile);
+	const settings_t *pNew = settings_get();
+	if (pNew == pOld)
+		return;
+
+	if (pNew->logger_sampling_rate_index != pOld->logger_sampling_rate_index) {
+		data_acquisition_enable_capture(false);
+		exit_active();
+		enter_active();
+	}
+	else if (pNew->sensitivity_range != pOld->sensitivity_range
+			|| pNew->sensitivity_disable != pOld->sensitivity_disable) {
+		gain_set(pNew->sensitivity_range, pNew->sensitivity_disable);
+		agc_note_gain_change();
+	}
+
+	// The trigger thresholds and the rest can change even when the sampling rate and gain don't:
+	runtime_config_update();
+}
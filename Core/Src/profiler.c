@@ -0,0 +1,183 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "profiler.h"
+#include <stdio.h>
+#include <string.h>
+#include "settings.h"
+#include "events.h"
+#include "governor.h"
+
+#if DO_PROFILING
+
+typedef struct {
+	uint32_t count;
+	uint32_t min_cycles;
+	uint32_t max_cycles;
+	uint64_t total_cycles;
+	uint32_t histogram[PROFILE_HISTOGRAM_BUCKETS];
+} profile_entry_t;
+
+// Fixed size, no allocation:
+static profile_entry_t s_entries[PROFILE_LEN];
+static uint32_t s_start_tick = 0;
+
+static const char *s_names[PROFILE_LEN] = {
+	"mode_main",
+	"manual_mode_main",
+	"usb_mode_main",
+	"auto_mode_main",
+	"leds_main",
+	"storage_main",
+	"recording_main",
+	"sd_lowlevel_main",
+	"ltsa_main",
+	"second_pass_main",
+	"thumbnail_main",
+	"agc_main",
+	"storm_main",
+	"usb_mode_fast",
+	"auto_mode_fast",
+	"sd_lowlevel_fast",
+	"recording_fast",
+	"trigger_fast",
+	"buffers_fast",
+	"ltsa_fast",
+	"agc_fast",
+	"half_frame_isr",
+	"apc_sof_isr",
+	"sdmmc_isr"
+};
+
+#endif
+
+void profiler_init(void)
+{
+	// events_init has already enabled the DWT cycle counter.
+	profiler_reset();
+}
+
+void profiler_reset(void)
+{
+#if DO_PROFILING
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	memset(s_entries, 0, sizeof(s_entries));
+	for (int i = 0; i < PROFILE_LEN; i++)
+		s_entries[i].min_cycles = UINT32_MAX;
+	s_start_tick = HAL_GetTick();
+	__set_PRIMASK(primask);
+#endif
+}
+
+/**
+ * Safe to call from interrupt context. Note that the cycles recorded for main loop
+ * hooks include any time spent in interrupts that happened to fire meanwhile.
+ */
+RAM_TEXT_SECTION void profiler_record(profile_id_t id, uint32_t cycles)
+{
+#if DO_PROFILING
+	// Bucket by the position of the most significant bit:
+	int bucket = cycles == 0 ? 0 : 31 - __CLZ(cycles);
+	if (bucket >= PROFILE_HISTOGRAM_BUCKETS)
+		bucket = PROFILE_HISTOGRAM_BUCKETS - 1;
+
+	// Interrupts off briefly so that an ISR recording the same entry can't tear it:
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	profile_entry_t *pe = &s_entries[id];
+	pe->count++;
+	pe->total_cycles += cycles;
+	if (cycles < pe->min_cycles)
+		pe->min_cycles = cycles;
+	if (cycles > pe->max_cycles)
+		pe->max_cycles = cycles;
+	pe->histogram[bucket]++;
+	__set_PRIMASK(primask);
+#else
+	(void) id;
+	(void) cycles;
+#endif
+}
+
+/**
+ * Summary information that applies to all the lines of the report.
+ */
+size_t profiler_get_report_header(char *buf, size_t buflen)
+{
+#if DO_PROFILING
+	snprintf(buf, buflen,
+			"# firmware %s\n"
+			"# core clock %lu Hz, sampling rate %d Hz, %lu ms profiled, average duty cycle %d permille\n"
+			"# clock residency: %lu Hz for %lu ms, %lu Hz for %lu ms\n"
+			"# Times are in core clock cycles; histogram bucket n counts durations of 2^n to 2^(n+1)-1 cycles.\n"
+			"# name count min avg max histogram...\n",
+			FIRMWARE_VERSION,
+			(unsigned long) SystemCoreClock,
+			settings_get_logger_sampling_rate(),
+			(unsigned long) (HAL_GetTick() - s_start_tick),
+			events_get_average_duty_cycle_permille(),
+			(unsigned long) governor_get_level_hz(GOVERNOR_LEVEL_LOW),
+			(unsigned long) governor_get_residency_ms(GOVERNOR_LEVEL_LOW),
+			(unsigned long) governor_get_level_hz(GOVERNOR_LEVEL_FULL),
+			(unsigned long) governor_get_residency_ms(GOVERNOR_LEVEL_FULL));
+#else
+	snprintf(buf, buflen, "# profiling is not enabled in this build\n");
+#endif
+	return strlen(buf);
+}
+
+/**
+ * One line of the report, for one profiled item. Returns 0 for items that have
+ * never run.
+ */
+size_t profiler_get_report_line(profile_id_t id, char *buf, size_t buflen)
+{
+#if DO_PROFILING
+	// Take a copy so that the values are consistent with each other:
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	profile_entry_t e = s_entries[id];
+	__set_PRIMASK(primask);
+
+	if (e.count == 0 || buflen == 0)
+		return 0;
+
+	int n = snprintf(buf, buflen, "%s %lu %lu %lu %lu",
+			s_names[id],
+			(unsigned long) e.count,
+			(unsigned long) e.min_cycles,
+			(unsigned long) (e.total_cycles / e.count),
+			(unsigned long) e.max_cycles);
+	for (int i = 0; i < PROFILE_HISTOGRAM_BUCKETS && n > 0 && (size_t) n < buflen; i++)
+		n += snprintf(buf + n, buflen - n, " %lu", (unsigned long) e.histogram[i]);
+	if (n > 0 && (size_t) n < buflen)
+		n += snprintf(buf + n, buflen - n, "\n");
+
+	return strlen(buf);
+#else
+	(void) id;
+	(void) buf;
+	(void) buflen;
+	return 0;
+#endif
+}
@@ -23,12 +23,19 @@
 #include <data_processor_buffers.h>
 #include <memory.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 #include "recording.h"
 #include "storage.h"
 #include "settings.h"
+#include "buffer.h"
 #include "leds.h"
 #include "sd_lowlevel.h"
+#include "zc.h"
+#include "baseband.h"
+#include "storm.h"
+#include "thumbnail.h"
+#include "second_pass.h"
 
 #define BLINK_LEDS 1
 
@@ -38,8 +45,18 @@ static FX_FILE s_fx_file;
 static FX_MEDIA *s_fx_pMedium = NULL;
 static FX_FILE *s_fx_pFile = NULL;
 
+// The zero crossing file, if we are recording in that format:
+static FX_FILE s_zc_fx_file;
+static FX_FILE *s_zc_pFile = NULL;
+
 static int s_max_samples_per_file = 0;
 static int s_file_samples_written = 0;
+static int64_t s_file_start_position = 0;		// Of the file's first sample, in the data processor's stream.
+
+#if ACQUISITION_CHANNELS > 1
+#define ANALYSIS_CHUNK 1024
+static sample_type_t s_analysis_chunk[ANALYSIS_CHUNK];
+#endif
 static bool s_recording_opened = false;
 static bool s_recording_primed = false;		// Has recording_prime been called?
 static bool s_recording_started = false;
@@ -57,6 +74,7 @@ static int s_sampling_rate = 0;
  *  		recording_start			<-- This is will low latency if recording_prime was called.
  *  		recording_stop
  *  	recording_close				<-- Typically as part of client module closing.
+ *  	recording_reopen			<-- Optional: carry on with the same session after closing.
  *
  */
 
@@ -66,6 +84,10 @@ void recording_init(void)
 	s_fx_pMedium = NULL;
 	s_fx_pFile = NULL;
 	memset(&s_fx_file, 0, sizeof(s_fx_file));
+	s_zc_pFile = NULL;
+	memset(&s_zc_fx_file, 0, sizeof(s_zc_fx_file));
+	zc_init();
+	baseband_init();
 	s_max_samples_per_file = 0;
 	s_file_samples_written = 0;
 	s_recording_opened = false;
@@ -91,19 +113,167 @@ void recording_open(int sampling_rate)
 		}
 	}
 
+	s_sampling_rate = sampling_rate;
+	recording_reopen();
+}
+
+/**
+ * Open again after recording_close, without the once per session work that recording_open
+ * does. This is for clients that pause between bouts of recording, such as duty cycled
+ * listening in auto mode.
+ */
+void recording_reopen(void)
+{
 	s_recording_opened = true;
 	s_recording_first = true;
 	s_recording_primed = false;
 	s_recording_started = false;
-	s_sampling_rate = sampling_rate;
 }
 
-static void close_or_clean_up(FX_MEDIA *pMedium, FX_FILE *pFile) {
+static void zc_write(void *context, const uint8_t *data, int len)
+{
+	storage_zc_file_append_data((FX_FILE *) context, data, len);
+}
+
+static void baseband_write(void *context, int16_t *pSamples, int count)
+{
+	storage_wav_file_append_data((FX_FILE *) context, pSamples, count);
+}
+
+static bool is_baseband(void)
+{
+	return settings_get()->recording_format == RECORDING_FORMAT_BASEBAND;
+}
+
+/**
+ * Open whichever of the wav and zero crossing files the settings call for.
+ */
+static void open_files(const char *trigger)
+{
+	const settings_t *pSettings = settings_get();
+
+	if (pSettings->recording_format == RECORDING_FORMAT_BASEBAND) {
+		// Set up first, for the sampling rate and what goes in the GUANO data:
+		baseband_reset(s_sampling_rate, baseband_write, &s_fx_file);
+		s_fx_pFile = storage_open_baseband_file(s_fx_pMedium, &s_fx_file, baseband_get_output_rate(),
+				baseband_get_centre_hz(), s_sampling_rate, baseband_get_delay(), trigger);
+	}
+	else if (pSettings->recording_format != RECORDING_FORMAT_ZC)
+		s_fx_pFile = storage_open_wav_file(s_fx_pMedium, &s_fx_file, s_sampling_rate, trigger);
+
+	if (pSettings->recording_format == RECORDING_FORMAT_ZC || pSettings->recording_format == RECORDING_FORMAT_WAV_ZC) {
+		s_zc_pFile = storage_open_zc_file(s_fx_pMedium, &s_zc_fx_file, pSettings->zc_division_ratio);
+		if (s_zc_pFile)
+			zc_reset(s_sampling_rate, zc_write, s_zc_pFile);
+	}
+
+	s_max_samples_per_file = pSettings->max_sampling_time_s * s_sampling_rate * ACQUISITION_CHANNELS;
+	s_file_samples_written = 0;
+}
+
+static bool files_open(void)
+{
+	return s_fx_pFile || s_zc_pFile;
+}
+
+/**
+ * Should the files end before the buffer we are about to write? Within split_search_time_s
+ * of the maximum length, we end them ahead of the quietest buffer we can see coming, so that
+ * passes are cut in two less often. The buffer in hand is the place when nothing after it
+ * that would still fit is quieter.
+ */
+static bool should_split_files(void)
+{
+	const int remaining = s_max_samples_per_file - s_file_samples_written;
+	if (remaining <= 0)
+		return true;
+
+	const int search_samples = settings_get()->split_search_time_s * s_sampling_rate * ACQUISITION_CHANNELS;
+	if (s_file_samples_written == 0 || remaining > search_samples)
+		return false;
+
+	// Including the one in hand:
+	const int buffers_that_fit = (remaining + DATA_BUFFER_ENTRIES - 1) / DATA_BUFFER_ENTRIES;
+	return data_processor_buffers_find_quietest(buffers_that_fit) == 0;
+}
+
+static void analyse_channel(const sample_type_t *pSamples, int count)
+{
+	if (s_fx_pFile && is_baseband())
+		baseband_process(pSamples, count);
+	if (s_zc_pFile)
+		zc_process(pSamples, count);
+}
+
+/**
+ * Pass what we are recording to the baseband and zero crossing processing. These
+ * work on one channel, so with two we pick out the one the trigger uses, a chunk at a time.
+ */
+static void analyse_buffer(const sample_type_t *pBuffer, int count)
+{
+#if ACQUISITION_CHANNELS > 1
+	const int channel = settings_get()->trigger_channel == TRIGGER_CHANNEL_SECOND ? 1 : 0;
+	const int frames = count / ACQUISITION_CHANNELS;
+	for (int done = 0; done < frames; done += ANALYSIS_CHUNK) {
+		const int n = MIN(ANALYSIS_CHUNK, frames - done);
+		const sample_type_t *pSource = pBuffer + done * ACQUISITION_CHANNELS + channel;
+		for (int i = 0; i < n; i++, pSource += ACQUISITION_CHANNELS)
+			s_analysis_chunk[i] = *pSource;
+		analyse_channel(s_analysis_chunk, n);
+	}
+#else
+	analyse_channel(pBuffer, count);
+#endif
+}
+
+/**
+ * Close the files we have open, with the wav file first so that the zero crossing
+ * file gets the same name. Ordinary wav recordings go to the second pass, which decides
+ * whether to keep them once we are idle; anything else we keep now.
+ */
+static void close_files(void)
+{
 	// Avoid leaving files with no data in:
-	if (s_file_samples_written > 0)
-		storage_close_wav_file(s_fx_pMedium, s_fx_pFile);
-	else
-		storage_clean_up_wav_file(s_fx_pMedium, s_fx_pFile);
+	const bool has_data = s_file_samples_written > 0;
+	const bool keeping = has_data && files_open();
+	if (has_data)
+		storage_set_gain_changes(s_file_start_position, s_file_samples_written);
+
+	bool queued = false;
+	char base_name[LEN_128BYTES_BUFFER];
+	base_name[0] = '\0';
+
+	if (s_fx_pFile) {
+		if (is_baseband())
+			baseband_flush();
+		if (has_data) {
+			storage_close_wav_file(s_fx_pMedium, s_fx_pFile);
+			// Closing the zero crossing file forgets the name, so we take a copy:
+			strcpy(base_name, storage_get_last_wav_base_name());
+			if (!is_baseband())		// The second pass and the thumbnails only know about ordinary audio.
+				queued = second_pass_add(base_name);
+		}
+		else
+			storage_clean_up_wav_file(s_fx_pMedium, s_fx_pFile);
+		s_fx_pFile = NULL;
+	}
+
+	if (s_zc_pFile) {
+		zc_flush();
+		zc_init();		// Stop it writing to the file we are about to close.
+		if (has_data)
+			storage_close_zc_file(s_fx_pMedium, s_zc_pFile);
+		else
+			storage_clean_up_zc_file(s_fx_pMedium, s_zc_pFile);
+		s_zc_pFile = NULL;
+	}
+
+	// The storm limit counts what we write, whether or not the second pass keeps it later,
+	// since it can't catch up until the storm is over:
+	if (keeping)
+		storm_note_file();
+	if (keeping && !queued && base_name[0] != '\0' && !is_baseband())
+		thumbnail_add(base_name);
 }
 
 void recording_close(void)
@@ -114,8 +284,7 @@ void recording_close(void)
 	// Clean up anything that left over. This can happen if this function is called while
 	// recording is primed.
 
-	if (s_fx_pFile)
-		close_or_clean_up(s_fx_pMedium, s_fx_pFile);
+	close_files();
 
 	// Unmount the SD card if we mounted it successfully:
 	if (s_fx_pMedium)
@@ -137,12 +306,9 @@ void recording_prime(void)
 	s_fx_pMedium = storage_mount(STORAGE_MODE);	// ~ 100+250 ms, or 100+100ms with STORAGE_NORMAL.
 	if (s_fx_pMedium) {
 		// ~300 ms:
-		s_fx_pFile =
-(s_fx_pMedium, &s_fx_file, s_sampling_rate, "(primed)");
-		s_max_samples_per_file = settings_get()->max_sampling_time_s * s_sampling_rate;
-		s_file_samples_written = 0;
+		open_files("(primed)");
 
-		if (s_fx_pFile) {
+		if (files_open()) {
 			// Get ahead of the game by flushing FAT updates and the file header to SD:
 			storage_flush(s_fx_pMedium);
 		}
@@ -173,10 +339,7 @@ void recording_start()
 
 void recording_stop(bool go_to_standby)
 {
-	if (s_fx_pFile) {
-		close_or_clean_up(s_fx_pMedium, s_fx_pFile);
-		s_fx_pFile = NULL;
-	}
+	close_files();
 
 	s_recording_started = false;
 
@@ -184,11 +347,9 @@ void recording_stop(bool go_to_standby)
 		// Prepare for another recording. Leave the SD card mounted, and open a new file ready:
 		if (s_fx_pMedium) {
 			// ~300 ms:
-			s_fx_pFile = storage_open_wav_file(s_fx_pMedium, &s_fx_file, s_sampling_rate, "(preopened)");
-			s_max_samples_per_file = settings_get()->max_sampling_time_s * s_sampling_rate;
-			s_file_samples_written = 0;
+			open_files("(preopened)");
 
-			if (s_fx_pFile) {
+			if (files_open()) {
 				// Get ahead of the game by flushing FAT updates and the file header to SD:
 				storage_flush(s_fx_pMedium);
 			}
@@ -241,10 +402,8 @@ void recording_main_processing(int main_tick_count)
 		{
 			// The SD card has reappeared, and we should be recording, so mount it and open a new file:
 			s_fx_pMedium = storage_mount(STORAGE_MODE);
-			if (s_fx_pMedium) {
-				s_fx_pFile = storage_open_wav_file(s_fx_pMedium, &s_fx_file, s_sampling_rate, "continued");
-				s_file_samples_written = 0;
-			}
+			if (s_fx_pMedium)
+				open_files("continued");
 		}
 
 		if (sd_present) {
@@ -261,7 +420,7 @@ void recording_main_processing(int main_tick_count)
 			// leds_set(led_red, false);
 
 			else if (buffer_to_write) {
-				if (s_fx_pFile == NULL) {
+				if (!files_open()) {
 					// We need to open a file:
 					recording_start();
 				}
@@ -270,32 +429,30 @@ void recording_main_processing(int main_tick_count)
 				// the maximum file is determined by the memory buffer size.
 				if (!settings_get()->gated_recording) {
 					// Do we need to start a new data file?
-					if (s_file_samples_written >= s_max_samples_per_file) {
+					if (should_split_files()) {
 	#if BLINK_LEDS
 						leds_set(LEDS_GREEN, true);
 	#endif
-						// Close the wav file and open a new one:
-						if (s_fx_pFile) {
-							storage_close_wav_file(s_fx_pMedium, s_fx_pFile);
-							s_fx_pFile = NULL;
-						}
-
-						s_fx_pFile = storage_open_wav_file(s_fx_pMedium, &s_fx_file, s_sampling_rate, "continued");
-
-						s_file_samples_written = 0;
+						// Close the files and open new ones:
+						close_files();
+						open_files("continued");
 	#if BLINK_LEDS
 						leds_set(LEDS_GREEN, false);
 	#endif
 					}
 				}
 
-				if (s_fx_pFile) {
+				if (files_open()) {
 #if BLINK_LEDS
 					leds_set(LEDS_GREEN, true);
 #endif
+					if (s_file_samples_written == 0)
+						s_file_start_position = data_processor_buffers_get_read_position();
 					// The following line blocks while it writes. Perhaps it would be smarter to kick off
 					// an async write, so as not to block the main thread. One day.
-					storage_wav_file_append_data(s_fx_pFile, (sample_type_t *) buffer_to_write, DATA_BUFFER_ENTRIES);
+					if (s_fx_pFile && !is_baseband())
+						storage_wav_file_append_data(s_fx_pFile, (sample_type_t *) buffer_to_write, DATA_BUFFER_ENTRIES);
+					analyse_buffer(buffer_to_write, DATA_BUFFER_ENTRIES);
 					s_file_samples_written += DATA_BUFFER_ENTRIES;
 #if BLINK_LEDS
 					leds_set(LEDS_GREEN, false);
@@ -0,0 +1,199 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "main.h"
+#include "retained.h"
+#include <string.h>
+#include <stddef.h>
+
+#define RETAINED_MAGIC 0x5247425A		// "ZBGR"
+#define RETAINED_SCHEDULE_VERSION 5
+#define RETAINED_SETTINGS_VERSION 5
+
+// Backup SRAM is 2K. We place blocks at fixed offsets so that adding a block doesn't
+// invalidate the others:
+#define RETAINED_SCHEDULE_OFFSET 0
+#define RETAINED_SETTINGS_OFFSET 768
+#define BKPSRAM_SIZE_BYTES 2048
+
+_Static_assert(RETAINED_SCHEDULE_OFFSET + sizeof(retained_schedule_t) <= RETAINED_SETTINGS_OFFSET,
+		"Retained schedule overlaps retained settings");
+_Static_assert(RETAINED_SETTINGS_OFFSET + sizeof(retained_settings_t) <= BKPSRAM_SIZE_BYTES,
+		"Retained settings don't fit in backup SRAM");
+
+// A block is only checked against its version, size and checksum, so a change to a retained
+// structure that keeps its size, such as a new field in padding, would have the old block
+// read as the new layout. These pin the layouts: if one fails, bump the version of the
+// block that changed and then update the numbers here. The layouts are the same for the
+// Cortex-M33 and the 64 bit host builds, as nothing in them has a size that differs.
+_Static_assert(sizeof(retained_header_t) == 12, "Bump both retained versions");
+_Static_assert(sizeof(schedule_entry_t) == 32 && offsetof(schedule_entry_t, profile) == 16,
+		"Bump RETAINED_SCHEDULE_VERSION");
+_Static_assert(sizeof(retained_schedule_t) == 672 && offsetof(retained_schedule_t, next_wakeup_epoch) == 664,
+		"Bump RETAINED_SCHEDULE_VERSION");
+_Static_assert(sizeof(settings_t) == 488 && offsetof(settings_t, thumbnails) == 349
+		&& offsetof(settings_t, _location_present) == 484, "Bump RETAINED_SETTINGS_VERSION");
+_Static_assert(sizeof(settings_profile_t) == 132 && offsetof(settings_profile_t, _trigger_flags) == 116,
+		"Bump RETAINED_SETTINGS_VERSION");
+_Static_assert(sizeof(retained_settings_t) == 1064 && offsetof(retained_settings_t, settings) == 40
+		&& offsetof(retained_settings_t, profiles) == 532, "Bump RETAINED_SETTINGS_VERSION");
+
+static retained_schedule_t * const s_pSchedule = (retained_schedule_t *) (BKPSRAM_BASE + RETAINED_SCHEDULE_OFFSET);
+static retained_settings_t * const s_pSettings = (retained_settings_t *) (BKPSRAM_BASE + RETAINED_SETTINGS_OFFSET);
+
+static bool s_standby_wake = false;
+
+void retained_init(void)
+{
+	// Backup domain access was enabled in SystemClock_Config.
+	__HAL_RCC_BKPSRAM_CLK_ENABLE();
+
+	// By default backup SRAM is lost in standby:
+	HAL_PWREx_EnableBkupRAMRetention();
+
+	// Note whether we are here because we woke from standby, rather than from power up
+	// or reset, and clear the flag ready for next time:
+	s_standby_wake = __HAL_PWR_GET_FLAG(PWR_FLAG_SBF);
+	__HAL_PWR_CLEAR_FLAG(PWR_FLAG_SBF);
+}
+
+/**
+ * True if we woke from hard standby, until retained_take_standby_wake is called.
+ */
+bool retained_is_standby_wake(void)
+{
+	return s_standby_wake;
+}
+
+/**
+ * True the first time this is called after waking from hard standby.
+ */
+bool retained_take_standby_wake(void)
+{
+	bool standby_wake = s_standby_wake;
+	s_standby_wake = false;
+	return standby_wake;
+}
+
+/**
+ * FNV-1a. Quick and good enough to detect changes and corruption.
+ */
+uint32_t retained_hash(const void *p, size_t len)
+{
+	const uint8_t *pb = (const uint8_t *) p;
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= pb[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static uint32_t block_checksum(const retained_header_t *pHeader, size_t size)
+{
+	return retained_hash((const uint8_t *) pHeader + sizeof(*pHeader), size - sizeof(*pHeader));
+}
+
+static bool block_valid(const retained_header_t *pHeader, uint16_t version, size_t size)
+{
+	return pHeader->magic == RETAINED_MAGIC
+			&& pHeader->version == version
+			&& pHeader->size == size
+			&& pHeader->checksum == block_checksum(pHeader, size);
+}
+
+static void block_seal(retained_header_t *pHeader, uint16_t version, size_t size)
+{
+	pHeader->magic = RETAINED_MAGIC;
+	pHeader->version = version;
+	pHeader->size = size;
+	pHeader->checksum = block_checksum(pHeader, size);
+}
+
+/**
+ * Returns NULL if there is no valid retained schedule.
+ */
+const retained_schedule_t *retained_get_schedule(void)
+{
+	if (block_valid(&s_pSchedule->header, RETAINED_SCHEDULE_VERSION, sizeof(*s_pSchedule)))
+		return s_pSchedule;
+	return NULL;
+}
+
+void retained_save_schedule(uint32_t schedule_hash, const schedule_entry_t entries[], int count)
+{
+	if (count < 0)
+		count = 0;
+	if (count > MAX_SCHEDULE_INTERVALS)
+		count = MAX_SCHEDULE_INTERVALS;
+
+	memset(s_pSchedule, 0, sizeof(*s_pSchedule));
+	s_pSchedule->schedule_hash = schedule_hash;
+	s_pSchedule->entry_count = count;
+	memcpy(s_pSchedule->entries, entries, count * sizeof(entries[0]));
+	s_pSchedule->next_wakeup_epoch = 0;
+	block_seal(&s_pSchedule->header, RETAINED_SCHEDULE_VERSION, sizeof(*s_pSchedule));
+}
+
+void retained_set_next_wakeup(time_t epoch)
+{
+	if (retained_get_schedule() == NULL)
+		return;
+	s_pSchedule->next_wakeup_epoch = epoch;
+	block_seal(&s_pSchedule->header, RETAINED_SCHEDULE_VERSION, sizeof(*s_pSchedule));
+}
+
+void retained_invalidate_schedule(void)
+{
+	s_pSchedule->header.magic = 0;
+}
+
+/**
+ * Returns NULL if there are no valid retained settings, or they are from a different
+ * firmware version.
+ */
+const retained_settings_t *retained_get_settings(void)
+{
+	if (block_valid(&s_pSettings->header, RETAINED_SETTINGS_VERSION, sizeof(*s_pSettings))
+			&& strncmp(s_pSettings->firmware_version, FIRMWARE_VERSION, sizeof(s_pSettings->firmware_version)) == 0)
+		return s_pSettings;
+	return NULL;
+}
+
+void retained_save_settings(bool file_present, uint32_t file_size, uint32_t file_timestamp,
+		const settings_t *pSettings, const settings_profile_t profiles[], int profile_count)
+{
+	memset(s_pSettings, 0, sizeof(*s_pSettings));
+	strncpy(s_pSettings->firmware_version, FIRMWARE_VERSION, sizeof(s_pSettings->firmware_version) - 1);
+	s_pSettings->file_present = file_present;
+	s_pSettings->file_size = file_size;
+	s_pSettings->file_timestamp = file_timestamp;
+	s_pSettings->settings = *pSettings;
+	s_pSettings->profile_count = profile_count;
+	memcpy(s_pSettings->profiles, profiles, profile_count * sizeof(profiles[0]));
+	block_seal(&s_pSettings->header, RETAINED_SETTINGS_VERSION, sizeof(*s_pSettings));
+}
+
+void retained_invalidate_settings(void)
+{
+	s_pSettings->header.magic = 0;
+}
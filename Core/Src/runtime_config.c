@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdatomic.h>
+#include <math.h>
+#include "main.h"
+#include "runtime_config.h"
+#include "data_processor_buffers.h"
+#include "gain.h"
+#include "storm.h"
+
+/*
+ * Two of them, so that a new one can be built while the hot paths might still be using the
+ * current one. Changes are only made in main context, and the interrupt that reads it
+ * always finishes before main context carries on, so two are enough.
+ */
+static runtime_config_t s_configs[2];
+static _Atomic(const runtime_config_t *) s_pCurrent = &s_configs[0];
+static int s_samples_per_second = 0;
+
+/**
+ * Build the configuration for a listening session at this sampling rate, and make it current.
+ */
+void runtime_config_start_session(int samples_per_second)
+{
+	s_samples_per_second = samples_per_second;
+	runtime_config_update();
+}
+
+/**
+ * Rebuild the configuration from the current settings, gain range and storm level, for when
+ * one of them has changed. Main context only.
+ */
+void runtime_config_update(void)
+{
+	const settings_t *ps = settings_get();
+	runtime_config_t *pc = atomic_load(&s_pCurrent) == &s_configs[0] ? &s_configs[1] : &s_configs[0];
+
+	pc->trigger_pipeline = ps->trigger_pipeline;
+	pc->trigger_channel = ps->trigger_channel;
+	pc->trigger_max_count = ps->trigger_max_count;
+
+	// The raw thresholds are for the most sensitive range, and are squares, so they come down
+	// by twice the shift for a less sensitive range. In a storm, they go up by twice its shift:
+	const int shift_for_gain = gain_shift_for_range(GAIN_MAX_RANGE_INDEX) - gain_get_shift();
+	const int storm_shift = 2 * storm_get_threshold_shift();
+	const float32_t scale = ldexpf(1.0f, storm_shift - 2 * shift_for_gain);
+	pc->trigger_bucket_mask = 0;
+	for (int i = 0; i < MAX_TRIGGER_MATCH_CLAUSES; i++) {
+		const q31_t raw = ps->_trigger_thresholds[i];
+		if (!ps->_trigger_flags[i] || raw == SETTINGS_IGNORE_TRIGGER_VALUE) {
+			pc->trigger_thresholds[i] = INT32_MAX;
+			pc->trigger_thresholds_f32[i] = INFINITY;
+			continue;
+		}
+
+		pc->trigger_bucket_mask |= 1u << i;
+		q31_t threshold = (raw >> shift_for_gain) >> shift_for_gain;
+		if (storm_shift)
+			threshold = threshold > (INT32_MAX >> storm_shift) ? INT32_MAX : threshold << storm_shift;
+		pc->trigger_thresholds[i] = threshold;
+		pc->trigger_thresholds_f32[i] = (float32_t) raw * scale;
+	}
+
+	pc->gated_recording = ps->gated_recording;
+	pc->buffers_per_second = (s_samples_per_second * ACQUISITION_CHANNELS) / DATA_BUFFER_ENTRIES;
+	pc->pretrigger_buffers = pc->buffers_per_second * ps->pretrigger_time_s;
+	pc->min_sampling_buffers = pc->buffers_per_second * ps->min_sampling_time_s;
+	pc->hangover_buffers = pc->buffers_per_second * ps->hangover_time_s;
+
+	atomic_store(&s_pCurrent, pc);
+}
+
+/**
+ * The current configuration. Take it once, and use that for the whole of a half frame or
+ * trigger check.
+ */
+RAM_TEXT_SECTION const runtime_config_t *runtime_config_get(void)
+{
+	return atomic_load(&s_pCurrent);
+}
@@ -29,6 +29,7 @@
 #include "stm32u5xx_hal_sd.h"		// For BLOCKSIZE.
 #include "sdmmc.h"
 #include "sd_lowlevel.h"
+#include "governor.h"
 
 // Support for logic for debouncing SD card presence detection:
 static bool s_debounced_sd_present = false;
@@ -407,6 +408,9 @@ static void apply_sd_power(bool powered)
 
 bool sd_lowlevel_open(storage_write_type_t write_type)
 {
+	// The SDMMC bus interface is clocked from HCLK, so we need to be at full speed:
+	governor_hold(GOVERNOR_HOLD_SD);
+
 	apply_sd_power(true);
 	s_opened = false;
 
@@ -424,6 +428,7 @@ bool sd_lowlevel_open(storage_write_type_t write_type)
 		}
 	}
 
+	governor_release(GOVERNOR_HOLD_SD);
 	return false;
 }
 
@@ -439,6 +444,8 @@ void sd_lowlevel_close(void)
 	HAL_GPIO_WritePin(CMD_PULLUP_GPIO_Port, CMD_PULLUP_Pin, GPIO_PIN_RESET);
 
 	s_opened = false;
+
+	governor_release(GOVERNOR_HOLD_SD);
 }
 
 void sd_lowlevel_main_fast_processing(int)
@@ -0,0 +1,254 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "second_pass.h"
+#include "verify.h"
+#include "classify.h"
+#include "thumbnail.h"
+#include "data_processor_buffers.h"
+#include "settings.h"
+#include "storage.h"
+#include "buffer.h"
+#include "sd_lowlevel.h"
+
+/*
+ * Like the thumbnails, this only runs while nothing is being recorded, and then only for a
+ * few reads per main loop tick. At 384 kHz that is about 0.1 s of recording per tick, so a
+ * five second recording takes about as long again to check.
+ */
+#define READ_FRAMES 2048
+#define READS_PER_TICK 4
+
+#define MAX_QUEUED 8				// Recordings waiting. Beyond that we keep them unchecked.
+#define BASE_NAME_LEN 32
+
+typedef enum {
+	STATE_IDLE,
+	STATE_READING
+} second_pass_state_t;
+
+static char s_queue[MAX_QUEUED][BASE_NAME_LEN];
+static int s_queue_count = 0;
+
+static second_pass_state_t s_state = STATE_IDLE;
+static FX_MEDIA *s_pMedium = NULL;
+static FX_FILE s_file;
+static ULONG s_frames_left = 0;
+
+static int s_kept = 0;
+static int s_discarded = 0;
+
+static sample_type_t s_frames[READ_FRAMES * ACQUISITION_CHANNELS];
+#if ACQUISITION_CHANNELS > 1
+static sample_type_t s_channel[READ_FRAMES];
+#endif
+
+void second_pass_init(void)
+{
+	verify_init();
+	s_queue_count = 0;
+	s_state = STATE_IDLE;
+	s_pMedium = NULL;
+	s_kept = 0;
+	s_discarded = 0;
+}
+
+/**
+ * Queue the wav file with this name, less its extension, which has just been closed. Returns
+ * false if there is nothing to do or no room, in which case the caller keeps the recording.
+ */
+bool second_pass_add(const char *base_name)
+{
+	const settings_t *pSettings = settings_get();
+	if (!(pSettings->verify_enabled || pSettings->classify_enabled) || s_queue_count >= MAX_QUEUED)
+		return false;
+
+	strncpy(s_queue[s_queue_count], base_name, BASE_NAME_LEN - 1);
+	s_queue[s_queue_count][BASE_NAME_LEN - 1] = '\0';
+	s_queue_count++;
+	return true;
+}
+
+bool second_pass_is_idle(void)
+{
+	return s_queue_count == 0;
+}
+
+/**
+ * How many recordings the second pass has kept and thrown away since it was initialised.
+ */
+void second_pass_get_counts(int *pKept, int *pDiscarded)
+{
+	*pKept = s_kept;
+	*pDiscarded = s_discarded;
+}
+
+static void pop_queue(void)
+{
+	memmove(s_queue[0], s_queue[1], sizeof(s_queue[0]) * (MAX_QUEUED - 1));
+	s_queue_count--;
+}
+
+static bool start_file(void)
+{
+	snprintf(g_128bytes_char_buffer, LEN_128BYTES_BUFFER, "%s.wav", s_queue[0]);
+	if (fx_file_open(s_pMedium, &s_file, g_128bytes_char_buffer, FX_OPEN_FOR_READ) != FX_SUCCESS)
+		return false;
+
+	int sampling_rate = 0;
+	ULONG data_offset = 0;
+	if (!storage_find_wav_data(&s_file, &sampling_rate, &data_offset, &s_frames_left) || sampling_rate <= 0) {
+		fx_file_close(&s_file);
+		return false;
+	}
+
+	verify_reset(sampling_rate);
+	return true;
+}
+
+/**
+ * Read the next frames and pass the channel the trigger uses to verification.
+ */
+static void read_frames(void)
+{
+	const ULONG frames = MIN(READ_FRAMES, s_frames_left);
+	ULONG actual = 0;
+	if (fx_file_read(&s_file, s_frames, frames * sizeof(sample_type_t) * ACQUISITION_CHANNELS, &actual) != FX_SUCCESS) {
+		s_frames_left = 0;
+		return;
+	}
+
+	const int n = actual / (sizeof(sample_type_t) * ACQUISITION_CHANNELS);
+#if ACQUISITION_CHANNELS > 1
+	const int channel = settings_get()->trigger_channel == TRIGGER_CHANNEL_SECOND ? 1 : 0;
+	for (int i = 0; i < n; i++)
+		s_channel[i] = s_frames[i * ACQUISITION_CHANNELS + channel];
+	verify_process(s_channel, n);
+#else
+	verify_process(s_frames, n);
+#endif
+
+	// A short read means the file is shorter than its header says. Stop at what we have:
+	s_frames_left = n < frames ? 0 : s_frames_left - n;
+}
+
+/**
+ * Add a line for a recording we are keeping to the catalogue of recordings on the SD card.
+ */
+static void add_to_catalogue(const classify_result_t *pResult, int call_count)
+{
+	static const char header[] = "file,species,confidence,calls\n";
+	char line[LEN_128BYTES_BUFFER + 32];
+
+	snprintf(line, sizeof(line), "%s.wav,%s,%d,%d\n", s_queue[0],
+			pResult->label, pResult->confidence_percent, call_count);
+	storage_append_file(s_pMedium, "catalogue.csv", header, sizeof(header) - 1, line, strlen(line));
+}
+
+static void keep_file(void)
+{
+	thumbnail_add(s_queue[0]);
+	s_kept++;
+}
+
+/**
+ * The whole recording has been through verification: throw it away, or label it and keep it.
+ */
+static void decide(void)
+{
+	const settings_t *pSettings = settings_get();
+	if (pSettings->verify_enabled && !verify_passed()) {
+		storage_discard_closed_files(s_pMedium, s_queue[0]);
+		s_discarded++;
+		return;
+	}
+
+	if (pSettings->classify_enabled) {
+		call_features_t features;
+		classify_result_t result;
+		verify_get_features(&features);
+		classify(&features, &result);
+		storage_set_wav_auto_id(s_pMedium, s_queue[0], result.label, result.confidence_percent);
+		add_to_catalogue(&result, features.call_count);
+	}
+	keep_file();
+}
+
+static void finish(void)
+{
+	if (s_state != STATE_IDLE)
+		fx_file_close(&s_file);
+	s_state = STATE_IDLE;
+	pop_queue();
+	storage_unmount(true);
+	s_pMedium = NULL;
+}
+
+void second_pass_main_processing(int main_tick_count)
+{
+	if (s_queue_count == 0)
+		return;
+
+	if (s_pMedium && !sd_lowlevel_get_debounced_sd_present()) {
+		// The SD card has gone, and with it the recordings we had still to check:
+		storage_unmount(false);
+		s_pMedium = NULL;
+		s_state = STATE_IDLE;
+		s_queue_count = 0;
+		return;
+	}
+
+	// Recording comes first. If it has started again we pick up where we left off later:
+	if (data_processor_buffers_is_busy())
+		return;
+
+	switch (s_state) {
+	case STATE_IDLE:
+		s_pMedium = storage_mount(STORAGE_LOW_NOISE);
+		if (!s_pMedium)
+			return;
+		if (start_file()) {
+			s_state = STATE_READING;
+		}
+		else {
+			// We can't read it, so we can't say it isn't a bat:
+			keep_file();
+			finish();
+		}
+		break;
+
+	case STATE_READING:
+		for (int i = 0; i < READS_PER_TICK && s_frames_left > 0; i++)
+			read_frames();
+		if (s_frames_left == 0) {
+			// Done with reading. The file has to be closed before we rename or rewrite it:
+			fx_file_close(&s_file);
+			s_state = STATE_IDLE;
+			decide();
+			finish();
+		}
+		break;
+	}
+}
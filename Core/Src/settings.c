@@ -29,9 +29,10 @@
 #include "settings.h"
 #include "gain.h"
 #include "buffer.h"
+#include "solar.h"
+#include "zc.h"
 
-#define JSMN_STRICT
-#include "jsmn.h"
+#include "json_stream.h"
 
 static void process_trigger_flags(settings_t *ps);
 static void process_trigger_thresholds(settings_t *ps);
@@ -54,6 +55,30 @@ static settings_t s_settings = {
 		latitude: 0,
 		logger_sampling_rate_index: 8,		// Sampling rate as multiples of 48 kHz: 5:240, 6:288, 7: 336, 8:384, 9:432: 10:480, 11:528
 		gated_recording: false,		// Will we write data to SD at the same time as acquiring it?
+		write_profile_to_sd: false,	// Write CPU profiling results to SD when we leave each mode.
+		listen_window_s: 0,			// Listen for this long in every listen_period_s. 0 means all the time.
+		listen_period_s: 300,
+		listen_adaptive: false,		// Extend the listening window while there is activity.
+		recording_format: RECORDING_FORMAT_WAV,
+		zc_division_ratio: 8,		// The usual Anabat division ratio.
+		zc_hysteresis: 64,
+		zc_band_low_khz: 15,		// Below bats, and keeps low frequency noise from swamping the crossings.
+		zc_band_high_khz: 0,
+		baseband_low_khz: 40,
+		baseband_high_khz: 60,
+		ltsa_enabled: false,
+		thumbnails: false,
+		verify_enabled: false,
+		verify_min_calls: 2,
+		verify_tonality_db: 12,
+		classify_enabled: false,
+		agc_enabled: false,			// sensitivity_range is where it starts.
+		agc_interval_s: 10,
+		trigger_channel: TRIGGER_CHANNEL_FIRST,		// Only matters with ACQUISITION_CHANNELS 2.
+		split_search_time_s: 1,
+		hangover_time_s: 1,
+		storm_files_per_hour: 0,
+		trigger_pipeline: TRIGGER_PIPELINE_Q15,
 
 		_trigger_thresholds: {0},
 		_trigger_flags: {false},
@@ -61,86 +86,77 @@ static settings_t s_settings = {
 		_location_present: false
 };
 
-// Lifted from the jsmn example code:
-static bool json_eq_string(const char *json, jsmntok_t *tok, const char *s)
+// One stream at a time is enough, and it's too big to want on the stack:
+static json_stream_t s_json_stream;
+
+// The settings being parsed, which only become current if the whole file is valid:
+static settings_t s_parsed_settings;
+static settings_profile_t s_parsed_profiles[SETTINGS_MAX_PROFILES];
+static int s_parsed_profile_count = 0;
+static settings_t s_profile_scratch;
+
+// Profiles, and the full settings for each, ready to switch to:
+static settings_profile_t s_profiles[SETTINGS_MAX_PROFILES];
+static settings_t s_profile_settings[SETTINGS_MAX_PROFILES];
+static int s_profile_count = 0;
+static const settings_t *s_pActive = &s_settings;
+static int s_active_profile = SETTINGS_NO_PROFILE;
+
+static bool json_key_is(const json_stream_t *ps, const char *s)
 {
-  if (tok->type == JSMN_STRING && (int)strlen(s) == tok->end - tok->start &&
-      strncmp(json + tok->start, s, tok->end - tok->start) == 0) {
-    return true;
-  }
-  return false;
+	return strcmp(ps->key, s) == 0;
 }
 
-static bool json_get_integer(const char *json, jsmntok_t *tok, int *value)
+static bool json_get_integer(json_stream_t *ps, int *value)
 {
-	// Attempt to extract an integer from the token:
-	if (tok->type == JSMN_PRIMITIVE) {
-		const char *cptr = json + tok->end;
-		char c = *cptr;
-		* (char*) cptr = '\0';	// Temporarily terminate the string after the value.
-		const char *s = json + tok->start, *tailptr = s;
+	// Attempt to extract an integer from the value following the key:
+	if (json_stream_next_value(ps) == JSON_STREAM_PRIMITIVE) {
+		const char *s = ps->value, *tailptr = s;
 		*value = strtod(s, (char**) &tailptr);
-		* (char*) cptr = c;
 		return tailptr > s;
 	}
 
 	return false;
 }
 
-static bool json_get_float(const char *json, jsmntok_t *tok, float *value)
+static bool json_get_float(json_stream_t *ps, float *value)
 {
-	// Attempt to extract an integer from the token:
-	if (tok->type == JSMN_PRIMITIVE) {
-		const char *cptr = json + tok->end;
-		char c = *cptr;
-		* (char*) cptr = '\0';	// Temporarily terminate the string after the value.
-		const char *s = json + tok->start, *tailptr = s;
+	// Attempt to extract a float from the value following the key:
+	if (json_stream_next_value(ps) == JSON_STREAM_PRIMITIVE) {
+		const char *s = ps->value, *tailptr = s;
 		*value = strtof(s, (char**) &tailptr);
-		* (char*) cptr = c;
 		return tailptr > s;
 	}
 
 	return false;
 }
 
-static bool json_get_bool(const char *json, jsmntok_t *tok, bool *value)
+static bool json_get_bool(json_stream_t *ps, bool *value)
 {
-	// Attempt to extract an integer from the token:
-	if (tok->type == JSMN_PRIMITIVE) {
-		const char *cptr = json + tok->end;
-		char c = *cptr;
-		* (char*) cptr = '\0';	// Temporarily terminate the string after the value.
-		const char *s = json + tok->start;
-		bool rc = false;
-		if (strncmp(s, "true", 4) == 0) {
+	// Attempt to extract a boolean from the value following the key:
+	if (json_stream_next_value(ps) == JSON_STREAM_PRIMITIVE) {
+		if (strcmp(ps->value, "true") == 0) {
 			*value = true;
-			rc = true;
+			return true;
 		}
-		else if (strncmp(s, "false", 5) == 0) {
+		else if (strcmp(ps->value, "false") == 0) {
 			*value = false;
-			rc = true;
+			return true;
 		}
-		* (char*) cptr = c;
-		return rc;
 	}
 
 	return false;
 }
 
-static int json_get_string(const char *json, jsmntok_t *tok, char *buf, size_t buflen)
+static int json_get_string(json_stream_t *ps, char *buf, size_t buflen)
 {
-	// Attempt to extract an integer from the token:
-	if (tok->type == JSMN_STRING) {
-		const char *cptr = json + tok->end;
-		char c = *cptr;
-		* (char*) cptr = '\0';	// Temporarily terminate the string after the value.
-		const char *s = json + tok->start;
+	// Attempt to extract a string from the value following the key:
+	if (json_stream_next_value(ps) == JSON_STREAM_STRING) {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wstringop-truncation"
-		strncpy(buf, s, buflen);
+		strncpy(buf, ps->value, buflen);
 #pragma GCC diagnostic pop
 		buf[buflen - 1] = '\0';	// strncpy can leave the string unterminated.
-		* (char*) cptr = c;
 		return strlen(buf);
 	}
 
@@ -152,9 +168,26 @@ void settings_init(void)
 {
 }
 
+/**
+ * The settings currently in force, which are those of the selected profile if there is one.
+ */
 const settings_t *settings_get(void)
 {
-	return &s_settings;
+	return s_pActive;
+}
+
+static void build_profile_settings(void);
+
+/**
+ * Put back settings saved earlier, calculated fields and all, as an alternative to
+ * parsing the JSON again.
+ */
+void settings_restore(const settings_t *pSettings, const settings_profile_t profiles[], int profile_count)
+{
+	s_settings = *pSettings;
+	s_profile_count = profile_count < SETTINGS_MAX_PROFILES ? profile_count : SETTINGS_MAX_PROFILES;
+	memcpy(s_profiles, profiles, s_profile_count * sizeof(s_profiles[0]));
+	build_profile_settings();
 }
 
 static int clip_to_int_range(int value, int min, int max)
@@ -177,144 +210,453 @@ static float clip_to_float_range(float value, float min, float max)
 	return value;
 }
 
-#define MAX_SETTINGS_TOKENS 64
+/**
+ * Deal with a key for one of the settings that profiles can override, recording it in
+ * overridden if that is supplied. Returns false if it is some other key, leaving its value
+ * unread.
+ */
+static bool parse_profile_setting(json_stream_t *ps, settings_t *pTarget, uint32_t *pOverridden)
+{
+	uint32_t field = 0;
+	if (json_key_is(ps, "max_sampling_time_s")) {
+		float float_value;
+		if (json_get_float(ps, &float_value)) {
+			pTarget->max_sampling_time_s = clip_to_float_range(float_value, 0.5, 120);
+			field = SETTINGS_PROFILE_MAX_SAMPLING_TIME;
+		}
+	}
+	else if (json_key_is(ps, "min_sampling_time_s")) {
+		float float_value;
+		if (json_get_float(ps, &float_value)) {
+			pTarget->min_sampling_time_s = clip_to_float_range(float_value, 0.5, 120);
+			field = SETTINGS_PROFILE_MIN_SAMPLING_TIME;
+		}
+	}
+	else if (json_key_is(ps, "pretrigger_time_s")) {
+		float float_value;
+		if (json_get_float(ps, &float_value)) {
+			pTarget->pretrigger_time_s = clip_to_float_range(float_value, 0.0, 2.0);
+			field = SETTINGS_PROFILE_PRETRIGGER_TIME;
+		}
+	}
+	else if (json_key_is(ps, "sensitivity_range")) {
+		int int_value;
+		if (json_get_integer(ps, &int_value)) {
+			pTarget->sensitivity_range = clip_to_int_range(int_value, 0, GAIN_MAX_RANGE_INDEX);
+			field = SETTINGS_PROFILE_SENSITIVITY_RANGE;
+		}
+	}
+	else if (json_key_is(ps, "sensitivity_disable")) {
+		bool bool_value = false;
+		if (json_get_bool(ps, &bool_value)) {
+			pTarget->sensitivity_disable = bool_value;
+			field = SETTINGS_PROFILE_SENSITIVITY_DISABLE;
+		}
+	}
+	else if (json_key_is(ps, "trigger_max_count")) {
+		int int_value;
+		if (json_get_integer(ps, &int_value)) {
+			pTarget->trigger_max_count = clip_to_int_range(int_value, 1, MAX_TRIGGER_MATCH_CLAUSES);
+			field = SETTINGS_PROFILE_TRIGGER_MAX_COUNT;
+		}
+	}
+	else if (json_key_is(ps, "trigger")) {
+		if (json_get_string(ps, pTarget->trigger_string, SETTINGS_TRIGGER_MATCH_LEN) > 0)
+			field = SETTINGS_PROFILE_TRIGGER;
+	}
+	else if (json_key_is(ps, "trigger_thresholds")) {
+		if (json_get_string(ps, pTarget->trigger_thresholds_string, SETTINGS_TRIGGER_MATCH_LEN) > 0)
+			field = SETTINGS_PROFILE_TRIGGER_THRESHOLDS;
+	}
+	else if (json_key_is(ps, "logger_sampling_rate_index")) {
+		int int_value;
+		if (json_get_integer(ps, &int_value)) {
+			pTarget->logger_sampling_rate_index = clip_to_int_range(int_value,
+					SETTINGS_MIN_SAMPLING_RATE_INDEX, SETTINGS_MAX_SAMPLING_RATE_INDEX);
+			field = SETTINGS_PROFILE_SAMPLING_RATE;
+		}
+	}
+	else if (json_key_is(ps, "trigger_pipeline")) {
+		json_get_string(ps, g_128bytes_char_buffer, LEN_128BYTES_BUFFER);
+		if (stricmp(g_128bytes_char_buffer, "q15") == 0) {
+			pTarget->trigger_pipeline = TRIGGER_PIPELINE_Q15;
+			field = SETTINGS_PROFILE_TRIGGER_PIPELINE;
+		}
+		else if (stricmp(g_128bytes_char_buffer, "float") == 0) {
+			pTarget->trigger_pipeline = TRIGGER_PIPELINE_FLOAT;
+			field = SETTINGS_PROFILE_TRIGGER_PIPELINE;
+		}
+	}
+	else {
+		return false;
+	}
 
-bool settings_parse_and_process_json_settings(const char *json)
+	if (pOverridden)
+		*pOverridden |= field;
+	return true;
+}
+
+static int find_profile(const settings_profile_t profiles[], int count, const char *name)
+{
+	if (*name == '\0')
+		return SETTINGS_NO_PROFILE;
+	for (int i = 0; i < count; i++) {
+		if (strcmp(profiles[i].name, name) == 0)
+			return i;
+	}
+	return SETTINGS_UNKNOWN_PROFILE;
+}
+
+/**
+ * Keep the values a profile overrides, compiling its trigger strings into tables now
+ * so that nothing needs doing when we switch to it.
+ */
+static void compile_profile(settings_t *pScratch, settings_profile_t *pProfile)
+{
+	pProfile->max_sampling_time_s = pScratch->max_sampling_time_s;
+	pProfile->min_sampling_time_s = pScratch->min_sampling_time_s;
+	pProfile->pretrigger_time_s = pScratch->pretrigger_time_s;
+	pProfile->sensitivity_range = pScratch->sensitivity_range;
+	pProfile->sensitivity_disable = pScratch->sensitivity_disable;
+	pProfile->trigger_max_count = pScratch->trigger_max_count;
+	pProfile->logger_sampling_rate_index = pScratch->logger_sampling_rate_index;
+	pProfile->trigger_pipeline = pScratch->trigger_pipeline;
+
+	if (pProfile->overridden & SETTINGS_PROFILE_TRIGGER) {
+		process_trigger_flags(pScratch);
+		memcpy(pProfile->_trigger_flags, pScratch->_trigger_flags, sizeof(pProfile->_trigger_flags));
+	}
+	if (pProfile->overridden & SETTINGS_PROFILE_TRIGGER_THRESHOLDS) {
+		process_trigger_thresholds(pScratch);
+		memcpy(pProfile->_trigger_thresholds, pScratch->_trigger_thresholds, sizeof(pProfile->_trigger_thresholds));
+	}
+}
+
+/**
+ * Parse "profiles": { "name": { settings... }, ... }. Only the settings that profiles can
+ * override are used; others are ignored. Returns false for anything we can't represent,
+ * such as too many profiles or a name that is too long, so that the user finds out.
+ */
+static bool parse_profiles(json_stream_t *ps)
+{
+	if (json_stream_next(ps) != JSON_STREAM_OBJECT_START)
+		return false;
+
+	json_stream_event_t event;
+	while ((event = json_stream_next(ps)) == JSON_STREAM_KEY) {
+		if (s_parsed_profile_count == SETTINGS_MAX_PROFILES
+				|| strlen(ps->key) >= SETTINGS_PROFILE_NAME_LEN
+				|| find_profile(s_parsed_profiles, s_parsed_profile_count, ps->key) != SETTINGS_UNKNOWN_PROFILE)
+			return false;
+
+		settings_profile_t *pProfile = &s_parsed_profiles[s_parsed_profile_count++];
+		memset(pProfile, 0, sizeof(*pProfile));
+		strcpy(pProfile->name, ps->key);
+
+		if (json_stream_next(ps) != JSON_STREAM_OBJECT_START)
+			return false;
+		while ((event = json_stream_next(ps)) == JSON_STREAM_KEY) {
+			if (!parse_profile_setting(ps, &s_profile_scratch, &pProfile->overridden))
+				json_stream_skip_value(ps);
+		}
+		if (event != JSON_STREAM_OBJECT_END)
+			return false;
+
+		compile_profile(&s_profile_scratch, pProfile);
+	}
+
+	return event == JSON_STREAM_OBJECT_END;
+}
+
+/**
+ * Build the full settings for each profile: the settings with the profile's values on top.
+ */
+static void build_profile_settings(void)
 {
-	jsmn_parser parser;
-	jsmntok_t tokens[MAX_SETTINGS_TOKENS];
-	typedef enum { top_level /*, trigger_item */ } parser_scope_t;
+	for (int i = 0; i < s_profile_count; i++) {
+		const settings_profile_t *pProfile = &s_profiles[i];
+		settings_t *pTarget = &s_profile_settings[i];
+		const uint32_t overridden = pProfile->overridden;
+
+		*pTarget = s_settings;
+		if (overridden & SETTINGS_PROFILE_MAX_SAMPLING_TIME)
+			pTarget->max_sampling_time_s = pProfile->max_sampling_time_s;
+		if (overridden & SETTINGS_PROFILE_MIN_SAMPLING_TIME)
+			pTarget->min_sampling_time_s = pProfile->min_sampling_time_s;
+		if (overridden & SETTINGS_PROFILE_PRETRIGGER_TIME)
+			pTarget->pretrigger_time_s = pProfile->pretrigger_time_s;
+		if (overridden & SETTINGS_PROFILE_SENSITIVITY_RANGE)
+			pTarget->sensitivity_range = pProfile->sensitivity_range;
+		if (overridden & SETTINGS_PROFILE_SENSITIVITY_DISABLE)
+			pTarget->sensitivity_disable = pProfile->sensitivity_disable;
+		if (overridden & SETTINGS_PROFILE_TRIGGER_MAX_COUNT)
+			pTarget->trigger_max_count = pProfile->trigger_max_count;
+		if (overridden & SETTINGS_PROFILE_SAMPLING_RATE)
+			pTarget->logger_sampling_rate_index = pProfile->logger_sampling_rate_index;
+		if (overridden & SETTINGS_PROFILE_TRIGGER_PIPELINE)
+			pTarget->trigger_pipeline = pProfile->trigger_pipeline;
+		if (overridden & SETTINGS_PROFILE_TRIGGER)
+			memcpy(pTarget->_trigger_flags, pProfile->_trigger_flags, sizeof(pTarget->_trigger_flags));
+		if (overridden & SETTINGS_PROFILE_TRIGGER_THRESHOLDS)
+			memcpy(pTarget->_trigger_thresholds, pProfile->_trigger_thresholds, sizeof(pTarget->_trigger_thresholds));
+	}
 
+	s_pActive = &s_settings;
+	s_active_profile = SETTINGS_NO_PROFILE;
+}
+
+const settings_profile_t *settings_get_profiles(int *pCount)
+{
+	*pCount = s_profile_count;
+	return s_profiles;
+}
+
+/**
+ * Look up a profile by name. An empty name means no profile.
+ */
+int settings_find_profile(const char *name)
+{
+	return find_profile(s_profiles, s_profile_count, name);
+}
+
+int settings_get_selected_profile(void)
+{
+	return s_active_profile;
+}
+
+/**
+ * Make a profile's settings current, or the plain settings for SETTINGS_NO_PROFILE. All the
+ * work was done when the settings were parsed, so this is cheap enough to do at any time.
+ */
+void settings_select_profile(int profile)
+{
+	if (profile >= 0 && profile < s_profile_count) {
+		s_pActive = &s_profile_settings[profile];
+		s_active_profile = profile;
+	}
+	else {
+		s_pActive = &s_settings;
+		s_active_profile = SETTINGS_NO_PROFILE;
+	}
+}
+
+/**
+ * Parse settings JSON from a stream that is ready to go. The settings only change if the
+ * whole of the JSON is valid.
+ */
+static bool parse_settings(json_stream_t *ps)
+{
 	/*
 	 * For now, error handling is as follows:
 	 * 	If it is not valid, we give up and return false.
-	 * 	If it is valid, we process each token as best we can, failing silently leaving the value
+	 * 	If it is valid, we process each key as best we can, failing silently leaving the value
 	 * 	as default, or silently clipping its value within the valid range.
 	 */
 
-	jsmn_init(&parser);
-	int token_count = jsmn_parse(&parser, json, strlen(json), tokens, MAX_SETTINGS_TOKENS);
-	if (token_count < 0)
+	s_parsed_settings = s_settings;
+	s_parsed_profile_count = 0;
+
+	if (json_stream_next(ps) != JSON_STREAM_OBJECT_START)
 		return false;
 
-	parser_scope_t parser_scope = top_level;
-	// int trigger_entries = 0, trigger_entry_index = 0, trigger_item_size = 0, trigger_item_values_seen = 0;
-	for (int i = 0; i < token_count; i++) {
-		jsmntok_t token = tokens[i];
-		switch (parser_scope) {
-			case top_level: {
-				if (json_eq_string(json, &token, "max_sampling_time_s")) {
-					// The value is the next token:
-					token = tokens[++i];
-					float float_value;
-					if (json_get_float(json, &token, &float_value))
-						s_settings.max_sampling_time_s = clip_to_float_range(float_value, 0.5, 120);
-				}
-				else if (json_eq_string(json, &token, "min_sampling_time_s")) {
-					// The value is the next token:
-					token = tokens[++i];
-					float float_value;
-					if (json_get_float(json, &token, &float_value))
-						s_settings.min_sampling_time_s = clip_to_float_range(float_value, 0.5, 120);
-				}
-				else if (json_eq_string(json, &token, "pretrigger_time_s")) {
-									// The value is the next token:
-									token = tokens[++i];
-									float float_value;
-									if (json_get_float(json, &token, &float_value))
-										s_settings.pretrigger_time_s = clip_to_float_range(float_value, 0.0, 2.0);
-								}
-				else if (json_eq_string(json, &token, "sensitivity_range")) {
-					// The value is the next token:
-					token = tokens[++i];
-					int int_value;
-					if (json_get_integer(json, &token, &int_value))
-						s_settings.sensitivity_range = clip_to_int_range(int_value, 0, GAIN_MAX_RANGE_INDEX);
-				}
-				else if (json_eq_string(json, &token, "sensitivity_disable")) {
-					// The value is the next token:
-					token = tokens[++i];
-					bool bool_value = false;
-					if (json_get_bool(json, &token, &bool_value))
-						s_settings.sensitivity_disable = bool_value;
-				}
-				else if (json_eq_string(json, &token, "write_settings_to_sd")) {
-					// The value is the next token:
-					token = tokens[++i];
-					bool bool_value;
-					if (json_get_bool(json, &token, &bool_value))
-						s_settings.write_settings_to_sd = bool_value;
-				}
-				else if (json_eq_string(json, &token, "trigger_max_count")) {
-					// The value is the next token:
-					token = tokens[++i];
-					int int_value;
-					if (json_get_integer(json, &token, &int_value))
-						s_settings.trigger_max_count = clip_to_int_range(int_value, 1, MAX_TRIGGER_MATCH_CLAUSES);
-				}
-				else if (json_eq_string(json, &token, "trigger")) {
-					// The value is the next token:
-					token = tokens[++i];
-					json_get_string(json, &token, s_settings.trigger_string, SETTINGS_TRIGGER_MATCH_LEN);
-				}
-				else if (json_eq_string(json, &token, "trigger_thresholds")) {
-					// The value is the next token:
-					token = tokens[++i];
-					json_get_string(json, &token, s_settings.trigger_thresholds_string, SETTINGS_TRIGGER_MATCH_LEN);
-				}
-				else if (json_eq_string(json, &token, "disable_usb_msc")) {
-					// The value is the next token:
-					token = tokens[++i];
-					bool bool_value;
-					if (json_get_bool(json, &token, &bool_value))
-						s_settings.disable_usb_msc = bool_value;
-				}
-				else if (json_eq_string(json, &token, "location")) {
-					// The value is the next token:
-					token = tokens[++i];
-					json_get_string(json, &token, g_128bytes_char_buffer, LEN_128BYTES_BUFFER);
-					// Attempt to parse out the latitude and longitude allowing arbitrary space between them:
-					double latitude, longitude;
-					if (sscanf(g_128bytes_char_buffer, "%lf %lf", &latitude, &longitude) == 2) {
-						s_settings.latitude = latitude;
-						s_settings.longitude = longitude;
-						s_settings._location_present = true;
-					}
-					else {
-						s_settings.latitude = 0;
-						s_settings.longitude = 0;
-						s_settings._location_present = false;
-					}
-				}
-				else if (json_eq_string(json, &token, "logger_sampling_rate_index")) {
-					// The value is the next token:
-					token = tokens[++i];
-					int int_value;
-					if (json_get_integer(json, &token, &int_value))
-						s_settings.logger_sampling_rate_index = clip_to_int_range(int_value,
-								SETTINGS_MIN_SAMPLING_RATE_INDEX, SETTINGS_MAX_SAMPLING_RATE_INDEX);
-				}
-				else if (json_eq_string(json, &token, "gated_recording")) {
-					// The value is the next token:
-					token = tokens[++i];
-					bool bool_value;
-					if (json_get_bool(json, &token, &bool_value))
-						s_settings.gated_recording  = bool_value;
-				}
-				else {
-					// Intentionally ignore unknown tokens to allow for compatibility when we add new tokens.
-				}
+	json_stream_event_t event;
+	while ((event = json_stream_next(ps)) == JSON_STREAM_KEY) {
+		if (parse_profile_setting(ps, &s_parsed_settings, NULL)) {
+			// One that profiles can override too, which has been dealt with.
+		}
+		else if (json_key_is(ps, "profiles")) {
+			if (!parse_profiles(ps))
+				return false;
+		}
+		else if (json_key_is(ps, "write_settings_to_sd")) {
+			bool bool_value;
+			if (json_get_bool(ps, &bool_value))
+				s_parsed_settings.write_settings_to_sd = bool_value;
+		}
+		else if (json_key_is(ps, "write_profile_to_sd")) {
+			bool bool_value;
+			if (json_get_bool(ps, &bool_value))
+				s_parsed_settings.write_profile_to_sd = bool_value;
+		}
+		else if (json_key_is(ps, "disable_usb_msc")) {
+			bool bool_value;
+			if (json_get_bool(ps, &bool_value))
+				s_parsed_settings.disable_usb_msc = bool_value;
+		}
+		else if (json_key_is(ps, "location")) {
+			json_get_string(ps, g_128bytes_char_buffer, LEN_128BYTES_BUFFER);
+			// Attempt to parse out the latitude and longitude allowing arbitrary space between them:
+			double latitude, longitude;
+			if (sscanf(g_128bytes_char_buffer, "%lf %lf", &latitude, &longitude) == 2) {
+				s_parsed_settings.latitude = latitude;
+				s_parsed_settings.longitude = longitude;
+				s_parsed_settings._location_present = true;
 			}
-			break;
+			else {
+				s_parsed_settings.latitude = 0;
+				s_parsed_settings.longitude = 0;
+				s_parsed_settings._location_present = false;
+			}
+		}
+		else if (json_key_is(ps, "gated_recording")) {
+			bool bool_value;
+			if (json_get_bool(ps, &bool_value))
+				s_parsed_settings.gated_recording  = bool_value;
+		}
+		else if (json_key_is(ps, "listen_window_s")) {
+			int int_value;
+			if (json_get_integer(ps, &int_value))
+				s_parsed_settings.listen_window_s = clip_to_int_range(int_value, 0, 24 * 60 * 60);
+		}
+		else if (json_key_is(ps, "listen_period_s")) {
+			int int_value;
+			if (json_get_integer(ps, &int_value))
+				s_parsed_settings.listen_period_s = clip_to_int_range(int_value, 10, 24 * 60 * 60);
+		}
+		else if (json_key_is(ps, "listen_adaptive")) {
+			bool bool_value;
+			if (json_get_bool(ps, &bool_value))
+				s_parsed_settings.listen_adaptive = bool_value;
+		}
+		else if (json_key_is(ps, "recording_format")) {
+			json_get_string(ps, g_128bytes_char_buffer, LEN_128BYTES_BUFFER);
+			if (stricmp(g_128bytes_char_buffer, "wav") == 0)
+				s_parsed_settings.recording_format = RECORDING_FORMAT_WAV;
+			else if (stricmp(g_128bytes_char_buffer, "zc") == 0)
+				s_parsed_settings.recording_format = RECORDING_FORMAT_ZC;
+			else if (stricmp(g_128bytes_char_buffer, "wav+zc") == 0)
+				s_parsed_settings.recording_format = RECORDING_FORMAT_WAV_ZC;
+			else if (stricmp(g_128bytes_char_buffer, "baseband") == 0)
+				s_parsed_settings.recording_format = RECORDING_FORMAT_BASEBAND;
+		}
+		else if (json_key_is(ps, "zc_division_ratio")) {
+			int int_value;
+			if (json_get_integer(ps, &int_value))
+				s_parsed_settings.zc_division_ratio = clip_to_int_range(int_value, ZC_MIN_DIVISION_RATIO, ZC_MAX_DIVISION_RATIO);
+		}
+		else if (json_key_is(ps, "zc_hysteresis")) {
+			int int_value;
+			if (json_get_integer(ps, &int_value))
+				s_parsed_settings.zc_hysteresis = clip_to_int_range(int_value, 0, 8192);
+		}
+		else if (json_key_is(ps, "zc_band_low_khz")) {
+			int int_value;
+			if (json_get_integer(ps, &int_value))
+				s_parsed_settings.zc_band_low_khz = clip_to_int_range(int_value, 0, 250);
+		}
+		else if (json_key_is(ps, "zc_band_high_khz")) {
+			int int_value;
+			if (json_get_integer(ps, &int_value))
+				s_parsed_settings.zc_band_high_khz = clip_to_int_range(int_value, 0, 250);
+		}
+		else if (json_key_is(ps, "baseband_low_khz")) {
+			int int_value;
+			if (json_get_integer(ps, &int_value))
+				s_parsed_settings.baseband_low_khz = clip_to_int_range(int_value, 0, 250);
+		}
+		else if (json_key_is(ps, "baseband_high_khz")) {
+			int int_value;
+			if (json_get_integer(ps, &int_value))
+				s_parsed_settings.baseband_high_khz = clip_to_int_range(int_value, 1, 250);
+		}
+		else if (json_key_is(ps, "ltsa_enabled")) {
+			bool bool_value;
+			if (json_get_bool(ps, &bool_value))
+				s_parsed_settings.ltsa_enabled = bool_value;
+		}
+		else if (json_key_is(ps, "thumbnails")) {
+			bool bool_value;
+			if (json_get_bool(ps, &bool_value))
+				s_parsed_settings.thumbnails = bool_value;
+		}
+		else if (json_key_is(ps, "verify_enabled")) {
+			bool bool_value;
+			if (json_get_bool(ps, &bool_value))
+				s_parsed_settings.verify_enabled = bool_value;
+		}
+		else if (json_key_is(ps, "verify_min_calls")) {
+			int int_value;
+			if (json_get_integer(ps, &int_value))
+				s_parsed_settings.verify_min_calls = clip_to_int_range(int_value, 1, 1000);
+		}
+		else if (json_key_is(ps, "verify_tonality_db")) {
+			int int_value;
+			if (json_get_integer(ps, &int_value))
+				s_parsed_settings.verify_tonality_db = clip_to_int_range(int_value, 3, 40);
+		}
+		else if (json_key_is(ps, "classify_enabled")) {
+			bool bool_value;
+			if (json_get_bool(ps, &bool_value))
+				s_parsed_settings.classify_enabled = bool_value;
+		}
+		else if (json_key_is(ps, "agc_enabled")) {
+			bool bool_value;
+			if (json_get_bool(ps, &bool_value))
+				s_parsed_settings.agc_enabled = bool_value;
+		}
+		else if (json_key_is(ps, "agc_interval_s")) {
+			int int_value;
+			if (json_get_integer(ps, &int_value))
+				s_parsed_settings.agc_interval_s = clip_to_int_range(int_value, 1, 3600);
+		}
+		else if (json_key_is(ps, "trigger_channel")) {
+			json_get_string(ps, g_128bytes_char_buffer, LEN_128BYTES_BUFFER);
+			if (stricmp(g_128bytes_char_buffer, "first") == 0)
+				s_parsed_settings.trigger_channel = TRIGGER_CHANNEL_FIRST;
+			else if (stricmp(g_128bytes_char_buffer, "second") == 0)
+				s_parsed_settings.trigger_channel = TRIGGER_CHANNEL_SECOND;
+			else if (stricmp(g_128bytes_char_buffer, "either") == 0)
+				s_parsed_settings.trigger_channel = TRIGGER_CHANNEL_EITHER;
+		}
+		else if (json_key_is(ps, "split_search_time_s")) {
+			float float_value;
+			if (json_get_float(ps, &float_value))
+				s_parsed_settings.split_search_time_s = clip_to_float_range(float_value, 0.0, 10.0);
+		}
+		else if (json_key_is(ps, "hangover_time_s")) {
+			float float_value;
+			if (json_get_float(ps, &float_value))
+				s_parsed_settings.hangover_time_s = clip_to_float_range(float_value, 0.1, 120);
+		}
+		else if (json_key_is(ps, "storm_files_per_hour")) {
+			int int_value;
+			if (json_get_integer(ps, &int_value))
+				s_parsed_settings.storm_files_per_hour = clip_to_int_range(int_value, 0, 3600);
+		}
+		else {
+			// Intentionally ignore unknown keys to allow for compatibility when we add new keys.
+			json_stream_skip_value(ps);
 		}
 	}
 
-	process_trigger_flags(&s_settings);
-	process_trigger_thresholds(&s_settings);
+	if (event != JSON_STREAM_OBJECT_END || json_stream_next(ps) != JSON_STREAM_END)
+		return false;
+
+	process_trigger_flags(&s_parsed_settings);
+	process_trigger_thresholds(&s_parsed_settings);
+	s_settings = s_parsed_settings;
+	memcpy(s_profiles, s_parsed_profiles, sizeof(s_profiles));
+	s_profile_count = s_parsed_profile_count;
+	build_profile_settings();
 
 	return true;
 }
 
+/**
+ * Parse settings JSON supplied through a read function, so that the file can be of any size.
+ */
+bool settings_parse_and_process_json_stream(json_stream_read_t read, void *context)
+{
+	json_stream_init(&s_json_stream, read, context);
+	return parse_settings(&s_json_stream);
+}
+
+bool settings_parse_and_process_json_settings(const char *json)
+{
+	json_stream_init_string(&s_json_stream, json);
+	return parse_settings(&s_json_stream);
+}
+
 static void process_trigger_flags(settings_t *ps)
 {
 	// Split the string based on whitespace (space, tab, newline). Note that the original
@@ -399,6 +741,10 @@ static void process_trigger_thresholds(settings_t *ps)
 	}
 }
 
+/**
+ * The settings as JSON, for the record. These are the settings without any profile, plus the
+ * name of the profile in use: its values are in settings.json.
+ */
 size_t settings_get_json_settings_string(char *buf, size_t buflen)
 {
 	snprintf(buf, buflen,
@@ -415,7 +761,32 @@ size_t settings_get_json_settings_string(char *buf, size_t buflen)
 			"  \"trigger_thresholds\":\"%s\",\n"		\
 			"  \"disable_usb_msc\":%s,\n"				\
 			"  \"logger_sampling_rate_index\":%d,\n"	\
-			"  \"gated_recording\":%s\n"				\
+			"  \"gated_recording\":%s,\n"				\
+			"  \"write_profile_to_sd\":%s,\n"			\
+			"  \"listen_window_s\":%d,\n"				\
+			"  \"listen_period_s\":%d,\n"				\
+			"  \"listen_adaptive\":%s,\n"				\
+			"  \"recording_format\":\"%s\",\n"			\
+			"  \"zc_division_ratio\":%d,\n"			\
+			"  \"zc_hysteresis\":%d,\n"				\
+			"  \"zc_band_low_khz\":%d,\n"				\
+			"  \"zc_band_high_khz\":%d,\n"			\
+			"  \"baseband_low_khz\":%d,\n"			\
+			"  \"baseband_high_khz\":%d,\n"			\
+			"  \"ltsa_enabled\":%s,\n"				\
+			"  \"thumbnails\":%s,\n"					\
+			"  \"verify_enabled\":%s,\n"				\
+			"  \"verify_min_calls\":%d,\n"			\
+			"  \"verify_tonality_db\":%d,\n"			\
+			"  \"classify_enabled\":%s,\n"			\
+			"  \"agc_enabled\":%s,\n"				\
+			"  \"agc_interval_s\":%d,\n"			\
+			"  \"trigger_channel\":\"%s\",\n"			\
+			"  \"split_search_time_s\":%.1f,\n"		\
+			"  \"hangover_time_s\":%.1f,\n"			\
+			"  \"storm_files_per_hour\":%d,\n"		\
+			"  \"trigger_pipeline\":\"%s\",\n"		\
+			"  \"profile\":\"%s\"\n"					\
 			"}\n",
 			s_settings._firmware_version,
 			s_settings.max_sampling_time_s,
@@ -429,13 +800,41 @@ size_t settings_get_json_settings_string(char *buf, size_t buflen)
 			s_settings.trigger_thresholds_string,
 			s_settings.disable_usb_msc ? "true" : "false",
 			s_settings.logger_sampling_rate_index,
-			s_settings.gated_recording ? "true" : "false"
+			s_settings.gated_recording ? "true" : "false",
+			s_settings.write_profile_to_sd ? "true" : "false",
+			s_settings.listen_window_s,
+			s_settings.listen_period_s,
+			s_settings.listen_adaptive ? "true" : "false",
+			s_settings.recording_format == RECORDING_FORMAT_ZC ? "zc" :
+					s_settings.recording_format == RECORDING_FORMAT_WAV_ZC ? "wav+zc" :
+					s_settings.recording_format == RECORDING_FORMAT_BASEBAND ? "baseband" : "wav",
+			s_settings.zc_division_ratio,
+			s_settings.zc_hysteresis,
+			s_settings.zc_band_low_khz,
+			s_settings.zc_band_high_khz,
+			s_settings.baseband_low_khz,
+			s_settings.baseband_high_khz,
+			s_settings.ltsa_enabled ? "true" : "false",
+			s_settings.thumbnails ? "true" : "false",
+			s_settings.verify_enabled ? "true" : "false",
+			s_settings.verify_min_calls,
+			s_settings.verify_tonality_db,
+			s_settings.classify_enabled ? "true" : "false",
+			s_settings.agc_enabled ? "true" : "false",
+			s_settings.agc_interval_s,
+			s_settings.trigger_channel == TRIGGER_CHANNEL_SECOND ? "second" :
+					s_settings.trigger_channel == TRIGGER_CHANNEL_EITHER ? "either" : "first",
+			s_settings.split_search_time_s,
+			s_settings.hangover_time_s,
+			s_settings.storm_files_per_hour,
+			s_settings.trigger_pipeline == TRIGGER_PIPELINE_FLOAT ? "float" : "q15",
+			s_active_profile == SETTINGS_NO_PROFILE ? "" : s_profiles[s_active_profile].name
 		);
 
 	return strlen(buf);
 }
 
-static bool get_minutes(char *s, int *m)
+static bool get_minutes(const char *s, int *m)
 {
 	int hours, minutes;
 	int n = sscanf(s, "%d:%d", &hours, &minutes);
@@ -447,12 +846,54 @@ static bool get_minutes(char *s, int *m)
 	return false;
 }
 
+/**
+ * Parse a schedule time, which is either a clock time "HH:MM", or an event optionally with
+ * an offset: "sunset", "sunset+00:30", "dawn-1:15" etc.
+ */
+static bool get_schedule_time(const char *s, schedule_time_t *pt)
+{
+	static const struct {
+		const char *name;
+		schedule_anchor_t anchor;
+	} anchors[] = {
+		{ "sunrise", SCHEDULE_ANCHOR_SUNRISE },
+		{ "sunset", SCHEDULE_ANCHOR_SUNSET },
+		{ "dawn", SCHEDULE_ANCHOR_DAWN },
+		{ "dusk", SCHEDULE_ANCHOR_DUSK }
+	};
+
+	for (size_t i = 0; i < sizeof(anchors) / sizeof(anchors[0]); i++) {
+		const size_t len = strlen(anchors[i].name);
+		if (strncmp(s, anchors[i].name, len) == 0) {
+			const char *pOffset = s + len;
+			int offset = 0;
+			if (*pOffset == '+' || *pOffset == '-') {
+				if (!get_minutes(pOffset + 1, &offset))
+					return false;
+				if (*pOffset == '-')
+					offset = -offset;
+			}
+			else if (*pOffset != '\0') {
+				return false;
+			}
+			pt->anchor = anchors[i].anchor;
+			pt->offset_minutes = offset;
+			return true;
+		}
+	}
+
+	pt->anchor = SCHEDULE_ANCHOR_CLOCK;
+	return get_minutes(s, &pt->offset_minutes);
+}
+
 static int compare_intervals(const void *pv1, const void *pv2)
 {
 	const schedule_interval_t *pi1 = * (schedule_interval_t **) pv1,
 			*pi2 = * (schedule_interval_t **) pv2;
-	if (pi1->start_minutes == pi2->start_minutes)
-		return 0;
+	if (pi1->start_minutes == pi2->start_minutes) {
+		// Keep the order of the schedule file, so that the later entry takes over:
+		return pi1 < pi2 ? -1 : (pi1 > pi2 ? 1 : 0);
+	}
 	else if (pi1->start_minutes < pi2->start_minutes)
 		return -1;
 	else
@@ -468,7 +909,10 @@ static int max_int(int i, int j)
 }
 
 /**
- * Sort the intervals provided by start time and merge any that overlap.
+ * Sort the intervals provided by start time and merge any that overlap and use the same
+ * profile. Overlapping intervals with different profiles are left separate: auto mode uses
+ * the one that started most recently, so an interval within another takes over for its
+ * duration.
  */
 static int calculate_resultant_intervals(schedule_interval_t intervals[], int count,
 		schedule_interval_t resultant_intervals[])
@@ -487,123 +931,221 @@ static int calculate_resultant_intervals(schedule_interval_t intervals[], int co
 		// interval in the list:
 		int start = pI->start_minutes;
 		int duration = pI->duration_minutes;
+		int profile = pI->profile;
 
 		for (int i = 1; i < count; i++) {
 			pI = sorted_intervals[i];
 			// Check for any overlap:
-			if (pI->start_minutes > start + duration) {
+			if (pI->start_minutes > start + duration || pI->profile != profile) {
 				// No overlap with our current merged interval, so copy that latter over.
 				resultant_intervals[resultant_count].start_minutes = start;
 				resultant_intervals[resultant_count].duration_minutes = duration;
+				resultant_intervals[resultant_count].profile = profile;
 				resultant_count++;
 
 				// Start again with the current entry:
 				start = pI->start_minutes;
 				duration = pI->duration_minutes;
+				profile = pI->profile;
 			}
 			else {
 				// This entry starts before the end of the previous one so merge them.
 				// Note that they might fully or partially overlap, hence the max_int:
-				duration = max_int(duration, pI->start_minutes + pI->duration_minutes);
+				duration = max_int(start + duration, pI->start_minutes + pI->duration_minutes) - start;
 			}
 		}
 		resultant_intervals[resultant_count].start_minutes = start;
 		resultant_intervals[resultant_count].duration_minutes = duration;
+		resultant_intervals[resultant_count].profile = profile;
 		resultant_count++;
 	}
 
 	return resultant_count;
 }
 
-#define MAX_SCHEDULE_TOKENS 64
+#define SCHEDULE_TIME_LEN 16
 
 /**
- * Parse the JSON supplied and populate the array of intervals, merging any intervals that overlap.
- * Return the number of intervals, or -1 if it didn't work out.
+ * Parse one {"from": ..., "to": ..., "profile": ...} object from the schedule array, the start of the
+ * object having been consumed.
  */
-int settings_parse_and_normalize_schedule(const char *json, schedule_interval_t resultant_intervals[])
+static bool parse_schedule_entry(json_stream_t *ps, schedule_entry_t *pEntry)
 {
-	jsmn_parser parser;
-	jsmntok_t tokens[MAX_SCHEDULE_TOKENS];
-	schedule_interval_t intervals[MAX_SCHEDULE_INTERVALS];
+	char time_string[SCHEDULE_TIME_LEN];
+	bool from_seen = false, to_seen = false;
+	pEntry->profile[0] = '\0';
 
-	jsmn_init(&parser);
-	int token_count = jsmn_parse(&parser, json, strlen(json), tokens, MAX_SCHEDULE_TOKENS);
-	if (token_count < 0)
-		return -1;
+	json_stream_event_t event;
+	while ((event = json_stream_next(ps)) == JSON_STREAM_KEY) {
+		if (json_key_is(ps, "from")) {
+			if (json_get_string(ps, time_string, sizeof(time_string)) == 0
+					|| !get_schedule_time(time_string, &pEntry->from))
+				return false;
+			from_seen = true;
+		}
+		else if (json_key_is(ps, "to")) {
+			if (json_get_string(ps, time_string, sizeof(time_string)) == 0
+					|| !get_schedule_time(time_string, &pEntry->to))
+				return false;
+			to_seen = true;
+		}
+		else if (json_key_is(ps, "profile")) {
+			// Checked against the profiles in settings.json when the schedule is resolved:
+			if (json_get_string(ps, pEntry->profile, sizeof(pEntry->profile)) == 0
+					|| strlen(ps->value) >= sizeof(pEntry->profile))
+				return false;
+		}
+		else {
+			// Ignore unknown keys, as for settings.
+			if (!json_stream_skip_value(ps))
+				return false;
+		}
+	}
 
-	int i = 0;
-	jsmntok_t token = tokens[i++];
-	if (token.type != JSMN_OBJECT)
-		return -1;
+	return event == JSON_STREAM_OBJECT_END && from_seen && to_seen;
+}
 
-	token = tokens[i++];
-	if (!json_eq_string(json, &token, "schedule"))
+/**
+ * Parse the JSON supplied and populate the array of schedule entries. Times relative to
+ * the sun can't be turned into intervals until we know the date: see settings_resolve_schedule.
+ * Return the number of entries, or -1 if it didn't work out.
+ */
+int settings_parse_schedule(const char *json, schedule_entry_t entries[])
+{
+	json_stream_t *ps = &s_json_stream;
+	json_stream_init_string(ps, json);
+
+	if (json_stream_next(ps) != JSON_STREAM_OBJECT_START)
 		return -1;
 
-	token = tokens[i++];
-	if (token.type != JSMN_ARRAY)
+	int entry_index = 0;
+	json_stream_event_t event;
+	while ((event = json_stream_next(ps)) == JSON_STREAM_KEY) {
+		if (!json_key_is(ps, "schedule")) {
+			if (!json_stream_skip_value(ps))
+				return -1;
+			continue;
+		}
+
+		if (json_stream_next(ps) != JSON_STREAM_ARRAY_START)
+			return -1;
+		while ((event = json_stream_next(ps)) == JSON_STREAM_OBJECT_START) {
+			if (entry_index == MAX_SCHEDULE_INTERVALS)
+				return -1;
+			if (!parse_schedule_entry(ps, &entries[entry_index]))
+				return -1;
+			entry_index++;
+		}
+		if (event != JSON_STREAM_ARRAY_END)
+			return -1;
+	}
+
+	if (event != JSON_STREAM_OBJECT_END || json_stream_next(ps) != JSON_STREAM_END)
 		return -1;
 
-	typedef enum { OBJECT, START, END } expecting_t;
-	expecting_t expecting = OBJECT;
-	char start[8], end[8];
-	int m_start = 0, m_end = 0;		// Total minutes into the day.
-	int interval_index = 0;
-	bool valid_times = false;
-	for (; i < token_count; i++) {
-		token = tokens[i];
-		switch (expecting) {
-			case OBJECT:
-				if (token.type != JSMN_OBJECT)
-					return false;
-				if (interval_index == MAX_SCHEDULE_INTERVALS)
-					return -1;
-				valid_times = true;
-				// Note that we have a hard coded expectation that the start value
-				// precedes the end value - which is not quite JSON, but never mind.
-				expecting = START;
-				break;
-			case START:
-				if (json_eq_string(json, &token, "from")) {
-					token = tokens[++i];
-					if (json_get_string(json, &token, start, sizeof(start)) > 0) {
-						valid_times = valid_times && get_minutes(start, &m_start);
-					}
-				}
-				else {
-					return -1;
-				}
-				expecting = END;
-				break;
-			case END:
-				if (json_eq_string(json, &token, "to")) {
-					token = tokens[++i];
-					if (json_get_string(json, &token, end, sizeof(end)) > 0) {
-						valid_times = valid_times && get_minutes(end, &m_end);
-						intervals[interval_index].start_minutes = m_start;
-						int duration = m_end - m_start;
-						if (duration < 0) {
-							// If the end is before the start, we take that to mean that it
-							// spans midnight. We are not supporting daylight savings time.
-							duration += 24 * 60;
-						}
-						// duration += 1;	// Inclusive of the final minute, so minute 3 to 3 is one minute.
-						intervals[interval_index].duration_minutes = duration;
-						interval_index++;
-					}
-				}
-				else {
-					return -1;
-				}
-				expecting = OBJECT;
-				break;
-		}
-	}
-
-	return calculate_resultant_intervals(intervals, interval_index, resultant_intervals);
+	return entry_index;
+}
+
+bool settings_schedule_uses_solar(const schedule_entry_t entries[], int count)
+{
+	for (int i = 0; i < count; i++) {
+		if (entries[i].from.anchor != SCHEDULE_ANCHOR_CLOCK || entries[i].to.anchor != SCHEDULE_ANCHOR_CLOCK)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Work out minutes into the day for the schedule time provided. Returns false if the
+ * event doesn't happen today (polar regions).
+ */
+static bool resolve_schedule_time(const schedule_time_t *pt, const solar_day_t *pSolar, int *pMinutes)
+{
+	int minutes = pt->offset_minutes;
+	switch (pt->anchor) {
+		case SCHEDULE_ANCHOR_CLOCK:
+			break;
+		case SCHEDULE_ANCHOR_SUNRISE:
+			if (!pSolar->sunrise_sunset_valid)
+				return false;
+			minutes += pSolar->sunrise_minutes;
+			break;
+		case SCHEDULE_ANCHOR_SUNSET:
+			if (!pSolar->sunrise_sunset_valid)
+				return false;
+			minutes += pSolar->sunset_minutes;
+			break;
+		case SCHEDULE_ANCHOR_DAWN:
+			if (!pSolar->dawn_dusk_valid)
+				return false;
+			minutes += pSolar->dawn_minutes;
+			break;
+		case SCHEDULE_ANCHOR_DUSK:
+			if (!pSolar->dawn_dusk_valid)
+				return false;
+			minutes += pSolar->dusk_minutes;
+			break;
+		default:
+			return false;
+	}
+
+	// Solar times and offsets can take us into the previous or next day:
+	minutes %= MINUTES_PER_DAY;
+	if (minutes < 0)
+		minutes += MINUTES_PER_DAY;
+	*pMinutes = minutes;
+	return true;
 }
 
+/**
+ * Turn the schedule entries into intervals for the date given (month and day 1 based),
+ * merging any intervals that overlap. Solar times are worked out from the location setting,
+ * and are in UTC like the RTC. An entry whose event doesn't happen on the date (in polar
+ * regions) is skipped for that date. An entry like sunset to sunrise uses the sunrise of
+ * the same date, which is close enough to the next morning's for our purposes.
+ * Return the number of intervals, or -1 if we need a location and don't have one, or an
+ * entry names a profile that settings.json doesn't define.
+ */
+int settings_resolve_schedule(const schedule_entry_t entries[], int count, int year, int month, int day,
+		schedule_interval_t resultant_intervals[])
+{
+	const solar_day_t *pSolar = NULL;
+	if (settings_schedule_uses_solar(entries, count)) {
+		if (!s_settings._location_present)
+			return -1;
+		pSolar = solar_get_day(year, month, day, s_settings.latitude, s_settings.longitude);
+	}
+
+	schedule_interval_t intervals[MAX_SCHEDULE_INTERVALS];
+	int interval_count = 0;
+	for (int i = 0; i < count; i++) {
+		const int profile = settings_find_profile(entries[i].profile);
+		if (profile == SETTINGS_UNKNOWN_PROFILE)
+			return -1;
+
+		int m_start, m_end;
+		if (resolve_schedule_time(&entries[i].from, pSolar, &m_start)
+				&& resolve_schedule_time(&entries[i].to, pSolar, &m_end)) {
+			intervals[interval_count].start_minutes = m_start;
+			int duration = m_end - m_start;
+			if (duration < 0) {
+				// If the end is before the start, we take that to mean that it
+				// spans midnight. We are not supporting daylight savings time.
+				duration += MINUTES_PER_DAY;
+			}
+			// duration += 1;	// Inclusive of the final minute, so minute 3 to 3 is one minute.
+			intervals[interval_count].duration_minutes = duration;
+			intervals[interval_count].profile = profile;
+			interval_count++;
+		}
+	}
+
+	return calculate_resultant_intervals(intervals, interval_count, resultant_intervals);
+}
+
+/**
+ * The sampling rate of the settings in force, which a profile can change.
+ */
 int settings_get_logger_sampling_rate(void) {
-	return s_settings.logger_sampling_rate_index * SETTINGS_SAMPLING_RATE_MULTIPLIER_KHZ * 1000;
+	return s_pActive->logger_sampling_rate_index * SETTINGS_SAMPLING_RATE_MULTIPLIER_KHZ * 1000;
 }
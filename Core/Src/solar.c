@@ -0,0 +1,185 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "solar.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Sunrise and sunset using the algorithm of NOAA's solar calculator spreadsheet, after
+ * Meeus, which keeps to a minute or so of the sun's true position up to the polar circles
+ * and beyond. The shorter "General Solar Position Calculations" approximations are a few
+ * minutes out at 60 degrees and tens of minutes further north. Single precision float is
+ * fine as long as time is counted from J2000 rather than as a Julian day: the FPU makes
+ * it quick and we only calculate each day once.
+ */
+
+#define PI_F 3.14159265f
+#define DEG_TO_RAD(d) ((d) * (PI_F / 180.0f))
+#define RAD_TO_DEG(r) ((r) * (180.0f / PI_F))
+
+// Zenith angles of the sun's centre for the events we want. 90.833 allows for atmospheric
+// refraction and the size of the solar disk:
+#define ZENITH_SUNRISE_SUNSET 90.833f
+#define ZENITH_CIVIL_TWILIGHT 96.0f
+
+// Refinements of an event's time, each with the sun's position at the last estimate:
+#define MAX_EVENT_PASSES 4
+
+// We're asked for yesterday, today and tomorrow, so a small cache is enough to avoid
+// repeat calculations:
+#define SOLAR_CACHE_SIZE 4
+
+typedef struct {
+	bool valid;
+	int year, month, day;
+	double latitude, longitude;
+	solar_day_t result;
+} solar_cache_entry_t;
+
+static solar_cache_entry_t s_cache[SOLAR_CACHE_SIZE];
+static int s_next_cache_entry = 0;
+
+void solar_init(void)
+{
+	memset(s_cache, 0, sizeof(s_cache));
+	s_next_cache_entry = 0;
+}
+
+/**
+ * Days from J2000.0, noon UTC on 1 January 2000, to noon UTC on the date. The Julian day
+ * itself has too many digits for a float.
+ */
+static int days_since_j2000(int year, int month, int day)
+{
+	const int a = (14 - month) / 12;
+	const int y = year + 4800 - a;
+	const int m = month + 12 * a - 3;
+	const int32_t julian_day_number = day + (153 * m + 2) / 5 + 365 * y + y / 4 - y / 100 + y / 400 - 32045;
+	return julian_day_number - 2451545;
+}
+
+typedef struct {
+	float eqtime;		// Equation of time, minutes.
+	float decl;			// Solar declination, radians.
+} solar_position_t;
+
+static void calculate_position(int j2000_day, float minutes_utc, solar_position_t *pPos)
+{
+	// Julian centuries from J2000.0:
+	const float t = (j2000_day + (minutes_utc - 720.0f) / 1440.0f) / 36525.0f;
+
+	// Geometric mean longitude and mean anomaly of the sun, and the orbit's eccentricity:
+	const float l0 = fmodf(280.46646f + t * (36000.76983f + t * 0.0003032f), 360.0f);
+	const float m = DEG_TO_RAD(fmodf(357.52911f + t * (35999.05029f - t * 0.0001537f), 360.0f));
+	const float e = 0.016708634f - t * (0.000042037f + t * 0.0000001267f);
+
+	// The apparent longitude, from the equation of the centre and nutation:
+	const float c = sinf(m) * (1.914602f - t * (0.004817f + t * 0.000014f))
+			+ sinf(2 * m) * (0.019993f - t * 0.000101f) + sinf(3 * m) * 0.000289f;
+	const float omega = DEG_TO_RAD(125.04f - 1934.136f * t);
+	const float apparent_longitude = DEG_TO_RAD(l0 + c - 0.00569f - 0.00478f * sinf(omega));
+
+	// The obliquity of the ecliptic, corrected for nutation:
+	const float mean_obliquity = 23.0f + (26.0f + (21.448f - t * (46.815f + t * (0.00059f - t * 0.001813f))) / 60.0f) / 60.0f;
+	const float obliquity = DEG_TO_RAD(mean_obliquity + 0.00256f * cosf(omega));
+
+	pPos->decl = asinf(sinf(obliquity) * sinf(apparent_longitude));
+
+	const float y = tanf(obliquity / 2) * tanf(obliquity / 2);
+	const float l0_rad = DEG_TO_RAD(l0);
+	pPos->eqtime = 4.0f * RAD_TO_DEG(y * sinf(2 * l0_rad) - 2 * e * sinf(m) + 4 * e * y * sinf(m) * cosf(2 * l0_rad)
+			- 0.5f * y * y * sinf(4 * l0_rad) - 1.25f * e * e * sinf(2 * m));
+}
+
+/**
+ * Calculate the time of an event when the sun is at the zenith angle given, before noon
+ * (direction -1) or after noon (direction 1). Returns false if that doesn't happen today.
+ */
+static bool calculate_event(int j2000_day, float zenith_deg, float lat_rad, float lon_deg,
+		int direction, int *minutes)
+{
+	// Start with the sun's position at noon, then refine it using the position at the
+	// estimated time of the event, which gains us a few minutes of accuracy. Once is
+	// usually enough, but near the poles the sun moves on far enough to need another:
+	float event_minutes = 720.0f;
+	for (int pass = 0; pass < MAX_EVENT_PASSES; pass++) {
+		const float previous_minutes = event_minutes;
+		solar_position_t pos;
+		calculate_position(j2000_day, event_minutes, &pos);
+
+		const float cos_ha = cosf(DEG_TO_RAD(zenith_deg)) / (cosf(lat_rad) * cosf(pos.decl))
+				- tanf(lat_rad) * tanf(pos.decl);
+		if (cos_ha > 1.0f || cos_ha < -1.0f)
+			return false;		// Polar night or midnight sun.
+
+		const float ha_deg = RAD_TO_DEG(acosf(cos_ha));
+		event_minutes = 720.0f - 4.0f * (lon_deg - direction * ha_deg) - pos.eqtime;
+		if (pass > 0 && fabsf(event_minutes - previous_minutes) < 0.5f)
+			break;
+	}
+
+	*minutes = (int) lroundf(event_minutes);
+	return true;
+}
+
+static void calculate_day(int year, int month, int day, double latitude, double longitude, solar_day_t *pResult)
+{
+	const int j2000_day = days_since_j2000(year, month, day);
+	const float lat_rad = DEG_TO_RAD((float) latitude);
+	const float lon_deg = (float) longitude;		// East is positive.
+
+	memset(pResult, 0, sizeof(*pResult));
+	pResult->sunrise_sunset_valid =
+			calculate_event(j2000_day, ZENITH_SUNRISE_SUNSET, lat_rad, lon_deg, -1, &pResult->sunrise_minutes)
+			&& calculate_event(j2000_day, ZENITH_SUNRISE_SUNSET, lat_rad, lon_deg, 1, &pResult->sunset_minutes);
+	pResult->dawn_dusk_valid =
+			calculate_event(j2000_day, ZENITH_CIVIL_TWILIGHT, lat_rad, lon_deg, -1, &pResult->dawn_minutes)
+			&& calculate_event(j2000_day, ZENITH_CIVIL_TWILIGHT, lat_rad, lon_deg, 1, &pResult->dusk_minutes);
+}
+
+/**
+ * Month and day are 1 based. Latitude is positive north, longitude positive east.
+ */
+const solar_day_t *solar_get_day(int year, int month, int day, double latitude, double longitude)
+{
+	for (int i = 0; i < SOLAR_CACHE_SIZE; i++) {
+		solar_cache_entry_t *pe = &s_cache[i];
+		if (pe->valid && pe->year == year && pe->month == month && pe->day == day
+				&& pe->latitude == latitude && pe->longitude == longitude)
+			return &pe->result;
+	}
+
+	solar_cache_entry_t *pe = &s_cache[s_next_cache_entry];
+	s_next_cache_entry = (s_next_cache_entry + 1) % SOLAR_CACHE_SIZE;
+
+	calculate_day(year, month, day, latitude, longitude, &pe->result);
+	pe->year = year;
+	pe->month = month;
+	pe->day = day;
+	pe->latitude = latitude;
+	pe->longitude = longitude;
+	pe->valid = true;
+
+	return &pe->result;
+}
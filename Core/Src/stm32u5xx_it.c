@@ -50,6 +50,8 @@
 #include "autophasecontrol.h"
 #include "leds.h"
 #include "usb_otg.h"
+#include "events.h"
+#include "profiler.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -75,6 +77,10 @@
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN PFP */
 
+// The audio DMA and SD card interrupts run from SRAM, see RAM_TEXT_SECTION:
+RAM_TEXT_SECTION void GPDMA1_Channel0_IRQHandler(void);
+RAM_TEXT_SECTION void SDMMC1_IRQHandler(void);
+
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -247,6 +253,8 @@ void RTC_IRQHandler(void)
   /* USER CODE END RTC_IRQn 0 */
   HAL_RTC_AlarmIRQHandler(&hrtc);
   /* USER CODE BEGIN RTC_IRQn 1 */
+  HAL_RTCEx_WakeUpTimerIRQHandler(&hrtc);		// Used by lowpower_stop.
+  events_post(EVENT_RTC);
 
   /* USER CODE END RTC_IRQn 1 */
 }
@@ -309,12 +317,13 @@ void OTG_HS_IRQHandler(void)
 		// USB->ISTR &= ~USB_ISTR_SOF;
 
 		// Auto phase control:
-		apc_on_SoF();
+		PROFILE(PROFILE_APC_SOF, apc_on_SoF());
 
 		// HAL_GPIO_WritePin(GPIO_LED_R_GPIO_Port, GPIO_LED_R_Pin, GPIO_PIN_SET);
 	}
 
 	tud_int_handler(0);
+	events_post(EVENT_USB);
 
 	return;   // Intentionally skip the code below.
 
@@ -331,14 +340,25 @@ void OTG_HS_IRQHandler(void)
 void SDMMC1_IRQHandler(void)
 {
   /* USER CODE BEGIN SDMMC1_IRQn 0 */
+  PROFILE_START();
 
   /* USER CODE END SDMMC1_IRQn 0 */
   HAL_SD_IRQHandler(&hsd1);
   /* USER CODE BEGIN SDMMC1_IRQn 1 */
+  events_post(EVENT_SD);
+  PROFILE_END(PROFILE_SDMMC_ISR);
 
   /* USER CODE END SDMMC1_IRQn 1 */
 }
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles EXTI Line13 interrupt: the mode switch while we are in STOP.
+  */
+void EXTI13_IRQHandler(void)
+{
+  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_13);
+}
+
 /* USER CODE END 1 */
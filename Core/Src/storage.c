@@ -36,6 +36,10 @@
 #include "settings.h"
 #include "gain.h"
 #include "sd_lowlevel.h"
+#include "profiler.h"
+#include "zc.h"
+#include "classify.h"
+#include "agc.h"
 
 typedef int16_t wav_data_type_t;
 
@@ -46,7 +50,7 @@ static int wav_offset_to_cksize2 = 0;
 static int wav_offset_to_guano = 0;
 
 static int s_bytes_per_sample = sizeof(wav_data_type_t);
-static uint16_t s_num_channels = 1;    // Type matches what we need for the wav file.
+static uint16_t s_num_channels = ACQUISITION_CHANNELS;    // Type matches what we need for the wav file.
 
 // Support for logic for debouncing SD card presence detection:
 static bool s_debounced_sd_present = false;
@@ -54,8 +58,10 @@ static int s_sd_present_count = 0;
 #define DEBOUNCE_COUNT 20
 
 #define TEMP_FILE_NAME ".temp.wav"
+#define TEMP_ZC_FILE_NAME ".temp.zc"
 
 #define TRIGGER_LEN 32
+#define MAX_GUANO_GAIN_CHANGES 4
 
 typedef struct {
 	int sampling_rate;
@@ -64,6 +70,15 @@ typedef struct {
 	RTC_DateTypeDef date;
 	double latitude, longitude;
 	bool location_present;
+	int gain_range;						// At the first sample.
+	bool gain_changes_present;			// Whether to leave room for gain changes.
+	int gain_change_count;
+	int32_t gain_change_offsets[MAX_GUANO_GAIN_CHANGES];	// In samples from the start of the data.
+	int gain_change_ranges[MAX_GUANO_GAIN_CHANGES];
+	bool auto_id_present;				// Whether to leave room for the classifier's verdict.
+	int baseband_centre_hz;				// 0 unless the file holds baseband I and Q.
+	int baseband_source_rate;			// The sampling rate before decimation.
+	int baseband_delay;					// How far the output lags, in samples at the source rate.
 } guano_data_t;
 
 guano_data_t s_guano_data;
@@ -79,6 +94,13 @@ guano_data_t s_guano_data;
  */
 static char s_filex_working_memory[8192];
 
+/*
+ * The name we gave the last wav file we closed, so that a ZC file recorded alongside it
+ * gets the same name even if the clock has ticked over in between. Empty if there is
+ * no such wav file.
+ */
+static char s_last_wav_base_name[LEN_128BYTES_BUFFER];
+
 /*
  * We use reference counting to track mounts and unmounts from multiple modules.
  */
@@ -96,6 +118,7 @@ void storage_init(void)
 	memset(&s_fx_medium, 0, sizeof(s_fx_medium));
 	s_mount_ref_count = 0;
 	memset(&s_guano_data, 0, sizeof(s_guano_data));
+	s_last_wav_base_name[0] = '\0';
 }
 
 /**
@@ -225,6 +248,18 @@ static void write_wav_header(FX_FILE *pFile, int sampling_rate, const char *trig
 	fx_file_write(pFile, &cksize, sizeof(cksize));
 }
 
+/**
+ * The GUANO lines for the classifier's verdict. They are padded to a fixed length, so that
+ * they can be filled in after the file is written.
+ */
+static void format_auto_id(char *buf, size_t buflen, const char *species, int confidence)
+{
+	snprintf(buf, buflen,
+			"Species Auto ID: %-*s\n"
+			"BatGizmo|Auto ID Confidence: %3d\n",
+			CLASSIFY_LABEL_LEN - 1, species, confidence < 0 ? 0 : confidence > 100 ? 100 : confidence);
+}
+
 static const char *get_guano_string(const guano_data_t *data)
 {
 	/*
@@ -244,7 +279,7 @@ static const char *get_guano_string(const guano_data_t *data)
 			data->date.Year + 2000, data->date.Month, data->date.Date, data->time.Hours, data->time.Minutes, data->time.Seconds,
 			data->sampling_rate,
 			FIRMWARE_VERSION,
-			gain_get_range(),
+			data->gain_range,
 			TRIGGER_LEN, (char*) data->trigger
 	);
 
@@ -254,6 +289,36 @@ static const char *get_guano_string(const guano_data_t *data)
 		strncat(g_2k_char_buffer, g_128bytes_char_buffer, LEN_2K_BUFFER - 1);
 	}
 
+	if (data->gain_changes_present) {
+		// Offset:range pairs, padded to a fixed length:
+		strncat(g_2k_char_buffer, "BatGizmo|Gain Changes:", LEN_2K_BUFFER - 1);
+		for (int i = 0; i < MAX_GUANO_GAIN_CHANGES; i++) {
+			if (i < data->gain_change_count)
+				snprintf(g_128bytes_char_buffer, LEN_128BYTES_BUFFER, " %10ld:%d",
+						(long) data->gain_change_offsets[i], data->gain_change_ranges[i]);
+			else
+				snprintf(g_128bytes_char_buffer, LEN_128BYTES_BUFFER, " %12s", "");
+			strncat(g_2k_char_buffer, g_128bytes_char_buffer, LEN_2K_BUFFER - 1);
+		}
+		strncat(g_2k_char_buffer, "\n", LEN_2K_BUFFER - 1);
+	}
+
+	if (data->auto_id_present) {
+		// Blank until the recording is classified, see storage_set_wav_auto_id:
+		format_auto_id(g_128bytes_char_buffer, LEN_128BYTES_BUFFER, "", 0);
+		strncat(g_2k_char_buffer, g_128bytes_char_buffer, LEN_2K_BUFFER - 1);
+	}
+
+	if (data->baseband_centre_hz) {
+		// Everything baseband_tool needs to put the band back where it was:
+		snprintf(g_128bytes_char_buffer, LEN_128BYTES_BUFFER,
+				"BatGizmo|Baseband Centre Hz: %06d\n"
+				"BatGizmo|Baseband Samplerate: %06d\n"
+				"BatGizmo|Baseband Delay: %04d\n",
+				data->baseband_centre_hz, data->baseband_source_rate, data->baseband_delay);
+		strncat(g_2k_char_buffer, g_128bytes_char_buffer, LEN_2K_BUFFER - 1);
+	}
+
 	return g_2k_char_buffer;
 }
 
@@ -287,9 +352,8 @@ static void patch_wav_header(FX_FILE *pFile, int sample_count)
  */
 FX_MEDIA *storage_mount(storage_write_type_t write_type)
 {
-	memset(&s_fx_medium, 0, sizeof(s_fx_medium));
-
 	if (s_mount_ref_count == 0) {
+		memset(&s_fx_medium, 0, sizeof(s_fx_medium));
 		if (sd_lowlevel_open(write_type)) {
 			MX_FileX_Init();
 			if (hsd1.ErrorCode == HAL_SD_ERROR_NONE) {
@@ -335,7 +399,15 @@ void storage_flush(FX_MEDIA *pMedium)
 	fx_media_flush(pMedium);
 }
 
-static void get_base_name(char *buf, size_t buflen) {
+/**
+ * The medium if some module has the SD card mounted, otherwise NULL.
+ */
+FX_MEDIA *storage_get_medium(void)
+{
+	return s_mount_ref_count > 0 ? &s_fx_medium : NULL;
+}
+
+void storage_get_base_name(char *buf, size_t buflen) {
 
 	snprintf(buf, buflen, "data");		// Fallback if we fail to read date/time from RTC.
 
@@ -371,12 +443,42 @@ static void note_guano_data(int sampling_rate, const char *trigger)
 	s_guano_data.location_present = pSettings->_location_present;
 	s_guano_data.latitude = pSettings->latitude;
 	s_guano_data.longitude = pSettings->longitude;
+	s_guano_data.auto_id_present = pSettings->classify_enabled;
+	s_guano_data.gain_range = gain_get_range();
+	s_guano_data.gain_changes_present = pSettings->agc_enabled;
 }
 
-FX_FILE *storage_open_wav_file(FX_MEDIA *pMedium, FX_FILE *pFile, int sampling_rate, const char *trigger)
+/**
+ * Record the gain at the start of the current recording, and any changes during it, from
+ * the AGC's history, to go in its GUANO data when it is closed. start is the position of
+ * the recording's first sample in the AGC's terms, and sample_count its length.
+ */
+void storage_set_gain_changes(int64_t start, int sample_count)
 {
+	agc_change_t changes[MAX_GUANO_GAIN_CHANGES];
+	const int count = agc_get_gain_changes(start, start + sample_count, &s_guano_data.gain_range,
+			changes, MAX_GUANO_GAIN_CHANGES);
+
+	// Positions count samples, but offsets in the file are in frames, at the file's own
+	// sampling rate:
+	const int source_rate = s_guano_data.baseband_centre_hz ? s_guano_data.baseband_source_rate : s_guano_data.sampling_rate;
+	s_guano_data.gain_change_count = count;
+	for (int i = 0; i < count; i++) {
+		s_guano_data.gain_change_offsets[i] = (int32_t) ((changes[i].position - start) / ACQUISITION_CHANNELS
+				* s_guano_data.sampling_rate / source_rate);
+		s_guano_data.gain_change_ranges[i] = changes[i].range;
+	}
+}
 
+/**
+ * Open a wav file with s_num_channels channels. centre_hz is 0 for ordinary recordings, and
+ * the other baseband values are then ignored.
+ */
+static FX_FILE *open_wav_file(FX_MEDIA *pMedium, FX_FILE *pFile, int sampling_rate, const char *trigger,
+		int centre_hz, int source_rate, int delay)
+{
 	memset(pFile, 0, sizeof(*pFile));
+	s_last_wav_base_name[0] = '\0';
 
 	storage_set_filex_time();		// So the file timestamp is right for the file we create.
 
@@ -399,12 +501,34 @@ FX_FILE *storage_open_wav_file(FX_MEDIA *pMedium, FX_FILE *pFile, int sampling_r
 		end of data recording.
 	*/
 	note_guano_data(sampling_rate, trigger);
+	s_guano_data.baseband_centre_hz = centre_hz;
+	s_guano_data.baseband_source_rate = source_rate;
+	s_guano_data.baseband_delay = delay;
+	if (centre_hz)
+		s_guano_data.auto_id_present = false;		// Only ordinary recordings are classified.
 
 	write_wav_header(pFile, sampling_rate, trigger);
 
 	return pFile;
 }
 
+FX_FILE *storage_open_wav_file(FX_MEDIA *pMedium, FX_FILE *pFile, int sampling_rate, const char *trigger)
+{
+	s_num_channels = ACQUISITION_CHANNELS;
+	return open_wav_file(pMedium, pFile, sampling_rate, trigger, 0, 0, 0);
+}
+
+/**
+ * Open a wav file for baseband I and Q, as the left and right channels, with GUANO data that
+ * says where the band came from. It's closed like any other wav file.
+ */
+FX_FILE *storage_open_baseband_file(FX_MEDIA *pMedium, FX_FILE *pFile, int sampling_rate,
+		int centre_hz, int source_rate, int delay, const char *trigger)
+{
+	s_num_channels = 2;
+	return open_wav_file(pMedium, pFile, sampling_rate, trigger, centre_hz, source_rate, delay);
+}
+
 #if 0
 static int s_append_data_count = 0;
 #endif
@@ -435,8 +559,11 @@ void storage_set_trigger_string(const char *trigger)
 
 void storage_close_wav_file(FX_MEDIA *pMedium, FX_FILE *pFile)
 {
+	// The temporary file may have been used before for a longer recording that was discarded:
+	const ULONG64 file_length = pFile->fx_file_current_file_offset;
+
 	// Now we know how much data there is, we can patch that back into the WAV header:
-	patch_wav_header(pFile, s_wav_total_data_count);
+	patch_wav_header(pFile, s_wav_total_data_count / s_num_channels);
 
 	/*
 	 *  Update the guano data now that we have the data. This works because we take care
@@ -446,10 +573,12 @@ void storage_close_wav_file(FX_MEDIA *pMedium, FX_FILE *pFile)
 		write_guano_data(pFile, &s_guano_data);
 	}
 
+	fx_file_truncate_release(pFile, file_length);
 	fx_file_close(pFile);
 
 	// Rename the file we just closed to the correct name based on time:
-	get_base_name(g_128bytes_char_buffer, LEN_128BYTES_BUFFER);
+	storage_get_base_name(g_128bytes_char_buffer, LEN_128BYTES_BUFFER);
+	strcpy(s_last_wav_base_name, g_128bytes_char_buffer);
 
 	const char *pExt = ".wav";
 	snprintf(g_2k_char_buffer, LEN_2K_BUFFER, "%s%s", g_128bytes_char_buffer, pExt);
@@ -472,35 +601,317 @@ void storage_clean_up_wav_file(FX_MEDIA *pMedium, FX_FILE *pFile) {
 	fx_media_flush(pMedium);
 }
 
-void storage_write_settings(FX_MEDIA *pMedium)
+/**
+ * Find the chunk with this id in a wav file we wrote, and leave the file at its contents.
+ * Only our own files get here, and they have only a few chunks.
+ */
+static bool find_wav_chunk(FX_FILE *pFile, const char *id, ULONG *pOffset, uint32_t *pLen)
+{
+	uint8_t header[12];
+	ULONG actual = 0;
+	if (fx_file_seek(pFile, 0) != FX_SUCCESS
+			|| fx_file_read(pFile, header, sizeof(header), &actual) != FX_SUCCESS || actual != sizeof(header)
+			|| memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0)
+		return false;
+
+	ULONG offset = sizeof(header);
+	for (int i = 0; i < 8; i++) {
+		uint8_t chunk[8];
+		if (fx_file_read(pFile, chunk, sizeof(chunk), &actual) != FX_SUCCESS || actual != sizeof(chunk))
+			return false;
+		const uint32_t len = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((uint32_t) chunk[7] << 24);
+		offset += sizeof(chunk);
+		if (memcmp(chunk, id, 4) == 0) {
+			*pOffset = offset;
+			*pLen = len;
+			return true;
+		}
+
+		// Chunks are padded to an even length:
+		offset += len + (len & 1);
+		if (fx_file_seek(pFile, offset) != FX_SUCCESS)
+			return false;
+	}
+
+	return false;
+}
+
+/**
+ * Where the samples are in an ordinary recording we wrote, with ACQUISITION_CHANNELS
+ * channels: the offset of the first, and how many frames there are. Also the sampling rate.
+ * The file is left at the first sample.
+ */
+bool storage_find_wav_data(FX_FILE *pFile, int *pSamplingRate, ULONG *pDataOffset, ULONG *pFrames)
+{
+	ULONG offset = 0;
+	uint32_t len = 0;
+	uint8_t format[16];
+	ULONG actual = 0;
+	if (!find_wav_chunk(pFile, "fmt ", &offset, &len) || len < sizeof(format)
+			|| fx_file_read(pFile, format, sizeof(format), &actual) != FX_SUCCESS || actual != sizeof(format))
+		return false;
+
+	const int channels = format[2] | (format[3] << 8);
+	if (channels != ACQUISITION_CHANNELS)
+		return false;
+	*pSamplingRate = format[4] | (format[5] << 8) | (format[6] << 16) | (format[7] << 24);
+
+	if (!find_wav_chunk(pFile, "data", &offset, &len))
+		return false;
+	*pDataOffset = offset;
+	*pFrames = len / (sizeof(wav_data_type_t) * ACQUISITION_CHANNELS);
+	return true;
+}
+
+/**
+ * Fill in the classifier's verdict in the GUANO data of a wav file closed earlier, named
+ * base_name less its extension.
+ */
+void storage_set_wav_auto_id(FX_MEDIA *pMedium, const char *base_name, const char *species, int confidence)
+{
+	static FX_FILE file;
+	snprintf(g_128bytes_char_buffer, LEN_128BYTES_BUFFER, "%s.wav", base_name);
+	if (fx_file_open(pMedium, &file, g_128bytes_char_buffer, FX_OPEN_FOR_WRITE) != FX_SUCCESS)
+		return;
+
+	ULONG offset = 0;
+	uint32_t len = 0;
+	ULONG actual = 0;
+	if (find_wav_chunk(&file, "guan", &offset, &len) && len < LEN_2K_BUFFER
+			&& fx_file_read(&file, g_2k_char_buffer, len, &actual) == FX_SUCCESS && actual == len) {
+		g_2k_char_buffer[len] = '\0';
+		const char *pAutoId = strstr(g_2k_char_buffer, "Species Auto ID: ");
+		if (pAutoId) {
+			format_auto_id(g_128bytes_char_buffer, LEN_128BYTES_BUFFER, species, confidence);
+			if (fx_file_seek(&file, offset + (pAutoId - g_2k_char_buffer)) == FX_SUCCESS)
+				fx_file_write(&file, g_128bytes_char_buffer, strlen(g_128bytes_char_buffer));
+		}
+	}
+
+	fx_file_close(&file);
+	fx_media_flush(pMedium);
+}
+
+/**
+ * Throw away a recording closed earlier, named base_name less its extension, and its zero
+ * crossing file if it has one. Where we can, the files become the temporary files, so that
+ * the next recording writes over their clusters, which is cheaper than deleting them.
+ */
+void storage_discard_closed_files(FX_MEDIA *pMedium, const char *base_name)
+{
+	snprintf(g_128bytes_char_buffer, LEN_128BYTES_BUFFER, "%s.wav", base_name);
+	if (fx_file_rename(pMedium, g_128bytes_char_buffer, TEMP_FILE_NAME) != FX_SUCCESS)
+		fx_file_delete(pMedium, g_128bytes_char_buffer);
+
+	snprintf(g_128bytes_char_buffer, LEN_128BYTES_BUFFER, "%s.zc", base_name);
+	if (fx_file_rename(pMedium, g_128bytes_char_buffer, TEMP_ZC_FILE_NAME) != FX_SUCCESS)
+		fx_file_delete(pMedium, g_128bytes_char_buffer);
+
+	fx_media_flush(pMedium);
+}
+
+/*
+ * Anabat zero crossing files, file type 132, as documented by Chris Corben. There is
+ * a fixed 0x150 byte header, then the data from zc.c. Text fields are space padded.
+ */
+#define ANABAT_HEADER_LEN 0x150
+#define ANABAT_FILE_TYPE 132
+#define ANABAT_DATA_INFO_OFFSET 0x11a
+
+static void put_u16(uint8_t *p, uint16_t value)
+{
+	p[0] = value & 0xFF;
+	p[1] = value >> 8;
+}
+
+static void put_text(uint8_t *p, int len, const char *text)
+{
+	memset(p, ' ', len);
+	memcpy(p, text, strnlen(text, len));
+}
+
+static void write_anabat_header(FX_FILE *pFile, int division_ratio)
+{
+	uint8_t header[ANABAT_HEADER_LEN];
+	memset(header, 0, sizeof(header));
+
+	RTC_TimeTypeDef t;
+	RTC_DateTypeDef d;
+	memset(&t, 0, sizeof(t));
+	memset(&d, 0, sizeof(d));
+	HAL_RTC_GetTime(&hrtc, &t, RTC_FORMAT_BIN);
+	// We *have* to call GetDate, otherwise the time is stuck. Duh.
+	HAL_RTC_GetDate(&hrtc, &d, RTC_FORMAT_BIN);
+
+	put_u16(header, ANABAT_DATA_INFO_OFFSET);
+	header[3] = ANABAT_FILE_TYPE;
+
+	// Kept to the digits each field can have, so the date always fits its 8 characters:
+	char date[9];
+	snprintf(date, sizeof(date), "%04d%02d%02d", (d.Year + 2000) % 10000, d.Month % 100, d.Date % 100);
+	put_text(header + 0x06, 8, "batgizmo");		// Tape.
+	put_text(header + 0x0e, 8, date);
+	put_text(header + 0x16, 40, "");			// Location.
+	put_text(header + 0x3e, 50, "");			// Species.
+	put_text(header + 0x70, 16, "");			// Spec.
+	put_text(header + 0x80, 73, "");			// Notes.
+	put_text(header + 0xc9, 80, "");
+
+	// Data information table:
+	put_u16(header + ANABAT_DATA_INFO_OFFSET, ANABAT_HEADER_LEN);	// Offset of the data.
+	put_u16(header + 0x11c, ZC_ANABAT_RES1);
+	header[0x11e] = division_ratio;
+	header[0x11f] = 0;							// vres: no amplitude data.
+
+	// Type 132 additions, the time of the start of the file and blank ID and GPS fields:
+	put_u16(header + 0x120, d.Year + 2000);
+	header[0x122] = d.Month;
+	header[0x123] = d.Date;
+	header[0x124] = t.Hours;
+	header[0x125] = t.Minutes;
+	header[0x126] = t.Seconds;
+	put_text(header + 0x12a, 6, "");
+	put_text(header + 0x130, 32, "");
+
+	fx_file_write(pFile, header, sizeof(header));
+}
+
+/**
+ * Open a new zero crossing file. Like wav files, it's written under a temporary name and
+ * then renamed when closed.
+ */
+FX_FILE *storage_open_zc_file(FX_MEDIA *pMedium, FX_FILE *pFile, int division_ratio)
+{
+	memset(pFile, 0, sizeof(*pFile));
+
+	storage_set_filex_time();		// So the file timestamp is right for the file we create.
+
+	UINT status = fx_file_create(pMedium, TEMP_ZC_FILE_NAME);
+	if (status != FX_SUCCESS && status != FX_ALREADY_CREATED)
+		return NULL;
+
+	if (fx_file_open(pMedium, pFile, TEMP_ZC_FILE_NAME, FX_OPEN_FOR_WRITE) != FX_SUCCESS)
+		return NULL;
+
+	// Truncate the file if it already exists:
+	if (fx_file_seek(pFile, 0) != FX_SUCCESS || fx_file_truncate(pFile, 0) != FX_SUCCESS)
+		return NULL;
+
+	write_anabat_header(pFile, division_ratio);
+
+	return pFile;
+}
+
+void storage_zc_file_append_data(FX_FILE *pFile, const uint8_t *pData, int len)
+{
+	fx_file_write(pFile, (void *) pData, len);
+}
+
+/**
+ * Close the zero crossing file, naming it to match the wav file we closed just before
+ * if there was one, otherwise after the current time.
+ */
+void storage_close_zc_file(FX_MEDIA *pMedium, FX_FILE *pFile)
+{
+	fx_file_close(pFile);
+
+	if (s_last_wav_base_name[0] != '\0')
+		strcpy(g_128bytes_char_buffer, s_last_wav_base_name);
+	else
+		storage_get_base_name(g_128bytes_char_buffer, LEN_128BYTES_BUFFER);
+	s_last_wav_base_name[0] = '\0';
+	snprintf(g_2k_char_buffer, LEN_2K_BUFFER, "%s.zc", g_128bytes_char_buffer);
+
+	// Ignoring failure - what can we do?
+	UINT status = fx_file_rename(pMedium, TEMP_ZC_FILE_NAME, g_2k_char_buffer);
+	(void) status;
+
+	fx_media_flush(pMedium);
+}
+
+/**
+ * The name, less extension, of the wav file we last closed, or an empty string if we have
+ * opened another since.
+ */
+const char *storage_get_last_wav_base_name(void)
+{
+	return s_last_wav_base_name;
+}
+
+void storage_clean_up_zc_file(FX_MEDIA *pMedium, FX_FILE *pFile) {
+	fx_file_close(pFile);
+	fx_file_delete(pMedium, TEMP_ZC_FILE_NAME);
+	fx_media_flush(pMedium);
+}
+
+/**
+ * Append data to a file, creating it if need be, in which case the header is written first.
+ * For small periodic writes such as logs: the file is only open for the duration of the call.
+ */
+bool storage_append_file(FX_MEDIA *pMedium, const char *pName, const void *pHeader, int header_len,
+		const void *pData, int len)
+{
+	static FX_FILE file;
+
+	storage_set_filex_time();
+
+	UINT status = fx_file_create(pMedium, (CHAR *) pName);
+	if (status != FX_SUCCESS && status != FX_ALREADY_CREATED)
+		return false;
+	const bool created = status == FX_SUCCESS;
+
+	if (fx_file_open(pMedium, &file, (CHAR *) pName, FX_OPEN_FOR_WRITE) != FX_SUCCESS)
+		return false;
+
+	bool ok = fx_file_relative_seek(&file, 0, FX_SEEK_END) == FX_SUCCESS;
+	if (ok && created && pHeader)
+		ok = fx_file_write(&file, (VOID *) pHeader, header_len) == FX_SUCCESS;
+	if (ok)
+		ok = fx_file_write(&file, (VOID *) pData, len) == FX_SUCCESS;
+
+	fx_file_close(&file);
+	fx_media_flush(pMedium);
+
+	return ok;
+}
+
+/**
+ * Create and open for writing a new file named after the current date and time, with the
+ * suffix and extension supplied. Uses both shared buffers.
+ */
+static bool open_new_dated_file(FX_MEDIA *pMedium, FX_FILE *pFile, const char *pSuffix, const char *pExt)
 {
 	storage_set_filex_time();		// So the file timestamp is right for the file we create.
 
-	get_base_name(g_128bytes_char_buffer, LEN_128BYTES_BUFFER);
+	storage_get_base_name(g_128bytes_char_buffer, LEN_128BYTES_BUFFER);
 
-	const char *pExt = ".json";
 	UINT status = FX_SUCCESS;
-	snprintf(g_2k_char_buffer, LEN_2K_BUFFER, "%s-settings%s", g_128bytes_char_buffer, pExt);
+	snprintf(g_2k_char_buffer, LEN_2K_BUFFER, "%s-%s%s", g_128bytes_char_buffer, pSuffix, pExt);
 	for (int i = 0; i < 100; i++) {
-		status = fx_file_create(&s_fx_medium, g_2k_char_buffer);
+		status = fx_file_create(pMedium, g_2k_char_buffer);
 		if (FX_SUCCESS != status && FX_ALREADY_CREATED != status)
-			return;
+			return false;
 
 		if (status == FX_SUCCESS) {
 			break;
 		}
 		else if (status == FX_ALREADY_CREATED) {
 			// Already exists: try adding a suffix:
-			snprintf(g_2k_char_buffer, LEN_2K_BUFFER, "%s-%d%s", g_128bytes_char_buffer, i + 1, pExt);
+			snprintf(g_2k_char_buffer, LEN_2K_BUFFER, "%s-%s-%d%s", g_128bytes_char_buffer, pSuffix, i + 1, pExt);
 		}
 	}
 
 	// If we get here, we either created the file successfully or ran out of suffixes to try:
 	if (status != FX_SUCCESS)
-		return;
+		return false;
 
+	return fx_file_open(pMedium, pFile, g_2k_char_buffer, FX_OPEN_FOR_WRITE) == FX_SUCCESS;
+}
+
+void storage_write_settings(FX_MEDIA *pMedium)
+{
 	FX_FILE file;
-	if (fx_file_open(pMedium, &file, g_2k_char_buffer, FX_OPEN_FOR_WRITE) == FX_SUCCESS) {
+	if (open_new_dated_file(pMedium, &file, "settings", ".json")) {
 		// This overwrites the filename in the buffer:
 		size_t json_len = settings_get_json_settings_string(g_2k_char_buffer, LEN_2K_BUFFER);
 		fx_file_write(&file, g_2k_char_buffer, json_len);
@@ -508,6 +919,24 @@ void storage_write_settings(FX_MEDIA *pMedium)
 	}
 }
 
+/**
+ * Write out the profiling results collected since the profiler was last reset.
+ */
+void storage_write_profile(FX_MEDIA *pMedium)
+{
+	FX_FILE file;
+	if (open_new_dated_file(pMedium, &file, "profile", ".txt")) {
+		size_t len = profiler_get_report_header(g_2k_char_buffer, LEN_2K_BUFFER);
+		fx_file_write(&file, g_2k_char_buffer, len);
+		for (int id = 0; id < PROFILE_LEN; id++) {
+			len = profiler_get_report_line((profile_id_t) id, g_2k_char_buffer, LEN_2K_BUFFER);
+			if (len > 0)
+				fx_file_write(&file, g_2k_char_buffer, len);
+		}
+		fx_file_close(&file);
+	}
+}
+
 bool storage_capacity(uint32_t* block_count, uint16_t* block_size)
 {
   if (s_mount_ref_count > 0)
@@ -0,0 +1,240 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "storm.h"
+#include "main.h"
+#include "settings.h"
+#include "runtime_config.h"
+#include "storage.h"
+#include "rtc.h"
+
+/*
+ * Recordings are counted in minute buckets stamped with the minute of the day they are for,
+ * from the RTC, so that the counts stay right across pauses in listening and the RTC's
+ * stop modes. Buckets more than an hour old are simply stale.
+ *
+ * Levels: 0 is normal; 1 to MAX_THRESHOLD_STEPS raise the thresholds; above that we sample.
+ * We wait a short window between steps, so that each step has had a chance to show whether
+ * it is enough before we take the next.
+ */
+#define WINDOW_MINUTES 60
+#define SHORT_WINDOW_MINUTES 10
+#define MAX_THRESHOLD_STEPS 3				// 6 dB each.
+#define MAX_SAMPLING_STEPS 4				// One trigger in 2, 4, 8, 16.
+#define MAX_LEVEL (MAX_THRESHOLD_STEPS + MAX_SAMPLING_STEPS)
+#define CHECK_INTERVAL_TICKS (10000 / MAIN_LOOP_DELAY_MS)
+#define MAX_PENDING_LINES 8
+#define LINE_LEN 64
+
+typedef struct {
+	int minute;						// Of the day, or -1 for none.
+	int count;
+} storm_bucket_t;
+
+static storm_bucket_t s_buckets[WINDOW_MINUTES];
+static int s_level = 0;
+static bool s_budget_spent = false;
+static int s_last_step_minute = -1;
+static int s_triggers_at_level = 0;		// New triggers seen while sampling, for one in N.
+static int s_next_check_tick = 0;
+
+static char s_pending[MAX_PENDING_LINES][LINE_LEN];
+static int s_pending_count = 0;
+
+static int get_minute_of_day(void)
+{
+	RTC_TimeTypeDef t;
+	RTC_DateTypeDef d;
+	memset(&t, 0, sizeof(t));
+	HAL_RTC_GetTime(&hrtc, &t, RTC_FORMAT_BIN);
+	// We *have* to call GetDate, otherwise the time is stuck. Duh.
+	HAL_RTC_GetDate(&hrtc, &d, RTC_FORMAT_BIN);
+	return t.Hours * 60 + t.Minutes;
+}
+
+static int minutes_since(int now, int then)
+{
+	return (now - then + MINUTES_PER_DAY) % MINUTES_PER_DAY;
+}
+
+static int count_files(int now, int window_minutes)
+{
+	int count = 0;
+	for (int i = 0; i < WINDOW_MINUTES; i++)
+		if (s_buckets[i].minute >= 0 && minutes_since(now, s_buckets[i].minute) < window_minutes)
+			count += s_buckets[i].count;
+	return count;
+}
+
+static void log_decision(int now, int short_count, int hour_count, const char *action)
+{
+	if (s_pending_count >= MAX_PENDING_LINES) {
+		// Lose the oldest rather than the newest:
+		memmove(s_pending, s_pending + 1, sizeof(s_pending[0]) * (MAX_PENDING_LINES - 1));
+		s_pending_count--;
+	}
+	snprintf(s_pending[s_pending_count++], LINE_LEN, "%02d:%02d,%d,%d,%d,%s\n",
+			now / 60, now % 60, s_level, short_count, hour_count, action);
+}
+
+static void write_pending_lines(FX_MEDIA *pMedium)
+{
+	static const char header[] = "time,level,files_10_min,files_hour,action\n";
+	char text[MAX_PENDING_LINES * LINE_LEN];
+	int len = 0;
+	for (int i = 0; i < s_pending_count; i++) {
+		strcpy(text + len, s_pending[i]);
+		len += strlen(s_pending[i]);
+	}
+	if (storage_append_file(pMedium, "storm.csv", header, sizeof(header) - 1, text, len))
+		s_pending_count = 0;
+}
+
+void storm_init(void)
+{
+	for (int i = 0; i < WINDOW_MINUTES; i++)
+		s_buckets[i].minute = -1;
+	s_level = 0;
+	s_budget_spent = false;
+	s_last_step_minute = -1;
+	s_triggers_at_level = 0;
+	s_pending_count = 0;
+}
+
+/**
+ * Call for each recording we write, including any the second pass may discard later.
+ */
+void storm_note_file(void)
+{
+	const int now = get_minute_of_day();
+	storm_bucket_t *pBucket = &s_buckets[now % WINDOW_MINUTES];
+	if (pBucket->minute != now) {
+		pBucket->minute = now;
+		pBucket->count = 0;
+	}
+	pBucket->count++;
+
+	// Check right away, in case this is the one that spends the budget:
+	s_next_check_tick = 0;
+}
+
+/**
+ * Should a new trigger start a recording?
+ */
+bool storm_admit_trigger(void)
+{
+	if (s_budget_spent)
+		return false;
+	if (s_level <= MAX_THRESHOLD_STEPS)
+		return true;
+
+	// Sampling: one in 2^(steps into sampling):
+	const int one_in = 1 << (s_level - MAX_THRESHOLD_STEPS);
+	return (s_triggers_at_level++ % one_in) == 0;
+}
+
+/**
+ * Should a retrigger extend the recording in progress?
+ */
+bool storm_admit_retrigger(void)
+{
+	return !s_budget_spent && s_level <= MAX_THRESHOLD_STEPS;
+}
+
+/**
+ * How many times to double the trigger thresholds, in amplitude. The thresholds are for
+ * power, so they need shifting by twice this.
+ */
+int storm_get_threshold_shift(void)
+{
+	return s_level < MAX_THRESHOLD_STEPS ? s_level : MAX_THRESHOLD_STEPS;
+}
+
+static void set_level(int level, int now, int short_count, int hour_count)
+{
+	s_level = level;
+	s_last_step_minute = now;
+	s_triggers_at_level = 0;
+	runtime_config_update();		// For the trigger thresholds.
+
+	char action[32];
+	if (level == 0)
+		strcpy(action, "normal");
+	else if (level <= MAX_THRESHOLD_STEPS)
+		snprintf(action, sizeof(action), "thresholds +%d dB", level * 6);
+	else
+		snprintf(action, sizeof(action), "thresholds +%d dB, 1 in %d", MAX_THRESHOLD_STEPS * 6,
+				1 << (level - MAX_THRESHOLD_STEPS));
+	log_decision(now, short_count, hour_count, action);
+}
+
+static void check(void)
+{
+	const int budget = settings_get()->storm_files_per_hour;
+	if (budget == 0 && s_level == 0 && !s_budget_spent)
+		return;			// Turned off, and nothing to undo.
+
+	const int now = get_minute_of_day();
+	const int short_count = count_files(now, SHORT_WINDOW_MINUTES);
+	const int hour_count = count_files(now, WINDOW_MINUTES);
+
+	if (budget == 0) {
+		// Turned off since we last looked: back to normal.
+		s_budget_spent = false;
+		set_level(0, now, short_count, hour_count);
+		return;
+	}
+
+	const bool spent = hour_count >= budget;
+	if (spent != s_budget_spent) {
+		s_budget_spent = spent;
+		log_decision(now, short_count, hour_count, spent ? "budget spent" : "budget available");
+	}
+
+	if (s_last_step_minute >= 0 && minutes_since(now, s_last_step_minute) < SHORT_WINDOW_MINUTES)
+		return;
+
+	// Compare the short window with its share of the budget:
+	const int projected = short_count * (WINDOW_MINUTES / SHORT_WINDOW_MINUTES);
+	if (projected > budget && s_level < MAX_LEVEL)
+		set_level(s_level + 1, now, short_count, hour_count);
+	else if (projected <= budget / 2 && hour_count <= budget && s_level > 0)
+		set_level(s_level - 1, now, short_count, hour_count);
+}
+
+void storm_main_processing(int main_tick_count)
+{
+	if (main_tick_count >= s_next_check_tick) {
+		s_next_check_tick = main_tick_count + CHECK_INTERVAL_TICKS;
+		check();
+	}
+
+	// Like the LTSA, write when someone else has the SD card mounted, so it costs us little:
+	if (s_pending_count > 0) {
+		FX_MEDIA *pMedium = storage_get_medium();
+		if (pMedium)
+			write_pending_lines(pMedium);
+	}
+}
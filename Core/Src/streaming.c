@@ -33,12 +33,16 @@
 #include "spi.h"
 #include "settings.h"
 #include "tusb_config.h"
+#include "governor.h"
 
 static void set_clocks(int multiplier, int pll_fracn);
 
 
 void streaming_start(int sampling_rate_index)
 {
+	// The ADC trigger timer needs SYSCLK at full speed - see governor.c:
+	governor_hold(GOVERNOR_HOLD_STREAMING);
+
 	const int sampling_rate = sampling_rate_index * SETTINGS_SAMPLING_RATE_MULTIPLIER_KHZ * 1000;
 	const int samples_per_frame = sampling_rate / USB_FRAMES_PERSECOND;
 
@@ -79,7 +83,7 @@ void streaming_start(int sampling_rate_index)
 	set_clocks(multiplier, fracn);
 
 	// Start the ADC->DMA:
-	HAL_ADC_Start_DMA(&hadc1, (uint32_t *) g_dmabuffer1, samples_per_frame);
+	HAL_ADC_Start_DMA(&hadc1, (uint32_t *) g_dmabuffer1, samples_per_frame * ACQUISITION_CHANNELS);
 
 	// Kick off triggering:
 	HAL_TIM_Base_Start(&htim2);			// Use HAL_TIM_Base_Start_IT if you want interrupts. Not needed in this design.
@@ -109,6 +113,8 @@ void streaming_stop(void)
 	HAL_TIM_Base_DeInit(&htim2);
 	HAL_SPI_DeInit(&hspi1);
 	HAL_ADC_DeInit(&hadc1);
+
+	governor_release(GOVERNOR_HOLD_STREAMING);
 }
 
 static void set_clocks(int multiplier, int pll_fracn) {
@@ -0,0 +1,275 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <arm_math.h>
+
+#include "thumbnail.h"
+#include "cmplx_mag_squared.h"
+#include "data_processor_buffers.h"
+#include "settings.h"
+#include "storage.h"
+#include "buffer.h"
+#include "sd_lowlevel.h"
+
+/*
+ * Each column of the image is the spectrum of one FFT window, taken at evenly spaced points
+ * through the recording. We only work on thumbnails while nothing is being recorded, and
+ * then only a few columns per main loop tick, so that this never gets in the way of
+ * acquisition. Columns are found by seeking, so only a small part of the file is read.
+ */
+#define FFT_SIZE_LOG2 8
+#define FFT_SIZE (1 << FFT_SIZE_LOG2)
+#define FFT_BINS (FFT_SIZE / 2)
+#define BINS_PER_ROW (FFT_BINS / THUMBNAIL_HEIGHT)
+#define COLUMNS_PER_TICK 4
+
+// Pixels are first in half dB steps, then stretched so that this range below the loudest
+// pixel covers black to white:
+#define DYNAMIC_RANGE_DB 60
+
+#define MAX_QUEUED 4				// Recordings waiting for thumbnails. Beyond that we skip some.
+#define BASE_NAME_LEN 32
+
+typedef enum {
+	STATE_IDLE,
+	STATE_COLUMNS,
+	STATE_WRITE
+} thumbnail_state_t;
+
+static char s_queue[MAX_QUEUED][BASE_NAME_LEN];
+static int s_queue_count = 0;
+
+static thumbnail_state_t s_state = STATE_IDLE;
+static FX_MEDIA *s_pMedium = NULL;
+static FX_FILE s_file;
+static ULONG s_data_offset = 0;
+static ULONG s_sample_count = 0;
+static int s_column = 0;
+
+static arm_rfft_instance_q15 s_fft_instance;
+static q15_t s_window_q15[FFT_SIZE];
+static q15_t s_samples[FFT_SIZE];
+static q15_t s_fft_output[FFT_SIZE * 2];
+static q31_t s_power[FFT_BINS];
+static uint8_t s_pixels[THUMBNAIL_HEIGHT][THUMBNAIL_WIDTH];
+
+void thumbnail_init(void)
+{
+	arm_rfft_init_q15(&s_fft_instance, FFT_SIZE, 0, 1);
+
+	// Hann window:
+	for (int i = 0; i < FFT_SIZE; i++) {
+		const float w = 0.5f - 0.5f * cosf(2.0f * (float) M_PI * i / (FFT_SIZE - 1));
+		s_window_q15[i] = (q15_t) (w * 32767.0f);
+	}
+
+	s_queue_count = 0;
+	s_state = STATE_IDLE;
+	s_pMedium = NULL;
+}
+
+/**
+ * Queue a thumbnail for the wav file with this name, less its extension, which has just been closed.
+ */
+void thumbnail_add(const char *base_name)
+{
+	if (!settings_get()->thumbnails || s_queue_count >= MAX_QUEUED)
+		return;
+
+	strncpy(s_queue[s_queue_count], base_name, BASE_NAME_LEN - 1);
+	s_queue[s_queue_count][BASE_NAME_LEN - 1] = '\0';
+	s_queue_count++;
+}
+
+static void pop_queue(void)
+{
+	memmove(s_queue[0], s_queue[1], sizeof(s_queue[0]) * (MAX_QUEUED - 1));
+	s_queue_count--;
+}
+
+/**
+ * Walk the RIFF chunks to find the sample data. Only our own 16 bit files get here, with
+ * ACQUISITION_CHANNELS channels.
+ */
+static bool find_data_chunk(FX_FILE *pFile)
+{
+	uint8_t header[12];
+	ULONG actual = 0;
+	if (fx_file_read(pFile, header, sizeof(header), &actual) != FX_SUCCESS || actual != sizeof(header)
+			|| memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0)
+		return false;
+
+	ULONG offset = sizeof(header);
+	for (int i = 0; i < 8; i++) {
+		uint8_t chunk[8];
+		if (fx_file_read(pFile, chunk, sizeof(chunk), &actual) != FX_SUCCESS || actual != sizeof(chunk))
+			return false;
+		const uint32_t len = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((uint32_t) chunk[7] << 24);
+		offset += sizeof(chunk);
+		if (memcmp(chunk, "data", 4) == 0) {
+			s_data_offset = offset;
+			s_sample_count = len / (sizeof(q15_t) * ACQUISITION_CHANNELS);		// Frames, really.
+			return true;
+		}
+
+		// Chunks are padded to an even length:
+		offset += len + (len & 1);
+		if (fx_file_seek(pFile, offset) != FX_SUCCESS)
+			return false;
+	}
+
+	return false;
+}
+
+static bool start_thumbnail(void)
+{
+	snprintf(g_128bytes_char_buffer, LEN_128BYTES_BUFFER, "%s.wav", s_queue[0]);
+	if (fx_file_open(s_pMedium, &s_file, g_128bytes_char_buffer, FX_OPEN_FOR_READ) != FX_SUCCESS)
+		return false;
+
+	if (!find_data_chunk(&s_file) || s_sample_count < FFT_SIZE) {
+		fx_file_close(&s_file);
+		return false;
+	}
+
+	s_column = 0;
+	return true;
+}
+
+static void do_column(void)
+{
+	const ULONG last_start = s_sample_count - FFT_SIZE;
+	const ULONG start = (ULONG) (((uint64_t) last_start * s_column) / (THUMBNAIL_WIDTH - 1));
+
+	ULONG actual = 0;
+	memset(s_samples, 0, sizeof(s_samples));
+#if ACQUISITION_CHANNELS > 1
+	// Read whole frames into the FFT output, which is big enough for two channels and not
+	// needed yet, and take the first channel:
+	_Static_assert(sizeof(s_fft_output) >= sizeof(s_samples) * ACQUISITION_CHANNELS, "s_fft_output too small for frames");
+	if (fx_file_seek(&s_file, s_data_offset + start * sizeof(q15_t) * ACQUISITION_CHANNELS) == FX_SUCCESS)
+		fx_file_read(&s_file, s_fft_output, sizeof(s_samples) * ACQUISITION_CHANNELS, &actual);
+	for (int i = 0; i < FFT_SIZE; i++)
+		s_samples[i] = s_fft_output[i * ACQUISITION_CHANNELS];
+#else
+	if (fx_file_seek(&s_file, s_data_offset + start * sizeof(q15_t)) == FX_SUCCESS)
+		fx_file_read(&s_file, s_samples, sizeof(s_samples), &actual);
+#endif
+
+	arm_mult_q15(s_window_q15, s_samples, s_samples, FFT_SIZE);
+	arm_rfft_q15(&s_fft_instance, s_samples, s_fft_output);
+	cmplx_mag_squared_q15_q31(s_fft_output, s_power, FFT_BINS);
+
+	for (int row = 0; row < THUMBNAIL_HEIGHT; row++) {
+		uint32_t sum = 0;
+		for (int i = 0; i < BINS_PER_ROW; i++)
+			sum += (uint32_t) s_power[row * BINS_PER_ROW + i] / BINS_PER_ROW;
+
+		// Half dB steps, with 0 for 127.5 dB or more below full scale:
+		int level = 0;
+		if (sum > 0)
+			level = (int) (20.0f * log10f(sum / 2147483648.0f) + 255.5f);
+		s_pixels[THUMBNAIL_HEIGHT - 1 - row][s_column] = level < 0 ? 0 : level > 255 ? 255 : level;
+	}
+}
+
+static void write_thumbnail(void)
+{
+	// Stretch the levels so that the loudest pixel is white:
+	int max_level = 0;
+	for (int y = 0; y < THUMBNAIL_HEIGHT; y++)
+		for (int x = 0; x < THUMBNAIL_WIDTH; x++)
+			if (s_pixels[y][x] > max_level)
+				max_level = s_pixels[y][x];
+
+	const int min_level = max_level - DYNAMIC_RANGE_DB * 2;
+	for (int y = 0; y < THUMBNAIL_HEIGHT; y++) {
+		for (int x = 0; x < THUMBNAIL_WIDTH; x++) {
+			const int v = ((s_pixels[y][x] - min_level) * 255) / (DYNAMIC_RANGE_DB * 2);
+			s_pixels[y][x] = v < 0 ? 0 : v > 255 ? 255 : v;
+		}
+	}
+
+	char header[24];
+	const int header_len = snprintf(header, sizeof(header), "P5\n%d %d\n255\n", THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT);
+	snprintf(g_128bytes_char_buffer, LEN_128BYTES_BUFFER, "%s.pgm", s_queue[0]);
+	storage_append_file(s_pMedium, g_128bytes_char_buffer, header, header_len, s_pixels, sizeof(s_pixels));
+}
+
+static void finish(void)
+{
+	if (s_state != STATE_IDLE)
+		fx_file_close(&s_file);
+	s_state = STATE_IDLE;
+	pop_queue();
+	storage_unmount(true);
+	s_pMedium = NULL;
+}
+
+void thumbnail_main_processing(int main_tick_count)
+{
+	if (s_queue_count == 0)
+		return;
+
+	if (s_pMedium && !sd_lowlevel_get_debounced_sd_present()) {
+		// The SD card has gone. Let go of it so that it can be mounted afresh when it comes back:
+		storage_unmount(false);
+		s_pMedium = NULL;
+		s_state = STATE_IDLE;
+		s_queue_count = 0;
+		return;
+	}
+
+	// Recording comes first. If it has started again we pick up where we left off later:
+	if (data_processor_buffers_is_busy())
+		return;
+
+	switch (s_state) {
+	case STATE_IDLE:
+		// Usually the SD card is still mounted from the recording, so this costs nothing:
+		s_pMedium = storage_mount(STORAGE_LOW_NOISE);
+		if (!s_pMedium)
+			return;
+		if (start_thumbnail()) {
+			s_state = STATE_COLUMNS;
+		}
+		else {
+			finish();
+		}
+		break;
+
+	case STATE_COLUMNS:
+		for (int i = 0; i < COLUMNS_PER_TICK && s_column < THUMBNAIL_WIDTH; i++, s_column++)
+			do_column();
+		if (s_column >= THUMBNAIL_WIDTH)
+			s_state = STATE_WRITE;
+		break;
+
+	case STATE_WRITE:
+		write_thumbnail();
+		finish();
+		break;
+	}
+}
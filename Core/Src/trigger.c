@@ -25,10 +25,11 @@
 #include <arm_math.h>
 #include "cmplx_mag_squared.h"
 #include "settings.h"
-#include "gain.h"
 #include "data_acquisition.h"
 #include "leds.h"
 #include "data_processor_buffers.h"
+#include "events.h"
+#include "runtime_config.h"
 
 /**
  * Flags used to communicate between interrupt context and main processing consumers of the flag.
@@ -47,6 +48,9 @@ volatile bool g_trigger_matches[MAX_TRIGGER_MATCH_CLAUSES] = {0};
 
 static FFT_INSTANCE_TYPE fft_instance;
 
+// The same thing on the FPU, for TRIGGER_PIPELINE_FLOAT:
+static arm_rfft_fast_instance_f32 s_fft_instance_f32;
+
 /*
 	import numpy as np
 
@@ -69,8 +73,13 @@ static float fft_window_float[FFT_WINDOW_SIZE] = {
 
 static q15_t fft_window_q15[FFT_WINDOW_SIZE];
 
-static bool check_for_trigger(const q31_t fft_squared_output[], volatile bool *matches);
-static bool check_each_window(volatile const q15_t *pRawData, int count);
+// The window with the scaling of the q15 path folded in, so that the float path's power
+// values are on the same scale as the q15 ones and the thresholds mean the same:
+static float32_t s_fft_window_f32[FFT_WINDOW_SIZE];
+
+static bool check_for_trigger(const runtime_config_t *pc, const q31_t fft_squared_output[], volatile bool *matches, uint32_t *pEnergy);
+static bool check_for_trigger_f32(const runtime_config_t *pc, const float32_t freq_buckets[], uint32_t *pEnergy);
+static bool check_each_window(volatile const q15_t *pRawData, int count, uint32_t *pEnergy);
 
 
 void trigger_init(void)
@@ -78,6 +87,13 @@ void trigger_init(void)
 	FFT_INIT(&fft_instance, FFT_WINDOW_SIZE, 0, 1);
     arm_float_to_q15(fft_window_float, fft_window_q15, FFT_WINDOW_SIZE);
 
+	// Only the tables for the size we use get linked in this way:
+	arm_rfft_fast_init_32_f32(&s_fft_instance_f32);
+	// arm_rfft_q15 scales down by the window size, and we scale back up by all but a factor
+	// of 2 (FFT_OUTPUT_SHIFT_BITS), so the q15 output is half what the float FFT gives:
+	for (int i = 0; i < FFT_WINDOW_SIZE; i++)
+		s_fft_window_f32[i] = fft_window_float[i] / (1 << (FFT_WINDOW_SIZE_LOG2 - FFT_OUTPUT_SHIFT_BITS));
+
 	// g_triggered = false;
 	memset((void*) g_trigger_matches, '\0', sizeof(g_trigger_matches));
 }
@@ -90,32 +106,87 @@ static volatile int s_counter = 0;
  * Wait for a new half frame of data to be ready, process it for triggering, and if there was a trigger
  * and no race condition, publish the trigger.
  */
-void trigger_main_fast_processing(int main_tick_count)
+RAM_TEXT_SECTION void trigger_main_fast_processing(int main_tick_count)
 {
 	if (g_raw_half_frame_ready) {
 		// Consume the trigger:
 		g_raw_half_frame_ready = false;
 		int count1 = g_raw_half_frame_counter;
-		bool triggered = check_each_window(g_raw_half_frame, g_raw_half_frame_size);
+		uint32_t energy = 0;
+		bool triggered = check_each_window(g_raw_half_frame, g_raw_half_frame_size, &energy);
 		// Detect a race condition: ignore any trigger value as the raw data was being updated
 		// while we were working on it.
+		if (g_raw_half_frame_counter == count1)
+			data_processor_buffers_note_energy(energy);		// For choosing where to split files.
 		if (triggered) {
 			if (g_raw_half_frame_counter == count1) {
 				s_counter++;
 				// Tell any interested parties that there has been a trigger:
 				g_trigger_triggered = true;
+				events_post(EVENT_TRIGGER);
 			}
 		}
 	}
 }
 
-static bool check_each_window(volatile const q15_t *pRawData, int count)
+RAM_TEXT_SECTION static bool check_window_q15(const runtime_config_t *pc, volatile const q15_t *pFftSrc, uint32_t *pEnergy)
 {
 	static q15_t fft_output[FFT_WINDOW_SIZE * 2], working_copy[FFT_WINDOW_SIZE];
 	static q31_t fft_squared_modulus[FFT_WINDOW_SIZE / 2];
 
+	// The FFT function modifies the source buffer, so we copy it. An optimization might
+	// be modify it in place, once we no longer need it:
+	memcpy(working_copy, (void*) pFftSrc, sizeof(working_copy));
+	// Apply the window to minimize spectral leakage:
+	// Calculate the frequency buckets:
+	arm_mult_q15(fft_window_q15, working_copy, working_copy, FFT_WINDOW_SIZE);
+	arm_rfft_q15(&fft_instance, working_copy, fft_output);
+	// The FFT scales down to avoid overflow, so we unscale the output:
+	arm_shift_q15(fft_output, FFT_OUTPUT_SHIFT_BITS, fft_output, FFT_WINDOW_SIZE * 2);
+	// Avoid arm_cmplx_mag_q15 as it includes a square root we don't want, since
+	// power is what we are interested in.
+	cmplx_mag_squared_q15_q31(fft_output, fft_squared_modulus, FFT_WINDOW_SIZE / 2);
+
+	/*
+		A side effect of the following call is to record the buckets that actually triggered.
+		This will be written to guano data to aid in selecting trigger profiles.
+
+		We want setting and consuming of the trigger data and flag to be consistent/atomic,
+		which we can achieve by only updating the data when the flag is false, and having
+		the reader reset the flag as its last step.
+	*/
+	// triggered = triggered || check_for_trigger(fft_squared_modulus, g_triggered ? NULL : g_trigger_matches);
+	return check_for_trigger(pc, fft_squared_modulus, NULL, pEnergy);
+}
+
+/**
+ * As check_window_q15, with nothing lost to scaling however quiet the signal is.
+ */
+RAM_TEXT_SECTION static bool check_window_f32(const runtime_config_t *pc, volatile const q15_t *pFftSrc, uint32_t *pEnergy)
+{
+	static float32_t working_copy[FFT_WINDOW_SIZE], fft_output[FFT_WINDOW_SIZE];
+	static float32_t fft_squared_modulus[FFT_WINDOW_SIZE / 2];
+
+	// Convert and window in one pass. The FFT modifies its input, which this copy is too:
+	for (int i = 0; i < FFT_WINDOW_SIZE; i++)
+		working_copy[i] = (float32_t) pFftSrc[i] * s_fft_window_f32[i];
+	arm_rfft_fast_f32(&s_fft_instance_f32, working_copy, fft_output, 0);
+	// The real FFT packs the Nyquist value into the imaginary part of DC, which the q15
+	// FFT doesn't, so leave it out of the first bucket:
+	fft_squared_modulus[0] = fft_output[0] * fft_output[0];
+	for (int i = 1; i < FFT_WINDOW_SIZE / 2; i++)
+		fft_squared_modulus[i] = fft_output[2 * i] * fft_output[2 * i] + fft_output[2 * i + 1] * fft_output[2 * i + 1];
+
+	return check_for_trigger_f32(pc, fft_squared_modulus, pEnergy);
+}
+
+RAM_TEXT_SECTION static bool check_each_window(volatile const q15_t *pRawData, int count, uint32_t *pEnergy)
+{
 	volatile const q15_t *pFftSrc = pRawData;
 	bool triggered = false;
+	// The same configuration for every window, even if it changes while we work:
+	const runtime_config_t *pc = runtime_config_get();
+	const bool use_float = pc->trigger_pipeline == TRIGGER_PIPELINE_FLOAT;
 
 	// There aren't enough CPU cycles to evaluate all the windows:
 	const int windows_to_check_log2 = 1;	// We'll evaluate two of the windows, distributed.
@@ -123,29 +194,11 @@ static bool check_each_window(volatile const q15_t *pRawData, int count)
 	const int increment = count >> windows_to_check_log2;
 
 	for (int i = 0; i < windows_to_check; i++, pFftSrc += increment) {
-		// The FFT function modifies the source buffer, so we copy it. An optimization might
-		// be modify it in place, once we no longer need it:
-		memcpy(working_copy, (void*) pFftSrc, sizeof(working_copy));
-		// Apply the window to minimize spectral leakage:
-		// Calculate the frequency buckets:
-		arm_mult_q15(fft_window_q15, working_copy, working_copy, FFT_WINDOW_SIZE);
-		arm_rfft_q15(&fft_instance, working_copy, fft_output);
-		// The FFT scales down to avoid overflow, so we unscale the output:
-		arm_shift_q15(fft_output, FFT_OUTPUT_SHIFT_BITS, fft_output, FFT_WINDOW_SIZE * 2);
-		// Avoid arm_cmplx_mag_q15 as it includes a square root we don't want, since
-		// power is what we are interested in.
-		cmplx_mag_squared_q15_q31(fft_output, fft_squared_modulus, FFT_WINDOW_SIZE / 2);
-
-		/*
-			A side effect of the following call is to record the buckets that actually triggered.
-			This will be written to guano data to aid in selecting trigger profiles.
-
-			We want setting and consuming of the trigger data and flag to be consistent/atomic,
-			which we can achieve by only updating the data when the flag is false, and having
-			the reader reset the flag as its last step.
-		*/
-		// triggered = triggered || check_for_trigger(fft_squared_modulus, g_triggered ? NULL : g_trigger_matches);
-		triggered = triggered || check_for_trigger(fft_squared_modulus, NULL);
+		// Look at every window, even once triggered, so that the energy covers them all:
+		if (use_float)
+			triggered = check_window_f32(pc, pFftSrc, pEnergy) || triggered;
+		else
+			triggered = check_window_q15(pc, pFftSrc, pEnergy) || triggered;
 	}
 
 	return triggered;
@@ -156,42 +209,53 @@ static bool check_each_window(volatile const q15_t *pRawData, int count)
 #	error("bucket count mismatch")
 #endif
 
-static bool check_for_trigger(const q31_t freq_buckets[], volatile bool *matches)
+/**
+ * Also raises *pEnergy to the loudest bucket that the trigger is listening to. The thresholds
+ * have already been adjusted for the gain range and any trigger storm, see runtime_config.
+ */
+RAM_TEXT_SECTION static bool check_for_trigger(const runtime_config_t *pc, const q31_t freq_buckets[], volatile bool *matches, uint32_t *pEnergy)
 {
-	const settings_t *ps = settings_get();
-	const q31_t *pv = ps->_trigger_thresholds;
-	const bool *pf = ps->_trigger_flags;
-
+	const uint32_t mask = pc->trigger_bucket_mask;
 	int match_count = 0;
 
-	// Bit shift we need to adjust thresholds for the gain range we are on:
-	int shift = gain_get_shift();
+	for (int i = 0; i < MAX_TRIGGER_MATCH_CLAUSES; i++) {
+		if ((mask & (1u << i)) == 0)
+			continue;		// Don't care about this bucket.
 
-	// The raw value is relative to the most sensitive range. For less sensitive ranges,
-	// we need to shift accordingly to reduce the raw value. Also, the raw value is
-	// a square for comparison with the frequency bucket value, so shift twice:
-	int shift_for_gain = gain_shift_for_range(GAIN_MAX_RANGE_INDEX) - shift;
+		if ((uint32_t) freq_buckets[i] > *pEnergy)
+			*pEnergy = freq_buckets[i];
 
-	for (int i = 0; i < MAX_TRIGGER_MATCH_CLAUSES; i++, pv++, pf++) {
-		if ((*pf == false) || (*pv == SETTINGS_IGNORE_TRIGGER_VALUE)) {
-			// Don't care about this bucket, nothing to do.
-		}
-		else {
-			// Adjust the threshold value by the squared of the gain factor difference. A lower
-			// gain range means we need to reduce the threshold. Note that we are dealing in squared values
-			// so we do the shift twice:
-			const q31_t threshold = (*pv >> shift_for_gain) >> shift_for_gain;
-
-			bool matched = freq_buckets[i] >= threshold;
-			if (matched)
-				match_count++;
-			if (matches)
-				matches[i] = matched;
-		}
+		bool matched = freq_buckets[i] >= pc->trigger_thresholds[i];
+		if (matched)
+			match_count++;
+		if (matches)
+			matches[i] = matched;
 	}
 
-	bool triggered = (match_count > 0) && (match_count <= ps->trigger_max_count);
+	bool triggered = (match_count > 0) && (match_count <= pc->trigger_max_count);
 
 	return triggered;
 }
 
+/**
+ * check_for_trigger for the float pipeline, which compares power in linear units rather
+ * than shifting. The thresholds are the same, so the two pipelines agree on loud calls.
+ */
+RAM_TEXT_SECTION static bool check_for_trigger_f32(const runtime_config_t *pc, const float32_t freq_buckets[], uint32_t *pEnergy)
+{
+	const uint32_t mask = pc->trigger_bucket_mask;
+	int match_count = 0;
+
+	for (int i = 0; i < MAX_TRIGGER_MATCH_CLAUSES; i++) {
+		if ((mask & (1u << i)) == 0)
+			continue;
+
+		if (freq_buckets[i] > *pEnergy)
+			*pEnergy = freq_buckets[i] >= (float32_t) UINT32_MAX ? UINT32_MAX : (uint32_t) freq_buckets[i];
+
+		if (freq_buckets[i] >= pc->trigger_thresholds_f32[i])
+			match_count++;
+	}
+
+	return (match_count > 0) && (match_count <= pc->trigger_max_count);
+}
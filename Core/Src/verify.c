@@ -0,0 +1,230 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <arm_math.h>
+
+#include "verify.h"
+#include "cmplx_mag_squared.h"
+#include "settings.h"
+
+/*
+ * We use a finer FFT than the trigger does, on every window of the recording. A window is
+ * tonal if the loudest bin in the bat band stands out from the average of the band by
+ * verify_tonality_db. Bat calls show up as runs of tonal windows whose peak moves smoothly
+ * (an FM sweep or a CF call) and which end: a tone that goes on and on is interference,
+ * and isolated tonal windows are clicks or chance.
+ *
+ * At 384 kHz a window is 0.67 ms and a bin is 1.5 kHz.
+ */
+#define FFT_SIZE_LOG2 8
+#define FFT_SIZE (1 << FFT_SIZE_LOG2)
+#define FFT_BINS (FFT_SIZE / 2)
+
+#define MIN_FREQUENCY_HZ 15000			// Lower edge of the band we look in.
+#define MIN_CALL_MS 1
+#define MAX_CALL_MS 100
+#define MAX_PEAK_STEP_HZ 15000			// Per window. Steep FM calls sweep fast.
+
+static arm_rfft_instance_q15 s_fft_instance;
+static q15_t s_window_q15[FFT_SIZE];
+static q15_t s_samples[FFT_SIZE];
+static q15_t s_fft_output[FFT_SIZE * 2];
+static q31_t s_power[FFT_BINS];
+
+static int s_min_bin = 0;
+static int s_min_call_windows = 0;
+static int s_max_call_windows = 0;
+static int s_max_peak_step_bins = 0;
+static float s_tonality_ratio = 0;
+
+static int s_bin_hz = 0;
+static int s_window_us = 0;
+
+static int s_fill_count = 0;			// Samples in s_samples so far.
+static int s_window_count = 0;
+static int s_run_length = 0;			// Consecutive tonal windows with a smoothly moving peak.
+static int s_last_peak_bin = -1;
+static int s_call_count = 0;
+
+// The shape of the current run, and totals over the calls so far, for the classifier:
+static int s_run_start_bin, s_run_min_bin, s_run_max_bin, s_run_loudest_bin;
+static q31_t s_run_loudest;
+static int s_sum_start_bins, s_sum_end_bins, s_sum_loudest_bins, s_sum_bandwidth_bins, s_sum_windows;
+
+void verify_init(void)
+{
+	arm_rfft_init_q15(&s_fft_instance, FFT_SIZE, 0, 1);
+
+	// Hann window:
+	for (int i = 0; i < FFT_SIZE; i++) {
+		const float w = 0.5f - 0.5f * cosf(2.0f * (float) M_PI * i / (FFT_SIZE - 1));
+		s_window_q15[i] = (q15_t) (w * 32767.0f);
+	}
+
+	s_call_count = 0;
+}
+
+/**
+ * Start afresh for a new recording.
+ */
+void verify_reset(int sampling_rate)
+{
+	const int window_us = (int) ((FFT_SIZE * 1000000LL) / sampling_rate);
+	const int bin_hz = sampling_rate / FFT_SIZE;
+
+	s_bin_hz = bin_hz;
+	s_window_us = window_us;
+	s_min_bin = MIN_FREQUENCY_HZ / bin_hz;
+	s_min_call_windows = (MIN_CALL_MS * 1000 + window_us - 1) / window_us;
+	s_max_call_windows = (MAX_CALL_MS * 1000) / window_us;
+	s_max_peak_step_bins = MAX_PEAK_STEP_HZ / bin_hz;
+	s_tonality_ratio = powf(10.0f, settings_get()->verify_tonality_db / 10.0f);
+
+	s_fill_count = 0;
+	s_window_count = 0;
+	s_run_length = 0;
+	s_last_peak_bin = -1;
+	s_call_count = 0;
+	s_sum_start_bins = s_sum_end_bins = s_sum_loudest_bins = s_sum_bandwidth_bins = s_sum_windows = 0;
+}
+
+static void end_run(void)
+{
+	if (s_run_length >= s_min_call_windows && s_run_length <= s_max_call_windows) {
+		s_call_count++;
+		s_sum_start_bins += s_run_start_bin;
+		s_sum_end_bins += s_last_peak_bin;
+		s_sum_loudest_bins += s_run_loudest_bin;
+		s_sum_bandwidth_bins += s_run_max_bin - s_run_min_bin;
+		s_sum_windows += s_run_length;
+	}
+	s_run_length = 0;
+	s_last_peak_bin = -1;
+}
+
+static void analyse_window(void)
+{
+	arm_mult_q15(s_window_q15, s_samples, s_samples, FFT_SIZE);
+	arm_rfft_q15(&s_fft_instance, s_samples, s_fft_output);
+	cmplx_mag_squared_q15_q31(s_fft_output, s_power, FFT_BINS);
+
+	uint64_t sum = 0;
+	q31_t peak = 0;
+	int peak_bin = s_min_bin;
+	for (int i = s_min_bin; i < FFT_BINS; i++) {
+		sum += (uint32_t) s_power[i];
+		if (s_power[i] > peak) {
+			peak = s_power[i];
+			peak_bin = i;
+		}
+	}
+
+	const float mean = (float) sum / (FFT_BINS - s_min_bin);
+	const bool tonal = peak > 0 && peak >= mean * s_tonality_ratio;
+
+	if (!tonal) {
+		end_run();
+	}
+	else {
+		if (s_last_peak_bin >= 0 && abs(peak_bin - s_last_peak_bin) > s_max_peak_step_bins) {
+			// A jump: not the same call.
+			end_run();
+		}
+		if (s_run_length == 0) {
+			s_run_start_bin = s_run_min_bin = s_run_max_bin = s_run_loudest_bin = peak_bin;
+			s_run_loudest = peak;
+		}
+		else {
+			if (peak_bin < s_run_min_bin)
+				s_run_min_bin = peak_bin;
+			if (peak_bin > s_run_max_bin)
+				s_run_max_bin = peak_bin;
+			if (peak > s_run_loudest) {
+				s_run_loudest = peak;
+				s_run_loudest_bin = peak_bin;
+			}
+		}
+		s_run_length++;
+		s_last_peak_bin = peak_bin;
+	}
+}
+
+/**
+ * Process the next samples of the recording.
+ */
+void verify_process(const sample_type_t *pSamples, int count)
+{
+	while (count > 0) {
+		int n = FFT_SIZE - s_fill_count;
+		if (n > count)
+			n = count;
+		memcpy(s_samples + s_fill_count, pSamples, n * sizeof(sample_type_t));
+		s_fill_count += n;
+		pSamples += n;
+		count -= n;
+
+		if (s_fill_count == FFT_SIZE) {
+			analyse_window();
+			s_fill_count = 0;
+			s_window_count++;
+		}
+	}
+}
+
+int verify_get_call_count(void)
+{
+	return s_call_count;
+}
+
+/**
+ * The average shape of the calls in the recording so far. All zero if there were none.
+ */
+void verify_get_features(call_features_t *pFeatures)
+{
+	end_run();
+	memset(pFeatures, 0, sizeof(*pFeatures));
+	pFeatures->call_count = s_call_count;
+	if (s_call_count == 0)
+		return;
+
+	pFeatures->start_khz = (s_sum_start_bins * s_bin_hz) / (s_call_count * 1000);
+	pFeatures->end_khz = (s_sum_end_bins * s_bin_hz) / (s_call_count * 1000);
+	pFeatures->peak_khz = (s_sum_loudest_bins * s_bin_hz) / (s_call_count * 1000);
+	pFeatures->bandwidth_khz = (s_sum_bandwidth_bins * s_bin_hz) / (s_call_count * 1000);
+	pFeatures->duration_tenths_ms = (s_sum_windows * s_window_us) / (s_call_count * 100);
+
+	const int recording_ms = (int) (((int64_t) s_window_count * s_window_us) / 1000);
+	if (recording_ms > 0)
+		pFeatures->calls_per_10s = (s_call_count * 10000) / recording_ms;
+}
+
+/**
+ * At the end of the recording: should we keep it?
+ */
+bool verify_passed(void)
+{
+	end_run();
+	return s_call_count >= settings_get()->verify_min_calls;
+}
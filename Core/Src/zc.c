@@ -0,0 +1,216 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "zc.h"
+#include "settings.h"
+
+/*
+ * The signal goes through an optional band pass filter, then a comparator with hysteresis:
+ * it counts as a crossing when the signal rises above +hysteresis having been below -hysteresis,
+ * which stops noise around zero producing spurious crossings. Every division_ratio crossings
+ * we note the time, and the intervals between these times are what we output.
+ *
+ * Anabat encodes each interval as the difference from the previous one, in as few bytes
+ * as it fits:
+ *
+ * 	0xxxxxxx								7 bit signed difference
+ * 	100xxxxx xxxxxxxx						13 bit signed difference
+ * 	101xxxxx xxxxxxxx xxxxxxxx				21 bit signed difference
+ * 	110xxxxx xxxxxxxx xxxxxxxx xxxxxxxx		29 bit interval
+ */
+
+#define OUTPUT_BUFFER_LEN 2048			// Plenty: most calls produce a few hundred bytes.
+#define MAX_ANABAT_INTERVAL ((1 << 29) - 1)
+
+// A biquad section, transposed direct form II, which is the most accurate in float:
+typedef struct {
+	float b0, b1, b2, a1, a2;
+	float z1, z2;
+	bool enabled;
+} biquad_t;
+
+static biquad_t s_high_pass, s_low_pass;
+static int s_sampling_rate = 0;
+static int s_division_ratio = 8;
+static int s_hysteresis = 0;
+static bool s_above = false;					// Which side of the hysteresis band we were last.
+static int s_crossings = 0;					// Since we last output an interval.
+static uint32_t s_sample_count = 0;			// Since the start of the file.
+static uint32_t s_last_event_us = 0;
+static int32_t s_last_interval_us = 0;
+
+static zc_write_t s_write = NULL;
+static void *s_write_context = NULL;
+static uint8_t s_output[OUTPUT_BUFFER_LEN];
+static int s_output_len = 0;
+
+/**
+ * Butterworth (Q = 1/sqrt(2)) coefficients from the RBJ audio EQ cookbook.
+ */
+static void design_biquad(biquad_t *pb, float cutoff_hz, bool high_pass)
+{
+	memset(pb, 0, sizeof(*pb));
+	if (cutoff_hz <= 0 || cutoff_hz >= s_sampling_rate / 2)
+		return;
+
+	const float w0 = 2.0f * (float) M_PI * cutoff_hz / s_sampling_rate;
+	const float cos_w0 = cosf(w0);
+	const float alpha = sinf(w0) / (2.0f * 0.70710678f);
+	const float a0 = 1.0f + alpha;
+	if (high_pass) {
+		pb->b0 = (1.0f + cos_w0) / 2.0f / a0;
+		pb->b1 = -(1.0f + cos_w0) / a0;
+	}
+	else {
+		pb->b0 = (1.0f - cos_w0) / 2.0f / a0;
+		pb->b1 = (1.0f - cos_w0) / a0;
+	}
+	pb->b2 = pb->b0;
+	pb->a1 = -2.0f * cos_w0 / a0;
+	pb->a2 = (1.0f - alpha) / a0;
+	pb->enabled = true;
+}
+
+static inline float biquad(biquad_t *pb, float x)
+{
+	const float y = pb->b0 * x + pb->z1;
+	pb->z1 = pb->b1 * x - pb->a1 * y + pb->z2;
+	pb->z2 = pb->b2 * x - pb->a2 * y;
+	return y;
+}
+
+void zc_init(void)
+{
+	s_write = NULL;
+	s_output_len = 0;
+}
+
+/**
+ * Start afresh, for a new file. Settings are read now, so that they are fixed for the file.
+ */
+void zc_reset(int sampling_rate, zc_write_t write, void *context)
+{
+	const settings_t *pSettings = settings_get();
+
+	s_sampling_rate = sampling_rate;
+	s_division_ratio = pSettings->zc_division_ratio;
+	s_hysteresis = pSettings->zc_hysteresis;
+	design_biquad(&s_high_pass, pSettings->zc_band_low_khz * 1000.0f, true);
+	design_biquad(&s_low_pass, pSettings->zc_band_high_khz * 1000.0f, false);
+
+	s_above = false;
+	s_crossings = 0;
+	s_sample_count = 0;
+	s_last_event_us = 0;
+	s_last_interval_us = 0;
+
+	s_write = write;
+	s_write_context = context;
+	s_output_len = 0;
+}
+
+int zc_get_division_ratio(void)
+{
+	return s_division_ratio;
+}
+
+void zc_flush(void)
+{
+	if (s_output_len > 0 && s_write)
+		s_write(s_write_context, s_output, s_output_len);
+	s_output_len = 0;
+}
+
+static void output_interval(int32_t interval_us)
+{
+	if (s_output_len > OUTPUT_BUFFER_LEN - 4)
+		zc_flush();
+
+	uint8_t *p = s_output + s_output_len;
+	const int32_t difference = interval_us - s_last_interval_us;
+	if (difference >= -64 && difference <= 63) {
+		p[0] = difference & 0x7F;
+		s_output_len += 1;
+	}
+	else if (difference >= -4096 && difference <= 4095) {
+		p[0] = 0x80 | ((difference >> 8) & 0x1F);
+		p[1] = difference & 0xFF;
+		s_output_len += 2;
+	}
+	else if (difference >= -1048576 && difference <= 1048575) {
+		p[0] = 0xA0 | ((difference >> 16) & 0x1F);
+		p[1] = (difference >> 8) & 0xFF;
+		p[2] = difference & 0xFF;
+		s_output_len += 3;
+	}
+	else {
+		p[0] = 0xC0 | ((interval_us >> 24) & 0x1F);
+		p[1] = (interval_us >> 16) & 0xFF;
+		p[2] = (interval_us >> 8) & 0xFF;
+		p[3] = interval_us & 0xFF;
+		s_output_len += 4;
+	}
+	s_last_interval_us = interval_us;
+}
+
+/**
+ * Process the next samples for the file. Encoded data goes to the write function supplied
+ * to zc_reset whenever our buffer fills: call zc_flush at the end of the file for the rest.
+ */
+void zc_process(const sample_type_t *pSamples, int count)
+{
+	if (!s_write)
+		return;
+
+	const float hysteresis = s_hysteresis;
+	for (int i = 0; i < count; i++) {
+		float x = pSamples[i];
+		if (s_high_pass.enabled)
+			x = biquad(&s_high_pass, x);
+		if (s_low_pass.enabled)
+			x = biquad(&s_low_pass, x);
+
+		if (s_above) {
+			if (x < -hysteresis)
+				s_above = false;
+		}
+		else if (x > hysteresis) {
+			s_above = true;
+			if (++s_crossings >= s_division_ratio) {
+				s_crossings = 0;
+
+				// Times relative to the start of the file, worked out from the sample count
+				// each time so that rounding doesn't accumulate:
+				const uint32_t event_us = (uint32_t) (((uint64_t) (s_sample_count + i) * 1000000) / s_sampling_rate);
+				uint32_t interval_us = event_us - s_last_event_us;
+				if (interval_us > MAX_ANABAT_INTERVAL)
+					interval_us = MAX_ANABAT_INTERVAL;
+				output_interval((int32_t) interval_us);
+				s_last_event_us = event_us;
+			}
+		}
+	}
+	s_sample_count += count;
+}
@@ -17,6 +17,11 @@ extern void MX_SDMMC1_SD_Init(void);
 #endif
 
 /* USER CODE BEGIN  0 */
+#include "main.h"
+
+// The SDMMC interrupt calls these on every transfer, so they run from SRAM with it:
+RAM_TEXT_SECTION void HAL_SD_TxCpltCallback(SD_HandleTypeDef *hsd);
+RAM_TEXT_SECTION void HAL_SD_RxCpltCallback(SD_HandleTypeDef *hsd);
 
 /* USER CODE END  0 */
 
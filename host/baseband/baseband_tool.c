@@ -0,0 +1,204 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include "settings.h"
+#include "baseband.h"
+#include "wav_io.h"
+
+/*
+ * Baseband recordings on a PC.
+ *
+ * down mixes an ordinary recording down to baseband I and Q with the logger's own code and
+ * the band from the settings, to see what a band would keep before setting a logger up for
+ * it. up puts the band of a baseband recording back where it came from, as an ordinary
+ * recording at the original sampling rate that any bat software can read.
+ *
+ * Usage: baseband_tool down [-s settings.json] in.wav out.wav
+ *        baseband_tool up in.wav out.wav
+ */
+
+#define MAX_SETTINGS_LEN (64 * 1024)
+#define INTERPOLATION_TAPS_PER_SAMPLE 16	// Of the baseband signal: enough for the band's edges.
+
+int stricmp(const char *s1, const char *s2)
+{
+	return strcasecmp(s1, s2);
+}
+
+static char s_settings[MAX_SETTINGS_LEN + 1];
+
+static int guano_int(const char *guano, const char *key)
+{
+	const char *p = strstr(guano, key);
+	return p ? atoi(p + strlen(key)) : 0;
+}
+
+/*
+ * Mixing down, with the logger's code.
+ */
+
+static int16_t *s_pOutput = NULL;
+static size_t s_output_len = 0;
+
+static void collect(void *context, int16_t *pSamples, int count)
+{
+	(void) context;
+	memcpy(s_pOutput + s_output_len, pSamples, count * sizeof(int16_t));
+	s_output_len += count;
+}
+
+static int down(const wav_info_t *pIn, const int16_t *pSamples, const char *out_path)
+{
+	if (pIn->channels != 1) {
+		fprintf(stderr, "down needs a mono recording\n");
+		return 2;
+	}
+
+	baseband_init();
+	baseband_reset(pIn->sampling_rate, collect, NULL);
+	// At least two inputs per output, and one flush's worth of slack:
+	s_pOutput = malloc((pIn->frame_count + 4096) * sizeof(int16_t));
+	if (!s_pOutput)
+		return 2;
+	baseband_process(pSamples, (int) pIn->frame_count);
+	baseband_flush();
+
+	char guano[256];
+	snprintf(guano, sizeof(guano),
+			"GUANO|Version: 1.0\n"
+			"Samplerate: %d\n"
+			"BatGizmo|Baseband Centre Hz: %06d\n"
+			"BatGizmo|Baseband Samplerate: %06d\n"
+			"BatGizmo|Baseband Delay: %04d\n",
+			baseband_get_output_rate(), baseband_get_centre_hz(), pIn->sampling_rate, baseband_get_delay());
+	printf("%d Hz centre, %d Hz I/Q, %zu bytes from %zu\n", baseband_get_centre_hz(), baseband_get_output_rate(),
+			s_output_len * sizeof(int16_t), pIn->frame_count * sizeof(int16_t));
+
+	return wav_write(out_path, 2, baseband_get_output_rate(), s_pOutput, s_output_len / 2, guano) ? 0 : 1;
+}
+
+/*
+ * Putting it back: interpolate I and Q up to the original rate with a windowed sinc low pass
+ * filter, and mix back up with the same oscillator, allowing for both filters' delays.
+ */
+
+static int up(const wav_info_t *pIn, const int16_t *pSamples, const char *out_path)
+{
+	const int centre_hz = guano_int(pIn->guano, "BatGizmo|Baseband Centre Hz:");
+	const int source_rate = guano_int(pIn->guano, "BatGizmo|Baseband Samplerate:");
+	const int logger_delay = guano_int(pIn->guano, "BatGizmo|Baseband Delay:");
+	if (pIn->channels != 2 || centre_hz <= 0 || source_rate <= pIn->sampling_rate) {
+		fprintf(stderr, "up needs a baseband recording\n");
+		return 2;
+	}
+
+	const int decimation = (int) lround((double) source_rate / pIn->sampling_rate);
+	const int tap_count = INTERPOLATION_TAPS_PER_SAMPLE * decimation + 1;
+	const int our_delay = (tap_count - 1) / 2;
+	double *pTaps = malloc(tap_count * sizeof(double));
+	const double cutoff = 0.5 / decimation;
+	double sum = 0;
+	for (int m = 0; m < tap_count; m++) {
+		const double x = m - our_delay;
+		const double sinc = x == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * x) / (M_PI * x);
+		pTaps[m] = sinc * (0.54 - 0.46 * cos(2 * M_PI * m / (tap_count - 1)));
+		sum += pTaps[m];
+	}
+	for (int m = 0; m < tap_count; m++)
+		pTaps[m] *= decimation / sum;		// Make up for the zeros between the samples.
+
+	const size_t out_count = pIn->frame_count * decimation;
+	int16_t *pOut = malloc(out_count * sizeof(int16_t));
+	if (!pTaps || !pOut)
+		return 2;
+
+	// Output n is the band at source time n, which the baseband data holds at n plus both delays:
+	const double w = 2 * M_PI * centre_hz / source_rate;
+	for (size_t n = 0; n < out_count; n++) {
+		const long t = (long) n + logger_delay + our_delay;
+		double i = 0, q = 0;
+		// The baseband samples that the filter centred on t reaches:
+		long k = (t - (tap_count - 1) + decimation - 1) / decimation;
+		if (k < 0)
+			k = 0;
+		for (; k * decimation <= t && k < (long) pIn->frame_count; k++) {
+			const double tap = pTaps[t - k * decimation];
+			i += tap * pSamples[2 * k];
+			q += tap * pSamples[2 * k + 1];
+		}
+		const double phase = w * (double) n;
+		const double y = i * cos(phase) - q * sin(phase);
+		pOut[n] = (int16_t) (y > INT16_MAX ? INT16_MAX : y < INT16_MIN ? INT16_MIN : lround(y));
+	}
+
+	printf("%d Hz centre, %d Hz from %d Hz I/Q\n", centre_hz, source_rate, pIn->sampling_rate);
+	const bool ok = wav_write(out_path, 1, source_rate, pOut, out_count, NULL);
+	free(pOut);
+	free(pTaps);
+	return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	settings_init();
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s down [-s settings.json] in.wav out.wav\n"
+				"       %s up in.wav out.wav\n", argv[0], argv[0]);
+		return 2;
+	}
+
+	const bool is_down = strcmp(argv[1], "down") == 0;
+	int i = 2;
+	if (is_down && i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+		FILE *f = fopen(argv[i + 1], "rb");
+		if (!f) {
+			perror(argv[i + 1]);
+			return 2;
+		}
+		const size_t len = fread(s_settings, 1, MAX_SETTINGS_LEN, f);
+		fclose(f);
+		s_settings[len] = '\0';
+		if (!settings_parse_and_process_json_settings(s_settings)) {
+			fprintf(stderr, "%s: invalid settings\n", argv[i + 1]);
+			return 2;
+		}
+		i += 2;
+	}
+	if ((!is_down && strcmp(argv[1], "up") != 0) || i + 2 != argc) {
+		fprintf(stderr, "usage: %s down [-s settings.json] in.wav out.wav\n"
+				"       %s up in.wav out.wav\n", argv[0], argv[0]);
+		return 2;
+	}
+
+	wav_info_t in;
+	int16_t *pSamples = wav_read(argv[i], &in);
+	if (!pSamples)
+		return 2;
+	const int result = is_down ? down(&in, pSamples, argv[i + 1]) : up(&in, pSamples, argv[i + 1]);
+	free(pSamples);
+	return result;
+}
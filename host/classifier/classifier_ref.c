@@ -0,0 +1,121 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "settings.h"
+#include "verify.h"
+#include "classify.h"
+#include "wav_io.h"
+
+/*
+ * Run the logger's verification and classification over WAV files on a PC, with the same
+ * code, so what it prints is exactly what the logger would have decided. The output is a
+ * CSV row per file: put the true label in the first column and it is training data for
+ * classifier_train.
+ *
+ * Usage: classifier_ref [-s settings.json] file.wav...
+ */
+
+#define MAX_SETTINGS_LEN (64 * 1024)
+#define READ_SAMPLES 4096
+
+int stricmp(const char *s1, const char *s2)
+{
+	return strcasecmp(s1, s2);
+}
+
+static char s_settings[MAX_SETTINGS_LEN + 1];
+static sample_type_t s_samples[READ_SAMPLES];
+
+static void process_file(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return;
+	}
+
+	// We only deal with what the logger writes: 16 bit mono PCM.
+	wav_info_t info;
+	if (!wav_open(f, &info) || info.channels != 1) {
+		fprintf(stderr, "%s: not a 16 bit mono WAV file\n", path);
+		fclose(f);
+		return;
+	}
+
+	verify_reset(info.sampling_rate);
+	uint64_t remaining = info.frame_count;
+	while (remaining > 0) {
+		const size_t wanted = remaining < READ_SAMPLES ? remaining : READ_SAMPLES;
+		const size_t count = fread(s_samples, sizeof(sample_type_t), wanted, f);
+		if (count == 0)
+			break;
+		verify_process(s_samples, (int) count);
+		remaining -= count;
+	}
+	fclose(f);
+
+	call_features_t features;
+	verify_get_features(&features);
+	classify_result_t result;
+	classify(&features, &result);
+
+	printf("%s,%d,%d,%d,%d,%d,%d,%d,%s,%d\n", path,
+			features.start_khz, features.end_khz, features.peak_khz, features.bandwidth_khz,
+			features.duration_tenths_ms, features.calls_per_10s, features.call_count,
+			result.label, result.confidence_percent);
+}
+
+int main(int argc, char *argv[])
+{
+	int i = 1;
+	settings_init();
+	if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+		FILE *f = fopen(argv[i + 1], "rb");
+		if (!f) {
+			perror(argv[i + 1]);
+			return 2;
+		}
+		const size_t len = fread(s_settings, 1, MAX_SETTINGS_LEN, f);
+		fclose(f);
+		s_settings[len] = '\0';
+		if (!settings_parse_and_process_json_settings(s_settings)) {
+			fprintf(stderr, "%s: invalid settings\n", argv[i + 1]);
+			return 2;
+		}
+		i += 2;
+	}
+	if (i >= argc) {
+		fprintf(stderr, "usage: %s [-s settings.json] file.wav...\n", argv[0]);
+		return 2;
+	}
+
+	verify_init();
+	printf("file,start_khz,end_khz,peak_khz,bandwidth_khz,duration_tenths_ms,calls_per_10s,calls,species,confidence\n");
+	for (; i < argc; i++)
+		process_file(argv[i]);
+
+	return 0;
+}
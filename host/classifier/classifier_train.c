@@ -0,0 +1,534 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "classify.h"
+
+/*
+ * Train the recording classifier and write it out as classifier_model.c for the firmware.
+ *
+ * The network is trained in floating point on inputs quantized exactly as the logger
+ * quantizes them, then its weights are quantized and the result is checked with the
+ * firmware's own classify_run, so the accuracy reported is what the logger will get.
+ *
+ * Usage: classifier_train [-H hidden] [-e epochs] [-n samples] [-o classifier_model.c]
+ *                         [-p prototypes.csv]... [-f features.csv]...
+ *
+ * features.csv has a row per recording: label, then the six features in the order
+ * classify_get_inputs takes them. Extra columns are ignored, so the output of
+ * classifier_ref can be used with its first column replaced by the true label.
+ *
+ * prototypes.csv has a row per group: label, then a mean and a standard deviation for
+ * each feature. Samples are drawn from these for training when there are no labelled
+ * recordings to hand.
+ */
+
+#define MAX_SAMPLES 20000
+#define MAX_CLASSES 16
+#define MAX_HIDDEN 32
+#define LINE_LEN 512
+
+// The generated file carries the same licence as the rest of the firmware:
+#define LICENSE \
+		"/**\n" \
+		" * Copyright (c) 2022-2026 John Mears\n" \
+		" *\n" \
+		" * Permission is hereby granted, free of charge, to any person obtaining a copy\n" \
+		" * of this software and associated documentation files (the \"Software\"), to deal\n" \
+		" * in the Software without restriction, including without limitation the rights\n" \
+		" * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell\n" \
+		" * copies of the Software, and to permit persons to whom the Software is\n" \
+		" * furnished to do so, subject to the following conditions:\n" \
+		" *\n" \
+		" * The above copyright notice and this permission notice shall be included in all\n" \
+		" * copies or substantial portions of the Software.\n" \
+		" *\n" \
+		" * THE SOFTWARE IS PROVIDED \"AS IS\", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR\n" \
+		" * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,\n" \
+		" * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE\n" \
+		" * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER\n" \
+		" * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,\n" \
+		" * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE\n" \
+		" * SOFTWARE.\n" \
+		" */\n"
+
+typedef struct {
+	int16_t inputs[CLASSIFY_FEATURES];
+	int label;
+} sample_t;
+
+static sample_t s_samples[MAX_SAMPLES];
+static int s_sample_count = 0;
+static char s_labels[MAX_CLASSES][CLASSIFY_LABEL_LEN];
+static int s_class_count = 0;
+
+static int s_hidden_count = 16;
+
+// The float network:
+static float s_w1[MAX_HIDDEN][CLASSIFY_FEATURES], s_b1[MAX_HIDDEN];
+static float s_w2[MAX_CLASSES][MAX_HIDDEN], s_b2[MAX_CLASSES];
+
+// The quantized model:
+static int16_t s_input_offsets[CLASSIFY_FEATURES], s_input_scales[CLASSIFY_FEATURES];
+static int8_t s_hidden_weights[MAX_HIDDEN * CLASSIFY_FEATURES];
+static int32_t s_hidden_biases[MAX_HIDDEN];
+static int8_t s_output_weights[MAX_CLASSES * MAX_HIDDEN];
+static int32_t s_output_biases[MAX_CLASSES];
+
+static int find_label(const char *label)
+{
+	for (int i = 0; i < s_class_count; i++)
+		if (strncmp(s_labels[i], label, CLASSIFY_LABEL_LEN - 1) == 0)
+			return i;
+
+	if (s_class_count >= MAX_CLASSES) {
+		fprintf(stderr, "Too many classes\n");
+		exit(1);
+	}
+	strncpy(s_labels[s_class_count], label, CLASSIFY_LABEL_LEN - 1);
+	return s_class_count++;
+}
+
+static void add_sample(int label, const float features[])
+{
+	if (s_sample_count >= MAX_SAMPLES) {
+		fprintf(stderr, "Too many samples\n");
+		exit(1);
+	}
+	sample_t *ps = &s_samples[s_sample_count++];
+	ps->label = label;
+	for (int i = 0; i < CLASSIFY_FEATURES; i++) {
+		const float v = features[i] < 0 ? 0 : features[i];
+		ps->inputs[i] = (int16_t) (v + 0.5f);
+	}
+}
+
+/**
+ * Split a CSV line, returning the label and filling in up to max_values numbers.
+ */
+static int parse_line(char *line, char **pLabel, float values[], int max_values)
+{
+	if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+		return -1;
+
+	*pLabel = strtok(line, ",\r\n");
+	if (*pLabel == NULL)
+		return -1;
+
+	int n = 0;
+	char *token;
+	while (n < max_values && (token = strtok(NULL, ",\r\n")) != NULL) {
+		char *end;
+		values[n] = strtof(token, &end);
+		if (end == token)
+			return -1;		// Probably a header line.
+		n++;
+	}
+	return n;
+}
+
+static void read_features(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	char line[LINE_LEN];
+	while (fgets(line, sizeof(line), f)) {
+		char *label;
+		float values[CLASSIFY_FEATURES];
+		if (parse_line(line, &label, values, CLASSIFY_FEATURES) == CLASSIFY_FEATURES)
+			add_sample(find_label(label), values);
+	}
+	fclose(f);
+}
+
+static float gaussian(void)
+{
+	const float u = (rand() + 1.0f) / ((float) RAND_MAX + 2.0f);
+	const float v = rand() / (float) RAND_MAX;
+	return sqrtf(-2.0f * logf(u)) * cosf(2.0f * (float) M_PI * v);
+}
+
+static void read_prototypes(const char *path, int samples_per_class)
+{
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	char line[LINE_LEN];
+	while (fgets(line, sizeof(line), f)) {
+		char *label;
+		float values[CLASSIFY_FEATURES * 2];
+		if (parse_line(line, &label, values, CLASSIFY_FEATURES * 2) != CLASSIFY_FEATURES * 2)
+			continue;
+		const int c = find_label(label);
+		for (int n = 0; n < samples_per_class; n++) {
+			float features[CLASSIFY_FEATURES];
+			for (int i = 0; i < CLASSIFY_FEATURES; i++)
+				features[i] = values[i * 2] + values[i * 2 + 1] * gaussian();
+			add_sample(c, features);
+		}
+	}
+	fclose(f);
+}
+
+static int clip(int v, int min, int max)
+{
+	return v < min ? min : v > max ? max : v;
+}
+
+/**
+ * Input quantization: centre each feature on its mean and scale so that three standard
+ * deviations reach the limit.
+ */
+static void choose_input_scaling(void)
+{
+	for (int i = 0; i < CLASSIFY_FEATURES; i++) {
+		double sum = 0, sum2 = 0;
+		for (int n = 0; n < s_sample_count; n++) {
+			sum += s_samples[n].inputs[i];
+			sum2 += (double) s_samples[n].inputs[i] * s_samples[n].inputs[i];
+		}
+		const double mean = sum / s_sample_count;
+		double sd = sqrt(sum2 / s_sample_count - mean * mean);
+		if (sd < 1)
+			sd = 1;
+		s_input_offsets[i] = (int16_t) lround(mean);
+		s_input_scales[i] = (int16_t) clip(lround(256 * 127 / (3 * sd)), 1, 32767);
+	}
+}
+
+// The same as classify_run does:
+static void quantize_inputs(const sample_t *ps, float x[])
+{
+	for (int i = 0; i < CLASSIFY_FEATURES; i++)
+		x[i] = clip(((int32_t) (ps->inputs[i] - s_input_offsets[i]) * s_input_scales[i]) >> 8, -127, 127) / 127.0f;
+}
+
+static void forward(const float x[], float h[], float out[])
+{
+	for (int j = 0; j < s_hidden_count; j++) {
+		float a = s_b1[j];
+		for (int i = 0; i < CLASSIFY_FEATURES; i++)
+			a += s_w1[j][i] * x[i];
+		h[j] = a > 0 ? a : 0;
+	}
+	for (int c = 0; c < s_class_count; c++) {
+		float a = s_b2[c];
+		for (int j = 0; j < s_hidden_count; j++)
+			a += s_w2[c][j] * h[j];
+		out[c] = a;
+	}
+}
+
+static float train(int epochs)
+{
+	for (int j = 0; j < s_hidden_count; j++) {
+		for (int i = 0; i < CLASSIFY_FEATURES; i++)
+			s_w1[j][i] = gaussian() * sqrtf(2.0f / CLASSIFY_FEATURES);
+		s_b1[j] = 0;
+	}
+	for (int c = 0; c < s_class_count; c++) {
+		for (int j = 0; j < s_hidden_count; j++)
+			s_w2[c][j] = gaussian() * sqrtf(1.0f / s_hidden_count);
+		s_b2[c] = 0;
+	}
+
+	float accuracy = 0;
+	for (int epoch = 0; epoch < epochs; epoch++) {
+		const float rate = 0.02f / (1.0f + epoch * 0.02f);
+		int correct = 0;
+		for (int n = 0; n < s_sample_count; n++) {
+			// Visit the samples in a different order each epoch:
+			const sample_t *ps = &s_samples[rand() % s_sample_count];
+			float x[CLASSIFY_FEATURES], h[MAX_HIDDEN], out[MAX_CLASSES], grad[MAX_CLASSES];
+			quantize_inputs(ps, x);
+			forward(x, h, out);
+
+			// Softmax cross entropy:
+			float max = out[0];
+			int best = 0;
+			for (int c = 1; c < s_class_count; c++) {
+				if (out[c] > max) {
+					max = out[c];
+					best = c;
+				}
+			}
+			correct += best == ps->label;
+			float sum = 0;
+			for (int c = 0; c < s_class_count; c++)
+				sum += grad[c] = expf(out[c] - max);
+			for (int c = 0; c < s_class_count; c++)
+				grad[c] = grad[c] / sum - (c == ps->label ? 1.0f : 0.0f);
+
+			for (int j = 0; j < s_hidden_count; j++) {
+				float gh = 0;
+				for (int c = 0; c < s_class_count; c++)
+					gh += grad[c] * s_w2[c][j];
+				for (int c = 0; c < s_class_count; c++)
+					s_w2[c][j] -= rate * grad[c] * h[j];
+				if (h[j] > 0) {
+					for (int i = 0; i < CLASSIFY_FEATURES; i++)
+						s_w1[j][i] -= rate * gh * x[i];
+					s_b1[j] -= rate * gh;
+				}
+			}
+			for (int c = 0; c < s_class_count; c++)
+				s_b2[c] -= rate * grad[c];
+		}
+		accuracy = (float) correct / s_sample_count;
+	}
+
+	return accuracy;
+}
+
+static float max_abs(const float *p, int n, int stride, int rows)
+{
+	float m = 1e-9f;
+	for (int r = 0; r < rows; r++)
+		for (int i = 0; i < n; i++)
+			if (fabsf(p[r * stride + i]) > m)
+				m = fabsf(p[r * stride + i]);
+	return m;
+}
+
+static classify_model_t quantize(void)
+{
+	const float s1 = 127.0f / max_abs(&s_w1[0][0], CLASSIFY_FEATURES, CLASSIFY_FEATURES, s_hidden_count);
+	const float s2 = 127.0f / max_abs(&s_w2[0][0], s_hidden_count, MAX_HIDDEN, s_class_count);
+
+	for (int j = 0; j < s_hidden_count; j++) {
+		for (int i = 0; i < CLASSIFY_FEATURES; i++)
+			s_hidden_weights[j * CLASSIFY_FEATURES + i] = (int8_t) lroundf(s_w1[j][i] * s1);
+		s_hidden_biases[j] = (int32_t) lroundf(s_b1[j] * s1 * 127);
+	}
+
+	// Shift the hidden activations down so that the largest we see fits in 0..127:
+	int32_t max_acc = 1;
+	for (int n = 0; n < s_sample_count; n++) {
+		float x[CLASSIFY_FEATURES];
+		quantize_inputs(&s_samples[n], x);
+		for (int j = 0; j < s_hidden_count; j++) {
+			int32_t acc = s_hidden_biases[j];
+			for (int i = 0; i < CLASSIFY_FEATURES; i++)
+				acc += s_hidden_weights[j * CLASSIFY_FEATURES + i] * (int32_t) lroundf(x[i] * 127);
+			if (acc > max_acc)
+				max_acc = acc;
+		}
+	}
+	int shift = 0;
+	while ((max_acc >> shift) > 127)
+		shift++;
+
+	const float hidden_scale = s1 * 127 / (1 << shift);		// Quantized hidden per unit of float hidden.
+	for (int c = 0; c < s_class_count; c++) {
+		for (int j = 0; j < s_hidden_count; j++)
+			s_output_weights[c * s_hidden_count + j] = (int8_t) lroundf(s_w2[c][j] * s2);
+		s_output_biases[c] = (int32_t) lroundf(s_b2[c] * s2 * hidden_scale);
+	}
+
+	classify_model_t model = {
+		.hidden_count = s_hidden_count,
+		.class_count = s_class_count,
+		.input_offsets = s_input_offsets,
+		.input_scales = s_input_scales,
+		.hidden_weights = s_hidden_weights,
+		.hidden_biases = s_hidden_biases,
+		.hidden_shift = shift,
+		.output_weights = s_output_weights,
+		.output_biases = s_output_biases,
+		// A softmax over the top two gives 75% at a margin of ln(3):
+		.confidence_margin = (int32_t) lroundf(logf(3.0f) * s2 * hidden_scale),
+		.labels = (const char (*)[CLASSIFY_LABEL_LEN]) s_labels
+	};
+	return model;
+}
+
+/**
+ * Accuracy with the firmware's own inference code.
+ */
+static float evaluate(const classify_model_t *pModel, bool print_confusion)
+{
+	int correct = 0;
+	static int confusion[MAX_CLASSES][MAX_CLASSES];
+	memset(confusion, 0, sizeof(confusion));
+	for (int n = 0; n < s_sample_count; n++) {
+		classify_result_t result;
+		classify_run(pModel, s_samples[n].inputs, &result);
+		correct += result.class_index == s_samples[n].label;
+		if (result.class_index >= 0)
+			confusion[s_samples[n].label][result.class_index]++;
+	}
+
+	if (print_confusion) {
+		printf("%-8s", "");
+		for (int c = 0; c < s_class_count; c++)
+			printf(" %7s", s_labels[c]);
+		printf("\n");
+		for (int r = 0; r < s_class_count; r++) {
+			printf("%-8s", s_labels[r]);
+			for (int c = 0; c < s_class_count; c++)
+				printf(" %7d", confusion[r][c]);
+			printf("\n");
+		}
+	}
+
+	return (float) correct / s_sample_count;
+}
+
+static void write_array8(FILE *f, const char *type, const char *name, const int8_t *p, int n, int per_line)
+{
+	fprintf(f, "static const %s %s[%d] = {", type, name, n);
+	for (int i = 0; i < n; i++)
+		fprintf(f, "%s%4d%s", i % per_line == 0 ? "\n\t\t" : " ", p[i], i < n - 1 ? "," : "");
+	fprintf(f, "\n};\n\n");
+}
+
+static void write_array16(FILE *f, const char *name, const int16_t *p, int n)
+{
+	fprintf(f, "static const int16_t %s[%d] = {", name, n);
+	for (int i = 0; i < n; i++)
+		fprintf(f, " %d%s", p[i], i < n - 1 ? "," : " ");
+	fprintf(f, "};\n\n");
+}
+
+static void write_array32(FILE *f, const char *name, const int32_t *p, int n)
+{
+	fprintf(f, "static const int32_t %s[%d] = {", name, n);
+	for (int i = 0; i < n; i++)
+		fprintf(f, "%s%ld%s", i % 8 == 0 ? "\n\t\t" : " ", (long) p[i], i < n - 1 ? "," : "");
+	fprintf(f, "\n};\n\n");
+}
+
+static void write_model(const char *path, const classify_model_t *pModel, const char *sources)
+{
+	FILE *f = fopen(path, "w");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+
+	fputs(LICENSE, f);
+	fprintf(f,
+			"\n/*\n"
+			" * Generated by host/classifier/classifier_train from %s.\n"
+			" * Don't edit: train a new model instead.\n"
+			" */\n\n"
+			"#include \"classify.h\"\n\n", sources);
+
+	write_array16(f, "s_input_offsets", pModel->input_offsets, CLASSIFY_FEATURES);
+	write_array16(f, "s_input_scales", pModel->input_scales, CLASSIFY_FEATURES);
+	write_array8(f, "int8_t", "s_hidden_weights", pModel->hidden_weights, pModel->hidden_count * CLASSIFY_FEATURES, CLASSIFY_FEATURES);
+	write_array32(f, "s_hidden_biases", pModel->hidden_biases, pModel->hidden_count);
+	write_array8(f, "int8_t", "s_output_weights", pModel->output_weights, pModel->class_count * pModel->hidden_count, pModel->hidden_count);
+	write_array32(f, "s_output_biases", pModel->output_biases, pModel->class_count);
+
+	fprintf(f, "static const char s_labels[%d][CLASSIFY_LABEL_LEN] = {", pModel->class_count);
+	for (int c = 0; c < pModel->class_count; c++)
+		fprintf(f, " \"%s\"%s", pModel->labels[c], c < pModel->class_count - 1 ? "," : " ");
+	fprintf(f, "};\n\n");
+
+	fprintf(f,
+			"const classify_model_t g_classify_model = {\n"
+			"\t\t.hidden_count = %d,\n"
+			"\t\t.class_count = %d,\n"
+			"\t\t.input_offsets = s_input_offsets,\n"
+			"\t\t.input_scales = s_input_scales,\n"
+			"\t\t.hidden_weights = s_hidden_weights,\n"
+			"\t\t.hidden_biases = s_hidden_biases,\n"
+			"\t\t.hidden_shift = %d,\n"
+			"\t\t.output_weights = s_output_weights,\n"
+			"\t\t.output_biases = s_output_biases,\n"
+			"\t\t.confidence_margin = %ld,\n"
+			"\t\t.labels = s_labels\n"
+			"};\n",
+			pModel->hidden_count, pModel->class_count, pModel->hidden_shift, (long) pModel->confidence_margin);
+	fclose(f);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *out_path = "classifier_model.c";
+	int epochs = 60;
+	int samples_per_class = 1000;
+	char sources[LINE_LEN] = "";
+	srand(1);
+
+	int opt;
+	while ((opt = getopt(argc, argv, "H:e:n:o:p:f:")) != -1) {
+		switch (opt) {
+		case 'H':
+			s_hidden_count = clip(atoi(optarg), 1, MAX_HIDDEN);
+			break;
+		case 'e':
+			epochs = atoi(optarg);
+			break;
+		case 'n':
+			samples_per_class = atoi(optarg);
+			break;
+		case 'o':
+			out_path = optarg;
+			break;
+		case 'p':
+		case 'f': {
+			const char *base = strrchr(optarg, '/') ? strrchr(optarg, '/') + 1 : optarg;
+			if (sources[0])
+				strncat(sources, ", ", sizeof(sources) - strlen(sources) - 1);
+			strncat(sources, base, sizeof(sources) - strlen(sources) - 1);
+			if (opt == 'p')
+				read_prototypes(optarg, samples_per_class);
+			else
+				read_features(optarg);
+			break;
+		}
+		default:
+			fprintf(stderr, "Usage: %s [-H hidden] [-e epochs] [-n samples] [-o classifier_model.c] [-p prototypes.csv]... [-f features.csv]...\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (s_sample_count == 0 || s_class_count < 2) {
+		fprintf(stderr, "Need samples of at least two classes\n");
+		return 1;
+	}
+
+	printf("%d samples of %d classes\n", s_sample_count, s_class_count);
+	printf("Current model: %.1f%% (if it has the same classes)\n", evaluate(&g_classify_model, false) * 100);
+
+	choose_input_scaling();
+	const float float_accuracy = train(epochs);
+	const classify_model_t model = quantize();
+	const float accuracy = evaluate(&model, true);
+	printf("Float model: %.1f%%, quantized: %.1f%%\n", float_accuracy * 100, accuracy * 100);
+
+	write_model(out_path, &model, sources);
+	printf("Wrote %s\n", out_path);
+
+	return 0;
+}
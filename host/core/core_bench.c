@@ -0,0 +1,392 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "settings.h"
+#include "trigger.h"
+#include "data_processor_buffers.h"
+#include "cmplx_mag_squared.h"
+#include "verify.h"
+#include "zc.h"
+#include "baseband.h"
+#include "storage.h"
+#include "gain.h"
+#include "agc.h"
+#include "runtime_config.h"
+#include "core_host.h"
+#include "wav_io.h"
+
+/*
+ * Times the logger's hot paths on the host with the core library, over a synthetic
+ * signal: noise with a bat-like FM sweep every 100 ms. Each is reported as host time
+ * per second of audio, so a change to a module shows up as a change in its line. Host
+ * timings only show relative cost; the logger's CPU is a lot slower and has no cache
+ * to speak of. The last line writes the signal to a wav file on the in-memory card and
+ * reports what the card was asked to do.
+ *
+ * With -i, the signal is the first channel of a recording instead. The trigger is timed
+ * with both its q15 and float pipelines, and then the two are compared as the signal is
+ * turned down: how many half frames each still triggers on, to show which holds on to
+ * quiet calls for longer.
+ *
+ * With -w, the signal is written to a wav file as well, as input for virtual_logger.
+ *
+ * Usage: core_bench [-r sampling_rate_hz] [-s seconds] [-i recording.wav] [-o image] [-w signal.wav] [settings.json]
+ */
+
+#define MAX_SETTINGS_LEN (64 * 1024)
+
+static sample_type_t *s_signal;
+static int s_signal_len;
+static int s_sampling_rate = 384000;
+static double s_seconds = 10;
+static volatile uint32_t s_sink;
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, double seconds)
+{
+	printf("%-24s %10.1f us per s of audio %8.3f%% of real time\n", name,
+			seconds * 1e6 / s_seconds, seconds * 100 / s_seconds);
+}
+
+/**
+ * The first channel of a 16 bit PCM file, as the signal.
+ */
+static bool read_signal(const char *path)
+{
+	wav_info_t info;
+	int16_t *pFrames = wav_read(path, &info);
+	if (!pFrames)
+		return false;
+	if (info.frame_count == 0) {
+		fprintf(stderr, "%s: no samples\n", path);
+		free(pFrames);
+		return false;
+	}
+
+	s_sampling_rate = info.sampling_rate;
+	s_signal_len = (int) info.frame_count;
+	s_signal = malloc(s_signal_len * sizeof(sample_type_t));
+	for (int i = 0; i < s_signal_len; i++)
+		s_signal[i] = pFrames[i * info.channels];
+	free(pFrames);
+	s_seconds = (double) s_signal_len / s_sampling_rate;
+	return true;
+}
+
+static void make_signal(void)
+{
+	s_signal_len = (int) (s_sampling_rate * s_seconds);
+	s_signal = malloc(s_signal_len * sizeof(sample_type_t));
+	if (!s_signal) {
+		fprintf(stderr, "out of memory\n");
+		exit(2);
+	}
+
+	// 80 kHz down to 40 kHz over 5 ms, every 100 ms, in noise:
+	const int period = s_sampling_rate / 10, call_len = s_sampling_rate / 200;
+	double phase = 0;
+	unsigned seed = 1;
+	for (int i = 0; i < s_signal_len; i++) {
+		seed = seed * 1103515245u + 12345u;
+		double v = ((int) (seed >> 16 & 0x7fff) - 0x4000) / 512.0;
+		const int t = i % period;
+		if (t < call_len) {
+			const double f = 80000 - 40000.0 * t / call_len;
+			phase += 2 * M_PI * f / s_sampling_rate;
+			v += 8000 * sin(phase);
+		}
+		s_signal[i] = (sample_type_t) v;
+	}
+}
+
+static void select_trigger_pipeline(trigger_pipeline_t pipeline)
+{
+	settings_t settings = *settings_get();
+	settings.trigger_pipeline = pipeline;
+	int profile_count;
+	const settings_profile_t *pProfiles = settings_get_profiles(&profile_count);
+	settings_restore(&settings, pProfiles, profile_count);
+	runtime_config_update();
+}
+
+/**
+ * The trigger as main processing sees it: a half frame at a time, 1 ms frames.
+ */
+static int run_trigger(const sample_type_t *pSignal)
+{
+	const int half_frame = s_sampling_rate / 2000;
+	int triggers = 0;
+	g_raw_half_frame_size = half_frame;
+	for (int i = 0; i + half_frame <= s_signal_len; i += half_frame) {
+		g_raw_half_frame = (sample_type_t *) pSignal + i;
+		g_raw_half_frame_counter++;
+		g_raw_half_frame_ready = true;
+		trigger_main_fast_processing(0);
+		if (g_trigger_triggered) {
+			g_trigger_triggered = false;
+			triggers++;
+		}
+	}
+	return triggers;
+}
+
+static void bench_trigger(trigger_pipeline_t pipeline)
+{
+	select_trigger_pipeline(pipeline);
+	const double start = now_s();
+	const int triggers = run_trigger(s_signal);
+	report(pipeline == TRIGGER_PIPELINE_FLOAT ? "trigger float" : "trigger q15", now_s() - start);
+	printf("%-24s %d half frames triggered\n", "", triggers);
+}
+
+/**
+ * Turn the signal down 6 dB at a time, and see how long each trigger pipeline keeps
+ * finding the calls in it.
+ */
+static void compare_trigger_sensitivity(void)
+{
+	sample_type_t *pQuieter = malloc(s_signal_len * sizeof(sample_type_t));
+	printf("%-24s %10s %10s\n", "half frames triggered", "q15", "float");
+	for (int db = 0; db <= 48; db += 6) {
+		const double gain = pow(10, -db / 20.0);
+		for (int i = 0; i < s_signal_len; i++)
+			pQuieter[i] = (sample_type_t) lrint(s_signal[i] * gain);
+		select_trigger_pipeline(TRIGGER_PIPELINE_Q15);
+		const int q15 = run_trigger(pQuieter);
+		select_trigger_pipeline(TRIGGER_PIPELINE_FLOAT);
+		const int f32 = run_trigger(pQuieter);
+		printf("%18d dB down %10d %10d\n", db, q15, f32);
+	}
+	free(pQuieter);
+}
+
+/**
+ * The copy into the recording buffers the ADC interrupt does, draining them as
+ * recording would.
+ */
+static void bench_buffers(void)
+{
+	const int half_frame = s_sampling_rate / 2000;
+	data_processor_buffers_reset(DATA_PROCESSOR_CONTINUOUS, s_sampling_rate);
+	const double start = now_s();
+	for (int i = 0; i + half_frame <= s_signal_len; i += half_frame) {
+		data_processor_buffers(s_signal + i, 0, half_frame);
+		sample_type_t *pBuffer;
+		dataprocessor_buffers_get_next(&pBuffer);
+	}
+	report("data_processor_buffers", now_s() - start);
+}
+
+static void bench_mag_squared(void)
+{
+	// What the trigger does with each 32 point FFT, twice per half frame:
+	static q15_t fft_output[32];
+	static q31_t squared[16];
+	for (int i = 0; i < 32; i++)
+		fft_output[i] = s_signal[i];
+	const int calls = 2 * (s_signal_len / (s_sampling_rate / 2000));
+	const double start = now_s();
+	for (int i = 0; i < calls; i++) {
+		cmplx_mag_squared_q15_q31(fft_output, squared, 16);
+		s_sink += squared[i & 15];
+	}
+	report("cmplx_mag_squared", now_s() - start);
+}
+
+static void bench_verify(void)
+{
+	verify_reset(s_sampling_rate);
+	const double start = now_s();
+	for (int i = 0; i < s_signal_len; i += DATA_BUFFER_ENTRIES)
+		verify_process(s_signal + i, MIN(DATA_BUFFER_ENTRIES, s_signal_len - i));
+	report("verify", now_s() - start);
+	printf("%-24s %d calls, %s\n", "", verify_get_call_count(), verify_passed() ? "passed" : "failed");
+}
+
+static void count_bytes(void *context, const uint8_t *data, int len)
+{
+	UNUSED(data);
+	*(int*) context += len;
+}
+
+static void bench_zc(void)
+{
+	int bytes = 0;
+	zc_reset(s_sampling_rate, count_bytes, &bytes);
+	const double start = now_s();
+	for (int i = 0; i < s_signal_len; i += DATA_BUFFER_ENTRIES)
+		zc_process(s_signal + i, MIN(DATA_BUFFER_ENTRIES, s_signal_len - i));
+	zc_flush();
+	report("zc", now_s() - start);
+	printf("%-24s %d bytes of Anabat data\n", "", bytes);
+}
+
+static void count_samples(void *context, int16_t *pSamples, int count)
+{
+	UNUSED(pSamples);
+	*(int*) context += count;
+}
+
+static void bench_baseband(void)
+{
+	int samples = 0;
+	baseband_reset(s_sampling_rate, count_samples, &samples);
+	const double start = now_s();
+	for (int i = 0; i < s_signal_len; i += DATA_BUFFER_ENTRIES)
+		baseband_process(s_signal + i, MIN(DATA_BUFFER_ENTRIES, s_signal_len - i));
+	baseband_flush();
+	report("baseband", now_s() - start);
+	printf("%-24s %d I and Q values at %d Hz\n", "", samples, baseband_get_output_rate());
+}
+
+static bool bench_storage(void)
+{
+	// 32 GB, which costs only what is written:
+	if (!core_sd_create(64ull * 1024 * 1024)) {
+		fprintf(stderr, "failed to format the card\n");
+		return false;
+	}
+
+	const double start = now_s();
+	FX_MEDIA *pMedium = storage_mount(STORAGE_FAST);
+	FX_FILE file;
+	if (!pMedium || !storage_open_wav_file(pMedium, &file, s_sampling_rate, "bench")) {
+		fprintf(stderr, "failed to open a wav file\n");
+		return false;
+	}
+	for (int i = 0; i < s_signal_len; i += DATA_BUFFER_ENTRIES)
+		storage_wav_file_append_data(&file, s_signal + i, MIN(DATA_BUFFER_ENTRIES, s_signal_len - i));
+	storage_close_wav_file(pMedium, &file);
+	storage_unmount(true);
+	report("wav to SD", now_s() - start);
+
+	core_sd_stats_t stats;
+	core_sd_get_stats(&stats);
+	printf("%-24s %s.wav: %lu blocks in %lu writes (%lu out of sequence), %lu blocks in %lu reads\n", "",
+			storage_get_last_wav_base_name(), (unsigned long) stats.blocks_written,
+			(unsigned long) stats.write_commands, (unsigned long) stats.nonsequential_writes,
+			(unsigned long) stats.blocks_read, (unsigned long) stats.read_commands);
+	return true;
+}
+
+static bool load_settings(const char *path)
+{
+	static char json[MAX_SETTINGS_LEN + 1];
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return false;
+	}
+	const size_t len = fread(json, 1, MAX_SETTINGS_LEN, f);
+	fclose(f);
+	json[len] = '\0';
+	if (!settings_parse_and_process_json_settings(json)) {
+		fprintf(stderr, "%s: invalid settings\n", path);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *image_path = NULL;
+	const char *signal_path = NULL;
+	const char *signal_out_path = NULL;
+	int i = 1;
+	for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+		if (strcmp(argv[i], "-r") == 0)
+			s_sampling_rate = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-s") == 0)
+			s_seconds = atof(argv[i + 1]);
+		else if (strcmp(argv[i], "-i") == 0)
+			signal_path = argv[i + 1];
+		else if (strcmp(argv[i], "-o") == 0)
+			image_path = argv[i + 1];
+		else if (strcmp(argv[i], "-w") == 0)
+			signal_out_path = argv[i + 1];
+		else
+			break;
+	}
+	if (i + 1 < argc || (i < argc && argv[i][0] == '-') || s_sampling_rate < 8000 || s_seconds <= 0) {
+		fprintf(stderr, "usage: %s [-r sampling_rate_hz] [-s seconds] [-i recording.wav] [-o image] [-w signal.wav] [settings.json]\n", argv[0]);
+		return 2;
+	}
+
+	g_core_now = 1750000000;		// Mid June 2025.
+	settings_init();
+	if (i < argc) {
+		if (!load_settings(argv[i]))
+			return 2;
+	}
+	else {
+		// The defaults, with the fields worked out from them, as the logger would have:
+		settings_parse_and_process_json_settings("{}");
+	}
+
+	gain_init();
+	gain_set(settings_get()->sensitivity_range, false);
+	trigger_init();
+	agc_init();
+	verify_init();
+	zc_init();
+	baseband_init();
+	storage_init();
+
+	if (signal_path) {
+		if (!read_signal(signal_path))
+			return 2;
+	}
+	else
+		make_signal();
+	if (signal_out_path && !wav_write(signal_out_path, 1, s_sampling_rate, s_signal, s_signal_len, NULL))
+		return 1;
+	printf("%d Hz, %.1f s of audio\n", s_sampling_rate, s_seconds);
+	const trigger_pipeline_t pipeline = settings_get()->trigger_pipeline;
+	bench_trigger(TRIGGER_PIPELINE_Q15);
+	bench_trigger(TRIGGER_PIPELINE_FLOAT);
+	compare_trigger_sensitivity();
+	select_trigger_pipeline(pipeline);
+	bench_buffers();
+	bench_mag_squared();
+	bench_verify();
+	bench_zc();
+	bench_baseband();
+	if (!bench_storage())
+		return 1;
+
+	if (image_path && !core_sd_save(image_path)) {
+		perror(image_path);
+		return 1;
+	}
+	return 0;
+}
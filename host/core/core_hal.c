@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "main.h"
+#include "rtc.h"
+#include "spi.h"
+#include "core_host.h"
+
+/*
+ * The clock, and the parts of the HAL that the core modules call that aren't the SD card.
+ * The RTC holds UTC broken down time, as the firmware expects.
+ */
+
+time_t g_core_now = 0;
+uint32_t g_core_tick_ms = 0;
+
+RTC_HandleTypeDef hrtc;
+SPI_HandleTypeDef hspi1;
+ADC_HandleTypeDef hadc1;
+DWT_Type g_host_dwt;
+
+void Error_Handler(void)
+{
+	fprintf(stderr, "Error_Handler called\n");
+	exit(3);
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+	g_core_tick_ms += Delay;
+}
+
+uint32_t HAL_GetTick(void)
+{
+	return g_core_tick_ms;
+}
+
+void HAL_SuspendTick(void) {}
+void HAL_ResumeTick(void) {}
+void HAL_DBGMCU_EnableDBGStandbyMode(void) {}
+void HAL_DBGMCU_EnableDBGStopMode(void) {}
+
+uint8_t RTC_ByteToBcd2(uint8_t Value)
+{
+	return (uint8_t) (((Value / 10) << 4) | (Value % 10));
+}
+
+uint8_t RTC_Bcd2ToByte(uint8_t Value)
+{
+	return (uint8_t) (((Value >> 4) * 10) + (Value & 0x0F));
+}
+
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format)
+{
+	UNUSED(hrtc);
+	struct tm tm;
+	gmtime_r(&g_core_now, &tm);
+	memset(sTime, 0, sizeof(*sTime));
+	sTime->Hours = tm.tm_hour;
+	sTime->Minutes = tm.tm_min;
+	sTime->Seconds = tm.tm_sec;
+	if (Format == RTC_FORMAT_BCD) {
+		sTime->Hours = RTC_ByteToBcd2(sTime->Hours);
+		sTime->Minutes = RTC_ByteToBcd2(sTime->Minutes);
+		sTime->Seconds = RTC_ByteToBcd2(sTime->Seconds);
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format)
+{
+	UNUSED(hrtc);
+	struct tm tm;
+	gmtime_r(&g_core_now, &tm);
+	sDate->Year = tm.tm_year - 100;
+	sDate->Month = tm.tm_mon + 1;
+	sDate->Date = tm.tm_mday;
+	sDate->WeekDay = tm.tm_wday == 0 ? 7 : tm.tm_wday;
+	if (Format == RTC_FORMAT_BCD) {
+		sDate->Year = RTC_ByteToBcd2(sDate->Year);
+		sDate->Month = RTC_ByteToBcd2(sDate->Month);
+		sDate->Date = RTC_ByteToBcd2(sDate->Date);
+	}
+	return HAL_OK;
+}
+
+// Gain changes go to the amplifier over SPI; gain.c keeps its own note of the setting.
+HAL_StatusTypeDef HAL_SPI_Transmit_IT(SPI_HandleTypeDef *hspi, const uint8_t *pData, uint16_t Size)
+{
+	UNUSED(hspi);
+	UNUSED(pData);
+	UNUSED(Size);
+	return HAL_OK;
+}
@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_CORE_HOST_H
+#define MY_CORE_HOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * What host/core puts in place of the hardware, for tools that link the core library:
+ * a clock for the RTC and HAL tick, an SD card in memory under the real FileX driver,
+ * and a record of the events the modules post. Nothing here runs by itself; the tool
+ * moves the clock on and feeds the modules data.
+ */
+
+extern time_t g_core_now;				// RTC time, UTC, as a unix epoch.
+extern uint32_t g_core_tick_ms;			// HAL_GetTick().
+
+/*
+ * Counts of what the card has been asked to do, for modelling how long it would have
+ * taken. A command is one ReadBlocks or WriteBlocks call, however many blocks it covers.
+ */
+typedef struct {
+	uint32_t read_commands;
+	uint32_t write_commands;
+	uint64_t blocks_read;
+	uint64_t blocks_written;
+	uint32_t nonsequential_writes;		// Writes that didn't follow on from the last one.
+	uint64_t busy_us;					// Modelled time the card was busy, from core_sd_timing_t.
+	uint32_t longest_busy_us;			// The longest single command.
+} core_sd_stats_t;
+
+/*
+ * How long the card takes over each command: a fixed overhead per command and a time
+ * per block. Every so many blocks written, the card also goes away for a while to erase
+ * and tidy up, as real cards do. All zeros, the default, makes transfers take no time.
+ */
+typedef struct {
+	uint32_t read_command_us;
+	uint32_t write_command_us;
+	uint32_t read_block_ns;
+	uint32_t write_block_ns;
+	uint32_t stall_interval_blocks;		// 0 for no stalls.
+	uint32_t stall_us;
+} core_sd_timing_t;
+
+// Called with the modelled time of each command before it completes, so a tool can move
+// its clock on and deliver the interrupts that would have arrived in the meantime:
+typedef void (*core_sd_busy_handler_t)(uint32_t busy_us);
+
+bool core_sd_create(uint64_t block_count);
+bool core_sd_load(const char *path);
+bool core_sd_save(const char *path);
+void core_sd_destroy(void);
+void core_sd_set_present(bool present);
+void core_sd_get_stats(core_sd_stats_t *pStats);
+void core_sd_reset_stats(void);
+void core_sd_set_timing(const core_sd_timing_t *pTiming, core_sd_busy_handler_t handler);
+
+uint32_t core_take_events(void);
+
+#endif // MY_CORE_HOST_H
@@ -0,0 +1,284 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "main.h"
+#include "sdmmc.h"
+#include "sd_lowlevel.h"
+#include "fx_api.h"
+#include "fx_stm32_sd_driver.h"
+#include "core_host.h"
+
+/*
+ * An SD card in memory, at the level of the HAL calls the FileX driver's glue makes, so
+ * the real driver and all of FileX run above it. Transfers complete at once and call the
+ * completion callbacks the way the DMA interrupt would, after telling the tool how long
+ * they would have taken if it has given us a timing model. Memory is allocated a chunk at a
+ * time as it is written, so a full sized card costs only what has been written to it.
+ */
+
+#define BLOCKS_PER_CHUNK 2048		// 1 MB.
+#define CHUNK_BYTES (BLOCKS_PER_CHUNK * BLOCKSIZE)
+
+SD_HandleTypeDef hsd1;
+
+static uint8_t **s_chunks = NULL;
+static uint64_t s_block_count = 0;
+static uint64_t s_chunk_count = 0;
+static bool s_present = true;
+static core_sd_stats_t s_stats;
+static uint64_t s_next_write_block = 0;
+static core_sd_timing_t s_timing;
+static core_sd_busy_handler_t s_busy_handler = NULL;
+static uint64_t s_blocks_since_stall = 0;
+
+static bool is_zero(const uint8_t *pData, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		if (pData[i])
+			return false;
+	return true;
+}
+
+static bool allocate(uint64_t block_count)
+{
+	core_sd_destroy();
+	s_chunk_count = (block_count + BLOCKS_PER_CHUNK - 1) / BLOCKS_PER_CHUNK;
+	s_chunks = calloc(s_chunk_count, sizeof(uint8_t*));
+	s_block_count = s_chunks ? block_count : 0;
+	core_sd_reset_stats();
+	return s_chunks != NULL;
+}
+
+/**
+ * Writes to blocks nobody has written to yet that are all zeros, as formatting does
+ * a lot of, don't need memory.
+ */
+static void write_block(uint64_t block, const uint8_t *pData)
+{
+	uint8_t **ppChunk = &s_chunks[block / BLOCKS_PER_CHUNK];
+	if (!*ppChunk) {
+		if (is_zero(pData, BLOCKSIZE))
+			return;
+		*ppChunk = calloc(1, CHUNK_BYTES);
+		if (!*ppChunk) {
+			fprintf(stderr, "out of memory for the SD card\n");
+			exit(3);
+		}
+	}
+	memcpy(*ppChunk + (block % BLOCKS_PER_CHUNK) * BLOCKSIZE, pData, BLOCKSIZE);
+}
+
+static void read_block(uint64_t block, uint8_t *pData)
+{
+	const uint8_t *pChunk = s_chunks[block / BLOCKS_PER_CHUNK];
+	if (pChunk)
+		memcpy(pData, pChunk + (block % BLOCKS_PER_CHUNK) * BLOCKSIZE, BLOCKSIZE);
+	else
+		memset(pData, 0, BLOCKSIZE);
+}
+
+/**
+ * A new card, formatted exFAT with the cluster size and alignment an SD card of that
+ * size would come with.
+ */
+bool core_sd_create(uint64_t block_count)
+{
+	if (!allocate(block_count))
+		return false;
+
+	static FX_MEDIA medium;
+	static UCHAR working_memory[BLOCKSIZE];
+	const UINT sectors_per_cluster = block_count > 64 * 1024 * 1024 ? 256 : 64;
+	fx_system_initialize();
+	const UINT status = fx_media_exFAT_format(&medium, fx_stm32_sd_driver, NULL, working_memory,
+			sizeof(working_memory), "BATGIZMO", 1, 0, block_count, BLOCKSIZE, sectors_per_cluster,
+			0x12345678, 8192);
+	core_sd_reset_stats();
+	return status == FX_SUCCESS;
+}
+
+/**
+ * Uses an existing image as the card, such as one made with dd from a real card.
+ */
+bool core_sd_load(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f)
+		return false;
+	fseek(f, 0, SEEK_END);
+	const long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	bool ok = len > 0 && allocate(len / BLOCKSIZE);
+
+	uint8_t block[BLOCKSIZE];
+	for (uint64_t i = 0; ok && i < s_block_count; i++) {
+		ok = fread(block, 1, BLOCKSIZE, f) == BLOCKSIZE;
+		write_block(i, block);
+	}
+	fclose(f);
+	core_sd_reset_stats();
+	return ok;
+}
+
+/**
+ * Saves the card as an image that can be mounted or copied to a card. Chunks that were
+ * never written are left as holes, so on most file systems the file is sparse.
+ */
+bool core_sd_save(const char *path)
+{
+	FILE *f = fopen(path, "wb");
+	if (!f)
+		return false;
+	bool ok = true;
+	for (uint64_t i = 0; ok && i < s_chunk_count; i++) {
+		if (s_chunks[i]) {
+			const uint64_t blocks = MIN(BLOCKS_PER_CHUNK, s_block_count - i * BLOCKS_PER_CHUNK);
+			ok = fseek(f, (long) (i * CHUNK_BYTES), SEEK_SET) == 0
+					&& fwrite(s_chunks[i], BLOCKSIZE, blocks, f) == blocks;
+		}
+	}
+	ok = fflush(f) == 0 && ftruncate(fileno(f), (off_t) (s_block_count * BLOCKSIZE)) == 0 && ok;
+	return fclose(f) == 0 && ok;
+}
+
+void core_sd_destroy(void)
+{
+	for (uint64_t i = 0; s_chunks && i < s_chunk_count; i++)
+		free(s_chunks[i]);
+	free(s_chunks);
+	s_chunks = NULL;
+	s_chunk_count = 0;
+	s_block_count = 0;
+}
+
+void core_sd_set_present(bool present)
+{
+	s_present = present;
+}
+
+void core_sd_get_stats(core_sd_stats_t *pStats)
+{
+	*pStats = s_stats;
+}
+
+void core_sd_reset_stats(void)
+{
+	memset(&s_stats, 0, sizeof(s_stats));
+	s_next_write_block = 0;
+	s_blocks_since_stall = 0;
+}
+
+void core_sd_set_timing(const core_sd_timing_t *pTiming, core_sd_busy_handler_t handler)
+{
+	if (pTiming)
+		s_timing = *pTiming;
+	else
+		memset(&s_timing, 0, sizeof(s_timing));
+	s_busy_handler = handler;
+}
+
+static void note_busy(uint32_t command_us, uint32_t block_ns, uint32_t blocks, bool is_write)
+{
+	uint32_t busy_us = command_us + (uint32_t) (((uint64_t) block_ns * blocks) / 1000);
+	if (is_write && s_timing.stall_interval_blocks) {
+		s_blocks_since_stall += blocks;
+		if (s_blocks_since_stall >= s_timing.stall_interval_blocks) {
+			s_blocks_since_stall -= s_timing.stall_interval_blocks;
+			busy_us += s_timing.stall_us;
+		}
+	}
+	s_stats.busy_us += busy_us;
+	s_stats.longest_busy_us = MAX(s_stats.longest_busy_us, busy_us);
+	if (s_busy_handler && busy_us)
+		s_busy_handler(busy_us);
+}
+
+HAL_SD_CardStateTypeDef HAL_SD_GetCardState(SD_HandleTypeDef *hsd)
+{
+	UNUSED(hsd);
+	if (s_present && s_chunks)
+		return HAL_SD_CARD_TRANSFER;
+
+	// The driver polls this until its timeout on HAL_GetTick(), which only moves when the
+	// tool moves it, so let time pass while it waits:
+	g_core_tick_ms++;
+	return HAL_SD_CARD_ERROR;
+}
+
+HAL_StatusTypeDef HAL_SD_ReadBlocks_DMA(SD_HandleTypeDef *hsd, uint8_t *pData, uint32_t BlockAdd, uint32_t NumberOfBlocks)
+{
+	if (!s_present || (uint64_t) BlockAdd + NumberOfBlocks > s_block_count)
+		return HAL_ERROR;
+	for (uint32_t i = 0; i < NumberOfBlocks; i++)
+		read_block(BlockAdd + i, pData + i * BLOCKSIZE);
+	s_stats.read_commands++;
+	s_stats.blocks_read += NumberOfBlocks;
+	note_busy(s_timing.read_command_us, s_timing.read_block_ns, NumberOfBlocks, false);
+	HAL_SD_RxCpltCallback(hsd);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SD_WriteBlocks_DMA(SD_HandleTypeDef *hsd, const uint8_t *pData, uint32_t BlockAdd, uint32_t NumberOfBlocks)
+{
+	if (!s_present || (uint64_t) BlockAdd + NumberOfBlocks > s_block_count)
+		return HAL_ERROR;
+	for (uint32_t i = 0; i < NumberOfBlocks; i++)
+		write_block(BlockAdd + i, pData + i * BLOCKSIZE);
+	s_stats.write_commands++;
+	s_stats.blocks_written += NumberOfBlocks;
+	if (BlockAdd != s_next_write_block)
+		s_stats.nonsequential_writes++;
+	s_next_write_block = (uint64_t) BlockAdd + NumberOfBlocks;
+	note_busy(s_timing.write_command_us, s_timing.write_block_ns, NumberOfBlocks, true);
+	HAL_SD_TxCpltCallback(hsd);
+	return HAL_OK;
+}
+
+/**
+ * The only pin the core modules read is card detect, which is low when there is a card.
+ */
+GPIO_PinState HAL_GPIO_ReadPin(const GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	if (GPIOx == GPIO_SD_DETECT_GPIO_Port && GPIO_Pin == GPIO_SD_DETECT_Pin)
+		return s_present ? GPIO_PIN_RESET : GPIO_PIN_SET;
+	return GPIO_PIN_RESET;
+}
+
+// In place of sd_lowlevel.c, which powers the card and sets up SDMMC1:
+bool sd_lowlevel_open(storage_write_type_t write_type)
+{
+	UNUSED(write_type);
+	hsd1.ErrorCode = HAL_SD_ERROR_NONE;
+	return s_present && s_chunks;
+}
+
+void sd_lowlevel_close(void)
+{
+}
+
+bool sd_lowlevel_get_debounced_sd_present(void)
+{
+	return s_present;
+}
@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <strings.h>
+#include "main.h"
+#include "data_acquisition.h"
+#include "leds.h"
+#include "events.h"
+#include "profiler.h"
+#include "core_host.h"
+
+/*
+ * Stand ins for the firmware modules that drive hardware directly, which the core
+ * modules call but which have nothing to do on a PC.
+ */
+
+// newlib has this, glibc doesn't:
+int stricmp(const char *s1, const char *s2)
+{
+	return strcasecmp(s1, s2);
+}
+
+void leds_set(int led, bool lit)
+{
+	UNUSED(led);
+	UNUSED(lit);
+}
+
+void leds_blink(leds_led_t led)
+{
+	UNUSED(led);
+}
+
+void leds_start_flash(void) {}
+void leds_reset(void) {}
+
+static uint32_t s_pending_events = 0;
+
+void events_post(uint32_t events)
+{
+	s_pending_events |= events;
+}
+
+/**
+ * The events posted since the last call, for tools that run the main loop.
+ */
+uint32_t core_take_events(void)
+{
+	const uint32_t events = s_pending_events;
+	s_pending_events = 0;
+	return events;
+}
+
+// There's no cycle counter to profile with, so profile files are empty:
+void profiler_record(profile_id_t id, uint32_t cycles)
+{
+	UNUSED(id);
+	UNUSED(cycles);
+}
+
+size_t profiler_get_report_header(char *buf, size_t buflen)
+{
+	UNUSED(buf);
+	UNUSED(buflen);
+	return 0;
+}
+
+size_t profiler_get_report_line(profile_id_t id, char *buf, size_t buflen)
+{
+	UNUSED(id);
+	UNUSED(buf);
+	UNUSED(buflen);
+	return 0;
+}
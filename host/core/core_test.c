@@ -0,0 +1,481 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "settings.h"
+#include "trigger.h"
+#include "data_processor_buffers.h"
+#include "runtime_config.h"
+#include "verify.h"
+#include "classify.h"
+#include "storage.h"
+#include "gain.h"
+#include "storm.h"
+#include "core_host.h"
+#include "wav_io.h"
+
+/*
+ * Checks on the core modules with the core library, for ctest: the settings parser and
+ * profiles, the runtime configuration built from them, the trigger in both its pipelines,
+ * the recording buffers around a trigger, verification and classification of calls, the
+ * host tools' wav reader and writer, and a wav file written to the in-memory card and read
+ * back. Each failed check is reported
+ * with its line, and the exit status is 1 if any failed.
+ *
+ * Usage: core_test
+ */
+
+#define SAMPLING_RATE 384000
+#define HALF_FRAME (SAMPLING_RATE / 2000)
+#define SIGNAL_SECONDS 4
+
+static int s_checks = 0, s_failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static void check(bool ok, const char *text, int line)
+{
+	s_checks++;
+	if (!ok) {
+		fprintf(stderr, "core_test.c:%d: check failed: %s\n", line, text);
+		s_failures++;
+	}
+}
+
+static sample_type_t s_signal[SAMPLING_RATE * SIGNAL_SECONDS];
+static const int s_signal_len = SAMPLING_RATE * SIGNAL_SECONDS;
+
+/**
+ * Noise at noise_amplitude, with a call at call_amplitude sweeping from start_hz to end_hz
+ * over call_ms, every period_ms. Either amplitude can be 0.
+ */
+static void make_calls(double noise_amplitude, double call_amplitude, double start_hz, double end_hz,
+		double call_ms, double period_ms)
+{
+	const int period = (int) (SAMPLING_RATE * period_ms / 1000), call_len = (int) (SAMPLING_RATE * call_ms / 1000);
+	double phase = 0;
+	unsigned seed = 1;
+	for (int i = 0; i < s_signal_len; i++) {
+		seed = seed * 1103515245u + 12345u;
+		double v = ((int) (seed >> 16 & 0x7fff) - 0x4000) * noise_amplitude / 0x4000;
+		const int t = i % period;
+		if (t < call_len) {
+			const double f = start_hz + (end_hz - start_hz) * t / call_len;
+			phase += 2 * M_PI * f / SAMPLING_RATE;
+			v += call_amplitude * sin(phase);
+		}
+		s_signal[i] = (sample_type_t) lrint(v);
+	}
+}
+
+/**
+ * core_bench's signal: an 80 to 40 kHz sweep of 5 ms every 100 ms.
+ */
+static void make_signal(double noise_amplitude, double call_amplitude)
+{
+	make_calls(noise_amplitude, call_amplitude, 80000, 40000, 5, 100);
+}
+
+static void select_trigger_pipeline(trigger_pipeline_t pipeline)
+{
+	settings_t settings = *settings_get();
+	settings.trigger_pipeline = pipeline;
+	int profile_count;
+	const settings_profile_t *pProfiles = settings_get_profiles(&profile_count);
+	settings_restore(&settings, pProfiles, profile_count);
+	runtime_config_update();
+}
+
+/**
+ * The trigger over the signal as main processing sees it, a half frame at a time. Returns
+ * how many half frames it triggered on.
+ */
+static int run_trigger(void)
+{
+	int triggers = 0;
+	g_raw_half_frame_size = HALF_FRAME;
+	for (int i = 0; i + HALF_FRAME <= s_signal_len; i += HALF_FRAME) {
+		g_raw_half_frame = s_signal + i;
+		g_raw_half_frame_counter++;
+		g_raw_half_frame_ready = true;
+		trigger_main_fast_processing(0);
+		if (g_trigger_triggered) {
+			g_trigger_triggered = false;
+			triggers++;
+		}
+	}
+	return triggers;
+}
+
+static void test_settings(void)
+{
+	// The defaults, with the fields worked out from them:
+	CHECK(settings_parse_and_process_json_settings("{}"));
+	CHECK(settings_get_logger_sampling_rate() == 384000);
+	CHECK(settings_get()->trigger_pipeline == TRIGGER_PIPELINE_Q15);
+	CHECK(settings_get()->_trigger_flags[0] == false);
+	CHECK(settings_get()->_trigger_flags[1] == true);
+
+	// Nothing changes unless all of it is valid:
+	CHECK(!settings_parse_and_process_json_settings("{ \"trigger_pipeline\":\"float\", "));
+	CHECK(settings_get()->trigger_pipeline == TRIGGER_PIPELINE_Q15);
+
+	CHECK(settings_parse_and_process_json_settings(
+			"{ \"trigger_pipeline\":\"float\", \"pretrigger_time_s\":1.0, \"min_sampling_time_s\":2.0,"
+			" \"hangover_time_s\":1.0,"
+			" \"profiles\": { \"noctule\": { \"logger_sampling_rate_index\":5, \"trigger_pipeline\":\"q15\" } } }"));
+	CHECK(settings_get()->trigger_pipeline == TRIGGER_PIPELINE_FLOAT);
+	const int noctule = settings_find_profile("noctule");
+	CHECK(noctule >= 0);
+	CHECK(settings_find_profile("pipistrelle") < 0);
+
+	// A profile overrides only what it names:
+	settings_select_profile(noctule);
+	CHECK(settings_get_logger_sampling_rate() == 240000);
+	CHECK(settings_get()->trigger_pipeline == TRIGGER_PIPELINE_Q15);
+	CHECK(settings_get()->pretrigger_time_s == 1.0f);
+	settings_select_profile(SETTINGS_NO_PROFILE);
+	CHECK(settings_get_logger_sampling_rate() == 384000);
+	CHECK(settings_get()->trigger_pipeline == TRIGGER_PIPELINE_FLOAT);
+
+	// And the copy written to the card says so:
+	static char json[8192];
+	CHECK(settings_get_json_settings_string(json, sizeof(json)) > 0);
+	CHECK(strstr(json, "\"trigger_pipeline\":\"float\"") != NULL);
+}
+
+static void test_runtime_config(void)
+{
+	data_processor_buffers_reset(DATA_PROCESSOR_TRIGGERED, SAMPLING_RATE);
+	const runtime_config_t *pc = runtime_config_get();
+	CHECK(pc->trigger_pipeline == TRIGGER_PIPELINE_FLOAT);
+	CHECK(pc->buffers_per_second == SAMPLING_RATE / DATA_BUFFER_ENTRIES);
+	CHECK(pc->pretrigger_buffers == pc->buffers_per_second);
+	CHECK(pc->min_sampling_buffers == 2 * pc->buffers_per_second);
+	CHECK(pc->hangover_buffers == pc->buffers_per_second);
+
+	// Buckets 1 to 9 take part, and the others never trigger:
+	CHECK(pc->trigger_bucket_mask == 0x3fe);
+	CHECK(pc->trigger_thresholds[0] == INT32_MAX);
+	CHECK(isinf(pc->trigger_thresholds_f32[15]));
+
+	// A change makes a new configuration, and leaves the one taken before alone:
+	select_trigger_pipeline(TRIGGER_PIPELINE_Q15);
+	CHECK(runtime_config_get() != pc);
+	CHECK(runtime_config_get()->trigger_pipeline == TRIGGER_PIPELINE_Q15);
+	CHECK(pc->trigger_pipeline == TRIGGER_PIPELINE_FLOAT);
+
+	// The thresholds are for the most sensitive range, and come down by twice as many bits
+	// as the gain does:
+	const q31_t raw = settings_get()->_trigger_thresholds[1];
+	for (int range = GAIN_MIN_RANGE_INDEX; range <= GAIN_MAX_RANGE_INDEX; range++) {
+		gain_set(range, false);
+		const int shift = gain_shift_for_range(GAIN_MAX_RANGE_INDEX) - gain_shift_for_range(range);
+		CHECK(runtime_config_get()->trigger_thresholds[1] == (raw >> shift) >> shift);
+	}
+	gain_set(settings_get()->sensitivity_range, false);
+}
+
+static void test_trigger(void)
+{
+	make_signal(0, 0);
+	select_trigger_pipeline(TRIGGER_PIPELINE_Q15);
+	CHECK(run_trigger() == 0);
+	select_trigger_pipeline(TRIGGER_PIPELINE_FLOAT);
+	CHECK(run_trigger() == 0);
+
+	// Quiet noise on its own shouldn't trigger either:
+	make_signal(64, 0);
+	select_trigger_pipeline(TRIGGER_PIPELINE_Q15);
+	CHECK(run_trigger() == 0);
+	select_trigger_pipeline(TRIGGER_PIPELINE_FLOAT);
+	CHECK(run_trigger() == 0);
+
+	// Loud calls trigger in about the half frames they are in, with either pipeline:
+	make_signal(64, 8000);
+	const int calls = SIGNAL_SECONDS * 10;
+	const int call_half_frames = calls * ((SAMPLING_RATE / 200) / HALF_FRAME + 1);
+	select_trigger_pipeline(TRIGGER_PIPELINE_Q15);
+	const int q15 = run_trigger();
+	select_trigger_pipeline(TRIGGER_PIPELINE_FLOAT);
+	const int f32 = run_trigger();
+	CHECK(q15 >= calls && q15 <= call_half_frames);
+	CHECK(f32 >= calls && f32 <= call_half_frames);
+	CHECK(abs(q15 - f32) <= calls / 4);
+	select_trigger_pipeline(TRIGGER_PIPELINE_Q15);
+}
+
+/**
+ * Turn the calls down 6 dB at a time. The two pipelines must stay close at every level,
+ * and stop finding the calls within a step of each other once they are lost in the noise.
+ */
+static void test_trigger_sensitivity(void)
+{
+	const int calls = SIGNAL_SECONDS * 10;
+	int q15_gone_db = -1, f32_gone_db = -1;
+	for (int db = 0; db <= 60; db += 6) {
+		make_signal(32, 8000 * pow(10, -db / 20.0));
+		select_trigger_pipeline(TRIGGER_PIPELINE_Q15);
+		const int q15 = run_trigger();
+		select_trigger_pipeline(TRIGGER_PIPELINE_FLOAT);
+		const int f32 = run_trigger();
+		CHECK(abs(q15 - f32) <= calls / 4);
+		if (q15 == 0 && q15_gone_db < 0)
+			q15_gone_db = db;
+		if (f32 == 0 && f32_gone_db < 0)
+			f32_gone_db = db;
+	}
+	CHECK(q15_gone_db > 0 && f32_gone_db > 0);
+	CHECK(abs(q15_gone_db - f32_gone_db) <= 6);
+	select_trigger_pipeline(TRIGGER_PIPELINE_Q15);
+}
+
+static void test_buffers(void)
+{
+	// A ramp, so that every sample says where it came from:
+	for (int i = 0; i < s_signal_len; i++)
+		s_signal[i] = (sample_type_t) (i & 0x7fff);
+
+	data_processor_buffers_reset(DATA_PROCESSOR_TRIGGERED, SAMPLING_RATE);
+	const runtime_config_t *pc = runtime_config_get();
+	const int trigger_at_buffer = 20;
+	int32_t trigger_buffer = -1;
+	int buffers = 0, ends = 0;
+	int64_t first_position = -1;
+	bool in_order = true;
+	for (int i = 0; i + HALF_FRAME <= s_signal_len; i += HALF_FRAME) {
+		data_processor_buffers(s_signal, i, HALF_FRAME);
+		const int64_t written = data_processor_buffers_get_write_position();
+		if (trigger_buffer < 0 && written >= (int64_t) trigger_at_buffer * DATA_BUFFER_ENTRIES) {
+			trigger_buffer = (int32_t) (written / DATA_BUFFER_ENTRIES);
+			g_trigger_triggered = true;
+			data_processor_buffers_fast_main_processing(1000);
+			CHECK(data_processor_buffers_is_busy());
+		}
+
+		sample_type_t *pBuffer;
+		if (dataprocessor_buffers_get_next(&pBuffer))
+			ends++;
+		else if (pBuffer) {
+			const int64_t position = data_processor_buffers_get_read_position();
+			if (first_position < 0)
+				first_position = position;
+			else if (position != first_position + (int64_t) buffers * DATA_BUFFER_ENTRIES)
+				in_order = false;
+			if (pBuffer[0] != (sample_type_t) (position & 0x7fff)
+					|| pBuffer[DATA_BUFFER_ENTRIES - 1] != (sample_type_t) ((position + DATA_BUFFER_ENTRIES - 1) & 0x7fff))
+				in_order = false;
+			buffers++;
+		}
+	}
+
+	// The pretrigger, the buffer being filled at the trigger, and the minimum after it:
+	CHECK(trigger_buffer == trigger_at_buffer);
+	CHECK(first_position == (int64_t) (trigger_buffer - pc->pretrigger_buffers) * DATA_BUFFER_ENTRIES);
+	CHECK(buffers == pc->pretrigger_buffers + pc->min_sampling_buffers + 1);
+	CHECK(in_order);
+	CHECK(ends == 1);
+	CHECK(!data_processor_buffers_is_busy());
+	CHECK(data_processor_buffers_get_lost_count() == 0);
+}
+
+static void verify_signal(call_features_t *pFeatures)
+{
+	verify_reset(SAMPLING_RATE);
+	for (int i = 0; i < s_signal_len; i += DATA_BUFFER_ENTRIES)
+		verify_process(s_signal + i, MIN(DATA_BUFFER_ENTRIES, s_signal_len - i));
+	verify_get_features(pFeatures);
+}
+
+static void test_verify(void)
+{
+	make_signal(64, 8000);
+	call_features_t features;
+	verify_signal(&features);
+	CHECK(verify_passed());
+	CHECK(abs(features.call_count - SIGNAL_SECONDS * 10) <= 2);
+	CHECK(features.start_khz >= 70 && features.start_khz <= 84);
+	CHECK(features.end_khz >= 38 && features.end_khz <= 50);
+	CHECK(features.duration_tenths_ms >= 35 && features.duration_tenths_ms <= 55);
+	CHECK(features.calls_per_10s >= 90 && features.calls_per_10s <= 110);
+
+	// Noise alone has no calls in it:
+	make_signal(64, 0);
+	verify_signal(&features);
+	CHECK(!verify_passed());
+	CHECK(features.call_count == 0);
+}
+
+static void test_classify(void)
+{
+	// Sequences like the middle of each group in host/classifier/prototypes.csv, which the
+	// model must put in that group, and the same way every time:
+	static const struct {
+		const char *label;
+		double start_khz, end_khz, call_ms, period_ms;
+	} groups[] = {
+		{ "Pip", 70, 45, 5, 100 },
+		{ "Myo", 90, 30, 3, 83 },
+		{ "NSL", 35, 22, 12, 250 },
+		{ "Rhi", 83, 80, 40, 125 },
+		{ "Plec", 45, 25, 3, 100 },
+	};
+	for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++) {
+		make_calls(64, 8000, groups[g].start_khz * 1000, groups[g].end_khz * 1000, groups[g].call_ms,
+				groups[g].period_ms);
+		classify_result_t results[2];
+		for (int run = 0; run < 2; run++) {
+			call_features_t features;
+			verify_signal(&features);
+			classify(&features, &results[run]);
+		}
+		CHECK(results[0].class_index >= 0);
+		CHECK(results[0].class_index < 0 || strcmp(results[0].label, groups[g].label) == 0);
+		CHECK(results[0].confidence_percent >= 50 && results[0].confidence_percent <= 100);
+		CHECK(results[1].class_index == results[0].class_index);
+		CHECK(results[1].confidence_percent == results[0].confidence_percent);
+	}
+
+	// With nothing to go on, there is no answer:
+	call_features_t none = { 0 };
+	classify_result_t result;
+	classify(&none, &result);
+	CHECK(result.class_index == -1);
+	CHECK(result.label[0] == '\0');
+}
+
+/**
+ * wav_io, which the host tools read recordings with: a stereo file with an odd length of
+ * GUANO, which has to be padded, written and read back.
+ */
+static void test_wav_io(void)
+{
+	char path[] = "/tmp/core_test_XXXXXX";
+	const int fd = mkstemp(path);
+	CHECK(fd >= 0);
+	if (fd < 0)
+		return;
+	close(fd);
+
+	static int16_t frames[1001 * 2];
+	for (int i = 0; i < 1001 * 2; i++)
+		frames[i] = (int16_t) (i * 37);
+	const char *guano = "GUANO|Version:1.0\nNote:odd!";
+	CHECK(strlen(guano) % 2 == 1);
+	CHECK(wav_write(path, 2, 250000, frames, 1001, guano));
+
+	wav_info_t info;
+	int16_t *pRead = wav_read(path, &info);
+	CHECK(pRead != NULL);
+	CHECK(info.channels == 2);
+	CHECK(info.sampling_rate == 250000);
+	CHECK(info.frame_count == 1001);
+	CHECK(strcmp(info.guano, guano) == 0);
+	CHECK(pRead && memcmp(pRead, frames, sizeof(frames)) == 0);
+	free(pRead);
+
+	// A file that was never finished says its data is empty; what is there still counts:
+	FILE *f = fopen(path, "r+b");
+	fseek(f, info.data_offset - 4, SEEK_SET);
+	fwrite("\0\0\0\0", 1, 4, f);
+	fclose(f);
+	pRead = wav_read(path, &info);
+	CHECK(info.frame_count == 1001);
+	free(pRead);
+	remove(path);
+}
+
+static void test_storage(void)
+{
+	make_signal(64, 8000);
+	CHECK(core_sd_create(64ull * 1024 * 1024));
+	FX_MEDIA *pMedium = storage_mount(STORAGE_FAST);
+	CHECK(pMedium != NULL);
+	if (!pMedium)
+		return;
+
+	FX_FILE file;
+	CHECK(storage_open_wav_file(pMedium, &file, SAMPLING_RATE, "test") != NULL);
+	for (int i = 0; i < s_signal_len; i += DATA_BUFFER_ENTRIES)
+		storage_wav_file_append_data(&file, s_signal + i, MIN(DATA_BUFFER_ENTRIES, s_signal_len - i));
+	storage_close_wav_file(pMedium, &file);
+
+	// Read it back through FileX, and check it as any other wav file:
+	char name[128];
+	snprintf(name, sizeof(name), "%s.wav", storage_get_last_wav_base_name());
+	CHECK(fx_file_open(pMedium, &file, name, FX_OPEN_FOR_READ) == FX_SUCCESS);
+	const size_t capacity = s_signal_len * sizeof(sample_type_t) + 64 * 1024;
+	uint8_t *pContents = malloc(capacity);
+	ULONG len = 0;
+	CHECK(fx_file_read(&file, pContents, capacity, &len) == FX_SUCCESS);
+	fx_file_close(&file);
+	storage_unmount(true);
+
+	FILE *f = fmemopen(pContents, len, "rb");
+	wav_info_t info;
+	CHECK(wav_open(f, &info));
+	CHECK(info.channels == 1);
+	CHECK(info.sampling_rate == SAMPLING_RATE);
+	CHECK(info.frame_count == (uint64_t) s_signal_len);
+	CHECK(strncmp(info.guano, "GUANO|Version:", 14) == 0);
+	CHECK(info.data_offset + s_signal_len * sizeof(sample_type_t) <= len);
+	CHECK(memcmp(pContents + info.data_offset, s_signal, s_signal_len * sizeof(sample_type_t)) == 0);
+	fclose(f);
+	free(pContents);
+	core_sd_destroy();
+}
+
+int main(int argc, char *argv[])
+{
+	UNUSED(argv);
+	if (argc != 1) {
+		fprintf(stderr, "usage: core_test\n");
+		return 2;
+	}
+
+	g_core_now = 1750000000;		// Mid June 2025.
+	settings_init();
+	test_settings();
+
+	gain_init();
+	gain_set(settings_get()->sensitivity_range, false);
+	trigger_init();
+	storm_init();
+	verify_init();
+	storage_init();
+
+	test_runtime_config();
+	test_trigger();
+	test_trigger_sensitivity();
+	test_buffers();
+	test_verify();
+	test_classify();
+	test_wav_io();
+	test_storage();
+
+	printf("%d checks, %d failures\n", s_checks, s_failures);
+	return s_failures ? 1 : 0;
+}
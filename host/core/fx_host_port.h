@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_FX_HOST_PORT_H
+#define MY_FX_HOST_PORT_H
+
+/*
+ * FileX's generic port makes ULONG an unsigned long, which is 64 bits on a 64 bit PC,
+ * and FileX relies on it being 32 bits, as it is on the logger: the media can't even be
+ * opened otherwise. The port only defines its types if VOID isn't defined, so this is
+ * force included ahead of everything in the core library to define them first.
+ */
+
+#include <stdint.h>
+
+#define VOID void
+typedef char CHAR;
+typedef char BOOL;
+typedef unsigned char UCHAR;
+typedef int INT;
+typedef unsigned int UINT;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef short SHORT;
+typedef unsigned short USHORT;
+
+// Has to hold a pointer as well as being at least 32 bits:
+#define ALIGN_TYPE_DEFINED
+#define ALIGN_TYPE uintptr_t
+
+#endif // MY_FX_HOST_PORT_H
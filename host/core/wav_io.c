@@ -0,0 +1,167 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "wav_io.h"
+
+static uint32_t read_u32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t read_u16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static void write_u32(FILE *f, uint32_t value)
+{
+	const uint8_t b[4] = { value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24 };
+	fwrite(b, 1, sizeof(b), f);
+}
+
+static void write_u16(FILE *f, uint16_t value)
+{
+	const uint8_t b[2] = { value & 0xFF, value >> 8 };
+	fwrite(b, 1, sizeof(b), f);
+}
+
+/**
+ * Walk the chunks to the data, checking the format on the way, and leave the file at the
+ * first sample. A file that was never finished can say its data is empty, or longer than
+ * it is, so the frame count goes by what is actually there.
+ */
+bool wav_open(FILE *f, wav_info_t *pInfo)
+{
+	memset(pInfo, 0, sizeof(*pInfo));
+
+	uint8_t header[12];
+	if (fread(header, 1, sizeof(header), f) != sizeof(header) || memcmp(header, "RIFF", 4) != 0
+			|| memcmp(header + 8, "WAVE", 4) != 0)
+		return false;
+
+	uint8_t chunk[8];
+	while (fread(chunk, 1, sizeof(chunk), f) == sizeof(chunk)) {
+		const uint32_t size = read_u32(chunk + 4);
+		if (memcmp(chunk, "fmt ", 4) == 0) {
+			uint8_t fmt[16];
+			if (size < sizeof(fmt) || fread(fmt, 1, sizeof(fmt), f) != sizeof(fmt))
+				return false;
+			if (read_u16(fmt) != 1 || read_u16(fmt + 14) != 16)
+				return false;
+			pInfo->channels = read_u16(fmt + 2);
+			pInfo->sampling_rate = (int) read_u32(fmt + 4);
+			fseek(f, (long) (size - sizeof(fmt) + (size & 1)), SEEK_CUR);
+		}
+		else if (memcmp(chunk, "guan", 4) == 0 && size <= WAV_MAX_GUANO_LEN) {
+			if (fread(pInfo->guano, 1, size, f) != size)
+				return false;
+			pInfo->guano[size] = '\0';
+			fseek(f, (long) (size & 1), SEEK_CUR);
+		}
+		else if (memcmp(chunk, "data", 4) == 0) {
+			if (pInfo->channels <= 0)
+				return false;
+			pInfo->data_offset = ftell(f);
+			fseek(f, 0, SEEK_END);
+			const uint64_t available = (uint64_t) (ftell(f) - pInfo->data_offset);
+			const uint64_t len = size && size <= available ? size : available;
+			pInfo->frame_count = len / (sizeof(int16_t) * pInfo->channels);
+			fseek(f, pInfo->data_offset, SEEK_SET);
+			return true;
+		}
+		else
+			fseek(f, (long) (size + (size & 1)), SEEK_CUR);
+	}
+
+	return false;
+}
+
+/**
+ * Read all of a file's samples, with the channels interleaved. The caller frees them.
+ * Returns NULL, having said why, if the file can't be read.
+ */
+int16_t *wav_read(const char *path, wav_info_t *pInfo)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return NULL;
+	}
+
+	int16_t *pSamples = NULL;
+	if (wav_open(f, pInfo)) {
+		const size_t count = (size_t) pInfo->frame_count * pInfo->channels;
+		pSamples = malloc(count ? count * sizeof(int16_t) : 1);
+		if (pSamples)
+			pInfo->frame_count = fread(pSamples, sizeof(int16_t), count, f) / pInfo->channels;
+	}
+	else
+		fprintf(stderr, "%s: not a 16 bit PCM WAV file\n", path);
+	fclose(f);
+
+	return pSamples;
+}
+
+/**
+ * Write a file of 16 bit samples, with the channels interleaved, and GUANO text if
+ * guano isn't NULL. Returns false if it can't be written.
+ */
+bool wav_write(const char *path, int channels, int sampling_rate, const int16_t *pSamples,
+		size_t frame_count, const char *guano)
+{
+	FILE *f = fopen(path, "wb");
+	if (!f) {
+		perror(path);
+		return false;
+	}
+
+	const uint32_t data_len = (uint32_t) (frame_count * channels * sizeof(int16_t));
+	const uint32_t guano_len = guano ? (uint32_t) strlen(guano) : 0;
+	const uint32_t guano_chunk_len = guano_len ? 8 + guano_len + (guano_len & 1) : 0;
+
+	fwrite("RIFF", 1, 4, f);
+	write_u32(f, 4 + 8 + 16 + guano_chunk_len + 8 + data_len);
+	fwrite("WAVEfmt ", 1, 8, f);
+	write_u32(f, 16);
+	write_u16(f, 1);
+	write_u16(f, channels);
+	write_u32(f, sampling_rate);
+	write_u32(f, sampling_rate * channels * sizeof(int16_t));
+	write_u16(f, channels * sizeof(int16_t));
+	write_u16(f, 16);
+	if (guano_len) {
+		fwrite("guan", 1, 4, f);
+		write_u32(f, guano_len);
+		fwrite(guano, 1, guano_len, f);
+		if (guano_len & 1)
+			fputc(0, f);
+	}
+	fwrite("data", 1, 4, f);
+	write_u32(f, data_len);
+	fwrite(pSamples, sizeof(int16_t), frame_count * channels, f);
+
+	const bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
@@ -0,0 +1,51 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_WAV_IO_H
+#define MY_WAV_IO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Reading 16 bit PCM WAV files, the logger's own and anyone else's, for the host tools.
+ * Chunks before the data are walked and checked; anything after it is ignored. Files
+ * are written plainly: fmt, then GUANO if there is any, then the data.
+ */
+
+#define WAV_MAX_GUANO_LEN 4096
+
+typedef struct {
+	int channels;
+	int sampling_rate;
+	long data_offset;					// Where the first sample is in the file.
+	uint64_t frame_count;
+	char guano[WAV_MAX_GUANO_LEN + 1];	// The GUANO text, if it comes before the data, or empty.
+} wav_info_t;
+
+bool wav_open(FILE *f, wav_info_t *pInfo);
+int16_t *wav_read(const char *path, wav_info_t *pInfo);
+bool wav_write(const char *path, int channels, int sampling_rate, const int16_t *pSamples,
+		size_t frame_count, const char *guano);
+
+#endif // MY_WAV_IO_H
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "json_stream.h"
+#include "settings.h"
+
+#define JSMN_STATIC
+#define JSMN_STRICT
+#include "jsmn.h"
+
+/*
+ * Compare the time and memory needed to tokenize a JSON file with jsmn, which is what
+ * the settings parser used to do, and with the streaming tokenizer, and time the whole
+ * settings parse. Host timings only show the relative cost, not what the logger will see.
+ *
+ * Usage: json_bench [-n repeats] file
+ */
+
+#define MAX_INPUT_LEN (64 * 1024)
+#define MAX_JSMN_TOKENS 4096
+
+int stricmp(const char *s1, const char *s2)
+{
+	return strcasecmp(s1, s2);
+}
+
+static char s_input[MAX_INPUT_LEN + 1];
+static jsmntok_t s_tokens[MAX_JSMN_TOKENS];
+static json_stream_t s_stream;
+static volatile int s_sink;
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, double seconds, long repeats, size_t len)
+{
+	const double per_parse_s = seconds / repeats;
+	printf("%-24s %10.2f us/parse %8.2f ns/byte\n", name, per_parse_s * 1e6, per_parse_s * 1e9 / len);
+}
+
+int main(int argc, char *argv[])
+{
+	long repeats = 10000;
+	int i = 1;
+	if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+		repeats = atol(argv[i + 1]);
+		i += 2;
+	}
+	if (i + 1 != argc) {
+		fprintf(stderr, "usage: %s [-n repeats] file\n", argv[0]);
+		return 2;
+	}
+
+	FILE *f = fopen(argv[i], "rb");
+	if (!f) {
+		perror(argv[i]);
+		return 2;
+	}
+	const size_t len = fread(s_input, 1, MAX_INPUT_LEN, f);
+	fclose(f);
+	s_input[len] = '\0';
+
+	// jsmn needs a token per value, key and container, all at once:
+	jsmn_parser parser;
+	jsmn_init(&parser);
+	const int token_count = jsmn_parse(&parser, s_input, len, s_tokens, MAX_JSMN_TOKENS);
+	printf("%s: %zu bytes, %d jsmn tokens\n", argv[i], len, token_count);
+	printf("memory: jsmn %zu bytes (for this file), stream %zu bytes (for any file)\n",
+			token_count > 0 ? token_count * sizeof(jsmntok_t) : 0, sizeof(json_stream_t));
+
+	double start = now_s();
+	for (long r = 0; r < repeats; r++) {
+		jsmn_init(&parser);
+		s_sink = jsmn_parse(&parser, s_input, len, s_tokens, MAX_JSMN_TOKENS);
+	}
+	report("jsmn tokenize", now_s() - start, repeats, len);
+
+	start = now_s();
+	for (long r = 0; r < repeats; r++) {
+		json_stream_init_string(&s_stream, s_input);
+		json_stream_event_t event;
+		int events = 0;
+		while ((event = json_stream_next(&s_stream)) != JSON_STREAM_END && event != JSON_STREAM_ERROR)
+			events++;
+		s_sink = events;
+	}
+	report("stream tokenize", now_s() - start, repeats, len);
+
+	start = now_s();
+	bool ok = false;
+	for (long r = 0; r < repeats; r++)
+		ok = settings_parse_and_process_json_settings(s_input);
+	report("settings parse", now_s() - start, repeats, len);
+	printf("settings %s\n", ok ? "valid" : "invalid");
+
+	return 0;
+}
@@ -0,0 +1,209 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "json_stream.h"
+#include "settings.h"
+
+/*
+ * Mutation fuzzer for the streaming JSON tokenizer and the settings and schedule parsers
+ * built on it. Each seed file is mutated at random and then:
+ *
+ * 	- Tokenized in one go and again with random read sizes, which must give the same events,
+ * 	  as the chunk boundaries mustn't make any difference.
+ * 	- Given to the settings and schedule parsers, which mustn't crash or overrun (build with
+ * 	  -DHOST_SANITIZE=ON to have the sanitizers check that).
+ *
+ * Usage: json_fuzz [-n iterations] [-s seed] file...
+ */
+
+#define MAX_INPUT_LEN (64 * 1024)
+#define MAX_EVENTS 4096
+
+// settings.c uses this for matching trigger flags:
+int stricmp(const char *s1, const char *s2)
+{
+	return strcasecmp(s1, s2);
+}
+
+typedef struct {
+	json_stream_event_t event;
+	char text[JSON_STREAM_VALUE_LEN];
+} event_record_t;
+
+typedef struct {
+	const char *data;
+	int len, pos;
+	bool random_sizes;
+} reader_t;
+
+static event_record_t s_events_whole[MAX_EVENTS], s_events_chunked[MAX_EVENTS];
+static char s_input[MAX_INPUT_LEN + 1];
+
+static int read_input(void *context, char *buf, int len)
+{
+	reader_t *pr = (reader_t *) context;
+	int n = pr->len - pr->pos;
+	if (pr->random_sizes)
+		len = 1 + rand() % len;
+	if (n > len)
+		n = len;
+	memcpy(buf, pr->data + pr->pos, n);
+	pr->pos += n;
+	return n;
+}
+
+static int tokenize(const char *data, int len, bool random_sizes, event_record_t events[])
+{
+	static json_stream_t stream;
+	reader_t reader = { data, len, 0, random_sizes };
+	json_stream_init(&stream, read_input, &reader);
+
+	int count = 0;
+	for (;;) {
+		const json_stream_event_t event = json_stream_next(&stream);
+		if (count < MAX_EVENTS) {
+			events[count].event = event;
+			const char *text = event == JSON_STREAM_KEY ? stream.key
+					: (event == JSON_STREAM_STRING || event == JSON_STREAM_PRIMITIVE) ? stream.value : "";
+			snprintf(events[count].text, sizeof(events[count].text), "%s", text);
+			count++;
+		}
+		if (event == JSON_STREAM_END || event == JSON_STREAM_ERROR)
+			return count;
+	}
+}
+
+static size_t read_file(const char *path, char *buf, size_t buflen)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		exit(2);
+	}
+	const size_t n = fread(buf, 1, buflen, f);
+	fclose(f);
+	return n;
+}
+
+static bool same_events(const event_record_t e1[], int count1, const event_record_t e2[], int count2)
+{
+	if (count1 != count2)
+		return false;
+	for (int i = 0; i < count1; i++) {
+		if (e1[i].event != e2[i].event || strcmp(e1[i].text, e2[i].text) != 0)
+			return false;
+	}
+	return true;
+}
+
+static int mutate(char *buf, int len)
+{
+	static const char interesting[] = "{}[]\":,\\ -0123456789.eEtrufalsn\n\x01\xff";
+
+	const int mutations = 1 + rand() % 4;
+	for (int m = 0; m < mutations && len > 0; m++) {
+		const int pos = rand() % len;
+		switch (rand() % 5) {
+			case 0:		// Replace a byte.
+				buf[pos] = interesting[rand() % (sizeof(interesting) - 1)];
+				break;
+			case 1:		// Insert a byte.
+				if (len < MAX_INPUT_LEN) {
+					memmove(buf + pos + 1, buf + pos, len - pos);
+					buf[pos] = interesting[rand() % (sizeof(interesting) - 1)];
+					len++;
+				}
+				break;
+			case 2:		// Delete a byte.
+				memmove(buf + pos, buf + pos + 1, len - pos - 1);
+				len--;
+				break;
+			case 3:		// Truncate.
+				len = pos;
+				break;
+			case 4: {	// Repeat a run of bytes, which makes for long strings and deep nesting.
+				const int run = 1 + rand() % 64;
+				const int copy_len = pos + run <= len ? run : len - pos;
+				const int repeats = 1 + rand() % 8;
+				for (int r = 0; r < repeats && len + copy_len <= MAX_INPUT_LEN; r++) {
+					memmove(buf + pos + copy_len, buf + pos, len - pos);
+					len += copy_len;
+				}
+				break;
+			}
+		}
+	}
+
+	return len;
+}
+
+int main(int argc, char *argv[])
+{
+	long iterations = 100000;
+	unsigned seed = 1;
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			iterations = atol(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = atoi(argv[++i]);
+		else
+			break;
+	}
+	if (i == argc) {
+		fprintf(stderr, "usage: %s [-n iterations] [-s seed] file...\n", argv[0]);
+		return 2;
+	}
+
+	static char seed_data[MAX_INPUT_LEN];
+	static schedule_entry_t entries[MAX_SCHEDULE_INTERVALS];
+	const int first_file = i;
+	long valid = 0, failures = 0;
+	srand(seed);
+	for (long iteration = 0; iteration < iterations; iteration++) {
+		const char *path = argv[first_file + iteration % (argc - first_file)];
+		const int seed_len = read_file(path, seed_data, sizeof(seed_data));
+		memcpy(s_input, seed_data, seed_len);
+		const int len = iteration < argc - first_file ? seed_len : mutate(s_input, seed_len);
+
+		const int whole_count = tokenize(s_input, len, false, s_events_whole);
+		const int chunked_count = tokenize(s_input, len, true, s_events_chunked);
+		if (!same_events(s_events_whole, whole_count, s_events_chunked, chunked_count)) {
+			fprintf(stderr, "iteration %ld (%s): events depend on read sizes\n", iteration, path);
+			failures++;
+		}
+		if (s_events_whole[whole_count - 1].event == JSON_STREAM_END)
+			valid++;
+
+		// The parsers take a terminated string:
+		s_input[len] = '\0';
+		settings_parse_and_process_json_settings(s_input);
+		settings_parse_schedule(s_input, entries);
+	}
+
+	printf("%ld iterations, %ld valid JSON, %ld failures\n", iterations, valid, failures);
+	return failures ? 1 : 0;
+}
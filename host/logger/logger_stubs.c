@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "main.h"
+#include "streaming.h"
+#include "lowpower.h"
+#include "gain.h"
+#include "data_acquisition.h"
+#include "settings.h"
+#include "core_host.h"
+#include "logger.h"
+
+/*
+ * Stand ins for the hardware auto mode drives that the core library leaves out: the
+ * ADC clocks, STOP2, hard standby and the RTC alarm. As in auto_mode_sim, STOP and
+ * standby skip straight to the wakeup time, but here the main loop has to know so it
+ * can skip the input with them.
+ */
+
+PWR_TypeDef g_sim_pwr;
+uint8_t g_sim_bkpsram[SIM_BKPSRAM_SIZE];
+
+static uint32_t s_pwr_flags = 0;
+static bool s_alarm_set = false;
+static time_t s_alarm_epoch = 0;
+
+void streaming_start(int sampling_rate_index)
+{
+	const int sampling_rate = sampling_rate_index * SETTINGS_SAMPLING_RATE_MULTIPLIER_KHZ * 1000;
+	const int samples_per_frame = sampling_rate / 1000;
+	gain_init();
+	gain_set(settings_get()->sensitivity_range, settings_get()->sensitivity_disable);
+	data_acquisition_reset(samples_per_frame);
+	logger_start_streaming(sampling_rate);
+}
+
+void streaming_stop(void)
+{
+	logger_stop_streaming();
+}
+
+lowpower_wake_t lowpower_stop(uint32_t seconds)
+{
+	logger_stop(seconds);
+	return LOWPOWER_WAKE_TIMER;
+}
+
+/**
+ * As the RTC would: the alarm fires the next time the day of the month, hours, minutes
+ * and seconds all match.
+ */
+HAL_StatusTypeDef HAL_RTC_SetAlarm_IT(RTC_HandleTypeDef *hrtc, RTC_AlarmTypeDef *sAlarm, uint32_t Format)
+{
+	UNUSED(hrtc);
+	int mday = sAlarm->AlarmDateWeekDay, hours = sAlarm->AlarmTime.Hours,
+			minutes = sAlarm->AlarmTime.Minutes, seconds = sAlarm->AlarmTime.Seconds;
+	if (Format == RTC_FORMAT_BCD) {
+		mday = RTC_Bcd2ToByte(mday);
+		hours = RTC_Bcd2ToByte(hours);
+		minutes = RTC_Bcd2ToByte(minutes);
+		seconds = RTC_Bcd2ToByte(seconds);
+	}
+
+	const time_t midnight = g_core_now - g_core_now % (24 * 60 * 60);
+	s_alarm_set = false;
+	for (int day = 0; day < 62 && !s_alarm_set; day++) {
+		const time_t t = midnight + day * (24 * 60 * 60) + hours * 3600 + minutes * 60 + seconds;
+		struct tm tm;
+		gmtime_r(&t, &tm);
+		if (t > g_core_now && tm.tm_mday == mday) {
+			s_alarm_epoch = t;
+			s_alarm_set = true;
+		}
+	}
+
+	return HAL_OK;
+}
+
+uint32_t sim_pwr_get_flag(uint32_t flag)
+{
+	return s_pwr_flags & flag;
+}
+
+void sim_pwr_clear_flag(uint32_t flag)
+{
+	s_pwr_flags &= ~flag;
+}
+
+HAL_StatusTypeDef HAL_PWREx_ConfigSupply(uint32_t SupplySource)
+{
+	UNUSED(SupplySource);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PWREx_EnableGPIOPullUp(uint32_t GPIO_Port, uint32_t GPIO_Pin)
+{
+	UNUSED(GPIO_Port);
+	UNUSED(GPIO_Pin);
+	return HAL_OK;
+}
+
+void HAL_PWREx_EnablePullUpPullDownConfig(void) {}
+void HAL_PWREx_EnableBkupRAMRetention(void) {}
+
+void HAL_PWR_EnableWakeUpPin(uint32_t WakeUpPin)
+{
+	UNUSED(WakeUpPin);
+}
+
+/**
+ * Doesn't return: the main loop starts again from reset once the alarm fires.
+ */
+void HAL_PWR_EnterSTANDBYMode(void)
+{
+	s_pwr_flags |= PWR_FLAG_SBF;
+	const bool alarm_set = s_alarm_set;
+	s_alarm_set = false;
+	logger_standby(alarm_set, s_alarm_epoch);
+}
@@ -0,0 +1,747 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+#include <setjmp.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "main.h"
+#include "settings.h"
+#include "mode_auto.h"
+#include "retained.h"
+#include "storage.h"
+#include "adc.h"
+#include "data_acquisition.h"
+#include "data_processor_buffers.h"
+#include "recording.h"
+#include "trigger.h"
+#include "ltsa.h"
+#include "agc.h"
+#include "storm.h"
+#include "thumbnail.h"
+#include "second_pass.h"
+#include "events.h"
+#include "core_host.h"
+#include "wav_io.h"
+#include "logger.h"
+
+/*
+ * The whole logger in auto mode, fed from WAV files rather than the microphone: the real
+ * auto mode state machine, half frames through data_acquisition.c's DMA callbacks, the
+ * trigger, the ring buffers and the recorder, writing through FileX to an SD card in
+ * memory. The input plays at the logger's sampling rate against a virtual RTC, and the
+ * card takes as long as its timing model says, with half frames arriving all the while,
+ * so a card that can't keep up loses buffers as it would on the device. Processing in
+ * the main loop takes no time at all, so this shows what the card does to the data path
+ * and not what the CPU does. It runs as fast as the host can go.
+ *
+ * The input files are played one after another as a single stream starting at the
+ * start time, and the run ends when they run out, as if the mode switch were moved off
+ * auto. Time the logger spends in STOP or standby skips that part of the input.
+ *
+ * Usage: virtual_logger [options] schedule.json settings.json input.wav|directory...
+ */
+
+#define MAX_INPUT_FILES 100000
+#define MAX_SETTINGS_LEN (64 * 1024)
+#define MAX_INPUT_CHANNELS 16
+
+typedef struct {
+	char *path;
+	long data_offset;
+	uint64_t frame_count;
+} input_file_t;
+
+static input_file_t *s_inputs = NULL;
+static int s_input_count = 0;
+static int s_input_channels = 0;
+static int s_input_rate = 0;
+static uint64_t s_input_frames = 0;
+
+// Where reading has got to in the input:
+static int s_current_input = -1;
+static FILE *s_pCurrent_file = NULL;
+static uint64_t s_current_first_frame = 0;		// The stream position of the current file's first frame.
+static uint64_t s_next_frame = 0;				// Stream position of the next frame in the current file.
+
+static time_t s_start = 0;
+static uint64_t s_now_us = 0, s_end_us = 0;	// Since s_start.
+static jmp_buf s_reset;
+static bool s_verbose = false;
+
+static bool s_streaming = false;
+static int s_sampling_rate = 0;
+static int s_half_frame_samples = 0;
+static uint64_t s_stream_start_us = 0, s_stream_start_frame = 0;
+static uint64_t s_half_frames_delivered = 0;
+
+static int s_boots = 0, s_warnings = 0;
+static uint64_t s_listened_us = 0;
+static uint64_t s_half_frames_total = 0, s_half_frames_unseen = 0;
+static int16_t *s_pFrames = NULL;
+
+static const char *format_time(uint64_t us)
+{
+	static char buf[4][32];
+	static int i = 0;
+	i = (i + 1) % 4;
+	const time_t t = s_start + (time_t) (us / 1000000);
+	struct tm tm;
+	gmtime_r(&t, &tm);
+	const size_t len = strftime(buf[i], sizeof(buf[i]), "%Y-%m-%d %H:%M:%S", &tm);
+	snprintf(buf[i] + len, sizeof(buf[i]) - len, ".%03u", (unsigned) (us / 1000 % 1000));
+	return buf[i];
+}
+
+void logger_warn(const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	printf("%s WARNING: ", format_time(s_now_us));
+	vprintf(fmt, args);
+	printf("\n");
+	va_end(args);
+	s_warnings++;
+}
+
+void logger_log(const char *fmt, ...)
+{
+	if (!s_verbose)
+		return;
+	va_list args;
+	va_start(args, fmt);
+	printf("%s ", format_time(s_now_us));
+	vprintf(fmt, args);
+	printf("\n");
+	va_end(args);
+}
+
+/**
+ * Find the samples in a 16 bit PCM file, without reading them.
+ */
+static bool open_wav(input_file_t *pInput, int *pChannels, int *pRate)
+{
+	FILE *f = fopen(pInput->path, "rb");
+	if (!f) {
+		perror(pInput->path);
+		return false;
+	}
+
+	wav_info_t info;
+	const bool ok = wav_open(f, &info);
+	fclose(f);
+	if (!ok) {
+		fprintf(stderr, "%s: not a 16 bit PCM WAV file\n", pInput->path);
+		return false;
+	}
+
+	*pChannels = info.channels;
+	*pRate = info.sampling_rate;
+	pInput->data_offset = info.data_offset;
+	pInput->frame_count = info.frame_count;
+	return true;
+}
+
+static void add_input(const char *path)
+{
+	if (s_input_count == MAX_INPUT_FILES) {
+		fprintf(stderr, "too many input files\n");
+		exit(2);
+	}
+	if (!s_inputs)
+		s_inputs = malloc(MAX_INPUT_FILES * sizeof(input_file_t));
+
+	input_file_t *pInput = &s_inputs[s_input_count];
+	pInput->path = strdup(path);
+	int channels = 0, rate = 0;
+	if (!open_wav(pInput, &channels, &rate))
+		exit(2);
+	if (channels > MAX_INPUT_CHANNELS) {
+		fprintf(stderr, "%s: more than %d channels\n", path, MAX_INPUT_CHANNELS);
+		exit(2);
+	}
+	if (s_input_count > 0 && (channels != s_input_channels || rate != s_input_rate)) {
+		fprintf(stderr, "%s: %d channels at %d Hz, but the input so far is %d channels at %d Hz\n",
+				path, channels, rate, s_input_channels, s_input_rate);
+		exit(2);
+	}
+	s_input_channels = channels;
+	s_input_rate = rate;
+	s_input_frames += pInput->frame_count;
+	s_input_count++;
+}
+
+static int compare_names(const void *pv1, const void *pv2)
+{
+	return strcmp(*(char * const *) pv1, *(char * const *) pv2);
+}
+
+/**
+ * A directory stands for the WAV files in it, in name order, which for the logger's own
+ * files is the order they were recorded in.
+ */
+static void add_inputs(const char *path)
+{
+	struct stat st;
+	if (stat(path, &st) != 0) {
+		perror(path);
+		exit(2);
+	}
+	if (!S_ISDIR(st.st_mode)) {
+		add_input(path);
+		return;
+	}
+
+	DIR *pDir = opendir(path);
+	char **names = NULL;
+	int count = 0, capacity = 0;
+	struct dirent *pEntry;
+	while (pDir && (pEntry = readdir(pDir)) != NULL) {
+		const size_t len = strlen(pEntry->d_name);
+		if (len < 4 || strcasecmp(pEntry->d_name + len - 4, ".wav") != 0)
+			continue;
+		if (count == capacity) {
+			capacity = capacity ? capacity * 2 : 256;
+			names = realloc(names, capacity * sizeof(char *));
+		}
+		names[count] = malloc(strlen(path) + len + 2);
+		sprintf(names[count], "%s/%s", path, pEntry->d_name);
+		count++;
+	}
+	if (pDir)
+		closedir(pDir);
+
+	qsort(names, count, sizeof(char *), compare_names);
+	for (int i = 0; i < count; i++) {
+		add_input(names[i]);
+		free(names[i]);
+	}
+	free(names);
+}
+
+/**
+ * Read frames from anywhere at or after where we last read, across files as needed.
+ * Anything past the end of the input is silence.
+ */
+static void read_input(uint64_t first_frame, int16_t *pFrames, int frame_count)
+{
+	int16_t frame[MAX_INPUT_CHANNELS];
+	for (int i = 0; i < frame_count; i++) {
+		const uint64_t position = first_frame + i;
+		while (s_current_input < s_input_count
+				&& (s_current_input < 0 || position >= s_current_first_frame + s_inputs[s_current_input].frame_count)) {
+			if (s_pCurrent_file)
+				fclose(s_pCurrent_file);
+			s_pCurrent_file = NULL;
+			if (s_current_input >= 0)
+				s_current_first_frame += s_inputs[s_current_input].frame_count;
+			s_current_input++;
+			s_next_frame = s_current_first_frame;
+			if (s_current_input < s_input_count) {
+				s_pCurrent_file = fopen(s_inputs[s_current_input].path, "rb");
+				if (!s_pCurrent_file || fseek(s_pCurrent_file, s_inputs[s_current_input].data_offset, SEEK_SET) != 0) {
+					perror(s_inputs[s_current_input].path);
+					exit(2);
+				}
+			}
+		}
+
+		if (s_current_input >= s_input_count) {
+			memset(pFrames + i * ACQUISITION_CHANNELS, 0, ACQUISITION_CHANNELS * sizeof(int16_t));
+			continue;
+		}
+
+		if (position != s_next_frame) {
+			const long offset = s_inputs[s_current_input].data_offset
+					+ (long) ((position - s_current_first_frame) * s_input_channels * sizeof(int16_t));
+			fseek(s_pCurrent_file, offset, SEEK_SET);
+		}
+		if (fread(frame, sizeof(int16_t), s_input_channels, s_pCurrent_file) != (size_t) s_input_channels)
+			memset(frame, 0, sizeof(frame));
+		s_next_frame = position + 1;
+
+		// Any extra input channels are dropped, and a mono input feeds every channel:
+		for (int channel = 0; channel < ACQUISITION_CHANNELS; channel++)
+			pFrames[i * ACQUISITION_CHANNELS + channel] = frame[MIN(channel, s_input_channels - 1)];
+	}
+}
+
+static void set_now(uint64_t us)
+{
+	s_now_us = us;
+	g_core_now = s_start + (time_t) (us / 1000000);
+	g_core_tick_ms = (uint32_t) (us / 1000);
+}
+
+static uint64_t next_half_frame_us(void)
+{
+	return s_stream_start_us + (s_half_frames_delivered + 1) * s_half_frame_samples * 1000000ull / s_sampling_rate;
+}
+
+/**
+ * What the ADC and DMA do every half frame: fill half the DMA buffer, and interrupt.
+ */
+static void deliver_half_frame(void)
+{
+	const bool is_first_half = (s_half_frames_delivered & 1) == 0;
+	read_input(s_stream_start_frame + s_half_frames_delivered * s_half_frame_samples, s_pFrames, s_half_frame_samples);
+
+	dma_buffer_type_t *pDest = g_dmabuffer1 + (is_first_half ? 0 : s_half_frame_samples * ACQUISITION_CHANNELS);
+	for (int i = 0; i < s_half_frame_samples * ACQUISITION_CHANNELS; i++)
+		pDest[i] = (dma_buffer_type_t) ((s_pFrames[i] >> ACQUISITION_LEFTSHIFT) + ACQUISITION_OFFSET);
+
+	// If the trigger hasn't had the last one yet, it never will:
+	if (g_raw_half_frame_ready)
+		s_half_frames_unseen++;
+
+	if (is_first_half)
+		HAL_ADC_ConvHalfCpltCallback(&hadc1);
+	else
+		HAL_ADC_ConvCpltCallback(&hadc1);
+	s_half_frames_delivered++;
+	s_half_frames_total++;
+}
+
+/**
+ * Move the clock on, with the half frames that arrive on the way.
+ */
+static void advance_to(uint64_t us)
+{
+	while (s_streaming) {
+		const uint64_t due = next_half_frame_us();
+		if (due > us)
+			break;
+		set_now(due);
+		deliver_half_frame();
+	}
+	set_now(us);
+}
+
+static void on_sd_busy(uint32_t busy_us)
+{
+	advance_to(s_now_us + busy_us);
+}
+
+void logger_start_streaming(int sampling_rate)
+{
+	if (sampling_rate != s_input_rate) {
+		fprintf(stderr, "The logger is sampling at %d Hz but the input is %d Hz: set the sampling rate "
+				"in the settings to match.\n", sampling_rate, s_input_rate);
+		exit(2);
+	}
+	s_streaming = true;
+	s_sampling_rate = sampling_rate;
+	s_half_frame_samples = sampling_rate / 2000;
+	s_stream_start_us = s_now_us;
+	s_stream_start_frame = s_now_us * sampling_rate / 1000000;
+	s_half_frames_delivered = 0;
+
+	int profile_count;
+	const settings_profile_t *pProfiles = settings_get_profiles(&profile_count);
+	const int profile = settings_get_selected_profile();
+	logger_log("listening starts at %d Hz, profile %s", sampling_rate,
+			profile == SETTINGS_NO_PROFILE ? "(none)" : pProfiles[profile].name);
+}
+
+void logger_stop_streaming(void)
+{
+	if (!s_streaming)
+		return;
+	s_streaming = false;
+	s_listened_us += s_now_us - s_stream_start_us;
+	logger_log("listening stops");
+}
+
+void logger_stop(uint32_t seconds)
+{
+	logger_log("STOP for %lu s", (unsigned long) seconds);
+	advance_to(MIN(s_now_us + seconds * 1000000ull, s_end_us));
+}
+
+void logger_standby(bool alarm_set, time_t alarm_epoch)
+{
+	uint64_t wake_us = s_end_us;
+	if (!alarm_set)
+		logger_warn("hard standby with no alarm: the logger won't wake up");
+	else if (alarm_epoch > s_start)
+		wake_us = MIN((uint64_t) (alarm_epoch - s_start) * 1000000, s_end_us);
+	logger_log("hard standby until %s", format_time(wake_us));
+
+	logger_stop_streaming();
+	set_now(MAX(wake_us, s_now_us));
+	longjmp(s_reset, 1);
+}
+
+/**
+ * Feed the settings parser from the card, a chunk at a time, as init.c does.
+ */
+static int read_settings_file(void *context, char *buf, int len)
+{
+	ULONG actual_len = 0;
+	if (fx_file_read((FX_FILE *) context, (void *) buf, len, &actual_len) != FX_SUCCESS)
+		return 0;
+	return (int) actual_len;
+}
+
+/**
+ * As init_read_all_settings: waking from standby we use the settings kept in backup
+ * SRAM, otherwise we mount the card and read them.
+ */
+static void read_settings(void)
+{
+	const retained_settings_t *pCached = retained_get_settings();
+	if (retained_is_standby_wake() && pCached) {
+		settings_restore(&pCached->settings, pCached->profiles, pCached->profile_count);
+		return;
+	}
+
+	FX_MEDIA *pMedium = storage_mount(STORAGE_FAST);
+	if (!pMedium) {
+		logger_warn("can't mount the card to read the settings");
+		return;
+	}
+	FX_FILE file;
+	memset(&file, 0, sizeof(file));
+	bool ok = false;
+	ULONG size = 0;
+	if (fx_file_open(pMedium, &file, "settings.json", FX_OPEN_FOR_READ) == FX_SUCCESS) {
+		size = file.fx_file_current_file_size;
+		ok = settings_parse_and_process_json_stream(read_settings_file, &file);
+		fx_file_close(&file);
+	}
+	storage_unmount(true);
+
+	if (ok) {
+		int profile_count;
+		const settings_profile_t *pProfiles = settings_get_profiles(&profile_count);
+		retained_save_settings(true, size, 0, settings_get(), pProfiles, profile_count);
+	}
+	else {
+		logger_warn("settings.json doesn't parse, using defaults");
+		retained_invalidate_settings();
+	}
+}
+
+/**
+ * What the device does from reset, for the modules we have.
+ */
+static void boot(void)
+{
+	settings_init();
+	storage_init();
+	data_acquisition_init();
+	data_processor_buffers_init();
+	recording_init();
+	trigger_init();
+	ltsa_init();
+	agc_init();
+	storm_init();
+	thumbnail_init();
+	second_pass_init();
+	retained_init();
+
+	read_settings();
+
+	auto_mode_driver.init();
+	auto_mode_driver.open();
+}
+
+/**
+ * The main loop in main.c, less the modules that have nothing to do in auto mode.
+ */
+static void run(void)
+{
+	if (setjmp(s_reset) != 0) {
+		// We get here when the RTC alarm wakes us from hard standby:
+		if (s_now_us >= s_end_us)
+			return;
+		s_boots++;
+		logger_log("wake from hard standby");
+	}
+	boot();
+
+	int main_tick_count = 0;
+	uint64_t next_tick_us = s_now_us + MAIN_LOOP_DELAY_MS * 1000;
+	while (s_now_us < s_end_us) {
+		auto_mode_main_processing(main_tick_count);
+		storage_main_processing(main_tick_count);
+		recording_main_processing(main_tick_count);
+		ltsa_main_processing(main_tick_count);
+		second_pass_main_processing(main_tick_count);
+		thumbnail_main_processing(main_tick_count);
+		agc_main_processing(main_tick_count);
+		storm_main_processing(main_tick_count);
+		main_tick_count++;
+
+		while (s_now_us < next_tick_us) {
+			const uint32_t events = core_take_events();
+			if (!events) {
+				// events_wait: sleep until the next interrupt or the next tick:
+				advance_to(s_streaming ? MIN(next_half_frame_us(), next_tick_us) : next_tick_us);
+				continue;
+			}
+
+			auto_mode_main_fast_processing(main_tick_count);
+			if (events & (EVENT_HALF_FRAME | EVENT_SD))
+				recording_main_processing(main_tick_count);
+			if (events & EVENT_HALF_FRAME) {
+				trigger_main_fast_processing(main_tick_count);
+				ltsa_main_fast_processing(main_tick_count);
+				agc_main_fast_processing(main_tick_count);
+			}
+			if (events & EVENT_TRIGGER)
+				data_processor_buffers_fast_main_processing(main_tick_count);
+		}
+		next_tick_us = s_now_us + MAIN_LOOP_DELAY_MS * 1000;
+	}
+
+	// The input has run out: leave auto mode, as if the switch had been moved, so the
+	// recording in progress is finished properly:
+	auto_mode_driver.close();
+	logger_stop_streaming();
+
+	// Let the second pass catch up with the last recordings, as it would while the logger sat
+	// idle, for up to an hour:
+	const int max_ticks = 3600 * 1000 / MAIN_LOOP_DELAY_MS;
+	for (int main_tick_count = 0; !second_pass_is_idle() && main_tick_count < max_ticks; main_tick_count++) {
+		second_pass_main_processing(main_tick_count);
+		thumbnail_main_processing(main_tick_count);
+		advance_to(s_now_us + MAIN_LOOP_DELAY_MS * 1000);
+	}
+}
+
+static void copy_to_card(FX_MEDIA *pMedium, const char *path, const char *name)
+{
+	static char buf[MAX_SETTINGS_LEN];
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		exit(2);
+	}
+	const size_t len = fread(buf, 1, sizeof(buf), f);
+	fclose(f);
+
+	FX_FILE file;
+	memset(&file, 0, sizeof(file));
+	fx_file_delete(pMedium, (CHAR *) name);
+	if (fx_file_create(pMedium, (CHAR *) name) != FX_SUCCESS
+			|| fx_file_open(pMedium, &file, (CHAR *) name, FX_OPEN_FOR_WRITE) != FX_SUCCESS
+			|| fx_file_write(&file, buf, len) != FX_SUCCESS
+			|| fx_file_close(&file) != FX_SUCCESS) {
+		fprintf(stderr, "Can't write %s to the card\n", name);
+		exit(2);
+	}
+}
+
+static bool has_extension(const char *name, const char *extension)
+{
+	const size_t len = strlen(name), extension_len = strlen(extension);
+	return len > extension_len && strcasecmp(name + len - extension_len, extension) == 0;
+}
+
+static void print_report(double wall_s)
+{
+	int wav_count = 0, other_count = 0;
+	uint64_t wav_bytes = 0;
+	FX_MEDIA *pMedium = storage_mount(STORAGE_FAST);
+	static CHAR name[FX_MAX_LONG_NAME_LEN];
+	UINT status = pMedium ? fx_directory_first_entry_find(pMedium, name) : FX_NO_MORE_ENTRIES;
+	while (status == FX_SUCCESS) {
+		UINT attributes, year, month, day, hour, minute, second;
+		ULONG size = 0;
+		fx_directory_information_get(pMedium, name, &attributes, &size, &year, &month, &day, &hour, &minute, &second);
+		// Not the temporary file, which a discarded recording leaves for the next to write over:
+		if (has_extension(name, ".wav") && name[0] != '.') {
+			wav_count++;
+			wav_bytes += size;
+			if (s_verbose)
+				printf("  %-40s %10lu bytes\n", name, (unsigned long) size);
+		}
+		else if (!(attributes & (FX_DIRECTORY | FX_VOLUME))) {
+			other_count++;
+		}
+		status = fx_directory_next_entry_find(pMedium, name);
+	}
+	if (pMedium)
+		storage_unmount(true);
+
+	core_sd_stats_t stats;
+	core_sd_get_stats(&stats);
+	const double input_s = (double) s_input_frames / s_input_rate;
+
+	printf("Input %d files, %.1f s at %d Hz, from %s.\n", s_input_count, input_s, s_input_rate, format_time(0));
+	printf("Listened %.1f s, woke from standby %d times.\n", s_listened_us * 1e-6, s_boots);
+	printf("Recordings %d, %.1f MB, and %d other files.\n", wav_count, wav_bytes / 1e6, other_count);
+	int kept = 0, discarded = 0;
+	second_pass_get_counts(&kept, &discarded);
+	printf("Second pass kept %d, discarded %d.\n", kept, discarded);
+	printf("Lost buffers %d, half frames the trigger missed %llu of %llu.\n", data_processor_buffers_get_lost_count(),
+			(unsigned long long) s_half_frames_unseen, (unsigned long long) s_half_frames_total);
+	printf("SD %u writes of %.1f MB, %u reads of %.1f MB, %u not sequential.\n",
+			stats.write_commands, stats.blocks_written * BLOCKSIZE / 1e6,
+			stats.read_commands, stats.blocks_read * BLOCKSIZE / 1e6, stats.nonsequential_writes);
+	printf("SD busy %.1f s (%.1f%% of listening), longest %.1f ms.\n", stats.busy_us * 1e-6,
+			s_listened_us ? stats.busy_us * 100.0 / s_listened_us : 0, stats.longest_busy_us * 1e-3);
+	printf("Ran in %.1f s, %.0f times real time, warnings %d.\n", wall_s, wall_s > 0 ? input_s / wall_s : 0, s_warnings);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+			"Usage: virtual_logger [options] schedule.json settings.json input.wav|directory...\n"
+			"  -s, --start TIME       RTC time the input starts, YYYY-MM-DD[THH:MM[:SS]] (default 2026-01-01T12:00)\n"
+			"  -o, --output IMAGE     save the card as an image\n"
+			"  -g, --card GB          card size (default 32)\n"
+			"  -w, --write MBPS       card write speed (default 20; reads are twice that)\n"
+			"  -l, --latency US       card time per command (default 1000)\n"
+			"  -x, --stall MS         card goes busy for this long (default 250)\n"
+			"  -e, --stall-every MB   every this much written (default 64; 0 for never)\n"
+			"  -v, --verbose          log each transition, and list the recordings\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option options[] = {
+		{ "start", required_argument, NULL, 's' },
+		{ "output", required_argument, NULL, 'o' },
+		{ "card", required_argument, NULL, 'g' },
+		{ "write", required_argument, NULL, 'w' },
+		{ "latency", required_argument, NULL, 'l' },
+		{ "stall", required_argument, NULL, 'x' },
+		{ "stall-every", required_argument, NULL, 'e' },
+		{ "verbose", no_argument, NULL, 'v' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	// As on the device, there is no time zone:
+	setenv("TZ", "UTC0", 1);
+	tzset();
+
+	struct tm start_tm = { .tm_year = 2026 - 1900, .tm_mon = 0, .tm_mday = 1, .tm_hour = 12 };
+	const char *image_path = NULL;
+	double card_gb = 32, write_mbps = 20, latency_us = 1000, stall_ms = 250, stall_every_mb = 64;
+	int c;
+	while ((c = getopt_long(argc, argv, "s:o:g:w:l:x:e:v", options, NULL)) != -1) {
+		switch (c) {
+			case 's': {
+				int y, mo, d, h = 0, mi = 0, se = 0;
+				const int n = sscanf(optarg, "%d-%d-%dT%d:%d:%d", &y, &mo, &d, &h, &mi, &se);
+				if (n != 3 && n != 5 && n != 6)
+					usage();
+				start_tm = (struct tm) { .tm_year = y - 1900, .tm_mon = mo - 1, .tm_mday = d,
+						.tm_hour = h, .tm_min = mi, .tm_sec = se };
+				break;
+			}
+			case 'o':
+				image_path = optarg;
+				break;
+			case 'g':
+				card_gb = atof(optarg);
+				break;
+			case 'w':
+				write_mbps = atof(optarg);
+				break;
+			case 'l':
+				latency_us = atof(optarg);
+				break;
+			case 'x':
+				stall_ms = atof(optarg);
+				break;
+			case 'e':
+				stall_every_mb = atof(optarg);
+				break;
+			case 'v':
+				s_verbose = true;
+				break;
+			default:
+				usage();
+		}
+	}
+	if (argc - optind < 3 || card_gb <= 0 || write_mbps <= 0)
+		usage();
+	const char *schedule_path = argv[optind], *settings_path = argv[optind + 1];
+	for (int i = optind + 2; i < argc; i++)
+		add_inputs(argv[i]);
+	if (s_input_frames == 0) {
+		fprintf(stderr, "No input\n");
+		return 2;
+	}
+	s_pFrames = malloc(SETTINGS_SAMPLING_RATE_MULTIPLIER_KHZ * SETTINGS_MAX_SAMPLING_RATE_INDEX
+			* ACQUISITION_CHANNELS * sizeof(int16_t));
+
+	s_start = timegm(&start_tm);
+	s_end_us = s_input_frames * 1000000 / s_input_rate;
+	set_now(0);
+
+	// A freshly formatted card with the settings and schedule on it:
+	storage_init();
+	if (!core_sd_create((uint64_t) (card_gb * 1e9) / BLOCKSIZE)) {
+		fprintf(stderr, "Can't format the card\n");
+		return 2;
+	}
+	FX_MEDIA *pMedium = storage_mount(STORAGE_FAST);
+	if (!pMedium) {
+		fprintf(stderr, "Can't mount the card\n");
+		return 2;
+	}
+	copy_to_card(pMedium, schedule_path, "schedule.json");
+	copy_to_card(pMedium, settings_path, "settings.json");
+	storage_unmount(true);
+
+	// From here on, the card takes time:
+	const double block_mb = BLOCKSIZE / 1e6;
+	const core_sd_timing_t timing = {
+		.read_command_us = (uint32_t) latency_us,
+		.write_command_us = (uint32_t) latency_us,
+		.read_block_ns = (uint32_t) (block_mb / (write_mbps * 2) * 1e9),
+		.write_block_ns = (uint32_t) (block_mb / write_mbps * 1e9),
+		.stall_interval_blocks = (uint32_t) (stall_every_mb / block_mb),
+		.stall_us = (uint32_t) (stall_ms * 1000)
+	};
+	core_sd_reset_stats();
+	core_sd_set_timing(&timing, on_sd_busy);
+
+	// Fresh power up, so nothing retained:
+	memset(g_sim_bkpsram, 0, sizeof(g_sim_bkpsram));
+	struct timespec wall_start, wall_end;
+	clock_gettime(CLOCK_MONOTONIC, &wall_start);
+	run();
+	clock_gettime(CLOCK_MONOTONIC, &wall_end);
+
+	core_sd_set_timing(NULL, NULL);
+	print_report((wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) * 1e-9);
+
+	if (image_path && !core_sd_save(image_path)) {
+		perror(image_path);
+		return 2;
+	}
+	core_sd_destroy();
+
+	return s_warnings || data_processor_buffers_get_lost_count() ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_SIM_H
+#define MY_SIM_H
+
+#include <stdbool.h>
+#include <time.h>
+
+/*
+ * Shared between the pieces of the auto mode simulator. Time is RTC time, as a unix
+ * epoch, the way the firmware sees it.
+ */
+
+typedef enum {
+	SIM_POWER_RUN,			// Awake, not listening: start, soft standby, settings error.
+	SIM_POWER_LISTENING,	// Streaming and checking for triggers.
+	SIM_POWER_RECORDING,	// Listening and writing a triggered recording to SD.
+	SIM_POWER_STOP,			// STOP2 between listening windows.
+	SIM_POWER_STANDBY,		// Hard standby waiting for the RTC alarm.
+	SIM_POWER_LEN
+} sim_power_state_t;
+
+extern time_t g_sim_now;
+
+void sim_set_listening(bool listening);
+bool sim_is_recording(void);
+void sim_stop(time_t seconds);
+void sim_standby(bool alarm_set, time_t alarm_epoch);
+void sim_note_sd_mount(void);
+void sim_warn(const char *fmt, ...);
+void sim_log(const char *fmt, ...);
+
+const char *sim_get_schedule_path(void);
+
+#endif // MY_SIM_H
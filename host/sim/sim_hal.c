@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include "stm32u5xx_hal.h"
+#include "sim.h"
+
+/*
+ * The simulated hardware: a virtual RTC driven by g_sim_now, and enough of PWR to
+ * model hard standby. The RTC holds UTC broken down time, as the firmware expects.
+ */
+
+PWR_TypeDef g_sim_pwr;
+uint8_t g_sim_bkpsram[SIM_BKPSRAM_SIZE];
+
+static uint32_t s_pwr_flags = 0;
+static bool s_alarm_set = false;
+static time_t s_alarm_epoch = 0;
+static uint32_t s_tick_ms = 0;
+
+void Error_Handler(void)
+{
+	sim_warn("Error_Handler called");
+	exit(3);
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+	// Too short to matter to the simulation:
+	s_tick_ms += Delay;
+}
+
+uint32_t HAL_GetTick(void)
+{
+	return s_tick_ms;
+}
+
+void HAL_SuspendTick(void) {}
+void HAL_ResumeTick(void) {}
+void HAL_DBGMCU_EnableDBGStandbyMode(void) {}
+void HAL_DBGMCU_EnableDBGStopMode(void) {}
+
+uint8_t RTC_ByteToBcd2(uint8_t Value)
+{
+	return (uint8_t) (((Value / 10) << 4) | (Value % 10));
+}
+
+uint8_t RTC_Bcd2ToByte(uint8_t Value)
+{
+	return (uint8_t) (((Value >> 4) * 10) + (Value & 0x0F));
+}
+
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format)
+{
+	UNUSED(hrtc);
+	struct tm tm;
+	gmtime_r(&g_sim_now, &tm);
+	memset(sTime, 0, sizeof(*sTime));
+	sTime->Hours = tm.tm_hour;
+	sTime->Minutes = tm.tm_min;
+	sTime->Seconds = tm.tm_sec;
+	if (Format == RTC_FORMAT_BCD) {
+		sTime->Hours = RTC_ByteToBcd2(sTime->Hours);
+		sTime->Minutes = RTC_ByteToBcd2(sTime->Minutes);
+		sTime->Seconds = RTC_ByteToBcd2(sTime->Seconds);
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format)
+{
+	UNUSED(hrtc);
+	struct tm tm;
+	gmtime_r(&g_sim_now, &tm);
+	sDate->Year = tm.tm_year - 100;
+	sDate->Month = tm.tm_mon + 1;
+	sDate->Date = tm.tm_mday;
+	sDate->WeekDay = tm.tm_wday == 0 ? 7 : tm.tm_wday;
+	if (Format == RTC_FORMAT_BCD) {
+		sDate->Year = RTC_ByteToBcd2(sDate->Year);
+		sDate->Month = RTC_ByteToBcd2(sDate->Month);
+		sDate->Date = RTC_ByteToBcd2(sDate->Date);
+	}
+	return HAL_OK;
+}
+
+/**
+ * Work out when the alarm will actually fire, the way the RTC would: the next time the
+ * day of the month, hours, minutes and seconds all match. That might be next month if
+ * the firmware asked for a time that has just passed.
+ */
+HAL_StatusTypeDef HAL_RTC_SetAlarm_IT(RTC_HandleTypeDef *hrtc, RTC_AlarmTypeDef *sAlarm, uint32_t Format)
+{
+	UNUSED(hrtc);
+	int mday = sAlarm->AlarmDateWeekDay, hours = sAlarm->AlarmTime.Hours,
+			minutes = sAlarm->AlarmTime.Minutes, seconds = sAlarm->AlarmTime.Seconds;
+	if (Format == RTC_FORMAT_BCD) {
+		mday = RTC_Bcd2ToByte(mday);
+		hours = RTC_Bcd2ToByte(hours);
+		minutes = RTC_Bcd2ToByte(minutes);
+		seconds = RTC_Bcd2ToByte(seconds);
+	}
+
+	const time_t midnight = g_sim_now - g_sim_now % (24 * 60 * 60);
+	s_alarm_set = false;
+	for (int day = 0; day < 62 && !s_alarm_set; day++) {
+		const time_t t = midnight + day * (24 * 60 * 60) + hours * 3600 + minutes * 60 + seconds;
+		struct tm tm;
+		gmtime_r(&t, &tm);
+		if (t > g_sim_now && tm.tm_mday == mday) {
+			s_alarm_epoch = t;
+			s_alarm_set = true;
+		}
+	}
+
+	return HAL_OK;
+}
+
+uint32_t sim_pwr_get_flag(uint32_t flag)
+{
+	return s_pwr_flags & flag;
+}
+
+void sim_pwr_clear_flag(uint32_t flag)
+{
+	s_pwr_flags &= ~flag;
+}
+
+HAL_StatusTypeDef HAL_PWREx_ConfigSupply(uint32_t SupplySource)
+{
+	UNUSED(SupplySource);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PWREx_EnableGPIOPullUp(uint32_t GPIO_Port, uint32_t GPIO_Pin)
+{
+	UNUSED(GPIO_Port);
+	UNUSED(GPIO_Pin);
+	return HAL_OK;
+}
+
+void HAL_PWREx_EnablePullUpPullDownConfig(void) {}
+void HAL_PWREx_EnableBkupRAMRetention(void) {}
+
+void HAL_PWR_EnableWakeUpPin(uint32_t WakeUpPin)
+{
+	UNUSED(WakeUpPin);
+}
+
+/**
+ * Doesn't return: the simulator picks up again as if from reset once the alarm fires.
+ */
+void HAL_PWR_EnterSTANDBYMode(void)
+{
+	s_pwr_flags |= PWR_FLAG_SBF;
+	const bool alarm_set = s_alarm_set;
+	s_alarm_set = false;
+	sim_standby(alarm_set, s_alarm_epoch);
+}
@@ -0,0 +1,587 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <getopt.h>
+#include <setjmp.h>
+#include <time.h>
+#include "main.h"
+#include "settings.h"
+#include "mode_auto.h"
+#include "retained.h"
+#include "buffer.h"
+#include "sim.h"
+
+/*
+ * Runs the real auto mode state machine (mode_auto.c, settings.c, solar.c, retained.c)
+ * against a virtual RTC, so that weeks of schedule can be checked in seconds. Each
+ * pass of the main loop here is one second of RTC time, rather than the 20 ms slow tick
+ * on the device; auto mode only works in whole seconds so that makes no difference.
+ * STOP and hard standby skip straight to the wakeup time.
+ *
+ * Time spent in each power state is multiplied by a current model to estimate battery
+ * life. The default currents are rough figures: measure your own board and use -c.
+ */
+
+#define SECONDS_PER_DAY (24 * 60 * 60)
+#define LATE_START_TOLERANCE_S 60		// How late listening can start before we complain.
+
+time_t g_sim_now = 0;
+
+static const char *s_power_state_names[SIM_POWER_LEN] = {
+	"run", "listening", "recording", "stop", "standby"
+};
+
+static double s_current_ma[SIM_POWER_LEN] = {
+	1.5,		// SIM_POWER_RUN: 4 MHz, sleeping between ticks.
+	22.0,		// SIM_POWER_LISTENING: 48 MHz, PLLs, ADC and analogue front end.
+	45.0,		// SIM_POWER_RECORDING: as listening, plus SD writes.
+	0.05,		// SIM_POWER_STOP
+	0.01		// SIM_POWER_STANDBY: RTC, LSE and backup SRAM.
+};
+static double s_sd_mount_mas = 12.0;		// Charge per SD mount, about 0.4 s at 30 mA.
+static double s_boot_mas = 3.0;				// Charge per boot from hard standby.
+static double s_battery_mah = 2500;
+
+static const char *s_schedule_path = NULL, *s_settings_path = NULL, *s_tz = NULL;
+static time_t s_start = 0, s_end = 0;
+static double s_trigger_rate_per_hour = 0;
+static bool s_verbose = false;
+
+static double s_state_seconds[SIM_POWER_LEN];
+static int s_sd_mounts = 0, s_boots = 0, s_recordings = 0, s_warnings = 0;
+static bool s_listening = false;
+static time_t s_recording_until = 0;
+static jmp_buf s_reset;
+static int s_tick = 0;
+
+typedef struct {
+	time_t start, end;		// Inclusive, as in auto mode.
+} span_t;
+
+static span_t *s_scheduled = NULL;
+static int s_scheduled_count = 0;
+static time_t *s_listen_starts = NULL;
+static int s_listen_start_count = 0, s_listen_start_capacity = 0;
+static double s_listened_scheduled_s = 0, s_listened_unscheduled_s = 0;
+static double s_profile_listened_s[SETTINGS_MAX_PROFILES + 1];		// The first is for no profile.
+
+static const char *format_time(time_t t)
+{
+	static char buf[4][32];
+	static int i = 0;
+	i = (i + 1) % 4;
+	struct tm tm;
+	gmtime_r(&t, &tm);
+	strftime(buf[i], sizeof(buf[i]), "%Y-%m-%d %H:%M:%S", &tm);
+	return buf[i];
+}
+
+void sim_warn(const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	printf("%s WARNING: ", format_time(g_sim_now));
+	vprintf(fmt, args);
+	printf("\n");
+	va_end(args);
+	s_warnings++;
+}
+
+void sim_log(const char *fmt, ...)
+{
+	if (!s_verbose)
+		return;
+	va_list args;
+	va_start(args, fmt);
+	printf("%s ", format_time(g_sim_now));
+	vprintf(fmt, args);
+	printf("\n");
+	va_end(args);
+}
+
+const char *sim_get_schedule_path(void)
+{
+	return s_schedule_path;
+}
+
+/**
+ * Seconds of [from, from + seconds) that fall within the schedule.
+ */
+static time_t scheduled_overlap(time_t from, time_t seconds)
+{
+	time_t overlap = 0;
+	const time_t to = from + seconds;
+	for (int i = 0; i < s_scheduled_count; i++) {
+		const time_t start = s_scheduled[i].start > from ? s_scheduled[i].start : from;
+		const time_t end = s_scheduled[i].end + 1 < to ? s_scheduled[i].end + 1 : to;
+		if (end > start)
+			overlap += end - start;
+	}
+	return overlap;
+}
+
+static void account(sim_power_state_t state, time_t seconds)
+{
+	s_state_seconds[state] += seconds;
+	if (state == SIM_POWER_LISTENING || state == SIM_POWER_RECORDING) {
+		const time_t overlap = scheduled_overlap(g_sim_now, seconds);
+		s_listened_scheduled_s += overlap;
+		s_listened_unscheduled_s += seconds - overlap;
+		s_profile_listened_s[settings_get_selected_profile() + 1] += seconds;
+	}
+	g_sim_now += seconds;
+}
+
+void sim_note_sd_mount(void)
+{
+	s_sd_mounts++;
+}
+
+void sim_set_listening(bool listening)
+{
+	if (listening == s_listening)
+		return;
+	s_listening = listening;
+	s_recording_until = 0;
+	if (listening) {
+		int profile_count;
+		const settings_profile_t *pProfiles = settings_get_profiles(&profile_count);
+		const int profile = settings_get_selected_profile();
+		sim_log("listening starts, profile %s", profile == SETTINGS_NO_PROFILE ? "(none)" : pProfiles[profile].name);
+	}
+	else {
+		sim_log("listening stops");
+	}
+
+	if (listening) {
+		if (s_listen_start_count == s_listen_start_capacity) {
+			s_listen_start_capacity = s_listen_start_capacity ? s_listen_start_capacity * 2 : 256;
+			s_listen_starts = realloc(s_listen_starts, s_listen_start_capacity * sizeof(time_t));
+		}
+		s_listen_starts[s_listen_start_count++] = g_sim_now;
+	}
+}
+
+bool sim_is_recording(void)
+{
+	return s_listening && g_sim_now < s_recording_until;
+}
+
+void sim_stop(time_t seconds)
+{
+	if (g_sim_now + seconds > s_end)
+		seconds = s_end - g_sim_now;
+	sim_log("STOP for %ld s", (long) seconds);
+	account(SIM_POWER_STOP, seconds);
+}
+
+void sim_standby(bool alarm_set, time_t alarm_epoch)
+{
+	const retained_schedule_t *pRetained = retained_get_schedule();
+	if (!alarm_set) {
+		sim_warn("hard standby with no alarm: the logger won't wake up");
+		alarm_epoch = s_end;
+	}
+	else if (pRetained && pRetained->next_wakeup_epoch != alarm_epoch) {
+		sim_warn("RTC alarm fires at %s, but auto mode wanted %s",
+				format_time(alarm_epoch), format_time(pRetained->next_wakeup_epoch));
+	}
+	sim_log("hard standby until %s", format_time(alarm_epoch));
+
+	const time_t wake = alarm_epoch < s_end ? alarm_epoch : s_end;
+	if (wake > g_sim_now)
+		account(SIM_POWER_STANDBY, wake - g_sim_now);
+	longjmp(s_reset, 1);
+}
+
+static size_t read_file(const char *path, char *buf, size_t buflen)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		fprintf(stderr, "Can't open %s\n", path);
+		exit(2);
+	}
+	size_t len = fread(buf, 1, buflen - 1, f);
+	buf[len] = '\0';
+	fclose(f);
+	return len;
+}
+
+static int read_settings_file(void *context, char *buf, int len)
+{
+	return (int) fread(buf, 1, len, (FILE *) context);
+}
+
+/**
+ * Streamed, as the device does, so there is no limit on the size.
+ */
+static bool parse_settings_file(void)
+{
+	FILE *f = fopen(s_settings_path, "rb");
+	if (!f) {
+		fprintf(stderr, "Can't open %s\n", s_settings_path);
+		exit(2);
+	}
+	const bool ok = settings_parse_and_process_json_stream(read_settings_file, f);
+	fclose(f);
+	return ok;
+}
+
+/**
+ * What the device does from reset as far as auto mode is concerned.
+ */
+static void boot(void)
+{
+	retained_init();
+
+	// As init_read_all_settings: waking from standby we use the settings kept in backup SRAM,
+	// otherwise we mount the card and read them:
+	const retained_settings_t *pCached = retained_get_settings();
+	if (retained_is_standby_wake() && pCached) {
+		settings_restore(&pCached->settings, pCached->profiles, pCached->profile_count);
+	}
+	else {
+		sim_note_sd_mount();
+		if (s_settings_path && !parse_settings_file())
+			sim_warn("%s doesn't parse, using defaults", s_settings_path);
+		int profile_count;
+		const settings_profile_t *pProfiles = settings_get_profiles(&profile_count);
+		retained_save_settings(s_settings_path != NULL, 0, 0, settings_get(), pProfiles, profile_count);
+	}
+
+	auto_mode_driver.init();
+	auto_mode_driver.open();
+}
+
+static void advance_awake(void)
+{
+	if (s_listening && s_trigger_rate_per_hour > 0 && !sim_is_recording()
+			&& (double) rand() / RAND_MAX < s_trigger_rate_per_hour / 3600.0) {
+		s_recording_until = g_sim_now + (time_t) (settings_get()->max_sampling_time_s + 0.999);
+		s_recordings++;
+	}
+
+	sim_power_state_t state = SIM_POWER_RUN;
+	if (s_listening)
+		state = sim_is_recording() ? SIM_POWER_RECORDING : SIM_POWER_LISTENING;
+	account(state, 1);
+}
+
+static void run(void)
+{
+	if (setjmp(s_reset) != 0) {
+		// We get here when the RTC alarm wakes us from hard standby:
+		if (g_sim_now >= s_end)
+			return;
+		s_boots++;
+		s_listening = false;
+		sim_log("wake from hard standby");
+	}
+	boot();
+
+	while (g_sim_now < s_end) {
+		auto_mode_main_processing(s_tick++);
+		advance_awake();
+	}
+}
+
+static int compare_spans(const void *pv1, const void *pv2)
+{
+	const span_t *p1 = pv1, *p2 = pv2;
+	return p1->start < p2->start ? -1 : p1->start > p2->start ? 1 : 0;
+}
+
+/**
+ * Work out the schedule independently of auto mode, using the same settings functions,
+ * so we have something to compare what it actually did with.
+ */
+static void calculate_schedule(void)
+{
+	read_file(s_schedule_path, g_2k_char_buffer, LEN_2K_BUFFER);
+	schedule_entry_t entries[MAX_SCHEDULE_INTERVALS];
+	const int entry_count = settings_parse_schedule(g_2k_char_buffer, entries);
+	if (entry_count <= 0) {
+		sim_warn("%s doesn't parse or has no entries: the logger will flash its LEDs", s_schedule_path);
+		return;
+	}
+
+	const int days = (s_end - s_start) / SECONDS_PER_DAY + 3;
+	span_t *spans = malloc(days * MAX_SCHEDULE_INTERVALS * sizeof(span_t));
+	int count = 0;
+	for (time_t day = s_start - s_start % SECONDS_PER_DAY - SECONDS_PER_DAY; day <= s_end; day += SECONDS_PER_DAY) {
+		struct tm tm;
+		gmtime_r(&day, &tm);
+		schedule_interval_t intervals[MAX_SCHEDULE_INTERVALS];
+		const int n = settings_resolve_schedule(entries, entry_count,
+				tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, intervals);
+		if (n < 0) {
+			sim_warn("the schedule can't be resolved: solar times with no location setting, or an unknown profile");
+			free(spans);
+			return;
+		}
+		for (int i = 0; i < n; i++) {
+			spans[count].start = day + intervals[i].start_minutes * 60;
+			spans[count].end = spans[count].start + intervals[i].duration_minutes * 60;
+			count++;
+		}
+	}
+
+	// Merge across days, as intervals can span midnight:
+	qsort(spans, count, sizeof(span_t), compare_spans);
+	s_scheduled = malloc((count + 1) * sizeof(span_t));
+	for (int i = 0; i < count; i++) {
+		if (s_scheduled_count > 0 && spans[i].start <= s_scheduled[s_scheduled_count - 1].end + 1) {
+			if (spans[i].end > s_scheduled[s_scheduled_count - 1].end)
+				s_scheduled[s_scheduled_count - 1].end = spans[i].end;
+		}
+		else {
+			s_scheduled[s_scheduled_count++] = spans[i];
+		}
+	}
+	free(spans);
+}
+
+static void check_start_times(void)
+{
+	int j = 0;
+	for (int i = 0; i < s_scheduled_count; i++) {
+		const span_t *pSpan = &s_scheduled[i];
+		if (pSpan->start < s_start || pSpan->start >= s_end)
+			continue;
+		while (j < s_listen_start_count && s_listen_starts[j] < pSpan->start)
+			j++;
+		if (j == s_listen_start_count || s_listen_starts[j] > pSpan->end) {
+			g_sim_now = pSpan->start;
+			sim_warn("no listening in the interval from %s to %s",
+					format_time(pSpan->start), format_time(pSpan->end));
+		}
+		else if (s_listen_starts[j] - pSpan->start > LATE_START_TOLERANCE_S) {
+			g_sim_now = pSpan->start;
+			sim_warn("listening started %ld s late", (long) (s_listen_starts[j] - pSpan->start));
+		}
+	}
+}
+
+/**
+ * The UTC offset of civil time in the time zone supplied, at the moment supplied.
+ * Auto mode itself always runs with TZ as UTC, as on the device.
+ */
+static long civil_offset(const char *tz, time_t utc)
+{
+	setenv("TZ", tz, 1);
+	tzset();
+	struct tm tm;
+	localtime_r(&utc, &tm);
+	const long offset = tm.tm_gmtoff;
+	setenv("TZ", "UTC0", 1);
+	tzset();
+	return offset;
+}
+
+/**
+ * The RTC has no idea about time zones or daylight saving. If the user sets it to civil time,
+ * report how far it drifts from civil time over the run.
+ */
+static void check_time_zone(void)
+{
+	const long rtc_offset = civil_offset(s_tz, s_start);
+	int days = 0, days_out = 0;
+	long worst = 0;
+	time_t first_out = 0;
+	for (time_t day = s_start - s_start % SECONDS_PER_DAY; day < s_end; day += SECONDS_PER_DAY) {
+		const long offset = civil_offset(s_tz, day + SECONDS_PER_DAY / 2 - rtc_offset);
+		days++;
+		if (offset != rtc_offset) {
+			if (!days_out)
+				first_out = day;
+			days_out++;
+			if (labs(offset - rtc_offset) > labs(worst))
+				worst = offset - rtc_offset;
+		}
+	}
+
+	printf("RTC set to civil time in %s (UTC%+.1f h) at the start.\n", s_tz, rtc_offset / 3600.0);
+	if (days_out)
+		printf("Civil time moves %+ld min from the RTC from %.10s, on %d of %d days. The schedule follows the RTC.\n",
+				worst / 60, format_time(first_out), days_out, days);
+
+	schedule_entry_t entries[MAX_SCHEDULE_INTERVALS];
+	read_file(s_schedule_path, g_2k_char_buffer, LEN_2K_BUFFER);
+	const int entry_count = settings_parse_schedule(g_2k_char_buffer, entries);
+	if (rtc_offset != 0 && entry_count > 0 && settings_schedule_uses_solar(entries, entry_count))
+		sim_warn("solar times assume the RTC is set to UTC, so they will be %+ld min out",
+				rtc_offset / 60);
+}
+
+static void print_report(void)
+{
+	printf("\nSimulated %s to %s RTC time (%.1f days)\n\n",
+			format_time(s_start), format_time(s_end), (double) (s_end - s_start) / SECONDS_PER_DAY);
+
+	double total_mah = 0;
+	printf("%-20s %10s %8s %10s %10s\n", "", "hours", "share", "mA", "mAh");
+	for (int i = 0; i < SIM_POWER_LEN; i++) {
+		const double mah = s_state_seconds[i] * s_current_ma[i] / 3600.0;
+		total_mah += mah;
+		printf("%-20s %10.2f %7.2f%% %10.3f %10.2f\n", s_power_state_names[i], s_state_seconds[i] / 3600.0,
+				100.0 * s_state_seconds[i] / (s_end - s_start), s_current_ma[i], mah);
+	}
+	const double sd_mah = s_sd_mounts * s_sd_mount_mas / 3600.0;
+	const double boot_mah = s_boots * s_boot_mas / 3600.0;
+	total_mah += sd_mah + boot_mah;
+	printf("%-20s %10d %8s %10s %10.2f\n", "SD mounts", s_sd_mounts, "", "", sd_mah);
+	printf("%-20s %10d %8s %10s %10.2f\n", "boots from standby", s_boots, "", "", boot_mah);
+	printf("%-20s %10s %8s %10s %10.2f\n\n", "total", "", "", "", total_mah);
+
+	const double average_ma = total_mah * 3600.0 / (s_end - s_start);
+	printf("Average current %.3f mA: a %.0f mAh battery lasts about %.0f days.\n",
+			average_ma, s_battery_mah, s_battery_mah / average_ma / 24.0);
+
+	const double scheduled_s = scheduled_overlap(s_start, s_end - s_start);
+	printf("Scheduled %.2f h, listened %.2f h of that (%.1f%%), and %.0f s outside the schedule.\n",
+			scheduled_s / 3600.0, s_listened_scheduled_s / 3600.0,
+			scheduled_s > 0 ? 100.0 * s_listened_scheduled_s / scheduled_s : 0.0, s_listened_unscheduled_s);
+
+	int profile_count;
+	const settings_profile_t *pProfiles = settings_get_profiles(&profile_count);
+	for (int i = 0; i < profile_count; i++)
+		printf("Listened %.2f h with profile %s.\n", s_profile_listened_s[i + 1] / 3600.0, pProfiles[i].name);
+	if (profile_count > 0)
+		printf("Listened %.2f h without a profile.\n", s_profile_listened_s[0] / 3600.0);
+
+	printf("Recordings %d, warnings %d.\n", s_recordings, s_warnings);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+			"Usage: auto_mode_sim [options] schedule.json [settings.json]\n"
+			"  -s, --start TIME       RTC time to start, YYYY-MM-DD[THH:MM] (default 2026-01-01T12:00)\n"
+			"  -d, --days N           days to simulate (default 7)\n"
+			"  -z, --tz ZONE          the RTC was set to civil time in ZONE, eg Europe/London\n"
+			"  -c, --current STATE=mA current for run, listening, recording, stop or standby\n"
+			"  -b, --battery MAH      battery capacity (default 2500)\n"
+			"  -t, --triggers N       triggers per hour while listening (default 0)\n"
+			"  -r, --seed N           random seed for triggers\n"
+			"  -v, --verbose          log each transition\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option options[] = {
+		{ "start", required_argument, NULL, 's' },
+		{ "days", required_argument, NULL, 'd' },
+		{ "tz", required_argument, NULL, 'z' },
+		{ "current", required_argument, NULL, 'c' },
+		{ "battery", required_argument, NULL, 'b' },
+		{ "triggers", required_argument, NULL, 't' },
+		{ "seed", required_argument, NULL, 'r' },
+		{ "verbose", no_argument, NULL, 'v' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	// As on the device, there is no time zone:
+	setenv("TZ", "UTC0", 1);
+	tzset();
+
+	struct tm start_tm = { .tm_year = 2026 - 1900, .tm_mon = 0, .tm_mday = 1, .tm_hour = 12 };
+	double days = 7;
+	int c;
+	while ((c = getopt_long(argc, argv, "s:d:z:c:b:t:r:v", options, NULL)) != -1) {
+		switch (c) {
+			case 's': {
+				int y, mo, d, h = 0, mi = 0;
+				const int n = sscanf(optarg, "%d-%d-%dT%d:%d", &y, &mo, &d, &h, &mi);
+				if (n != 3 && n != 5)
+					usage();
+				start_tm = (struct tm) { .tm_year = y - 1900, .tm_mon = mo - 1, .tm_mday = d, .tm_hour = h, .tm_min = mi };
+				break;
+			}
+			case 'd':
+				days = atof(optarg);
+				break;
+			case 'z':
+				s_tz = optarg;
+				break;
+			case 'c': {
+				char name[16];
+				double ma;
+				bool found = false;
+				if (sscanf(optarg, "%15[^=]=%lf", name, &ma) == 2) {
+					for (int i = 0; i < SIM_POWER_LEN; i++) {
+						if (strcmp(name, s_power_state_names[i]) == 0) {
+							s_current_ma[i] = ma;
+							found = true;
+						}
+					}
+				}
+				if (!found)
+					usage();
+				break;
+			}
+			case 'b':
+				s_battery_mah = atof(optarg);
+				break;
+			case 't':
+				s_trigger_rate_per_hour = atof(optarg);
+				break;
+			case 'r':
+				srand(atoi(optarg));
+				break;
+			case 'v':
+				s_verbose = true;
+				break;
+			default:
+				usage();
+		}
+	}
+	if (optind >= argc || argc - optind > 2 || days <= 0)
+		usage();
+	s_schedule_path = argv[optind];
+	if (argc - optind == 2)
+		s_settings_path = argv[optind + 1];
+
+	s_start = timegm(&start_tm);
+	s_end = s_start + (time_t) (days * SECONDS_PER_DAY);
+	g_sim_now = s_start;
+
+	// The settings are needed for any solar times in the schedule:
+	if (s_settings_path)
+		parse_settings_file();
+	calculate_schedule();
+	if (s_tz)
+		check_time_zone();
+
+	// Fresh power up, so nothing retained:
+	memset(g_sim_bkpsram, 0, sizeof(g_sim_bkpsram));
+	run();
+
+	check_start_times();
+	print_report();
+
+	return s_warnings ? 1 : 0;
+}
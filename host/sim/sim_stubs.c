@@ -0,0 +1,194 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <strings.h>
+#include "main.h"
+#include "rtc.h"
+#include "storage.h"
+#include "streaming.h"
+#include "recording.h"
+#include "data_acquisition.h"
+#include "data_processor_buffers.h"
+#include "lowpower.h"
+#include "gain.h"
+#include "ltsa.h"
+#include "agc.h"
+#include "second_pass.h"
+#include "runtime_config.h"
+#include "sim.h"
+
+/*
+ * Stand ins for the firmware modules that auto mode drives but which we don't build
+ * for the host. They tell the simulator what power state we are in.
+ */
+
+RTC_HandleTypeDef hrtc;
+
+int stricmp(const char *s1, const char *s2)
+{
+	return strcasecmp(s1, s2);
+}
+
+void streaming_start(int sampling_rate_index)
+{
+	UNUSED(sampling_rate_index);
+	sim_set_listening(true);
+}
+
+void streaming_stop(void)
+{
+	sim_set_listening(false);
+}
+
+void gain_set(int gain_index, bool disabled)
+{
+	sim_log("gain range %d%s", gain_index, disabled ? " (disabled)" : "");
+}
+
+void runtime_config_update(void)
+{
+}
+
+void data_acquisition_enable_capture(bool flag)
+{
+	UNUSED(flag);
+}
+
+void data_acquisition_set_processor(data_processor_t processor)
+{
+	UNUSED(processor);
+}
+
+void data_processor_buffers(const sample_type_t *pData, int buffer_offset, int count)
+{
+	UNUSED(pData);
+	UNUSED(buffer_offset);
+	UNUSED(count);
+}
+
+void data_processor_buffers_reset(data_processor_mode_t mode, int samples_per_second)
+{
+	UNUSED(mode);
+	UNUSED(samples_per_second);
+}
+
+bool data_processor_buffers_is_busy(void)
+{
+	return sim_is_recording();
+}
+
+// Recording: only SD card use matters to us.
+
+void recording_open(int sampling_rate)
+{
+	UNUSED(sampling_rate);
+	if (settings_get()->write_settings_to_sd)
+		sim_note_sd_mount();
+}
+
+void recording_reopen(void) {}
+
+void recording_prime(void)
+{
+	sim_note_sd_mount();
+}
+
+void recording_close(void) {}
+
+void ltsa_start(int sampling_rate)
+{
+	UNUSED(sampling_rate);
+}
+
+void ltsa_stop(void) {}
+
+void ltsa_end_file(void) {}
+
+void agc_start(bool resume)
+{
+	UNUSED(resume);
+}
+
+void agc_stop(void) {}
+
+void agc_note_gain_change(void) {}
+
+// Nothing is recorded, so there is nothing for the second pass to check:
+bool second_pass_is_idle(void)
+{
+	return true;
+}
+
+// Storage and FileX: enough to read schedule.json from the host file system.
+
+static FX_MEDIA s_medium;
+static FILE *s_pFile = NULL;
+
+FX_MEDIA *storage_mount(storage_write_type_t bandwidth)
+{
+	UNUSED(bandwidth);
+	sim_note_sd_mount();
+	return &s_medium;
+}
+
+void storage_unmount(bool clean_unmount)
+{
+	UNUSED(clean_unmount);
+}
+
+UINT _fxe_file_open(FX_MEDIA *media_ptr, FX_FILE *file_ptr, CHAR *file_name,
+		UINT open_type, UINT file_control_block_size)
+{
+	UNUSED(media_ptr);
+	UNUSED(file_ptr);
+	UNUSED(open_type);
+	UNUSED(file_control_block_size);
+
+	// The only file auto mode opens is schedule.json:
+	if (strcmp(file_name, "schedule.json") != 0)
+		return FX_NOT_FOUND;
+	s_pFile = fopen(sim_get_schedule_path(), "rb");
+	return s_pFile ? FX_SUCCESS : FX_NOT_FOUND;
+}
+
+UINT _fxe_file_read(FX_FILE *file_ptr, VOID *buffer_ptr, ULONG request_size, ULONG *actual_size)
+{
+	UNUSED(file_ptr);
+	*actual_size = s_pFile ? fread(buffer_ptr, 1, request_size, s_pFile) : 0;
+	return FX_SUCCESS;
+}
+
+UINT _fxe_file_close(FX_FILE *file_ptr)
+{
+	UNUSED(file_ptr);
+	if (s_pFile)
+		fclose(s_pFile);
+	s_pFile = NULL;
+	return FX_SUCCESS;
+}
+
+lowpower_wake_t lowpower_stop(uint32_t seconds)
+{
+	sim_stop(seconds);
+	return LOWPOWER_WAKE_TIMER;
+}
@@ -0,0 +1,345 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "solar.h"
+
+/*
+ * Checks solar.c against a reference. solar.c works out NOAA's solar calculator spreadsheet
+ * algorithm (after Meeus) in single precision, refining each event a few times. The
+ * reference is the same algorithm in double precision, and finds each event by searching
+ * for the moment the sun crosses the zenith angle. It runs every day of a year and of a
+ * leap year, at latitudes from the equator to beyond the polar circles:
+ *
+ * 	- Sunrise, sunset, dawn and dusk must be within TOLERANCE_MINUTES of the reference
+ * 	  wherever both have them.
+ * 	- Whether the sun rises and sets, and whether there is civil twilight, must agree with
+ * 	  the reference, except on the days either side of a change, where it comes down to
+ * 	  seconds.
+ * 	- Some days have known answers: at 78 N there is no sunset at midsummer and no sunrise
+ * 	  at midwinter, and at 70 N there is civil twilight at midwinter but no sunrise.
+ *
+ * Each failure is reported, and the exit status is 1 if there were any. -v lists the
+ * worst error at each latitude.
+ *
+ * Usage: solar_test [-v]
+ */
+
+#define TOLERANCE_MINUTES 3.6
+#define ZENITH_SUNRISE_SUNSET 90.833
+#define ZENITH_CIVIL_TWILIGHT 96.0
+
+#define DEG_TO_RAD(d) ((d) * (M_PI / 180.0))
+#define RAD_TO_DEG(r) ((r) * (180.0 / M_PI))
+
+typedef struct {
+	const char *name;
+	double latitude, longitude;
+} place_t;
+
+static const place_t s_places[] = {
+	{ "Quito", -0.2, -78.5 },
+	{ "Singapore", 1.35, 103.8 },
+	{ "Cape Town", -33.9, 18.4 },
+	{ "Los Angeles", 34.1, -118.2 },
+	{ "London", 51.5, -0.1 },
+	{ "Oslo", 59.9, 10.8 },
+	{ "Fairbanks", 64.8, -147.7 },
+	{ "Tromso", 69.6, 18.9 },
+	{ "Longyearbyen", 78.2, 15.6 },
+	{ "McMurdo", -77.8, 166.7 },
+};
+
+static const int s_years[] = { 2026, 2028 };
+
+static int s_checks = 0, s_failures = 0;
+
+#define CHECK(condition, ...) check((condition), __LINE__, __VA_ARGS__)
+
+static void check(bool ok, int line, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+static void check(bool ok, int line, const char *format, ...)
+{
+	s_checks++;
+	if (!ok) {
+		va_list args;
+		va_start(args, format);
+		fprintf(stderr, "solar_test.c:%d: check failed: ", line);
+		vfprintf(stderr, format, args);
+		fputc('\n', stderr);
+		va_end(args);
+		s_failures++;
+	}
+}
+
+/*
+ * The reference.
+ */
+
+static double julian_day(int year, int month, int day)
+{
+	// At 0h UTC:
+	const int a = (14 - month) / 12;
+	const int y = year + 4800 - a;
+	const int m = month + 12 * a - 3;
+	const long jdn = day + (153 * m + 2) / 5 + 365L * y + y / 4 - y / 100 + y / 400 - 32045;
+	return jdn - 0.5;
+}
+
+/**
+ * The sun's declination in radians and the equation of time in minutes, at a Julian day.
+ */
+static void reference_position(double jd, double *pDecl, double *pEqtime)
+{
+	const double t = (jd - 2451545.0) / 36525.0;
+	const double l0 = fmod(280.46646 + t * (36000.76983 + t * 0.0003032), 360.0);
+	const double m = 357.52911 + t * (35999.05029 - 0.0001537 * t);
+	const double e = 0.016708634 - t * (0.000042037 + 0.0000001267 * t);
+	const double c = sin(DEG_TO_RAD(m)) * (1.914602 - t * (0.004817 + 0.000014 * t))
+			+ sin(DEG_TO_RAD(2 * m)) * (0.019993 - 0.000101 * t)
+			+ sin(DEG_TO_RAD(3 * m)) * 0.000289;
+	const double omega = 125.04 - 1934.136 * t;
+	const double apparent_longitude = l0 + c - 0.00569 - 0.00478 * sin(DEG_TO_RAD(omega));
+	const double mean_obliquity = 23.0 + (26.0 + (21.448 - t * (46.815 + t * (0.00059 - t * 0.001813))) / 60.0) / 60.0;
+	const double obliquity = DEG_TO_RAD(mean_obliquity + 0.00256 * cos(DEG_TO_RAD(omega)));
+
+	*pDecl = asin(sin(obliquity) * sin(DEG_TO_RAD(apparent_longitude)));
+
+	const double y = tan(obliquity / 2) * tan(obliquity / 2);
+	const double l0_rad = DEG_TO_RAD(l0), m_rad = DEG_TO_RAD(m);
+	*pEqtime = 4 * RAD_TO_DEG(y * sin(2 * l0_rad) - 2 * e * sin(m_rad) + 4 * e * y * sin(m_rad) * cos(2 * l0_rad)
+			- 0.5 * y * y * sin(4 * l0_rad) - 1.25 * e * e * sin(2 * m_rad));
+}
+
+/**
+ * How far the sun's centre is from the zenith, in degrees, at a time in minutes after
+ * midnight UTC on the Julian day jd0.
+ */
+static double reference_zenith(double jd0, double minutes, double latitude, double longitude)
+{
+	double decl, eqtime;
+	reference_position(jd0 + minutes / 1440, &decl, &eqtime);
+	const double hour_angle = DEG_TO_RAD((minutes + eqtime + 4 * longitude) / 4 - 180);
+	const double lat = DEG_TO_RAD(latitude);
+	const double cos_zenith = sin(lat) * sin(decl) + cos(lat) * cos(decl) * cos(hour_angle);
+	return RAD_TO_DEG(acos(fmax(-1, fmin(1, cos_zenith))));
+}
+
+/**
+ * Minutes after midnight UTC when the sun crosses zenith_deg in the half day before local
+ * noon (direction -1) or after it (1), with the sun's position taken at that moment rather
+ * than worked out once for the day. Returns false if it doesn't cross.
+ */
+static bool reference_event(double jd0, double zenith_deg, double latitude, double longitude, int direction,
+		double *pMinutes)
+{
+	double decl, eqtime;
+	reference_position(jd0 + 0.5, &decl, &eqtime);
+	const double noon = 720 - 4 * longitude - eqtime;
+
+	// Walk away from noon a minute at a time until the sun is on the other side, then bisect:
+	double inner = noon, outer = noon;
+	const bool above_at_noon = reference_zenith(jd0, noon, latitude, longitude) < zenith_deg;
+	int step = 1;
+	for (; step <= 720; step++) {
+		outer = noon + direction * step;
+		if ((reference_zenith(jd0, outer, latitude, longitude) < zenith_deg) != above_at_noon)
+			break;
+		inner = outer;
+	}
+	if (step > 720 || !above_at_noon)
+		return false;
+
+	for (int i = 0; i < 30; i++) {
+		const double middle = (inner + outer) / 2;
+		if (reference_zenith(jd0, middle, latitude, longitude) < zenith_deg)
+			inner = middle;
+		else
+			outer = middle;
+	}
+	*pMinutes = (inner + outer) / 2;
+	return true;
+}
+
+typedef struct {
+	bool sunrise_sunset_valid;
+	double sunrise, sunset;
+	bool dawn_dusk_valid;
+	double dawn, dusk;
+} reference_day_t;
+
+static void reference_day(int year, int month, int day, const place_t *pPlace, reference_day_t *pResult)
+{
+	const double jd0 = julian_day(year, month, day);
+	const double lat = pPlace->latitude, lon = pPlace->longitude;
+	pResult->sunrise_sunset_valid =
+			reference_event(jd0, ZENITH_SUNRISE_SUNSET, lat, lon, -1, &pResult->sunrise)
+			&& reference_event(jd0, ZENITH_SUNRISE_SUNSET, lat, lon, 1, &pResult->sunset);
+	pResult->dawn_dusk_valid =
+			reference_event(jd0, ZENITH_CIVIL_TWILIGHT, lat, lon, -1, &pResult->dawn)
+			&& reference_event(jd0, ZENITH_CIVIL_TWILIGHT, lat, lon, 1, &pResult->dusk);
+}
+
+/*
+ * The checks.
+ */
+
+static int days_in_month(int year, int month)
+{
+	static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	const bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+	return days[month - 1] + (month == 2 && leap);
+}
+
+static double error_minutes(int minutes, double reference)
+{
+	return fabs(minutes - reference);
+}
+
+typedef struct {
+	int year, month, day;
+	reference_day_t ref;
+} dated_reference_t;
+
+static void check_times(const place_t *pPlace, const dated_reference_t *pd, double *pWorst)
+{
+	const solar_day_t *ps = solar_get_day(pd->year, pd->month, pd->day, pPlace->latitude, pPlace->longitude);
+	const reference_day_t *pr = &pd->ref;
+	if (ps->sunrise_sunset_valid && pr->sunrise_sunset_valid) {
+		const double rise = error_minutes(ps->sunrise_minutes, pr->sunrise);
+		const double set = error_minutes(ps->sunset_minutes, pr->sunset);
+		CHECK(rise <= TOLERANCE_MINUTES, "%s %04d-%02d-%02d: sunrise %d, reference %.1f",
+				pPlace->name, pd->year, pd->month, pd->day, ps->sunrise_minutes, pr->sunrise);
+		CHECK(set <= TOLERANCE_MINUTES, "%s %04d-%02d-%02d: sunset %d, reference %.1f",
+				pPlace->name, pd->year, pd->month, pd->day, ps->sunset_minutes, pr->sunset);
+		*pWorst = fmax(*pWorst, fmax(rise, set));
+	}
+	if (ps->dawn_dusk_valid && pr->dawn_dusk_valid) {
+		const double dawn = error_minutes(ps->dawn_minutes, pr->dawn);
+		const double dusk = error_minutes(ps->dusk_minutes, pr->dusk);
+		CHECK(dawn <= TOLERANCE_MINUTES, "%s %04d-%02d-%02d: dawn %d, reference %.1f",
+				pPlace->name, pd->year, pd->month, pd->day, ps->dawn_minutes, pr->dawn);
+		CHECK(dusk <= TOLERANCE_MINUTES, "%s %04d-%02d-%02d: dusk %d, reference %.1f",
+				pPlace->name, pd->year, pd->month, pd->day, ps->dusk_minutes, pr->dusk);
+		*pWorst = fmax(*pWorst, fmax(dawn, dusk));
+	}
+}
+
+static void check_validity(const place_t *pPlace, const dated_reference_t *pPrevious, const dated_reference_t *pd,
+		const dated_reference_t *pNext)
+{
+	const solar_day_t *ps = solar_get_day(pd->year, pd->month, pd->day, pPlace->latitude, pPlace->longitude);
+	const reference_day_t *pr = &pd->ref;
+	const bool rise_changing = pPrevious->ref.sunrise_sunset_valid != pr->sunrise_sunset_valid
+			|| pNext->ref.sunrise_sunset_valid != pr->sunrise_sunset_valid;
+	const bool twilight_changing = pPrevious->ref.dawn_dusk_valid != pr->dawn_dusk_valid
+			|| pNext->ref.dawn_dusk_valid != pr->dawn_dusk_valid;
+	CHECK(rise_changing || ps->sunrise_sunset_valid == pr->sunrise_sunset_valid,
+			"%s %04d-%02d-%02d: sunrise and sunset %s, but not in the reference", pPlace->name,
+			pd->year, pd->month, pd->day, ps->sunrise_sunset_valid ? "valid" : "invalid");
+	CHECK(twilight_changing || ps->dawn_dusk_valid == pr->dawn_dusk_valid,
+			"%s %04d-%02d-%02d: dawn and dusk %s, but not in the reference", pPlace->name,
+			pd->year, pd->month, pd->day, ps->dawn_dusk_valid ? "valid" : "invalid");
+}
+
+static void check_place(const place_t *pPlace, int year, bool verbose)
+{
+	// The days of the year with a day of the years either side, for telling when the
+	// reference is about to change:
+	static dated_reference_t days[368];
+	int count = 0;
+	for (int y = year - 1; y <= year + 1; y++) {
+		for (int month = 1; month <= 12; month++) {
+			for (int day = 1; day <= days_in_month(y, month); day++) {
+				if ((y < year && (month < 12 || day < 31)) || (y > year && (month > 1 || day > 1)))
+					continue;
+				dated_reference_t *pd = &days[count++];
+				pd->year = y;
+				pd->month = month;
+				pd->day = day;
+				reference_day(y, month, day, pPlace, &pd->ref);
+			}
+		}
+	}
+
+	double worst = 0;
+	for (int i = 1; i + 1 < count; i++) {
+		check_times(pPlace, &days[i], &worst);
+		check_validity(pPlace, &days[i - 1], &days[i], &days[i + 1]);
+	}
+	if (verbose)
+		printf("%-14s %6.1f %7.1f  %d  worst error %.2f minutes\n", pPlace->name, pPlace->latitude,
+				pPlace->longitude, year, worst);
+}
+
+static void check_polar_days(void)
+{
+	// Longyearbyen: midnight sun and polar night, with no civil twilight in the middle of winter:
+	const solar_day_t *ps = solar_get_day(2026, 6, 21, 78.2, 15.6);
+	CHECK(!ps->sunrise_sunset_valid && !ps->dawn_dusk_valid, "Longyearbyen midsummer: the sun sets");
+	ps = solar_get_day(2026, 12, 21, 78.2, 15.6);
+	CHECK(!ps->sunrise_sunset_valid && !ps->dawn_dusk_valid, "Longyearbyen midwinter: the sun rises");
+	ps = solar_get_day(2026, 3, 20, 78.2, 15.6);
+	CHECK(ps->sunrise_sunset_valid && ps->dawn_dusk_valid, "Longyearbyen equinox: no sunrise or sunset");
+	CHECK(ps->sunrise_minutes < 720 && ps->sunset_minutes > 720, "Longyearbyen equinox: sunrise after sunset");
+
+	// Tromso: no sunrise at midwinter, but it gets light around noon:
+	ps = solar_get_day(2026, 12, 21, 69.6, 18.9);
+	CHECK(!ps->sunrise_sunset_valid, "Tromso midwinter: the sun rises");
+	CHECK(ps->dawn_dusk_valid && ps->dawn_minutes < ps->dusk_minutes, "Tromso midwinter: no civil twilight");
+
+	// McMurdo, the other way round:
+	ps = solar_get_day(2026, 12, 21, -77.8, 166.7);
+	CHECK(!ps->sunrise_sunset_valid, "McMurdo midsummer: the sun sets");
+	ps = solar_get_day(2026, 6, 21, -77.8, 166.7);
+	CHECK(!ps->sunrise_sunset_valid && !ps->dawn_dusk_valid, "McMurdo midwinter: the sun rises");
+
+	// The equator always has both, with about 12 hours between sunrise and sunset:
+	ps = solar_get_day(2026, 6, 21, 0, 0);
+	CHECK(ps->sunrise_sunset_valid && ps->dawn_dusk_valid, "Equator: no sunrise or sunset");
+	CHECK(abs(ps->sunset_minutes - ps->sunrise_minutes - 727) <= 3, "Equator: day is %d minutes",
+			ps->sunset_minutes - ps->sunrise_minutes);
+}
+
+int main(int argc, char *argv[])
+{
+	bool verbose = false;
+	if (argc == 2 && strcmp(argv[1], "-v") == 0)
+		verbose = true;
+	else if (argc != 1) {
+		fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+		return 2;
+	}
+
+	solar_init();
+	for (size_t i = 0; i < sizeof(s_places) / sizeof(s_places[0]); i++)
+		for (size_t y = 0; y < sizeof(s_years) / sizeof(s_years[0]); y++)
+			check_place(&s_places[i], s_years[y], verbose);
+	check_polar_days();
+
+	printf("%d checks, %d failures\n", s_checks, s_failures);
+	return s_failures ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+/**
+ * Copyright (c) 2022-2026 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MY_HOST_STM32U5XX_HAL_H
+#define MY_HOST_STM32U5XX_HAL_H
+
+/*
+ * Stands in for the real HAL when firmware modules are built for the host. This comes
+ * first on the include path, so main.h and friends pick it up instead of the real one.
+ * Only what the host built modules use is here: types, constants and functions, with
+ * register access replaced by simulated state in sim_hal.c or host/core. Add to it as
+ * needed.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+// newlib declares this, glibc doesn't:
+int stricmp(const char *s1, const char *s2);
+
+#define UNUSED(X) (void)X
+#define __ALIGNED(x) __attribute__((aligned(x)))
+#define __IO volatile
+
+#ifndef MIN
+#define MIN(a, b)  (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b)  (((a) > (b)) ? (a) : (b))
+#endif
+
+typedef enum {
+	HAL_OK = 0x00,
+	HAL_ERROR = 0x01,
+	HAL_BUSY = 0x02,
+	HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+// Peripheral handles the firmware headers declare but the host modules don't use:
+typedef struct { int dummy; } ADC_HandleTypeDef;
+typedef struct { int dummy; } SPI_HandleTypeDef;
+typedef struct { int dummy; } GPIO_TypeDef;
+
+// data_acquisition.c's DMA interrupt callbacks, which a tool calls to deliver data:
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc);
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc);
+
+// storage.c checks the SD handle for errors after mounting:
+typedef struct {
+	uint32_t ErrorCode;
+} SD_HandleTypeDef;
+
+// The cycle counter the profiler reads. Nothing advances it, so profiles come out empty:
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+} DWT_Type;
+
+extern DWT_Type g_host_dwt;
+#define DWT (&g_host_dwt)
+
+// Everything runs from the same memory here:
+#define RAM_TEXT_SECTION
+
+// Interrupts are always "enabled" here, and masking them does nothing:
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t priMask) { (void) priMask; }
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+
+#define GPIOB ((GPIO_TypeDef *) 0)
+#define GPIOC ((GPIO_TypeDef *) 0)
+#define GPIO_PIN_0 ((uint16_t) 0x0001)
+#define GPIO_PIN_1 ((uint16_t) 0x0002)
+#define GPIO_PIN_2 ((uint16_t) 0x0004)
+#define GPIO_PIN_3 ((uint16_t) 0x0008)
+#define GPIO_PIN_5 ((uint16_t) 0x0020)
+#define GPIO_PIN_6 ((uint16_t) 0x0040)
+#define GPIO_PIN_7 ((uint16_t) 0x0080)
+#define GPIO_PIN_13 ((uint16_t) 0x2000)
+#define GPIO_PIN_14 ((uint16_t) 0x4000)
+#define GPIO_PIN_15 ((uint16_t) 0x8000)
+
+typedef enum {
+	GPIO_PIN_RESET = 0u,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+GPIO_PinState HAL_GPIO_ReadPin(const GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+void HAL_Delay(uint32_t Delay);
+uint32_t HAL_GetTick(void);
+void HAL_SuspendTick(void);
+void HAL_ResumeTick(void);
+void HAL_DBGMCU_EnableDBGStandbyMode(void);
+void HAL_DBGMCU_EnableDBGStopMode(void);
+
+HAL_StatusTypeDef HAL_SPI_Transmit_IT(SPI_HandleTypeDef *hspi, const uint8_t *pData, uint16_t Size);
+
+// SD: the FileX driver's glue calls these, and host/core/core_sd.c has a card in memory.
+#define HAL_SD_ERROR_NONE 0x00000000u
+#define BLOCKSIZE ((uint32_t) 512u)
+
+typedef uint32_t HAL_SD_CardStateTypeDef;
+#define HAL_SD_CARD_TRANSFER 0x00000004u
+#define HAL_SD_CARD_ERROR 0x000000FFu
+
+HAL_SD_CardStateTypeDef HAL_SD_GetCardState(SD_HandleTypeDef *hsd);
+HAL_StatusTypeDef HAL_SD_ReadBlocks_DMA(SD_HandleTypeDef *hsd, uint8_t *pData, uint32_t BlockAdd, uint32_t NumberOfBlocks);
+HAL_StatusTypeDef HAL_SD_WriteBlocks_DMA(SD_HandleTypeDef *hsd, const uint8_t *pData, uint32_t BlockAdd, uint32_t NumberOfBlocks);
+void HAL_SD_TxCpltCallback(SD_HandleTypeDef *hsd);
+void HAL_SD_RxCpltCallback(SD_HandleTypeDef *hsd);
+
+// RTC: backed by the virtual clock in sim_hal.c, or the host clock in host/core.
+typedef struct { int dummy; } RTC_HandleTypeDef;
+
+typedef struct {
+	uint8_t Hours;
+	uint8_t Minutes;
+	uint8_t Seconds;
+	uint8_t TimeFormat;
+	uint32_t SubSeconds;
+	uint32_t SecondFraction;
+	uint32_t DayLightSaving;
+	uint32_t StoreOperation;
+} RTC_TimeTypeDef;
+
+typedef struct {
+	uint8_t WeekDay;
+	uint8_t Month;
+	uint8_t Date;
+	uint8_t Year;
+} RTC_DateTypeDef;
+
+typedef struct {
+	RTC_TimeTypeDef AlarmTime;
+	uint32_t AlarmMask;
+	uint32_t AlarmSubSecondMask;
+	uint32_t BinaryAutoClr;
+	uint32_t AlarmDateWeekDaySel;
+	uint8_t AlarmDateWeekDay;
+	uint32_t Alarm;
+} RTC_AlarmTypeDef;
+
+#define RTC_FORMAT_BIN 0x00000000u
+#define RTC_FORMAT_BCD 0x00000001u
+#define RTC_ALARMMASK_NONE 0x00000000u
+#define RTC_ALARMSUBSECONDMASK_ALL 0x00000000u
+#define RTC_ALARMDATEWEEKDAYSEL_DATE 0x00000000u
+#define RTC_ALARM_A 0x00000100u
+#define RTC_WAKEUPCLOCK_CK_SPRE_16BITS 0x00000004u
+
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_SetAlarm_IT(RTC_HandleTypeDef *hrtc, RTC_AlarmTypeDef *sAlarm, uint32_t Format);
+void HAL_RTC_AlarmAEventCallback(RTC_HandleTypeDef *hrtc);
+uint8_t RTC_ByteToBcd2(uint8_t Value);
+uint8_t RTC_Bcd2ToByte(uint8_t Value);
+
+// PWR and RCC: standby, retention and the supply, as used by mode_auto.c and retained.c.
+typedef struct {
+	volatile uint32_t CR1;
+} PWR_TypeDef;
+
+extern PWR_TypeDef g_sim_pwr;
+#define PWR (&g_sim_pwr)
+
+#define PWR_SMPS_SUPPLY 0x00000002u
+#define PWR_LDO_SUPPLY 0x00000000u
+#define PWR_GPIO_C 0x00000002u
+#define PWR_WAKEUP_PIN2_HIGH_1 0x00000002u
+#define PWR_WAKEUP_PIN7_HIGH_3 0x00000040u
+#define PWR_WAKEUP_FLAG2 0x00000002u
+#define PWR_FLAG_SBF 0x00000100u
+
+uint32_t sim_pwr_get_flag(uint32_t flag);
+void sim_pwr_clear_flag(uint32_t flag);
+#define __HAL_PWR_GET_FLAG(FLAG) (sim_pwr_get_flag(FLAG) != 0)
+#define __HAL_PWR_CLEAR_FLAG(FLAG) sim_pwr_clear_flag(FLAG)
+#define __HAL_RCC_BKPSRAM_CLK_ENABLE() do { } while (0)
+
+HAL_StatusTypeDef HAL_PWREx_ConfigSupply(uint32_t SupplySource);
+HAL_StatusTypeDef HAL_PWREx_EnableGPIOPullUp(uint32_t GPIO_Port, uint32_t GPIO_Pin);
+void HAL_PWREx_EnablePullUpPullDownConfig(void);
+void HAL_PWREx_EnableBkupRAMRetention(void);
+void HAL_PWR_EnableWakeUpPin(uint32_t WakeUpPin);
+void HAL_PWR_EnterSTANDBYMode(void);
+
+// Backup SRAM is ordinary memory here, so it survives simulated standby like the real thing:
+#define SIM_BKPSRAM_SIZE 2048
+extern uint8_t g_sim_bkpsram[SIM_BKPSRAM_SIZE];
+#define BKPSRAM_BASE ((uintptr_t) g_sim_bkpsram)
+
+#endif // MY_HOST_STM32U5XX_HAL_H